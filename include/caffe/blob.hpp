@@ -24,7 +24,7 @@ template <typename Dtype>
 class Blob {
  public:
   Blob()
-       : data_(), diff_(), count_(0), capacity_(0) {}
+       : data_(), diff_(), count_(0), capacity_(0), zero_fill_data_(true) {}
 
   /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
   explicit Blob(const int num, const int channels, const int height,
@@ -211,6 +211,18 @@ class Blob {
     return data_;
   }
 
+  /// @brief Version of the data, see SyncedMemory::version(); 0 if the blob
+  ///        has no data yet. Caches derived from a blob compare against it.
+  inline uint64_t data_version() const {
+    return data_ ? data_->version() : 0;
+  }
+
+  /// @brief Whether the data is zeroed when first used on the host, see
+  ///        SyncedMemory::set_zero_fill; kept when Reshape reallocates.
+  ///        Layers that overwrite a top in full turn it off for that top.
+  void set_zero_fill_data(bool zero_fill);
+  inline bool zero_fill_data() const { return zero_fill_data_; }
+
   inline const shared_ptr<SyncedMemory>& diff() const {
     CHECK(diff_);
     return diff_;
@@ -282,6 +294,16 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  //CUSTOMIZATION
+  /**
+   * @brief Set the data_ shared_ptr to memory, which holds at least count()
+   *        elements and may be shared with other Blob%s -- used by Net to let
+   *        blobs that are never alive at the same time share memory.
+   *
+   * Reshaping to more than count() elements afterwards gives this Blob
+   * memory of its own again.
+   */
+  void set_data_memory(const shared_ptr<SyncedMemory>& memory);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -292,6 +314,7 @@ class Blob {
   vector<int> shape_;
   int count_;
   int capacity_;
+  bool zero_fill_data_;
 
   DISABLE_COPY_AND_ASSIGN(Blob);
 };  // class Blob
@@ -96,6 +96,8 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+class ThreadPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -171,6 +173,13 @@ class Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+  // Number of threads a CPU layer may split its work over (default 1). Like
+  // the mode it belongs to the calling thread.
+  inline static int num_threads() { return Get().num_threads_; }
+  static void set_num_threads(int num_threads);
+  // The worker threads of the calling thread, with at least num_threads
+  // threads (the caller included); created on first use.
+  static ThreadPool& thread_pool(int num_threads);
 
  protected:
 #ifndef CPU_ONLY
@@ -186,6 +195,10 @@ class Caffe {
   int solver_rank_;
   bool multiprocess_;
 
+  // Intra-layer CPU parallelism
+  int num_threads_;
+  shared_ptr<ThreadPool> thread_pool_;
+
  private:
   // The private constructor to avoid duplicate instantiation.
   Caffe();
@@ -0,0 +1,117 @@
+#ifndef CAFFE_INFERENCE_SERVER_HPP_
+#define CAFFE_INFERENCE_SERVER_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief One item to run a net on, and once it is served the items of the
+ *        outputs of the net.
+ */
+template <typename Dtype>
+class InferenceRequest {
+ public:
+  /// The input has shape, the shape of the input of the net for one item:
+  /// 1 along the first axis.
+  explicit InferenceRequest(const vector<int>& shape);
+
+  const Blob<Dtype>& input() const { return input_; }
+  Blob<Dtype>* mutable_input() { return &input_; }
+  /// Blocks until the request is served.
+  void Wait();
+  bool done() const;
+  /// The items of the output blobs of the net, in their order.
+  const vector<shared_ptr<Blob<Dtype> > >& outputs() const {
+    return outputs_;
+  }
+  /// The time from InferenceServer::Submit to done, in microseconds.
+  double latency_us() const { return latency_us_; }
+
+ protected:
+  void Done();
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  Blob<Dtype> input_;
+  vector<shared_ptr<Blob<Dtype> > > outputs_;
+  boost::posix_time::ptime submit_time_;
+  double latency_us_;
+  bool done_;
+  shared_ptr<sync> sync_;
+
+  template <typename T> friend class InferenceServer;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceRequest);
+};
+
+/**
+ * @brief Serves the forward passes of a net from worker threads, running the
+ *        requests that arrive together as one batch.
+ *
+ * Each worker owns a replica of the net, which shares the weights of the
+ * first through Net::ShareTrainedLayersWith. A free worker takes the oldest
+ * request along with the queued ones of the same shape, up to
+ * max_batch_size of them, waiting for more until max_delay_us after the
+ * oldest was submitted. A replica is only reshaped when its batch shape
+ * changes. The net must have one input, and its outputs must have the batch
+ * along their first axis.
+ */
+template <typename Dtype>
+class InferenceServer {
+ public:
+  InferenceServer(const NetParameter& param, const string& trained_filename,
+      int num_workers, int max_batch_size, int max_delay_us);
+  /// Stops the workers; the requests still queued are never served.
+  ~InferenceServer();
+
+  void Submit(const shared_ptr<InferenceRequest<Dtype> >& request);
+
+  /// The net of the first worker, whose weights the others share. Its blobs
+  /// are reshaped by the worker; see input_item_shape for the input shape.
+  const Net<Dtype>& net() const;
+  /// The shape of the net input as set up, with 1 as its first axis, which
+  /// is the shape of the requests the net takes without reshaping.
+  const vector<int>& input_item_shape() const { return input_item_shape_; }
+  int num_workers() const { return workers_.size(); }
+  /// The number of batches run so far.
+  int num_batches() const;
+
+ protected:
+  class Worker;
+  /// Blocks until a batch is due, and takes its requests from the queue.
+  void NextBatch(vector<shared_ptr<InferenceRequest<Dtype> > >* batch);
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  const int max_batch_size_;
+  const int max_delay_us_;
+  vector<int> input_item_shape_;
+  vector<shared_ptr<Worker> > workers_;
+  std::deque<shared_ptr<InferenceRequest<Dtype> > > queue_;
+  int num_batches_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceServer);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SERVER_HPP_
@@ -36,6 +36,8 @@ class AnnotatedDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<db::DB> db_;
   shared_ptr<db::Cursor> cursor_;
   uint64_t offset_;
+  // Whether cursor_ only reads the records of this solver.
+  bool sharded_;  //CUSTOMIZATION
   bool has_anno_type_;
   AnnotatedDatum_AnnotationType anno_type_;
   vector<BatchSampler> batch_samplers_;
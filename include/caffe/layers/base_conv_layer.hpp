@@ -18,7 +18,8 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), nhwc_(false), num_threads_(0),
+        has_weight_zero_point_(false), nhwc_weight_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   template <typename LayerParam> void LayerSetUpInternal(LayerParam conv_param, const vector<Blob<Dtype>*>& bottom,
@@ -42,6 +43,46 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Integer counterpart of forward_cpu_gemm for quantized 2D convolution:
+  // uint8 input and weights with their zero points, int32 output. The
+  // per-output-channel weight zero points and row sums come from packing.
+  void forward_cpu_qgemm(const uint8_t* input, const int input_zero_point,
+      const uint8_t* weights, const int* weight_zero_point,
+      const int* weight_row_sum, int* output);
+  // Zero-point handling of the quantized float forward, which reads the
+  // weights W and the input x as they are: with zw and zx their zero points,
+  // (W - zw) * (x - zx) = W * x - zw * sum(x) + T, where T, the layer applied
+  // with the weights W - zw to an image of -zx, is the zero_point_bias_ of
+  // Reshape. The middle term, zw times the sum of the taps of each output,
+  // is subtracted by forward_cpu_weight_zero_point from the output of the
+  // groups [group_begin, group_end) of an image whose im2col (or input, for
+  // 1x1 convolutions) is col_buff, with tap_sum as conv_out_spatial_dim_
+  // items of scratch memory.
+  void UpdateZeroPointBias();
+  void forward_cpu_weight_zero_point(const Dtype* col_buff,
+      const int group_begin, const int group_end, Dtype* tap_sum,
+      Dtype* output);
+  // The forward of a deconvolution for all num_ images: backward_cpu_gemm,
+  // with the columns corrected for the weight zero point before col2im, T,
+  // forward_cpu_bias (unless bias is NULL) and the fused activation.
+  void forward_cpu_deconv_gemm_batch(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, Dtype* output);
+  // Runs forward_cpu_gemm, the zero-point corrections and forward_cpu_bias
+  // (unless bias is NULL) for all num_ images, split over num_threads()
+  // threads.
+  // The work is divided by image and, for grouped 2D convolutions with
+  // fewer images than threads, by ranges of groups; each thread has its own
+  // column buffer, so the results are the same as with one thread.
+  void forward_cpu_gemm_batch(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, Dtype* output);
+  // convolution_param().num_threads() if set, Caffe::num_threads() otherwise.
+  int num_threads() const;
+  // Forward of all num_ images for a layer with data_format NHWC, where
+  // input and output are NHWC: a gemm per image on the im2row_cpu taps (or
+  // on the input itself for 1x1 convolutions), or a direct loop over the
+  // channels for depthwise convolutions. Split over num_threads() threads
+  // by images and, for fewer images than threads, by output rows.
+  void forward_cpu_nhwc(const Dtype* input, const Dtype* bias, Dtype* output);
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -112,8 +153,28 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool per_channel_scale_output_; //CUSTOMIZATION
   int quantize_method_; //CUSTOMIZATION
   bool submanifold_sparse_;
+  // Whether bottom and top are NHWC (LayerParameter.data_format). The layer
+  // is then set up on NCHW shapes, so all the members above keep their
+  // meaning, e.g. channels_ and conv_input_shape_.
+  bool nhwc_; //CUSTOMIZATION
+  int num_threads_; //CUSTOMIZATION
 
  private:
+  // The (num, channels, height, width) view of an NHWC bottom, and the
+  // blob BaseConvolutionLayer shapes as the NCHW top.
+  const vector<Blob<Dtype>*>& nchw_bottom(const vector<Blob<Dtype>*>& bottom);
+  void ReshapeInternal(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // The weights as (num_output, kernel_h, kernel_w, channels / group) rows
+  // for the gemm, or as (kernel_h, kernel_w, channels) for depthwise
+  // convolutions; cached until blobs_[0] is written.
+  const Dtype* nhwc_weight_cpu(bool depthwise);
+  // Output rows [row_begin, row_end) of one NHWC image of a depthwise
+  // convolution.
+  void forward_cpu_nhwc_depthwise(const Dtype* input, const Dtype* weights,
+      const Dtype* bias, const int row_begin, const int row_end,
+      Dtype* output);
+
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -130,6 +191,32 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data(), stride_.cpu_data(), pad_type_, dilation_.cpu_data(), col_buff); //CUSTOMIZATION
     }
   }
+  // 2D im2col of the channels of groups [group_begin, group_end) into the
+  // rows of col_buff those groups use.
+  inline void conv_im2col_cpu(const Dtype* data, int group_begin,
+      int group_end, Dtype* col_buff) {
+    const int height = conv_input_shape_.cpu_data()[1];
+    const int width = conv_input_shape_.cpu_data()[2];
+    const int channels = conv_in_channels_ / group_;
+    im2col_cpu(data + group_begin * channels * height * width,
+        (group_end - group_begin) * channels, height, width,
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        pad_type_, pad_l_, pad_r_, pad_t_, pad_b_, //CUSTOMIZATION
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+        col_buff + col_offset_ * group_begin);
+  }
+  inline void conv_im2col_cpu(const uint8_t* data, uint8_t* col_buff,
+      const uint8_t pad_value) {
+    im2col_cpu(data, conv_in_channels_,
+        conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+        kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+        pad_.cpu_data()[0], pad_.cpu_data()[1],
+        stride_.cpu_data()[0], stride_.cpu_data()[1],
+        pad_type_, pad_l_, pad_r_, pad_t_, pad_b_, //CUSTOMIZATION
+        dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff, pad_value);
+  }
   inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
       col2im_cpu(col_buff, conv_in_channels_,
@@ -193,7 +280,28 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   int output_offset_;
 
   Blob<Dtype> col_buffer_;
+  vector<uint8_t> qcol_buffer_;
+  // The zero-point terms of UpdateZeroPointBias: T (empty without an input
+  // zero point), the weight zero point of each output channel, ones to sum
+  // the taps with, and the blob versions and shapes they were computed for.
+  Blob<Dtype> zero_point_bias_;
+  Blob<Dtype> weight_zero_points_;
+  Blob<Dtype> zero_point_ones_;
+  bool has_weight_zero_point_;
+  vector<uint64_t> zero_point_key_;
+  // Column buffers of the threads of forward_cpu_gemm_batch after the first
+  // one, which uses col_buffer_.
+  vector<shared_ptr<Blob<Dtype> > > worker_col_buffers_;
   Blob<Dtype> bias_multiplier_;
+  Blob<Dtype> nchw_bottom_;
+  Blob<Dtype> nchw_top_;
+  vector<Blob<Dtype>*> nchw_bottom_vec_;
+  vector<Blob<Dtype>*> nchw_top_vec_;
+  Blob<Dtype> nhwc_weight_;
+  uint64_t nhwc_weight_version_;
+  // The im2row_cpu rows, and the output of one group for grouped
+  // convolutions, of each thread of forward_cpu_nhwc.
+  vector<shared_ptr<Blob<Dtype> > > nhwc_buffers_;
 };
 
 }  // namespace caffe
@@ -3,6 +3,8 @@
 
 #include <vector>
 
+#include <boost/function.hpp>
+
 #include "caffe/blob.hpp"
 #include "caffe/data_transformer.hpp"
 #include "caffe/internal_thread.hpp"
@@ -67,9 +69,33 @@ class BasePrefetchingDataLayer :
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+
+  /// @brief Microseconds the last Forward waited for the prefetch thread.
+  float data_wait_us() const { return data_wait_us_; }
+
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  /// @brief Whether load_batch transforms its items through TransformBatch,
+  ///        and so can use transform_threads workers.
+  virtual inline bool TransformsInParallel() const { return false; }
+  // Pops the next loaded batch, timing the wait for data_wait_us().
+  Batch<Dtype>* PopFullBatch(const string& log_on_wait);
+
+  /**
+   * @brief Calls transform(item_id, transformer, transformed_data) for every
+   *        item of a batch, spread over the transform_threads workers.
+   *
+   * Item item_id is handled by worker item_id % transform_threads, which has
+   * a DataTransformer of its own (worker 0 uses data_transformer_) and a
+   * transformed_data blob shaped like transformed_data_. The transformer
+   * and the Caffe RNG of the thread are reseeded for every item from the
+   * calling thread, so the random transformations only depend on the seed,
+   * whatever the number of workers. Called from load_batch; the calls may
+   * run concurrently and must only write their own item.
+   */
+  void TransformBatch(const int batch_size, const boost::function<void(int,
+      DataTransformer<Dtype>*, Blob<Dtype>*)>& transform);
 
   vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
@@ -77,6 +103,11 @@ class BasePrefetchingDataLayer :
   Batch<Dtype>* prefetch_current_;
 
   Blob<Dtype> transformed_data_;
+  //CUSTOMIZATION
+  int transform_threads_;
+  vector<shared_ptr<DataTransformer<Dtype> > > worker_transformers_;
+  vector<shared_ptr<Blob<Dtype> > > worker_transformed_data_;
+  float data_wait_us_;
 };
 
 template <typename Dtype>
@@ -59,6 +59,10 @@ class BatchNormLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  // Normalizes the channels, the last axis, of an NHWC blob with the global
+  // statistics, for layers with data_format NHWC.
+  void Forward_cpu_nhwc(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 
   Blob<Dtype> mean_, variance_, temp_, x_norm_;
   bool use_global_stats_;
@@ -68,6 +72,7 @@ class BatchNormLayer : public Layer<Dtype> {
   bool add_eps_before_sqrt_;
   bool update_global_stats_;
   bool icnet_; //CUSTOMIZATION
+  bool nhwc_; //CUSTOMIZATION
 
   // extra temporarary variables is used to carry out sums/broadcasting
   // using BLAS
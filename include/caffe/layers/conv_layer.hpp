@@ -8,6 +8,7 @@
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/quantized_gemm.hpp"
 
 namespace caffe {
 
@@ -60,9 +61,13 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  - bias_term (\b optional, default true). Whether to have a bias.
    *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
    *    kernels + stream parallelism) engines.
+   *  - integer_engine (\b optional, default false). Run quantized models on
+   *    uint8 operands with int32 accumulators instead of emulating them with
+   *    float GEMM; see Forward_cpu_quantized.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
-      : BaseConvolutionLayer<Dtype>(param) {}
+      : BaseConvolutionLayer<Dtype>(param), qweight_valid_(false),
+        qinput_offset_(0) {}
 
   virtual inline const char* type() const { return "Convolution"; }
 
@@ -77,6 +82,27 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+
+  // Integer engine for quantized models. Returns false, without touching
+  // top, whenever the layer or its blobs cannot be represented exactly as
+  // uint8 operands, so that the caller falls back to the float path.
+  bool Forward_cpu_quantized(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  bool PackQuantizedWeights();
+  void ComputeRequantizers(vector<Requantizer>* rq);
+
+  // Weights are packed on the first quantized pass and re-packed whenever
+  // one of the parameter blobs has been written since (see data_version()).
+  vector<uint64_t> qweight_version_;
+  bool qweight_valid_;
+  vector<uint8_t> qweight_;
+  vector<int> qweight_zero_point_;
+  vector<int> qweight_row_sum_;
+  vector<int> qbias_;
+  // Last offset (0 for uint8 data, 128 for int8 data) that fit the input.
+  int qinput_offset_;
+  vector<uint8_t> qinput_;
+  vector<int> qoutput_;
 };
 
 }  // namespace caffe
@@ -29,10 +29,13 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
   void Next();
   bool Skip();
   virtual void load_batch(Batch<Dtype>* batch);
+  virtual inline bool TransformsInParallel() const { return true; }
 
   shared_ptr<db::DB> db_;
   shared_ptr<db::Cursor> cursor_;
   uint64_t offset_;
+  // Whether cursor_ only reads the records of this solver.
+  bool sharded_;  //CUSTOMIZATION
 };
 
 }  // namespace caffe
@@ -21,7 +21,6 @@ class DenseCRFLayer : public Layer<Dtype> {
  public:
   explicit DenseCRFLayer(const LayerParameter& param)
       : Layer<Dtype>(param) {}
-  virtual ~DenseCRFLayer();
 
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -39,21 +38,47 @@ class DenseCRFLayer : public Layer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  virtual void SetupPairwiseFunctions(const vector<Blob<Dtype>*>& bottom);
-  virtual void ClearPairwiseFunctions();
+  // The state of the inference on one image. Each worker keeps its own
+  // across images and Forward calls, so that the buffers, lattices and hash
+  // tables are only reallocated when they grow.
+  struct Workspace {
+    Workspace();
+    ~Workspace();
 
-  virtual void SetupUnaryEnergy(const Dtype* bottom);
+    int W;   // effective width   (<= pad_width_)
+    int H;   // effective height  (<= pad_height_)
+    int N;   // = W * H
+    int num_threads;  // the threads each step of the inference runs on
 
-  virtual void ComputeMap(Dtype* top_inf);
+    int size;        // size of the buffers below
+    float* unary;    // unary energy
+    float* current;  // current inference values, will copy to top[0]
+    float* next;     // next inference values
+    float* tmp;      // buffer
 
-  virtual void RunInference();
-  virtual void StartInference();
-  virtual void StepInference();
+    std::vector<PottsPotential*> pairwise;
+    std::vector<float> features;
 
-  virtual void ExpAndNormalize(float* out, const float* in, float scale);
+    DISABLE_COPY_AND_ASSIGN(Workspace);
+  };
 
-  virtual void AllocateAllData();
-  virtual void DeAllocateAllData();
+  // Runs the inference on one image of the batch; image is NULL without
+  // bilateral potentials.
+  virtual void InferImage(const Dtype* bottom_data, const Dtype* data_dim,
+      const Dtype* image, Dtype* top_data, Workspace* ws);
+
+  virtual void SetupPairwiseFunctions(const Dtype* image, Workspace* ws);
+
+  virtual void SetupUnaryEnergy(const Dtype* bottom, Workspace* ws);
+
+  virtual void ComputeMap(Dtype* top_inf, Workspace* ws);
+
+  virtual void RunInference(Workspace* ws);
+  virtual void StartInference(Workspace* ws);
+  virtual void StepInference(Workspace* ws);
+
+  virtual void ExpAndNormalize(float* out, const float* in, float scale,
+      Workspace* ws);
 
   
   bool has_image;
@@ -63,9 +88,6 @@ class DenseCRFLayer : public Layer<Dtype> {
   int pad_width_;    // may have padded cols
 
   int M_;   // number of input feature (channel)
-  int W_;   // effective width   (<= pad_width_)
-  int H_;   // effective height  (<= pad_height_)
-  int N_;   // = W_ * H_
 
   int max_iter_;
 
@@ -78,15 +100,8 @@ class DenseCRFLayer : public Layer<Dtype> {
   std::vector<float> bi_xy_std_;
   std::vector<float> bi_rgb_std_;
 
-  std::vector<PairwisePotential*> pairwise_;
-
-  int unary_element_;  // size of unary energy
-  int map_element_;    // size of map result
-
-  float* unary_;     // unary energy
-  float* current_;   // current inference values, will copy to top[0]
-  float* next_;      // next inference values
-  float* tmp_;       // buffer
+  // One per worker of the thread pool.
+  std::vector<shared_ptr<Workspace> > workspaces_;
 
   /// sum_multiplier is used to carry out sum using BLAS
   Blob<Dtype> sum_multiplier_;
@@ -94,6 +94,14 @@ class GRULayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+  virtual void FusedSetUp(const vector<Blob<Dtype>*>& bottom);
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief R_z and R_r stacked, for one GEMM per timestep in the fused mode.
+  Blob<Dtype> fused_weights_; //CUSTOMIZATION
+  /// @brief data_version() of R_z and R_r when fused_weights_ was stacked.
+  vector<uint64_t> fused_weights_version_; //CUSTOMIZATION
 };
 
 
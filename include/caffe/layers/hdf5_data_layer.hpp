@@ -1,26 +1,80 @@
 #ifndef CAFFE_HDF5_DATA_LAYER_HPP_
 #define CAFFE_HDF5_DATA_LAYER_HPP_
 
-#include "hdf5.h"
-
 #include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/**
+ * @brief The rows [begin_, begin_ + blobs_[0]->shape(0)) of one dataset per
+ *        top of an HDF5 file, and the order they are output in.
+ */
+template <typename Dtype>
+class HDF5Chunk {
+ public:
+  HDF5Chunk() : file_(-1), begin_(0) {}
+
+  int num_rows() const { return blobs_.empty() ? 0 : blobs_[0]->shape(0); }
+
+  int file_;
+  int begin_;
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  vector<int> permutation_;
+};
+
+/**
+ * @brief Reads the chunks of a list of HDF5 files on a thread of its own,
+ *        epoch after epoch, into two buffers: while one is consumed from
+ *        full_, the next one is read, across file boundaries too.
+ *
+ * Consumers pop chunks from full_ and push them back to free_ when done. A
+ * buffer which already holds the rows to read next, as the single chunk of
+ * a single file does, is not read again.
+ */
+template <typename Dtype>
+class HDF5ChunkReader : public InternalThread {
+ public:
+  HDF5ChunkReader(const vector<string>& filenames,
+      const vector<string>& datasets, const int chunk_rows,
+      const bool shuffle);
+  virtual ~HDF5ChunkReader();
+
+  BlockingQueue<HDF5Chunk<Dtype>*>& free() { return free_; }
+  BlockingQueue<HDF5Chunk<Dtype>*>& full() { return full_; }
+
+ protected:
+  virtual void InternalThreadEntry();
+  void ReadFile(const int file);
+
+  const vector<string> filenames_;
+  const vector<string> datasets_;
+  const int chunk_rows_;
+  const bool shuffle_;
+  HDF5Chunk<Dtype> chunks_[2];
+  BlockingQueue<HDF5Chunk<Dtype>*> free_;
+  BlockingQueue<HDF5Chunk<Dtype>*> full_;
+
+  DISABLE_COPY_AND_ASSIGN(HDF5ChunkReader);
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
- * TODO(dox): thorough documentation for Forward and proto params.
+ * A prefetch thread assembles the batches from the chunks of an
+ * HDF5ChunkReader, so that neither the reads nor the copies run in Forward;
+ * rows which follow each other in a chunk are copied at once.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5DataLayer(const LayerParameter& param)
       : Layer<Dtype>(param), offset_() {}
@@ -36,8 +90,15 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
 
  protected:
+  // One blob per top.
+  typedef vector<shared_ptr<Blob<Dtype> > > HDF5Batch;
+
   void Next();
   bool Skip();
+  void StopPrefetch();
+
+  virtual void InternalThreadEntry();
+  virtual void LoadBatch(HDF5Batch* batch);
 
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -47,15 +108,16 @@ class HDF5DataLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
-  virtual void LoadHDF5FileData(const char* filename);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
-  unsigned int current_file_;
-  hsize_t current_row_;
-  std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
-  std::vector<unsigned int> data_permutation_;
-  std::vector<unsigned int> file_permutation_;
+  shared_ptr<HDF5ChunkReader<Dtype> > reader_;
+  // The chunk the prefetch thread reads from, and its next row.
+  HDF5Chunk<Dtype>* current_chunk_;
+  int current_row_;
+  vector<shared_ptr<HDF5Batch> > prefetch_;
+  BlockingQueue<HDF5Batch*> prefetch_free_;
+  BlockingQueue<HDF5Batch*> prefetch_full_;
   uint64_t offset_;
 };
 
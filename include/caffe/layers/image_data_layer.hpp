@@ -36,6 +36,7 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  virtual inline bool TransformsInParallel() const { return true; }
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
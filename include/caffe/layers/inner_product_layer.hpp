@@ -19,7 +19,7 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), zero_point_bias_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -58,6 +58,16 @@ class InnerProductLayer : public Layer<Dtype> {
   Dtype saturate_; //CUSTOMIZATION
   int quantize_method_; //CUSTOMIZATION
 
+  // The quantized forward reads the weights W and the input x as they are:
+  // with zw and zx their zero points, (W - zw) * (x - zx) = W * x -
+  // zw * sum(x) + T, where T, of N_ items, is -zx times the sums of the rows
+  // of W - zw. UpdateZeroPointBias rebuilds T when blobs_[0] is written.
+  void UpdateZeroPointBias();
+  Blob<Dtype> zero_point_bias_;
+  uint64_t zero_point_bias_version_;
+  // Ones of max(M_, K_, N_) items, for the sums and the outer products.
+  Blob<Dtype> zero_point_ones_;
+
 };
 
 }  // namespace caffe
@@ -57,6 +57,9 @@ class LSTMV2Layer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+  virtual void FusedSetUp(const vector<Blob<Dtype>*>& bottom);
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
 };
 
 }  // namespace caffe
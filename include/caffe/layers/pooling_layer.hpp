@@ -43,6 +43,11 @@ class PoolingLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+  // MAX, AVE and AVE_EXC_PAD pooling of NHWC blobs, with the arithmetic of
+  // Forward_cpu, for layers with data_format NHWC.
+  void Forward_cpu_nhwc(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const int pad_top,
+      const int pad_bottom, const int pad_left, const int pad_right);
 
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
@@ -66,6 +71,7 @@ class PoolingLayer : public Layer<Dtype> {
   double output_scale_; //CUSTOMIZATION
   int output_zero_point_; //CUSTOMIZATION
   int quantize_method_; //CUSTOMIZATION
+  bool nhwc_; //CUSTOMIZATION
 };
 
 }  // namespace caffe
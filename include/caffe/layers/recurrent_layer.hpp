@@ -1,6 +1,8 @@
 #ifndef CAFFE_RECURRENT_LAYER_HPP_
 #define CAFFE_RECURRENT_LAYER_HPP_
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
@@ -152,6 +154,57 @@ class RecurrentLayer : public Layer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /**
+   * @brief Adds to blobs_ the parameters of the fused mode, with the shapes,
+   *        fillers and order of those of the unrolled net.  Subclasses that
+   *        support <code>recurrent_param.fused</code> define this and
+   *        FusedForward_cpu -- see LSTMLayer and GRULayer for examples.
+   */
+  virtual void FusedSetUp(const vector<Blob<Dtype>*>& bottom);
+
+  /**
+   * @brief Computes all T timesteps without the unrolled net, starting from
+   *        the state in recur_input_blobs_ and leaving the state after the
+   *        last timestep in recur_output_blobs_.
+   */
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief Reshape for the fused mode.
+  void FusedReshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  enum FusedActivation { FUSED_SIGMOID, FUSED_TANH, FUSED_RELU };
+  /// @brief The activation the unrolled net would use at activations[index].
+  FusedActivation GetFusedActivation(int index, const char* default_type) const;
+  static inline Dtype FusedActivate(FusedActivation activation, Dtype x) {
+    switch (activation) {
+    case FUSED_SIGMOID:
+      return 1. / (1. + exp(-x));
+    case FUSED_TANH:
+      return tanh(x);
+    default:
+      return std::max(x, Dtype(0));
+    }
+  }
+  /// @brief Adds a parameter blob of the given shape to blobs_ and fills it.
+  void AddFusedParam(const vector<int>& shape, const FillerParameter& filler);
+  /// @brief Adds W_xc, b_c and, with a static input, W_xc_static.
+  void AddFusedInputParams(const vector<Blob<Dtype>*>& bottom, int gate_dim);
+  /**
+   * @brief Fills fused_gates_ with W_xc * x_t + b_c (+ W_xc_static * x_static)
+   *        of all timesteps, as a single GEMM.
+   */
+  void FusedInputGates(const vector<Blob<Dtype>*>& bottom, int gate_dim);
+  /// @brief The sequence continuation indicators, or NULL if all are 1.
+  const Dtype* FusedCont(const vector<Blob<Dtype>*>& bottom) const;
+  /**
+   * @brief Returns cont_t * h_{t-1}, written to h_conted unless cont_t is
+   *        NULL, in which case h_{t-1} itself is returned.
+   */
+  const Dtype* FusedContHidden(const Dtype* h_prev, const Dtype* cont_t,
+      int dim, Dtype* h_conted) const;
+
   /// @brief A Net to implement the Recurrent functionality.
   shared_ptr<Net<Dtype> > unrolled_net_;
 
@@ -198,6 +251,15 @@ class RecurrentLayer : public Layer<Dtype> {
   vector<string> activations_;
   vector<float> activation_alpha_;
   vector<float> activation_beta_;
+
+  /// @brief Whether the fused kernels run instead of unrolled_net_.
+  bool fused_; //CUSTOMIZATION
+  /// @brief In the fused mode, the blobs behind recur_(input|output)_blobs_.
+  vector<shared_ptr<Blob<Dtype> > > fused_state_; //CUSTOMIZATION
+  /// @brief The gate inputs of all timesteps, (T x N x gate_dim).
+  Blob<Dtype> fused_gates_; //CUSTOMIZATION
+  /// @brief Per-timestep scratch of the fused kernels.
+  Blob<Dtype> fused_buffer_; //CUSTOMIZATION
 };
 
 }  // namespace caffe
@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/sampling.hpp"
 
 namespace caffe {
 
@@ -34,6 +35,10 @@ class ResampleLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // The taps of the rows and the columns, for the sizes in sample_shape_.
+  SampleAxis<Dtype> axis_y_, axis_x_;
+  vector<int> sample_shape_;
 };
 
 }  // namespace caffe
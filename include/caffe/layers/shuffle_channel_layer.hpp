@@ -40,7 +40,6 @@ protected:
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
 private:
-  void Resize_cpu(Dtype *output, const Dtype *input, int group_row, int group_column, int len);
   void Resize_gpu(Dtype *output, const Dtype *input, int group_row, int group_column, int len);
 
   //Blob<Dtype> temp_blob_;
@@ -11,9 +11,12 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/profiler.hpp"
 
 namespace caffe {
 
+class MappedWeights;  //CUSTOMIZATION
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -91,6 +94,9 @@ class Net {
 
   /// @brief Updates the network weights based on the diff values computed.
   void Update();
+  /// @brief Whether Update() leaves the learnable param alone (a mask of
+  ///        pruning / splicing).
+  bool update_masked(int learnable_param_id) const;
   /**
    * @brief Shares weight data of owner blobs with shared blobs.
    *
@@ -114,6 +120,11 @@ class Net {
   void CopyTrainedLayersFrom(const string& trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string& trained_filename);
   void CopyTrainedLayersFromHDF5(const string& trained_filename);
+  /**
+   * @brief Loads weights written by WriteMappedWeights: the blobs of this
+   *        Dtype point into the mapped file rather than holding a copy.
+   */
+  void CopyTrainedLayersFromMapped(const string& trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -231,6 +242,17 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /**
+   * @brief Starts or stops recording the time of every layer's Forward,
+   *        Backward and Reshape into profiler().
+   *
+   * The profiler is created on first use and keeps its samples when
+   * profiling is stopped, so it can be read afterwards.
+   */
+  void EnableProfiler(const bool enable);
+  /// @brief The Profiler of the net, or NULL if it was never enabled.
+  const shared_ptr<Profiler>& profiler() const { return profiler_; }
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
@@ -284,6 +306,39 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /**
+   * @brief Lets the blobs of a TEST net that are never alive at the same time
+   *        share their data memory (NetParameter.share_blob_memory).
+   *
+   * A blob is alive from the layer producing it to the last layer reading it.
+   * Blobs sharing a SyncedMemory (in-place and split tops) are planned as one.
+   * The sharing is seen after setup, so layers whose Forward points a top at
+   * another blob (e.g. a no-op Permute) must already do so in Reshape.
+   */
+  void PlanBlobMemory(const NetParameter& param);
+  /// @brief Assigns the planned blobs to a best-fit arena of memory buffers.
+  void AssignBlobMemory();
+  /**
+   * @brief Checks that no top of a layer that just ran points at the memory
+   *        of one of its bottoms planned apart from it, as a layer aliasing
+   *        its top only in Forward would, which the plan could overwrite.
+   */
+  void CheckBlobMemoryAliases(const int layer_id);
+  /**
+   * @brief Sets up the layers fold_inference_layers folded into others, as
+   *        returned by FoldInferenceLayers, to hold their weights.
+   */
+  void SetUpFoldedLayers(const vector<vector<LayerParameter> >& folded);
+  /**
+   * @brief The layer trained weights named layer_name are copied to: the
+   *        folded layer of that name if any, else layers_[layer_id], or NULL
+   *        if layer_id is out of range.
+   */
+  Layer<Dtype>* TrainedLayer(const string& layer_name, const int layer_id);
+  /// @brief Recomputes the blobs of the layers others are folded into.
+  void FoldLayers();
+  /// @brief Helper for recording a profiled Forward.
+  void ProfileForward(const int layer_id);
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -358,6 +413,27 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  //CUSTOMIZATION
+  /// Per-layer timings, recorded while profiling_ is set.
+  shared_ptr<Profiler> profiler_;
+  bool profiling_;
+  /// The blob ids sharing memory, grouped by the SyncedMemory they already
+  /// share, and the first and last layer using each group.
+  vector<vector<int> > memory_plan_groups_;
+  vector<pair<int, int> > memory_plan_lifetimes_;
+  /// The group of each blob, or -1 for the blobs that are not planned.
+  vector<int> memory_plan_group_of_blob_;
+  /// The buffers the groups are currently assigned to.
+  vector<shared_ptr<SyncedMemory> > memory_plan_arena_;
+  /// The layers fold_inference_layers folded into layers_[folded_host_ids_[i]]
+  /// are folded_layers_[i]: that layer as written, then the affine layers it
+  /// absorbed. They never run, but take the trained weights by name, and the
+  /// host blobs are computed from theirs.
+  vector<vector<shared_ptr<Layer<Dtype> > > > folded_layers_;
+  vector<int> folded_host_ids_;
+  map<string, Layer<Dtype>*> folded_layer_names_index_;
+  /// The mapped weights files blobs point into, kept mapped for the net.
+  vector<shared_ptr<MappedWeights> > mapped_weights_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
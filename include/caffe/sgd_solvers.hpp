@@ -32,6 +32,34 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  /**
+   * @brief The fused_update path of ApplyUpdate on the CPU.
+   *
+   * The params are cut into blocks that fit in cache, which the update
+   * threads take in turn. Each block is normalized, regularized, given its
+   * update by UpdateBlock and updated while it stays in cache, so that each
+   * param, diff and history is read and written once per iteration.
+   */
+  void FusedApplyUpdate(Dtype rate);
+  /**
+   * @brief The CPU arrays of a param for FusedApplyUpdate, fetched before the
+   *        update threads start: fetching them from the threads would race on
+   *        the state of the SyncedMemory.
+   */
+  struct UpdateArrays {
+    const Dtype* data;
+    Dtype* mutable_data;  // NULL for the params update_masked.
+    Dtype* diff;
+    // history[k] is the data of history_[param_id + k * the number of params].
+    vector<Dtype*> history;
+  };
+  /// Normalize and Regularize of the items [begin, end) of the param.
+  void RegularizeBlock(int param_id, const UpdateArrays& arrays, int begin,
+      int end);
+  /// ComputeUpdateValue of the items [begin, end) of the param, on the CPU in
+  /// a single loop; the update is left in the diff all the same.
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const UpdateArrays& arrays, int begin, int end);
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
@@ -61,6 +89,9 @@ class NesterovSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+      int end);
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -76,6 +107,9 @@ class AdaGradSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+      int end);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with AdaGrad.";
@@ -96,6 +130,9 @@ class RMSPropSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+      int end);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
@@ -120,6 +157,9 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
  protected:
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+      int end);
 
   DISABLE_COPY_AND_ASSIGN(AdaDeltaSolver);
 };
@@ -144,6 +184,9 @@ class AdamSolver : public SGDSolver<Dtype> {
  protected:
   void AdamPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void UpdateBlock(int param_id, Dtype rate,
+      const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+      int end);
 
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
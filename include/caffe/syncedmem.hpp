@@ -1,6 +1,7 @@
 #ifndef CAFFE_SYNCEDMEM_HPP_
 #define CAFFE_SYNCEDMEM_HPP_
 
+#include <stdint.h>
 #include <cstdlib>
 
 #ifdef USE_MKL
@@ -8,6 +9,7 @@
 #endif
 
 #include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
 
 namespace caffe {
 
@@ -24,13 +26,8 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  *ptr = mkl_malloc(size ? size:1, 64);
-#else
-  *ptr = malloc(size);
-#endif
+  *ptr = HostAllocator::Get().Allocate(size);
   *use_cuda = false;
-  CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
 inline void CaffeFreeHost(void* ptr, bool use_cuda) {
@@ -40,11 +37,7 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  mkl_free(ptr);
-#else
-  free(ptr);
-#endif
+  HostAllocator::Get().Free(ptr);
 }
 
 
@@ -68,6 +61,15 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() const { return head_; }
   size_t size() const { return size_; }
+  // Changes every time the memory is handed out for writing (mutable_*_data,
+  // set_*_data). Versions are drawn from one process-wide counter, so a
+  // version never repeats, even across different SyncedMemory objects.
+  uint64_t version() const { return version_; }
+  // Whether the host memory is zeroed when it is first used (the default).
+  // Turning it off is only safe when the memory is written in full before
+  // it is read, e.g. for the tops of layers that overwrite them.
+  void set_zero_fill(bool zero_fill) { zero_fill_ = zero_fill; }
+  bool zero_fill() const { return zero_fill_; }
 
 #ifndef CPU_ONLY
   void async_gpu_push(const cudaStream_t& stream);
@@ -86,6 +88,8 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  uint64_t version_;
+  bool zero_fill_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -8,6 +8,7 @@
 #define CAFFE_UTIL_BBOX_UTIL_H_
 
 #include <stdint.h>
+#include <algorithm>
 #include <cmath>  // for std::fabs and std::signbit
 #include <map>
 #include <string>
@@ -29,6 +30,46 @@ typedef MultiBoxLossParameter_MiningType MiningType;
 
 typedef map<int, vector<NormalizedBBox> > LabelBBox;
 
+// A set of bboxes stored as a structure of arrays. The CPU detection path
+// decodes and suppresses tens of thousands of boxes per image, which as
+// NormalizedBBox messages pay protobuf construction and pointer chasing for
+// every box; here each coordinate lives in one contiguous float array, so
+// the overlap loops can run over several boxes per instruction.
+// size[i] holds BBoxSize() of box i, like the size field of the messages.
+struct BBoxArray {
+  vector<float> xmin;
+  vector<float> ymin;
+  vector<float> xmax;
+  vector<float> ymax;
+  vector<float> size;
+
+  inline int num() const { return xmin.size(); }
+  void clear();
+  void reserve(const int n);
+  // Appends a box and computes its size as BBoxSize() does.
+  inline void push_back(const float x1, const float y1, const float x2,
+      const float y2) {
+    xmin.push_back(x1);
+    ymin.push_back(y1);
+    xmax.push_back(x2);
+    ymax.push_back(y2);
+    size.push_back(x2 < x1 || y2 < y1 ? 0.f : (x2 - x1) * (y2 - y1));
+  }
+  void push_back(const NormalizedBBox& bbox);
+  // Writes box i with its size to bbox.
+  void Get(const int i, NormalizedBBox* bbox) const;
+};
+
+typedef map<int, BBoxArray> LabelBBoxArray;
+
+// Convert between vector<NormalizedBBox> and BBoxArray.
+void ToBBoxArray(const vector<NormalizedBBox>& bboxes, BBoxArray* bbox_array);
+void FromBBoxArray(const BBoxArray& bbox_array, vector<NormalizedBBox>* bboxes);
+void ToBBoxArray(const vector<LabelBBox>& all_bboxes,
+    vector<LabelBBoxArray>* all_bbox_arrays);
+void FromBBoxArray(const vector<LabelBBoxArray>& all_bbox_arrays,
+    vector<LabelBBox>* all_bboxes);
+
 // Function used to sort NormalizedBBox, stored in STL container (e.g. vector),
 // in ascend order based on the score value.
 bool SortBBoxAscend(const NormalizedBBox& bbox1, const NormalizedBBox& bbox2);
@@ -101,6 +142,14 @@ float JaccardOverlap(const NormalizedBBox& bbox1, const NormalizedBBox& bbox2,
 template <typename Dtype>
 Dtype JaccardOverlap(const Dtype* bbox1, const Dtype* bbox2);
 
+// Compute the jaccard overlap between bboxes i and j of a BBoxArray.
+float JaccardOverlap(const BBoxArray& bboxes, const int i, const int j);
+
+// Compute the jaccard overlap between box i of bboxes and every box of
+// others, written to overlaps[0 .. others.num()).
+void JaccardOverlap(const BBoxArray& bboxes, const int i,
+    const BBoxArray& others, float* overlaps);
+
 // Compute the coverage of bbox1 by bbox2.
 float BBoxCoverage(const NormalizedBBox& bbox1, const NormalizedBBox& bbox2);
 
@@ -136,6 +185,20 @@ void DecodeBBoxesAll(const vector<LabelBBox>& all_loc_pred,
     const CodeType code_type, const bool variance_encoded_in_target,
     const bool clip, vector<LabelBBox>* all_decode_bboxes);
 
+// BBoxArray versions of DecodeBBoxes and DecodeBBoxesAll, with the same
+// results. prior_variances holds 4 values per prior.
+void DecodeBBoxes(const BBoxArray& prior_bboxes,
+    const vector<float>& prior_variances,
+    const CodeType code_type, const bool variance_encoded_in_target,
+    const bool clip_bbox, const BBoxArray& bboxes, BBoxArray* decode_bboxes);
+
+void DecodeBBoxesAll(const vector<LabelBBoxArray>& all_loc_pred,
+    const BBoxArray& prior_bboxes, const vector<float>& prior_variances,
+    const int num, const bool share_location,
+    const int num_loc_classes, const int background_label_id,
+    const CodeType code_type, const bool variance_encoded_in_target,
+    const bool clip, vector<LabelBBoxArray>* all_decode_bboxes);
+
 void CasRegDecodeBBoxesAll(const vector<LabelBBox>& all_loc_pred,
     const vector<NormalizedBBox>& prior_bboxes,
     const vector<vector<float> >& prior_variances,
@@ -245,6 +308,11 @@ void GetLocPredictions(const Dtype* loc_data, const int num,
       const int num_preds_per_class, const int num_loc_classes,
       const bool share_location, vector<LabelBBox>* loc_preds);
 
+template <typename Dtype>
+void GetLocPredictions(const Dtype* loc_data, const int num,
+      const int num_preds_per_class, const int num_loc_classes,
+      const bool share_location, vector<LabelBBoxArray>* loc_preds);
+
 // Encode the localization prediction and ground truth for each matched prior.
 //    all_loc_preds: stores the location prediction, where each item contains
 //      location prediction for an image.
@@ -382,6 +450,11 @@ void GetPriorBBoxes(const Dtype* prior_data, const int num_priors,
       vector<NormalizedBBox>* prior_bboxes,
       vector<vector<float> >* prior_variances);
 
+// BBoxArray version of GetPriorBBoxes; prior_variances gets 4 values per prior.
+template <typename Dtype>
+void GetPriorBBoxes(const Dtype* prior_data, const int num_priors,
+      BBoxArray* prior_bboxes, vector<float>* prior_variances);
+
 // Get prior bounding boxes from prior_data.
 //    prior_data: 1 x num_priors * 4 x 1 blob.
 //    num_priors: number of priors.
@@ -454,6 +527,78 @@ void ApplyNMS(const vector<NormalizedBBox>& bboxes, const vector<float>& scores,
 
 void ApplyNMS(const bool* overlapped, const int num, vector<int>* indices);
 
+// Greedy non maximum suppression over num candidates visited in the order
+// 0, 1, ..., num - 1: a candidate is kept unless a candidate kept before it
+// suppresses it. The candidates are taken in blocks of 64 with a bitmask of
+// the ones still alive, which is first reduced by the boxes kept in earlier
+// blocks and then scanned in order, so no candidate list is erased from and
+// suppressed candidates are never compared again.
+//    suppress: suppress(i, begin, end, alive) returns the bits of the
+//      candidates in [begin, end), bit j - begin for candidate j, that the
+//      kept candidate i suppresses among those set in alive.
+//    top_k: if not -1, stop after keeping top_k candidates.
+//    indices: the kept candidates, in visiting order.
+template <typename SuppressFn>
+void ApplyNMSBitmask(const int num, const int top_k, SuppressFn suppress,
+      vector<int>* indices) {
+  const int kBlockSize = 64;
+  indices->clear();
+  if (top_k == 0) {
+    return;
+  }
+  for (int begin = 0; begin < num; begin += kBlockSize) {
+    const int end = std::min(begin + kBlockSize, num);
+    uint64_t alive = end - begin == kBlockSize ? ~uint64_t(0) :
+        (uint64_t(1) << (end - begin)) - 1;
+    const int num_kept = indices->size();
+    for (int k = 0; k < num_kept && alive; ++k) {
+      alive &= ~suppress((*indices)[k], begin, end, alive);
+    }
+    while (alive) {
+      const int i = begin + __builtin_ctzll(alive);
+      alive &= alive - 1;
+      indices->push_back(i);
+      if (top_k > -1 && indices->size() >= top_k) {
+        return;
+      }
+      if (alive) {
+        alive &= ~suppress(i, begin, end, alive);
+      }
+    }
+  }
+}
+
+// Wraps a predicate pair_suppress(i, j), whether the kept candidate i
+// suppresses candidate j, as the suppress function of ApplyNMSBitmask.
+template <typename PairSuppressFn>
+class PairwiseSuppressor {
+ public:
+  explicit PairwiseSuppressor(PairSuppressFn pair_suppress)
+      : pair_suppress_(pair_suppress) {}
+
+  uint64_t operator()(const int i, const int begin, const int end,
+      uint64_t alive) const {
+    uint64_t suppressed = 0;
+    while (alive) {
+      const int j = __builtin_ctzll(alive);
+      alive &= alive - 1;
+      if (pair_suppress_(i, begin + j)) {
+        suppressed |= uint64_t(1) << j;
+      }
+    }
+    return suppressed;
+  }
+
+ private:
+  PairSuppressFn pair_suppress_;
+};
+
+template <typename PairSuppressFn>
+PairwiseSuppressor<PairSuppressFn> MakePairwiseSuppressor(
+      PairSuppressFn pair_suppress) {
+  return PairwiseSuppressor<PairSuppressFn>(pair_suppress);
+}
+
 // Do non maximum suppression given bboxes and scores.
 // Inspired by Piotr Dollar's NMS implementation in EdgeBox.
 // https://goo.gl/jV3JYS
@@ -469,6 +614,15 @@ void ApplyNMSFast(const vector<NormalizedBBox>& bboxes,
       const float nms_threshold, const float eta, const int top_k,
       vector<int>* indices);
 
+// ApplyNMSFast on a BBoxArray, with the same results. Unless eta < 1, the
+// candidates are gathered in score order and go through ApplyNMSBitmask;
+// otherwise each candidate is compared against all kept boxes at once, which
+// are gathered into a contiguous BBoxArray as they are picked.
+void ApplyNMSFast(const BBoxArray& bboxes,
+      const vector<float>& scores, const float score_threshold,
+      const float nms_threshold, const float eta, const int top_k,
+      vector<int>* indices);
+
 // Do non maximum suppression based on raw bboxes and scores data.
 // Inspired by Piotr Dollar's NMS implementation in EdgeBox.
 // https://goo.gl/jV3JYS
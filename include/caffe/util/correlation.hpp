@@ -0,0 +1,56 @@
+#ifndef CAFFE_UTIL_CORRELATION_HPP_
+#define CAFFE_UTIL_CORRELATION_HPP_
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The geometry of a correlation of two images rearranged to padded
+ *        NHWC, shared by CorrelationLayer and Correlation1DLayer.
+ *
+ * The top item (c, y, x) compares the kernel_size x kernel_size patch of
+ * image 0 with upper-left corner (y * stride1 + y_offset,
+ * x * stride1 + x_offset) to the patch of image 1 displaced by
+ * ((grid_y_begin + c / grid_width) * stride2,
+ *  (grid_x_begin + c % grid_width) * stride2), averaged over the patch and
+ * channels. Displaced pixels outside image 1 count as zeros.
+ */
+struct CorrelationGeometry {
+  int num, channels;
+  int height, width;  // of the padded images
+  int top_height, top_width;
+  int kernel_size, stride1, stride2;
+  int y_offset, x_offset;
+  int grid_y_begin, grid_height;
+  int grid_x_begin, grid_width;
+};
+
+/**
+ * @brief Copies the NCHW src to the NHWC dst, of height + 2 * pad_h rows of
+ *        width + 2 * pad_w pixels, with zeros in the padding.
+ */
+template <typename Dtype>
+void caffe_cpu_pad_nhwc(const int num, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const Dtype* src,
+    Dtype* dst);
+
+/**
+ * @brief Correlates the padded NHWC bottom0 with bottom1 into the NCHW top:
+ *        by the dot product of the patches, or by their mean absolute
+ *        difference with subtract.
+ *
+ * The rows of top are split among Caffe::num_threads() threads. For each
+ * kernel pixel of an output, the channels of image 0 are compared with the
+ * grid_width displaced pixels of image 1 at once, which lie in one stretch of
+ * a row and stay in cache from one output to the next; the dot products of
+ * float run on the vectorized kernel of caffe_simd_dot_rows.
+ */
+template <typename Dtype>
+void caffe_cpu_correlate(const CorrelationGeometry& geometry,
+    const bool subtract, const Dtype* bottom0, const Dtype* bottom1,
+    Dtype* top);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CORRELATION_HPP_
@@ -2,6 +2,7 @@
 #define CAFFE_UTIL_DB_HPP
 
 #include <string>
+#include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
@@ -16,6 +17,8 @@ class Cursor {
   virtual ~Cursor() { }
   virtual void SeekToFirst() = 0;
   virtual void Next() = 0;
+  // Moves to the first key not less than key. //CUSTOMIZATION
+  virtual void Seek(const string& key) = 0;
   virtual string key() = 0;
   virtual string value() = 0;
   virtual bool valid() = 0;
@@ -23,6 +26,54 @@ class Cursor {
   DISABLE_COPY_AND_ASSIGN(Cursor);
 };
 
+//<--CUSTOMIZATION
+/**
+ * @brief Reads the records of a db one of num_solvers solvers gets, without
+ *        stepping over those of the others.
+ *
+ * The keys are split into num_solvers * shards_per_solver ranges of about as
+ * many consecutive records, found with one pass over the keys on
+ * construction. Each epoch the ranges are dealt to the solvers in an order
+ * that only depends on the epoch, so the solvers agree on it without talking,
+ * and a solver seeks from one of its ranges to the next. SeekToFirst starts
+ * the next epoch.
+ */
+class ShardedCursor : public Cursor {
+ public:
+  // Takes ownership of cursor.
+  ShardedCursor(Cursor* cursor, int num_solvers, int rank,
+      int shards_per_solver);
+  virtual void SeekToFirst();
+  virtual void Next();
+  // Moves to the first key not less than key in the ranges of this solver,
+  // the rest of the epoch reading on from the range it falls in.
+  virtual void Seek(const string& key);
+  virtual string key() { return cursor_->key(); }
+  virtual string value() { return cursor_->value(); }
+  virtual bool valid() { return valid_; }
+
+  int epoch() const { return epoch_; }
+  // The ranges of keys of the current epoch, in reading order.
+  const vector<int>& shards() const { return shards_; }
+
+ protected:
+  // Seeks to the start of shards_[shard_], or the next nonempty one.
+  void StartShard();
+
+  shared_ptr<Cursor> cursor_;
+  int num_solvers_;
+  int rank_;
+  // The first key and the number of records of each range.
+  vector<string> shard_keys_;
+  vector<size_t> shard_sizes_;
+  int epoch_;
+  vector<int> shards_;
+  int shard_;
+  size_t position_;
+  bool valid_;
+};
+//CUSTOMIZATION-->
+
 class Transaction {
  public:
   Transaction() { }
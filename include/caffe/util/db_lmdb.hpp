@@ -27,6 +27,11 @@ class LMDBCursor : public Cursor {
   }
   virtual void SeekToFirst() { Seek(MDB_FIRST); }
   virtual void Next() { Seek(MDB_NEXT); }
+  virtual void Seek(const string& key) {
+    mdb_key_.mv_size = key.size();
+    mdb_key_.mv_data = const_cast<char*>(key.data());
+    Seek(MDB_SET_RANGE);
+  }
   virtual string key() {
     return string(static_cast<const char*>(mdb_key_.mv_data), mdb_key_.mv_size);
   }
@@ -65,6 +70,7 @@ class LMDBTransaction : public Transaction {
   vector<string> keys, values;
 
   void DoubleMapSize();
+  void ReserveMapSize();
 
   DISABLE_COPY_AND_ASSIGN(LMDBTransaction);
 };
@@ -27,10 +27,17 @@ protected:
   int N_;
   float w_;
   float *norm_;
+  int norm_size_;
 public:
   virtual ~PottsPotential();
   PottsPotential(const float* features, int D, int N, float w, bool per_pixel_normalization=true);
 
+  // Rebuilds the potential on new features, reusing the memory of the
+  // lattice and the normalization.
+  void init(const float* features, int D, int N, bool per_pixel_normalization=true);
+  // The threads apply splits its work over, see Permutohedral.
+  void set_num_threads(int num_threads) { lattice_.set_num_threads(num_threads); }
+
   virtual void apply(float* out_values, const float* in_values, float* tmp, int value_size) const;
 };
 
@@ -30,6 +30,8 @@
 #ifndef _DENSECRF_UTIL_H
 #define _DENSECRF_UTIL_H
 
+#include <boost/function.hpp>
+
 inline float fast_log2 (float val) {
   int * const  exp_ptr = reinterpret_cast <int *> (&val);
   int          x = *exp_ptr;
@@ -158,6 +160,12 @@ inline __m128 fast_exp(__m128 x) {
 float* allocate ( size_t N ) ;
 void deallocate ( float *& ptr ) ;
 
+// Calls task(begin, end) on contiguous chunks of [0, n) of at least
+// min_chunk items, on up to num_threads workers of the thread pool of the
+// calling thread, and returns once all have finished.
+void parallel_for(int n, int num_threads, int min_chunk,
+    const boost::function<void(int, int)>& task);
+
 
 
 #endif
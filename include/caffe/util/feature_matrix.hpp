@@ -0,0 +1,55 @@
+#ifndef CAFFE_UTIL_FEATURE_MATRIX_HPP_
+#define CAFFE_UTIL_FEATURE_MATRIX_HPP_
+
+#include <stdint.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Writes rows of features, such as those of extract_features, as a
+ *        raw matrix to be memory-mapped.
+ *
+ * The file holds the rows back to back as little-endian float32 or IEEE
+ * float16 elements, each row zero-padded to a multiple of 64 bytes, and
+ * filename.index the FeatureMatrixIndex of the matrix as a text proto. The
+ * index is written by Close, so a matrix without one is incomplete.
+ */
+class FeatureMatrixWriter {
+ public:
+  FeatureMatrixWriter(const string& filename,
+      const FeatureMatrixIndex::Type type);
+  ~FeatureMatrixWriter();
+
+  const FeatureMatrixIndex& index() const { return index_; }
+
+  // Appends a row for each item of the first axis of blob. The rows of all
+  // the blobs written must have the same shape.
+  template <typename Dtype>
+  void Write(const Blob<Dtype>& blob);
+  // Closes the matrix and writes its index.
+  void Close();
+
+ protected:
+  string filename_;
+  std::ofstream file_;
+  FeatureMatrixIndex index_;
+  // A row as it is written to the file.
+  vector<char> row_;
+
+  DISABLE_COPY_AND_ASSIGN(FeatureMatrixWriter);
+};
+
+// The float16 nearest to value, rounding ties to even.
+uint16_t FloatToHalf(const float value);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FEATURE_MATRIX_HPP_
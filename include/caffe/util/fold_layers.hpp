@@ -0,0 +1,37 @@
+#ifndef CAFFE_UTIL_FOLD_LAYERS_HPP_
+#define CAFFE_UTIL_FOLD_LAYERS_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with the BatchNorm, BN, Scale and Bias layers that only
+// transform the top of a float Convolution, Deconvolution or InnerProduct
+// layer removed, and, with fuse_activations, a ReLU, Clip or HardSwish layer
+// after them turned into the fused_activation_param of that layer. The layer
+// takes over the top of the last layer it absorbed, and a bias if it absorbed
+// an affine one. For each such layer, folded gets the layer as written
+// followed by the affine layers it absorbed, in order, whose weights its own
+// are computed from by FoldAffineLayers.
+void FoldInferenceLayers(const NetParameter& param, bool fuse_activations,
+    NetParameter* param_folded, vector<vector<LayerParameter> >* folded);
+
+// Sets the weights and bias of host, a layer from FoldInferenceLayers, to
+// those of layers[0], the layer as written, with the per-channel affine
+// transforms of layers[1], layers[2], ... applied to its output.
+template <typename Dtype>
+void FoldAffineLayers(const vector<shared_ptr<Layer<Dtype> > >& layers,
+    Layer<Dtype>* host);
+
+// Applies the activation to the n values of data, in place.
+template <typename Dtype>
+void caffe_cpu_fused_activation(const FusedActivationParameter& param,
+    const int n, Dtype* data);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FOLD_LAYERS_HPP_
@@ -2,6 +2,8 @@
 #ifndef CAFFE_UTIL_HDF5_H_
 #define CAFFE_UTIL_HDF5_H_
 
+#include <boost/thread/recursive_mutex.hpp>
+
 #include <string>
 
 #include "hdf5.h"
@@ -11,6 +13,17 @@
 
 namespace caffe {
 
+// The HDF5 library is not thread-safe unless built so, and the HDF5 data
+// layers read on threads of their own while the net and solver load and
+// save weights and state. Every call into the library holds this lock: the
+// functions below take it themselves, and other callers around their own
+// calls.
+boost::recursive_mutex& hdf5_mutex();
+
+// The shape of a float or integer dataset of min_dim to max_dim axes.
+vector<int> hdf5_get_nd_dataset_shape(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim);
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -21,6 +34,13 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob, bool reshape = false);
 
+// Loads the rows [row_begin, row_begin + num_rows) of the first axis of a
+// dataset into blob, reshaped to num_rows rows.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    int row_begin, int num_rows, Blob<Dtype>* blob);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
@@ -0,0 +1,83 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The allocator behind the host memory of SyncedMemory in CPU mode.
+ *
+ * Sizes are rounded up to size classes a quarter of a power of two apart.
+ * With a pool set by set_max_retained_bytes, freed buffers are kept per
+ * class and handed out again, so nets that reshape for every input don't
+ * go back to malloc each time. The allocator is shared by all threads.
+ */
+class HostAllocator {
+ public:
+  struct Stats {
+    // Allocations served from the pool, and those that were not.
+    uint64_t hits;
+    uint64_t misses;
+    // Bytes of the buffers held by the pool, and of those handed out.
+    uint64_t retained_bytes;
+    uint64_t allocated_bytes;
+  };
+
+  static HostAllocator& Get();
+
+  void* Allocate(size_t size);
+  void Free(void* ptr);
+
+  // Bytes of freed buffers the pool keeps; 0 (the default) disables it.
+  void set_max_retained_bytes(size_t bytes);
+  size_t max_retained_bytes() const;
+  // Whether buffers of 2 MB and more are mapped with transparent huge pages.
+  // Only has an effect on Linux.
+  void set_huge_pages(bool huge_pages);
+  bool huge_pages() const;
+
+  Stats stats() const;
+  void ResetStats();
+  // Releases every buffer held by the pool.
+  void Trim();
+
+  static size_t SizeClass(size_t size);
+
+ protected:
+  // Precedes every buffer, keeping the buffer itself 64-byte aligned.
+  struct Header {
+    size_t size;
+    bool mapped;
+    char padding[64 - sizeof(size_t) - sizeof(bool)];
+  };
+
+  HostAllocator();
+  Header* AllocateBlock(size_t size, bool huge_pages);
+  void FreeBlock(Header* header);
+  // Frees pooled buffers until at most bytes are retained.
+  void Release(size_t bytes);
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  shared_ptr<sync> sync_;
+  // The free buffers by size class.
+  std::map<size_t, vector<Header*> > free_;
+  size_t max_retained_bytes_;
+  bool huge_pages_;
+  Stats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(HostAllocator);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
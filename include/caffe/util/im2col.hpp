@@ -10,6 +10,8 @@ void im2col_nd_cpu(const Dtype* data_im, const int num_spatial_axes,
 	const int pad_type, //CUSTOMIZATION
     const int* dilation, Dtype* data_col);
 
+// pad_value is written for taps that fall into the padding; quantized
+// operands pad with their zero point instead of 0.
 template <typename Dtype>
 void im2col_cpu(const Dtype* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
@@ -17,7 +19,32 @@ void im2col_cpu(const Dtype* data_im, const int channels,
 	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
 	const int pad_t, const int pad_b, //CUSTOMIZATION
 	const int dilation_h, const int dilation_w,
-    Dtype* data_col);
+    Dtype* data_col, const Dtype pad_value = Dtype(0));
+
+// The output size and the top and left padding of a 2D im2col_cpu.
+void im2col_output_and_pad(const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int pad_type, const int pad_l, const int pad_r,
+    const int pad_t, const int pad_b,
+    const int dilation_h, const int dilation_w,
+    int* output_h, int* output_w, int* pad_top, int* pad_left);
+
+// The transpose of im2col_cpu for one NHWC image: the taps of each output
+// pixel of the output rows [row_begin, row_end) are written as one row of
+// (kernel_h, kernel_w, channels) values, so that the convolution is a gemm
+// with the output in NHWC as well. Consecutive pixels are pixel_stride
+// values apart, which lets one group of a grouped convolution be read in
+// place. The padding arguments are those of im2col_cpu.
+template <typename Dtype>
+void im2row_cpu(const Dtype* data_im, const int channels,
+    const int pixel_stride, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int pad_type, const int pad_l, const int pad_r,
+    const int pad_t, const int pad_b,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_row);
 
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
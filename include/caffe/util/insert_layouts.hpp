@@ -0,0 +1,34 @@
+#ifndef _CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+#define _CAFFE_UTIL_INSERT_LAYOUTS_HPP_
+
+#include <string>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with the layers that can run on NHWC blobs switched to
+// data_format NHWC, and Permute layers added where blobs go from one layout
+// to the other. 2D convolutions and poolings always run in NHWC; the
+// element-wise and per-channel layers (Eltwise, Concat, BatchNorm, Scale,
+// Bias and the activations) follow when all their bottoms are in NHWC. The
+// NHWC blobs are named after the NCHW ones with an _nhwc suffix, and blobs
+// left in NHWC at the end of the net are converted back under their names.
+// Only meant for inference: the converted layers only run Forward_cpu.
+void InsertLayoutConversions(const NetParameter& param,
+    NetParameter* param_nhwc);
+
+// Whether the layer runs in NHWC whatever the layout of its bottoms, and
+// whether it can run in NHWC when its bottoms are in NHWC.
+bool IsNHWCAnchorLayer(const LayerParameter& layer_param);
+bool IsNHWCFollowerLayer(const LayerParameter& layer_param);
+
+// Sets up the Permute layer layer_name converting bottom_name to top_name,
+// to NHWC or back to NCHW.
+void ConfigureLayoutPermuteLayer(const string& layer_name,
+    const string& bottom_name, const string& top_name, const bool to_nhwc,
+    LayerParameter* permute_layer_param);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INSERT_LAYOUTS_HPP_
@@ -0,0 +1,66 @@
+#ifndef CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <string>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A file of trained weights laid out to be memory-mapped.
+ *
+ * The file holds a header (the magic "CAFFEMAP", a version, and the sizes
+ * below as little-endian integers), a serialized MappedWeightsIndex, and,
+ * from the next page on, the raw little-endian elements of each blob,
+ * 64-byte aligned. Blobs of the Dtype of the file get its mapped pages as
+ * their data without a copy; the mapping is private, so writes to them stay
+ * in the process while the pages they don't touch are shared through the
+ * page cache with every other process that maps the file.
+ */
+class MappedWeights {
+ public:
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  // Whether the file starts like a mapped weights file.
+  static bool IsMappedWeights(const string& filename);
+
+  const MappedWeightsIndex& index() const { return index_; }
+
+  // Whether blob has the shape of source, like Blob::ShapeEquals.
+  template <typename Dtype>
+  static bool ShapeEquals(const MappedWeightsIndex::Blob& source,
+      const Blob<Dtype>& blob);
+
+  // Sets the data of blob, which must already have its shape, to the
+  // elements of source: the mapped ones if they are Dtypes, otherwise a
+  // converted copy. The mapping lives as long as this object.
+  template <typename Dtype>
+  void Load(const MappedWeightsIndex::Blob& source, Blob<Dtype>* blob) const;
+
+ protected:
+  const char* data(const MappedWeightsIndex::Blob& source) const;
+
+  string filename_;
+  char* map_;
+  size_t size_;
+  bool mapped_;
+  size_t data_offset_;
+  MappedWeightsIndex index_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+// The shape of a mapped blob.
+vector<int> MappedBlobShape(const MappedWeightsIndex::Blob& source);
+
+// Writes the blobs of the layers of param, such as trained weights read
+// from a binary proto, to filename as mapped weights.
+void WriteMappedWeights(const NetParameter& param, const string& filename);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
@@ -20,6 +20,14 @@ void caffe_cpu_gemm(const CBLAS_TRANSPOSE TransA,
     const Dtype alpha, const Dtype* A, const Dtype* B, const Dtype beta,
     Dtype* C);
 
+// caffe_cpu_gemm on matrices whose rows are lda, ldb and ldc elements apart,
+// e.g. column ranges of larger matrices.
+template <typename Dtype>
+void caffe_cpu_strided_gemm(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype alpha, const Dtype* A, const int lda, const Dtype* B,
+    const int ldb, const Dtype beta, Dtype* C, const int ldc);
+
 template <typename Dtype>
 void caffe_cpu_gemv(const CBLAS_TRANSPOSE TransA, const int M, const int N,
     const Dtype alpha, const Dtype* A, const Dtype* x, const Dtype beta,
@@ -46,6 +54,11 @@ inline void caffe_memset(const size_t N, const int alpha, void* X) {
 template <typename Dtype>
 void caffe_add_scalar(const int N, const Dtype alpha, Dtype *X);
 
+// Out-of-place form: Y[i] = X[i] + alpha.
+template <typename Dtype>
+void caffe_add_scalar(const int N, const Dtype alpha, const Dtype* X,
+    Dtype* Y);
+
 template <typename Dtype>
 void caffe_div_scalar(const int N, const Dtype alpha, Dtype *X);
 
@@ -0,0 +1,83 @@
+#ifndef CAFFE_UTIL_MATH_FUNCTIONS_SIMD_H_
+#define CAFFE_UTIL_MATH_FUNCTIONS_SIMD_H_
+
+#include <stdint.h>
+
+namespace caffe {
+
+/**
+ * @brief Instruction sets the vectorized CPU kernels can run on.
+ *
+ * The level is detected from the CPU the first time it is needed, so one
+ * binary runs the widest kernels the machine supports. It can be lowered
+ * with caffe_set_simd_level, e.g. to compare against the scalar code.
+ */
+enum SimdLevel {
+  SIMD_SCALAR = 0,
+  SIMD_AVX2 = 1,
+  SIMD_AVX512 = 2
+};
+
+SimdLevel caffe_simd_level();
+
+// Selects min(level, detected level) and returns the level now in use.
+SimdLevel caffe_set_simd_level(SimdLevel level);
+
+// The kernels below are the vector bodies of MultiplyByQuantizedMultiplierVR,
+// caffe_cpu_universal_saturate and the BBoxArray JaccardOverlap. Each one processes a prefix of x and
+// returns its length; the caller finishes the remaining elements with the
+// scalar code, which keeps the results bit-exact with it. A kernel may stop
+// early (or return 0) whenever an element needs the scalar path.
+
+// round_mode 1: x = (x * mul + 2^(shf - 1)) >> shf.
+template <typename Dtype>
+int caffe_simd_multiply_single_round(const int n, Dtype* x, const int mul,
+    const int shf);
+
+// round_mode 2: x = RoundingDivideByPOT(
+//     SaturatingRoundingDoublingHighMul(x << left_shift, mul), right_shift).
+template <typename Dtype>
+int caffe_simd_multiply_double_round(const int n, Dtype* x, const int mul,
+    const int left_shift, const int right_shift);
+
+template <typename Dtype>
+int caffe_simd_saturate(const int n, Dtype* x, const Dtype max_value,
+    const Dtype min_value);
+
+// Jaccard overlap of the box bbox = {xmin, ymin, xmax, ymax, size} with
+// each box of the given coordinate and size arrays, as computed by
+// JaccardOverlap(const BBoxArray&, ...) in bbox_util.
+int caffe_simd_jaccard_overlap(const int n, const float* bbox,
+    const float* xmin, const float* ymin, const float* xmax,
+    const float* ymax, const float* size, float* overlap);
+
+// One row of DataTransformer::Transform: (src[i] - mean[i]) * scale, or
+// (src[i] - mean_value) * scale when mean is NULL, is stored to dst[i], or to
+// dst[n - 1 - i] with mirror.
+int caffe_simd_transform_row(const int n, const uint8_t* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst);
+int caffe_simd_transform_row(const int n, const float* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst);
+
+// Transposes 8 rows of src, row stride lds, into 8 columns of dst, row stride
+// ldd: dst[c * ldd + r] = src[r * lds + c] for r < 8 and c in the returned
+// prefix of [0, cols).
+int caffe_simd_transpose_rows8(const int cols, const float* src,
+    const int lds, float* dst, const int ldd);
+
+// The dot products of a with m rows of b, row stride ldb, over the returned
+// prefix of [0, n): the one of row d is added to dots[d * ldd], for d < m.
+int caffe_simd_dot_rows(const int n, const float* a, const float* b,
+    const int ldb, const int m, float* dots, const int ldd);
+
+// The weighted gathers of the sampling engine: dst[i] is the sum over
+// k < taps of weight[k * ld + i] * src[index[k * ld + i]], for i in the
+// returned prefix of [0, n).
+int caffe_simd_gather_taps(const int n, const float* src, const int* index,
+    const float* weight, const int taps, const int ld, float* dst);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MATH_FUNCTIONS_SIMD_H_
@@ -0,0 +1,25 @@
+#ifndef CAFFE_UTIL_ORDERED_PIPELINE_HPP_
+#define CAFFE_UTIL_ORDERED_PIPELINE_HPP_
+
+#include <boost/function.hpp>
+
+namespace caffe {
+
+/**
+ * @brief Calls produce(i, slot) for every i in [0, n) on num_workers threads,
+ *        and consume(i, slot) on the calling thread in the order of i.
+ *
+ * Item i owns slot i % window from the start of its produce to the end of
+ * its consume, so that the callers keep the output of the items in window
+ * buffers of their own: at most window items are produced ahead of the one
+ * being consumed. With num_workers <= 0, both run on the calling thread.
+ * As long as the producers do not depend on each other, the consumer sees
+ * the same items in the same order whatever the number of workers.
+ */
+void RunOrderedPipeline(const int n, const int num_workers, const int window,
+    const boost::function<void(int, int)>& produce,
+    const boost::function<void(int, int)>& consume);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_ORDERED_PIPELINE_HPP_
@@ -0,0 +1,30 @@
+#ifndef CAFFE_UTIL_PERMUTE_HPP_
+#define CAFFE_UTIL_PERMUTE_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Copies src, of the given shape, to dst with its axes reordered:
+ *        axis i of dst is axis order[i] of src.
+ *
+ * Axes of size 1 are dropped and axes that stay next to each other are
+ * merged first, so e.g. NCHW -> NHWC becomes a transpose of N (C, HW)
+ * matrices. Transposes of matrices and of matrices of blocks, which cover
+ * NCHW <-> NHWC, swapping the last two axes and ShuffleChannel, are copied
+ * tile by tile to stay in cache, with vectorized kernels for float; any
+ * other order walks dst with an incremental index into src.
+ */
+template <typename Dtype>
+void caffe_cpu_permute(const vector<int>& shape, const vector<int>& order,
+    const Dtype* src, Dtype* dst);
+
+// The order that undoes order, e.g. for the backward of a permute.
+vector<int> caffe_inverse_permute_order(const vector<int>& order);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PERMUTE_HPP_
@@ -41,6 +41,7 @@
 #include <cassert>
 #include <cstdio>
 #include <cmath>
+#include <vector>
 
 #ifdef __SSE__
 // SSE Permutohedral lattice
@@ -61,24 +62,53 @@
 /***          Permutohedral Lattice           ***/
 /************************************************/
 
+class HashTable;
+
 class Permutohedral {
  protected:
-  int * offset_;
-  float * barycentric_;
+  // The memory of the lattice is kept across init calls, which only grow it.
+  std::vector<int> offset_;
+  std::vector<float> barycentric_;
   
   struct Neighbors{
     int n1, n2;
     Neighbors(int n1=0, int n2=0 ) : n1(n1),n2(n2) {}
   };
-  Neighbors * blur_neighbors_;
+  std::vector<Neighbors> blur_neighbors_;
+  // The entries of offset_ and barycentric_ of each lattice point, in
+  // increasing order, so that splatting gathers the values of each point
+  // instead of scattering those of each feature.
+  std::vector<int> splat_begin_;
+  std::vector<int> splat_index_;
+  HashTable* hash_table_;
   // Number of elements, size of sparse discretized space, dimension of features
   int N_, M_, d_;
+  int num_threads_;
+  // The scratch memory of compute.
+  mutable float* values_;
+  mutable float* new_values_;
+  mutable float* packed_;
+  mutable size_t values_size_, packed_size_;
+
+  template <typename V>
+  void filter(V* out, const V* in, int value_size, int in_offset,
+      int out_offset, int in_size, int out_size) const;
+
+ private:
+  Permutohedral(const Permutohedral&);
+  Permutohedral& operator=(const Permutohedral&);
+
  public:
   Permutohedral();
   virtual ~Permutohedral();
 
   void init(const float* feature, int feature_size, int N);
 
+  // The threads that init and compute split their loops over; compute is not
+  // reentrant, so a lattice is only filtered by one caller at a time.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+  int num_threads() const { return num_threads_; }
+
 #ifdef SSE_PERMUTOHEDRAL
   void compute(__m128* out, const __m128* in, int value_size, int in_offset = 0, int out_offset = 0, int in_size = -1, int out_size = -1) const;
  #endif
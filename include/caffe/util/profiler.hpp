@@ -0,0 +1,106 @@
+#ifndef CAFFE_UTIL_PROFILER_HPP_
+#define CAFFE_UTIL_PROFILER_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records the time every layer of a Net spends in each call.
+ *
+ * Net fills it from ForwardFromTo, BackwardFromTo and Reshape once
+ * profiling is switched on with Net::EnableProfiler. All samples are kept,
+ * so unlike the averages of `caffe time` the report shows the p50, p90 and
+ * p99 latency of each layer, and every call can be exported as a
+ * chrome://tracing trace. Call Clear() to start a new profile.
+ */
+class Profiler {
+ public:
+  enum Event {
+    FORWARD = 0,
+    BACKWARD = 1,
+    RESHAPE = 2,
+    // Time a data layer waited for its prefetch thread, within its forward.
+    DATA_WAIT = 3
+  };
+  static const int kNumEvents = 4;
+
+  struct Stats {
+    int count;
+    double total_ms;
+    double mean_ms;
+    double p50_ms;
+    double p90_ms;
+    double p99_ms;
+    double max_ms;
+  };
+
+  Profiler(const vector<string>& layer_names,
+      const vector<string>& layer_types);
+
+  void Clear();
+
+  // Times one call of layer layer_id: Start() before and Stop() after it.
+  void Start();
+  void Stop(const int layer_id, const Event event);
+  // Records a duration measured by the layer itself, starting at the last
+  // Start().
+  void Record(const int layer_id, const Event event, const float microseconds);
+  // The blobs a forward of layer layer_id reads and writes, and their sizes
+  // in bytes as of the last forward.
+  void SetBlobNames(const int layer_id, const vector<string>& bottom_names,
+      const vector<string>& top_names);
+  void SetBlobBytes(const int layer_id, const vector<int64_t>& bottom_bytes,
+      const vector<int64_t>& top_bytes);
+
+  int num_layers() const { return layer_names_.size(); }
+  Stats LayerStats(const int layer_id, const Event event) const;
+  // Percentiles use the nearest rank of the sorted samples.
+  static Stats ComputeStats(const vector<float>& microseconds);
+
+  // The statistics of every layer as a JSON document.
+  string Report() const;
+  // Every recorded call in the chrome://tracing JSON format.
+  string ChromeTrace() const;
+  void WriteReport(const string& filename) const;
+  void WriteChromeTrace(const string& filename) const;
+
+ protected:
+  struct Call {
+    int layer_id;
+    Event event;
+    double start_us;
+    float duration_us;
+  };
+  struct BlobBytes {
+    vector<string> bottom_names;
+    vector<int64_t> bottom_bytes;
+    vector<string> top_names;
+    vector<int64_t> top_bytes;
+  };
+
+  double Now() const;
+
+  vector<string> layer_names_;
+  vector<string> layer_types_;
+  // samples_[layer_id * kNumEvents + event], in microseconds.
+  vector<vector<float> > samples_;
+  vector<BlobBytes> blob_bytes_;
+  vector<Call> calls_;
+  boost::posix_time::ptime origin_;
+  double start_us_;
+  Timer timer_;
+
+  DISABLE_COPY_AND_ASSIGN(Profiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PROFILER_HPP_
@@ -0,0 +1,68 @@
+#ifndef CAFFE_UTIL_QUANTIZED_GEMM_H_
+#define CAFFE_UTIL_QUANTIZED_GEMM_H_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+// Largest GEMM depth for which a uint8 x uint8 dot product cannot overflow
+// the int32 accumulator: 33025 * 255 * 255 < 2^31.
+const int kQuantizedGemmMaxDepth = 33025;
+
+/**
+ * @brief Per-output-channel parameters of the int32 -> Dtype epilogue.
+ *
+ * SINGLE_ROUND and DOUBLE_ROUND scale by the fixed-point (mul, shift) pair
+ * exactly as MultiplyByQuantizedMultiplierVR does with round_mode 1 and 2;
+ * FLOAT_SCALE multiplies by scale and rounds half to even (ONNX).
+ */
+struct Requantizer {
+  enum Mode { NONE = 0, SINGLE_ROUND = 1, DOUBLE_ROUND = 2, FLOAT_SCALE = 3 };
+  Mode mode;
+  int mul;
+  int shift;
+  float scale;
+  int zero_point;
+};
+
+/**
+ * @brief Stores the integer-valued x as uint8 q = x + offset.
+ *
+ * Returns false as soon as an element is not an integer in
+ * [-offset, 255 - offset], so that callers can fall back to the
+ * floating-point path; q is then left partially written.
+ */
+template <typename Dtype>
+bool caffe_cpu_quantize_u8(const int n, const Dtype* x, const int offset,
+    uint8_t* q);
+
+/**
+ * @brief Integer GEMM with zero-point offsets,
+ *   C[m][n] = sum_k (A[m][k] - a_zero_point[m]) * (B[k][n] - b_zero_point).
+ *
+ * A is M x K, B is K x N and C is M x N, all row-major. a_row_sum[m] must
+ * hold sum_k A[m][k]; it is computed once when the weights are packed, so
+ * the zero points never have to be subtracted from the operands themselves.
+ * K may not exceed kQuantizedGemmMaxDepth.
+ */
+void caffe_cpu_gemm_u8u8s32(const int M, const int N, const int K,
+    const uint8_t* A, const int* a_zero_point, const int* a_row_sum,
+    const uint8_t* B, const int b_zero_point, int* C);
+
+/**
+ * @brief Fused epilogue of the integer convolution: adds the (optional)
+ *        int32 bias, requantizes, adds the output zero point and saturates
+ *        one channel row at a time while it is still in cache.
+ *
+ * acc holds channels x spatial_dim accumulators and is used as scratch.
+ */
+template <typename Dtype>
+void caffe_cpu_requantize(const int channels, const int spatial_dim,
+    int* acc, const int* bias, const Requantizer* rq, const Dtype saturate,
+    Dtype* y);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_QUANTIZED_GEMM_H_
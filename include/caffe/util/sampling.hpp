@@ -0,0 +1,93 @@
+#ifndef CAFFE_UTIL_SAMPLING_HPP_
+#define CAFFE_UTIL_SAMPLING_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief The taps of a resampling along one axis, shared by every row (or
+ *        column) of every plane resampled on the same grid.
+ *
+ * Output i is the sum over k < taps of weight[k * size + i] times input
+ * index[k * size + i]. The taps are stored tap-major, so that the k-th taps
+ * of consecutive outputs are loaded at once by the vectorized gathers.
+ */
+template <typename Dtype>
+struct SampleAxis {
+  int size;
+  int taps;
+  vector<int> index;
+  vector<Dtype> weight;
+};
+
+/// The filters of ResampleLayer.
+enum SampleFilter {
+  SAMPLE_FILTER_CUBIC,
+  SAMPLE_FILTER_BOX,
+  SAMPLE_FILTER_TRIANGLE
+};
+
+/**
+ * @brief The linear taps of caffe_cpu_interp2: the first and the last of the
+ *        in_size inputs line up with the ones of the out_size outputs.
+ */
+template <typename Dtype>
+void caffe_bilinear_axis(const int in_size, const int out_size,
+    SampleAxis<Dtype>* axis);
+
+/**
+ * @brief The input nearest to the coordinate i * scale + start of each
+ *        output i, clamped to the in_size inputs.
+ */
+template <typename Dtype>
+void caffe_nearest_axis(const int in_size, const int out_size,
+    const float scale, const float start, SampleAxis<Dtype>* axis);
+
+/**
+ * @brief The filter taps of ResampleLayer around the coordinate
+ *        i * scale + start of each output i, normalized to sum to one over
+ *        the inputs within in_size; with antialias, the filter is widened
+ *        by scale.
+ */
+template <typename Dtype>
+void caffe_filter_axis(const int in_size, const int out_size,
+    const float scale, const float start, const SampleFilter filter,
+    const bool antialias, SampleAxis<Dtype>* axis);
+
+/**
+ * @brief Resamples planes of src into the planes of dst, the rows by axis_y
+ *        and the columns by axis_x.
+ *
+ * src and dst point to the first pixel of their first plane, with rows
+ * src_width (dst_width) apart and planes src_plane (dst_plane) apart, so
+ * that both can be crops of larger images. The rows of all planes are split
+ * among Caffe::num_threads() threads; each output row blends the input rows
+ * of its taps, then gathers its columns from the blend with
+ * caffe_simd_gather_taps.
+ */
+template <typename Dtype>
+void caffe_cpu_resample(const int planes, const SampleAxis<Dtype>& axis_y,
+    const SampleAxis<Dtype>& axis_x, const Dtype* src, const int src_width,
+    const int src_plane, Dtype* dst, const int dst_width,
+    const int dst_plane);
+
+/**
+ * @brief Warps each NCHW image by its flow, of channels x and y: the top
+ *        pixel (y, x) samples the image bilinearly at
+ *        (y + flow_y, x + flow_x), or is fill_value outside the image.
+ *
+ * The rows of all images are split among Caffe::num_threads() threads. The
+ * taps of a row are computed once from the flow, then gathered from every
+ * channel with caffe_simd_gather_taps.
+ */
+template <typename Dtype>
+void caffe_cpu_flow_warp(const int num, const int channels, const int height,
+    const int width, const Dtype* image, const Dtype* flow,
+    const Dtype fill_value, Dtype* top);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SAMPLING_HPP_
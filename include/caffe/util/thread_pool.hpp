@@ -0,0 +1,65 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of threads for intra-layer parallel loops on the CPU.
+ *
+ * The pool of a host thread is obtained with Caffe::thread_pool(), so that
+ * all layers of a Net share the same workers instead of starting their own.
+ */
+class ThreadPool {
+ public:
+  /// Starts num_threads - 1 workers; the thread calling Run is the last one.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Calls task(i, worker) for every i in [0, num_tasks) and returns
+   *        once all calls have finished.
+   *
+   * worker lies in [0, num_threads()) and is unique among the calls running
+   * at the same time, so callers can give each worker its own scratch
+   * memory; the calling thread is worker 0. Run is not reentrant.
+   */
+  void Run(int num_tasks, const boost::function<void(int, int)>& task);
+
+ protected:
+  void WorkerEntry(int worker);
+  void RunTasks(int worker);
+
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+   */
+  class sync;
+
+  int num_threads_;
+  vector<shared_ptr<boost::thread> > workers_;
+  shared_ptr<sync> sync_;
+  const boost::function<void(int, int)>* task_;
+  int num_tasks_;
+  int next_task_;
+  int busy_workers_;
+  int generation_;
+  bool stop_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
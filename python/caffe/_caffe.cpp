@@ -70,6 +70,7 @@ BP_GET_POINTER_T(AdaDeltaSolver, float);
 BP_GET_POINTER_T(AdamSolver, float);
 BP_GET_POINTER_T(NCCL, float);
 BP_GET_POINTER(Timer);
+BP_GET_POINTER(Profiler);
 
 #endif
 
@@ -109,6 +110,24 @@ void Log(const string& s) {
 
 void set_random_seed(unsigned int seed) { Caffe::set_random_seed(seed); }
 
+// Host memory pool, see HostAllocator.
+void set_host_pool_bytes(size_t bytes) {
+  HostAllocator::Get().set_max_retained_bytes(bytes);
+}
+void set_host_huge_pages(bool huge_pages) {
+  HostAllocator::Get().set_huge_pages(huge_pages);
+}
+void trim_host_pool() { HostAllocator::Get().Trim(); }
+bp::dict host_pool_stats() {
+  const HostAllocator::Stats stats = HostAllocator::Get().stats();
+  bp::dict result;
+  result["hits"] = stats.hits;
+  result["misses"] = stats.misses;
+  result["retained_bytes"] = stats.retained_bytes;
+  result["allocated_bytes"] = stats.allocated_bytes;
+  return result;
+}
+
 // For convenience, check that input files can be opened, and raise an
 // exception that boost will send to Python if not (caffe could still crash
 // later if the input files are disturbed before they are actually used, but
@@ -434,6 +453,11 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_logging_disabled", &set_logging_disabled);
   bp::def("set_random_seed", &set_random_seed);
   bp::def("set_device", &Caffe::SetDevice);
+  bp::def("set_num_threads", &Caffe::set_num_threads);
+  bp::def("set_host_pool_bytes", &set_host_pool_bytes);
+  bp::def("set_host_huge_pages", &set_host_huge_pages);
+  bp::def("trim_host_pool", &trim_host_pool);
+  bp::def("host_pool_stats", &host_pool_stats);
   bp::def("solver_count", &Caffe::solver_count);
   bp::def("set_solver_count", &Caffe::set_solver_count);
   bp::def("solver_rank", &Caffe::solver_rank);
@@ -459,6 +483,9 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("_forward", &Net<Dtype>::ForwardFromTo)
     .def("_backward", &Net<Dtype>::BackwardFromTo)
     .def("reshape", &Net<Dtype>::Reshape)
+    .def("enable_profiler", &Net<Dtype>::EnableProfiler)
+    .add_property("profiler", bp::make_function(&Net<Dtype>::profiler,
+        bp::return_value_policy<bp::copy_const_reference>()))
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
     .def("copy_from", static_cast<void (Net<Dtype>::*)(const string&)>(
@@ -622,6 +649,15 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("ms", &Timer::MilliSeconds);
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Timer);
 
+  bp::class_<Profiler, shared_ptr<Profiler>, boost::noncopyable>(
+    "Profiler", bp::no_init)
+    .def("clear", &Profiler::Clear)
+    .def("report", &Profiler::Report)
+    .def("chrome_trace", &Profiler::ChromeTrace)
+    .def("write_report", &Profiler::WriteReport)
+    .def("write_chrome_trace", &Profiler::WriteChromeTrace);
+  BP_REGISTER_SHARED_PTR_TO_PYTHON(Profiler);
+
   // boost python expects a void (missing) return value, while import_array
   // returns NULL for python3. import_array1() forces a void return value.
   import_array1();
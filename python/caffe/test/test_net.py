@@ -1,6 +1,7 @@
 import unittest
 import tempfile
 import os
+import json
 import numpy as np
 import six
 from collections import OrderedDict
@@ -119,6 +120,29 @@ class TestNet(unittest.TestCase):
         # Check that the diffs are now 0
         self.assertTrue((diff == 0).all())
 
+    def test_profiler(self):
+        self.assertIsNone(self.net.profiler)
+        self.net.enable_profiler(True)
+        for _ in range(3):
+            self.net.forward()
+            self.net.backward()
+        self.net.enable_profiler(False)
+        self.net.forward()
+        report = json.loads(self.net.profiler.report())
+        layers = dict((l['name'], l) for l in report['layers'])
+        self.assertEqual(sorted(layers.keys()),
+                         sorted(self.net._layer_names))
+        self.assertEqual(layers['conv']['forward']['count'], 3)
+        self.assertEqual(layers['conv']['backward']['count'], 3)
+        self.assertEqual(layers['ip']['tops'],
+                         [{'name': 'ip_blob', 'bytes': 5 * 13 * 4}])
+        trace = json.loads(self.net.profiler.chrome_trace())
+        forwards = [e for e in trace['traceEvents'] if e['cat'] == 'forward']
+        self.assertEqual(len(forwards), 4 * 3)
+        self.net.profiler.clear()
+        trace = json.loads(self.net.profiler.chrome_trace())
+        self.assertEqual(trace['traceEvents'], [])
+
     def test_inputs_outputs(self):
         self.assertEqual(self.net.inputs, [])
         self.assertEqual(self.net.outputs, ['loss'])
@@ -40,10 +40,19 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
   if (count_ > capacity_) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    data_->set_zero_fill(zero_fill_data_);
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
   }
 }
 
+template <typename Dtype>
+void Blob<Dtype>::set_zero_fill_data(bool zero_fill) {
+  zero_fill_data_ = zero_fill;
+  if (data_) {
+    data_->set_zero_fill(zero_fill);
+  }
+}
+
 template <typename Dtype>
 void Blob<Dtype>::Reshape(const BlobShape& shape) {
   CHECK_LE(shape.dim_size(), kMaxBlobAxes);
@@ -63,14 +72,14 @@ template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), zero_fill_data_(true) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
   // capacity_ must be initialized before calling Reshape
-  : capacity_(0) {
+  : capacity_(0), zero_fill_data_(true) {
   Reshape(shape);
 }
 
@@ -164,6 +173,15 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::set_data_memory(const shared_ptr<SyncedMemory>& memory) {
+  CHECK(memory);
+  CHECK_GE(memory->size(), count_ * sizeof(Dtype));
+  data_ = memory;
+  // Growing past count_ reallocates, so the blob never outgrows memory.
+  capacity_ = count_;
+}
+
 // jay add
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data_at(const int n, const int c, const int h, const int w) const {
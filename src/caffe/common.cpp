@@ -11,6 +11,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -33,6 +34,20 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+void Caffe::set_num_threads(int num_threads) {
+  CHECK_GE(num_threads, 1);
+  Get().num_threads_ = num_threads;
+}
+
+ThreadPool& Caffe::thread_pool(int num_threads) {
+  shared_ptr<ThreadPool>& pool = Get().thread_pool_;
+  if (!pool || pool->num_threads() < num_threads) {
+    pool.reset();  // join the old workers first
+    pool.reset(new ThreadPool(num_threads));
+  }
+  return *pool;
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
@@ -71,7 +86,8 @@ void GlobalInit(int* pargc, char*** pargv) {
 
 Caffe::Caffe()
     : random_generator_(), mode_(Caffe::CPU),
-      solver_count_(1), solver_rank_(0), multiprocess_(false) { }
+      solver_count_(1), solver_rank_(0), multiprocess_(false),
+      num_threads_(1) { }
 
 Caffe::~Caffe() { }
 
@@ -125,7 +141,8 @@ void* Caffe::RNG::generator() {
 Caffe::Caffe()
     : cublas_handle_(NULL), curand_generator_(NULL), random_generator_(),
     mode_(Caffe::CPU),
-    solver_count_(1), solver_rank_(0), multiprocess_(false) {
+    solver_count_(1), solver_rank_(0), multiprocess_(false),
+    num_threads_(1) {
   // Try to create a cublas handler, and report an error if failed (but we will
   // keep the program running as one might just want to run CPU code).
   if (cublasCreate(&cublas_handle_) != CUBLAS_STATUS_SUCCESS) {
@@ -3,6 +3,7 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif  // USE_OPENCV
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -12,10 +13,167 @@
 #include "caffe/util/yolo_preprocess.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+// The vector kernels of TransformRow; rows of double are left to the scalar
+// loop.
+static int SimdTransformRow(const int n, const uint8_t* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst) {
+  return caffe_simd_transform_row(n, src, mean, mean_value, scale, mirror,
+      dst);
+}
+
+static int SimdTransformRow(const int n, const float* src, const float* mean,
+    const float mean_value, const float scale, const bool mirror,
+    float* dst) {
+  return caffe_simd_transform_row(n, src, mean, mean_value, scale, mirror,
+      dst);
+}
+
+template <typename Stype>
+static int SimdTransformRow(const int n, const Stype* src,
+    const double* mean, const double mean_value, const double scale,
+    const bool mirror, double* dst) {
+  return 0;
+}
+
+// Transforms one row of n pixels: dst = (src - mean) * scale, stored in
+// reverse order with kMirror. The mean is an array aligned with src with
+// kMeanArray, otherwise mean_value (0 without a mean).
+template <typename Dtype, typename Stype, bool kMirror, bool kMeanArray>
+static void TransformRow(const int n, const Stype* src, const Dtype* mean,
+    const Dtype mean_value, const Dtype scale, Dtype* dst) {
+  int i = SimdTransformRow(n, src, kMeanArray ? mean : NULL, mean_value,
+      scale, kMirror, dst);
+  for (; i < n; ++i) {
+    const Dtype pixel = static_cast<Dtype>(src[i]);
+    dst[kMirror ? n - 1 - i : i] =
+        (pixel - (kMeanArray ? mean[i] : mean_value)) * scale;
+  }
+}
+
+// Transforms a crop of height x width pixels at (h_off, w_off) of a
+// channels x src_height x src_width image. mean, if not NULL, is an image of
+// the same shape; mean_values, if not NULL, holds a mean per channel.
+template <typename Dtype, typename Stype, bool kMirror, bool kMeanArray>
+static void TransformPlanes(const Stype* src, const int channels,
+    const int src_height, const int src_width, const int h_off,
+    const int w_off, const int height, const int width, const Dtype* mean,
+    const Dtype* mean_values, const Dtype scale, Dtype* dst) {
+  for (int c = 0; c < channels; ++c) {
+    const Dtype mean_value = mean_values ? mean_values[c] : Dtype(0);
+    for (int h = 0; h < height; ++h) {
+      const int src_index = (c * src_height + h_off + h) * src_width + w_off;
+      TransformRow<Dtype, Stype, kMirror, kMeanArray>(width, src + src_index,
+          kMeanArray ? mean + src_index : NULL, mean_value, scale,
+          dst + (c * height + h) * width);
+    }
+  }
+}
+
+// Selects the TransformPlanes kernel once per image.
+template <typename Dtype, typename Stype>
+static void TransformPlanes(const bool mirror, const Stype* src,
+    const int channels, const int src_height, const int src_width,
+    const int h_off, const int w_off, const int height, const int width,
+    const Dtype* mean, const Dtype* mean_values, const Dtype scale,
+    Dtype* dst) {
+  if (mirror) {
+    if (mean) {
+      TransformPlanes<Dtype, Stype, true, true>(src, channels, src_height,
+          src_width, h_off, w_off, height, width, mean, mean_values, scale,
+          dst);
+    } else {
+      TransformPlanes<Dtype, Stype, true, false>(src, channels, src_height,
+          src_width, h_off, w_off, height, width, mean, mean_values, scale,
+          dst);
+    }
+  } else {
+    if (mean) {
+      TransformPlanes<Dtype, Stype, false, true>(src, channels, src_height,
+          src_width, h_off, w_off, height, width, mean, mean_values, scale,
+          dst);
+    } else {
+      TransformPlanes<Dtype, Stype, false, false>(src, channels, src_height,
+          src_width, h_off, w_off, height, width, mean, mean_values, scale,
+          dst);
+    }
+  }
+}
+
+#ifdef USE_OPENCV
+// Transforms the height x width crop of a cv::Mat, whose channels are
+// interleaved, into planes. Unlike TransformPlanes, the mean image is read at
+// the position each pixel is stored to, so a mirrored row uses the mean row
+// reversed.
+template <typename Dtype, bool kMirror, bool kMeanArray>
+static void TransformInterleaved(const cv::Mat& img, const int channels,
+    const int height, const int width, const int mean_height,
+    const int mean_width, const int h_off, const int w_off, const Dtype* mean,
+    const Dtype* mean_values, const Dtype scale, Dtype* dst) {
+  vector<uint8_t> planes(channels > 1 ? channels * width : 0);
+  vector<Dtype> mean_row(kMirror && kMeanArray ? width : 0);
+  for (int h = 0; h < height; ++h) {
+    const uint8_t* row = img.ptr<uint8_t>(h);
+    if (channels > 1) {
+      for (int w = 0; w < width; ++w) {
+        for (int c = 0; c < channels; ++c) {
+          planes[c * width + w] = row[w * channels + c];
+        }
+      }
+    }
+    for (int c = 0; c < channels; ++c) {
+      const uint8_t* src = channels > 1 ? &planes[c * width] : row;
+      const Dtype* mean_c = NULL;
+      if (kMeanArray) {
+        mean_c = mean + (c * mean_height + h_off + h) * mean_width + w_off;
+        if (kMirror) {
+          std::reverse_copy(mean_c, mean_c + width, mean_row.begin());
+          mean_c = &mean_row[0];
+        }
+      }
+      TransformRow<Dtype, uint8_t, kMirror, kMeanArray>(width, src, mean_c,
+          mean_values ? mean_values[c] : Dtype(0), scale,
+          dst + (c * height + h) * width);
+    }
+  }
+}
+
+// Selects the TransformInterleaved kernel once per image.
+template <typename Dtype>
+static void TransformInterleaved(const bool mirror, const cv::Mat& img,
+    const int channels, const int height, const int width,
+    const int mean_height, const int mean_width, const int h_off,
+    const int w_off, const Dtype* mean, const Dtype* mean_values,
+    const Dtype scale, Dtype* dst) {
+  if (mirror) {
+    if (mean) {
+      TransformInterleaved<Dtype, true, true>(img, channels, height, width,
+          mean_height, mean_width, h_off, w_off, mean, mean_values, scale,
+          dst);
+    } else {
+      TransformInterleaved<Dtype, true, false>(img, channels, height, width,
+          mean_height, mean_width, h_off, w_off, mean, mean_values, scale,
+          dst);
+    }
+  } else {
+    if (mean) {
+      TransformInterleaved<Dtype, false, true>(img, channels, height, width,
+          mean_height, mean_width, h_off, w_off, mean, mean_values, scale,
+          dst);
+    } else {
+      TransformInterleaved<Dtype, false, false>(img, channels, height, width,
+          mean_height, mean_width, h_off, w_off, mean, mean_values, scale,
+          dst);
+    }
+  }
+}
+#endif  // USE_OPENCV
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -119,36 +277,15 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   crop_bbox->set_xmax(Dtype(w_off + width) / datum_width);
   crop_bbox->set_ymax(Dtype(h_off + height) / datum_height);
 
-  Dtype datum_element;
-  int top_index, data_index;
-  for (int c = 0; c < datum_channels; ++c) {
-    for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-        data_index = (c * datum_height + h_off + h) * datum_width + w_off + w;
-        if (*do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
-        if (has_mean_file) {
-          transformed_data[top_index] =
-            (datum_element - mean[data_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] =
-              (datum_element - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = datum_element * scale;
-          }
-        }
-      }
-    }
+  const Dtype* mean_values = has_mean_values ? &mean_values_[0] : NULL;
+  if (has_uint8) {
+    TransformPlanes(*do_mirror, reinterpret_cast<const uint8_t*>(data.data()),
+        datum_channels, datum_height, datum_width, h_off, w_off, height,
+        width, mean, mean_values, scale, transformed_data);
+  } else {
+    TransformPlanes(*do_mirror, datum.float_data().data(), datum_channels,
+        datum_height, datum_width, h_off, w_off, height, width, mean,
+        mean_values, scale, transformed_data);
   }
 }
 
@@ -857,37 +994,11 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK(cv_cropped_image.data);
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
-  for (int h = 0; h < height; ++h) {
-    const uchar* ptr = cv_cropped_image.ptr<uchar>(h);
-    int img_index = 0;
-    int h_idx = h;
-    for (int w = 0; w < width; ++w) {
-      int w_idx = w;
-      if (*do_mirror) {
-        w_idx = (width - 1 - w);
-      }
-      int h_idx_real = h_idx;
-      int w_idx_real = w_idx;
-      for (int c = 0; c < img_channels; ++c) {
-        top_index = (c * height + h_idx_real) * width + w_idx_real;
-        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-        if (has_mean_file && !preserve_pixel_vals) {
-          int mean_index = (c * img_height + h_off + h_idx_real) * img_width
-              + w_off + w_idx_real;
-          transformed_data[top_index] =
-              (pixel - mean[mean_index]) * scale;
-        } else {
-          if (has_mean_values && !preserve_pixel_vals) {
-            transformed_data[top_index] =
-                (pixel - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = pixel * scale;
-          }
-        }
-      }
-    }
-  }
+  const Dtype* mean_values = has_mean_values && !preserve_pixel_vals ?
+      &mean_values_[0] : NULL;
+  TransformInterleaved(*do_mirror, cv_cropped_image, img_channels, height,
+      width, img_height, img_width, h_off, w_off, mean, mean_values, scale,
+      transformed_data);
 }
 
 template<typename Dtype>
@@ -0,0 +1,218 @@
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "caffe/inference_server.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceRequest<Dtype>::sync {
+ public:
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+template <typename Dtype>
+InferenceRequest<Dtype>::InferenceRequest(const vector<int>& shape)
+    : input_(shape), latency_us_(0), done_(false), sync_(new sync()) {
+  CHECK(!shape.empty() && shape[0] == 1)
+      << "A request holds one item, along the first axis";
+}
+
+template <typename Dtype>
+void InferenceRequest<Dtype>::Wait() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (!done_) {
+    sync_->condition_.wait(lock);
+  }
+}
+
+template <typename Dtype>
+bool InferenceRequest<Dtype>::done() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return done_;
+}
+
+template <typename Dtype>
+void InferenceRequest<Dtype>::Done() {
+  latency_us_ = (boost::posix_time::microsec_clock::universal_time() -
+      submit_time_).total_microseconds();
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    done_ = true;
+  }
+  sync_->condition_.notify_all();
+}
+
+template <typename Dtype>
+class InferenceServer<Dtype>::sync {
+ public:
+  mutable boost::mutex mutex_;
+  boost::condition_variable condition_;
+};
+
+template <typename Dtype>
+class InferenceServer<Dtype>::Worker : public InternalThread {
+ public:
+  Worker(InferenceServer* server, const NetParameter& param)
+      : server_(server), net_(new Net<Dtype>(param)) {}
+  virtual ~Worker() { StopInternalThread(); }
+
+  Net<Dtype>* net() { return net_.get(); }
+
+ protected:
+  virtual void InternalThreadEntry() {
+    try {
+      while (!must_stop()) {
+        vector<shared_ptr<InferenceRequest<Dtype> > > batch;
+        server_->NextBatch(&batch);
+        Forward(batch);
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  void Forward(const vector<shared_ptr<InferenceRequest<Dtype> > >& batch) {
+    Blob<Dtype>* input = net_->input_blobs()[0];
+    vector<int> shape = batch[0]->input_.shape();
+    shape[0] = batch.size();
+    if (input->shape() != shape) {
+      input->Reshape(shape);
+      net_->Reshape();
+    }
+    for (int i = 0; i < batch.size(); ++i) {
+      caffe_copy(batch[i]->input_.count(), batch[i]->input_.cpu_data(),
+          input->mutable_cpu_data() + input->offset(i));
+    }
+    const vector<Blob<Dtype>*>& outputs = net_->Forward();
+    for (int i = 0; i < batch.size(); ++i) {
+      InferenceRequest<Dtype>* request = batch[i].get();
+      request->outputs_.resize(outputs.size());
+      for (int j = 0; j < outputs.size(); ++j) {
+        CHECK_EQ(outputs[j]->shape(0), batch.size()) << "Output "
+            << net_->blob_names()[net_->output_blob_indices()[j]]
+            << " doesn't have the batch along its first axis";
+        vector<int> item_shape = outputs[j]->shape();
+        item_shape[0] = 1;
+        request->outputs_[j].reset(new Blob<Dtype>(item_shape));
+        caffe_copy(outputs[j]->count(1),
+            outputs[j]->cpu_data() + outputs[j]->offset(i),
+            request->outputs_[j]->mutable_cpu_data());
+      }
+      request->Done();
+    }
+  }
+
+  InferenceServer* server_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+template <typename Dtype>
+InferenceServer<Dtype>::InferenceServer(const NetParameter& param,
+    const string& trained_filename, int num_workers, int max_batch_size,
+    int max_delay_us)
+    : max_batch_size_(max_batch_size), max_delay_us_(max_delay_us),
+      num_batches_(0), sync_(new sync()) {
+  CHECK_GT(num_workers, 0);
+  CHECK_GT(max_batch_size, 0);
+  CHECK_GE(max_delay_us, 0);
+  NetParameter net_param(param);
+  net_param.mutable_state()->set_phase(TEST);
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.push_back(shared_ptr<Worker>(new Worker(this, net_param)));
+    if (i == 0) {
+      CHECK_EQ(workers_[0]->net()->input_blobs().size(), 1)
+          << "InferenceServer needs a net with one input";
+      // Copied before the worker starts reshaping the input.
+      input_item_shape_ = workers_[0]->net()->input_blobs()[0]->shape();
+      CHECK_GT(input_item_shape_.size(), 0)
+          << "InferenceServer needs the batch along the first input axis";
+      input_item_shape_[0] = 1;
+      if (!trained_filename.empty()) {
+        workers_[0]->net()->CopyTrainedLayersFrom(trained_filename);
+      }
+    } else {
+      workers_[i]->net()->ShareTrainedLayersWith(workers_[0]->net());
+    }
+  }
+  for (int i = 0; i < num_workers; ++i) {
+    workers_[i]->StartInternalThread();
+  }
+}
+
+template <typename Dtype>
+InferenceServer<Dtype>::~InferenceServer() {
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->StopInternalThread();
+  }
+}
+
+template <typename Dtype>
+const Net<Dtype>& InferenceServer<Dtype>::net() const {
+  return *workers_[0]->net();
+}
+
+template <typename Dtype>
+int InferenceServer<Dtype>::num_batches() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return num_batches_;
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::Submit(
+    const shared_ptr<InferenceRequest<Dtype> >& request) {
+  {
+    boost::mutex::scoped_lock lock(request->sync_->mutex_);
+    request->done_ = false;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    request->submit_time_ = boost::posix_time::microsec_clock::universal_time();
+    queue_.push_back(request);
+  }
+  sync_->condition_.notify_all();
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::NextBatch(
+    vector<shared_ptr<InferenceRequest<Dtype> > >* batch) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  for (;;) {
+    while (queue_.empty()) {
+      sync_->condition_.wait(lock);
+    }
+    const InferenceRequest<Dtype>& oldest = *queue_.front();
+    int size = 0;
+    for (int i = 0; i < queue_.size() && size < max_batch_size_; ++i) {
+      size += queue_[i]->input_.shape() == oldest.input_.shape();
+    }
+    const boost::posix_time::ptime deadline = oldest.submit_time_ +
+        boost::posix_time::microseconds(max_delay_us_);
+    if (size == max_batch_size_ ||
+        boost::posix_time::microsec_clock::universal_time() >= deadline) {
+      break;
+    }
+    sync_->condition_.timed_wait(lock, deadline);
+  }
+  const vector<int> shape = queue_.front()->input_.shape();
+  for (int i = 0; i < queue_.size() && batch->size() < max_batch_size_; ) {
+    if (queue_[i]->input_.shape() == shape) {
+      batch->push_back(queue_[i]);
+      queue_.erase(queue_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+  ++num_batches_;
+}
+
+INSTANTIATE_CLASS(InferenceRequest);
+INSTANTIATE_CLASS(InferenceServer);
+
+}  // namespace caffe
@@ -18,10 +18,21 @@ template <typename Dtype>
 AnnotatedDataLayer<Dtype>::AnnotatedDataLayer(const LayerParameter& param)
   : BasePrefetchingDataLayer<Dtype>(param),
     //reader_(param) {
-    offset_() {
+    offset_(), sharded_(false) {
   db_.reset(db::GetDB(param.data_param().backend()));
   db_->Open(param.data_param().source(), db::READ);
-  cursor_.reset(db_->NewCursor());
+  //<--CUSTOMIZATION
+  // In test mode only rank 0 runs, and reads all the records.
+  const int shards_per_solver = param.data_param().shards_per_solver();
+  sharded_ = shards_per_solver > 0 && Caffe::solver_count() > 1 &&
+      param.phase() == TRAIN;
+  if (sharded_) {
+    cursor_.reset(new db::ShardedCursor(db_->NewCursor(),
+        Caffe::solver_count(), Caffe::solver_rank(), shards_per_solver));
+  } else {
+    cursor_.reset(db_->NewCursor());
+  }
+  //CUSTOMIZATION-->
 }
 
 template <typename Dtype>
@@ -163,7 +174,8 @@ bool AnnotatedDataLayer<Dtype>::Skip() {
   int rank = Caffe::solver_rank();
   bool keep = (offset_ % size) == rank ||
               // In test mode, only rank 0 runs, so avoid skipping
-              this->layer_param_.phase() == TEST;
+              this->layer_param_.phase() == TEST ||
+              sharded_;  //CUSTOMIZATION
   return !keep;
 }
 
@@ -1,10 +1,15 @@
 #include <algorithm>
 #include <vector>
 
+#include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/fold_layers.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/permute.hpp"
+#include "caffe/util/quantized_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -312,14 +317,69 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   // For Convolution
   //if (!strcmp(this->type(), "Convolution")) {
-  else LayerSetUpInternal(this->layer_param_.convolution_param(), bottom, top);
+  else {
+    //<--CUSTOMIZATION
+    nhwc_ = this->layer_param_.data_format() == "NHWC";
+    LayerSetUpInternal(this->layer_param_.convolution_param(),
+        nhwc_ ? nchw_bottom(bottom) : bottom, top);
+    //CUSTOMIZATION-->
+    num_threads_ = this->layer_param_.convolution_param().num_threads(); //CUSTOMIZATION
+  }
   //}
   /**************************************************************************************/
+  if (nhwc_) {
+    CHECK(!reverse_dimensions() && channel_axis_ == 1 &&
+        num_spatial_axes_ == 2 && !force_nd_im2col_)
+        << "data_format NHWC only applies to 2D convolutions.";
+    CHECK_EQ(bottom.size(), 1)
+        << "NHWC convolutions take a single bottom.";
+  }
+  if (this->layer_param_.fused_activation_param().type() !=
+      FusedActivationParameter_Type_NONE) {
+    CHECK(input_scale_ == 1 && weight_scale_ == 1 && output_scale_ == 1 &&
+        input_zero_point_ == 0 && weight_zero_point_ == 0 &&
+        output_zero_point_ == 0 && !per_channel_scale_weight_ &&
+        !per_channel_scale_output_ && !submanifold_sparse_ &&
+        saturate_ == ConvolutionParameter_SaturateMethod_None)
+        << "Fused activations need float convolutions.";
+  }
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& BaseConvolutionLayer<Dtype>::nchw_bottom(
+    const vector<Blob<Dtype>*>& bottom) {
+  CHECK_EQ(bottom[0]->num_axes(), 4)
+      << "NHWC bottoms must have 4 axes (num, height, width, channels).";
+  nchw_bottom_.Reshape(bottom[0]->shape(0), bottom[0]->shape(3),
+      bottom[0]->shape(1), bottom[0]->shape(2));
+  nchw_bottom_vec_.assign(1, &nchw_bottom_);
+  return nchw_bottom_vec_;
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (!nhwc_) {
+    ReshapeInternal(bottom, top);
+  } else {
+    // Shape an NCHW top, which is never allocated, then its NHWC
+    // counterpart.
+    nchw_top_vec_.assign(1, &nchw_top_);
+    ReshapeInternal(nchw_bottom(bottom), nchw_top_vec_);
+    for (int top_id = 0; top_id < top.size(); ++top_id) {
+      top[top_id]->Reshape(nchw_top_.shape(0), nchw_top_.shape(2),
+          nchw_top_.shape(3), nchw_top_.shape(1));
+    }
+  }
+  // Forward overwrites the whole tops.
+  for (int top_id = 0; top_id < top.size(); ++top_id) {
+    top[top_id]->set_zero_fill_data(false);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::ReshapeInternal(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const int first_spatial_axis = channel_axis_ + 1;
   CHECK_EQ(bottom[0]->num_axes(), first_spatial_axis + num_spatial_axes_)
       << "bottom num_axes may not change.";
@@ -388,6 +448,7 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     caffe_set(bias_multiplier_.count(), Dtype(1),
         bias_multiplier_.mutable_cpu_data());
   }
+  UpdateZeroPointBias();
 }
 
 template <typename Dtype>
@@ -408,6 +469,412 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_qgemm(const uint8_t* input,
+    const int input_zero_point, const uint8_t* weights,
+    const int* weight_zero_point, const int* weight_row_sum, int* output) {
+  CHECK(!force_nd_im2col_ && num_spatial_axes_ == 2)
+      << "The integer engine only supports 2D convolution.";
+  const uint8_t* col_buff = input;
+  if (!is_1x1_) {
+    qcol_buffer_.resize(col_buffer_.count());
+    conv_im2col_cpu(input, qcol_buffer_.data(),
+        static_cast<uint8_t>(input_zero_point));
+    col_buff = qcol_buffer_.data();
+  }
+  const int out_channels = conv_out_channels_ / group_;
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm_u8u8s32(out_channels, conv_out_spatial_dim_, kernel_dim_,
+        weights + weight_offset_ * g, weight_zero_point + out_channels * g,
+        weight_row_sum + out_channels * g, col_buff + col_offset_ * g,
+        input_zero_point, output + output_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::UpdateZeroPointBias() {
+  // Only convolutions have per-channel weight zero points, in blobs_[3].
+  const bool per_channel = !reverse_dimensions() &&
+      per_channel_scale_weight_ && weight_zero_point_ == 0;
+  if (input_zero_point_ == 0 && weight_zero_point_ == 0 && !per_channel) {
+    has_weight_zero_point_ = false;
+    return;
+  }
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  vector<uint64_t> key;
+  key.push_back(weight.data_version());
+  key.push_back(per_channel ? this->blobs_[3]->data_version() : 0);
+  for (int i = 0; i < num_spatial_axes_ + 1; ++i) {
+    key.push_back(conv_input_shape_.cpu_data()[i]);
+  }
+  for (int i = 0; i < output_shape_.size(); ++i) {
+    key.push_back(output_shape_[i]);
+  }
+  key.push_back(bottom_dim_);
+  if (key == zero_point_key_) {
+    return;
+  }
+  zero_point_key_ = key;
+  weight_zero_points_.Reshape(vector<int>(1, conv_out_channels_));
+  Dtype* zero_points = weight_zero_points_.mutable_cpu_data();
+  has_weight_zero_point_ = false;
+  for (int m = 0; m < conv_out_channels_; ++m) {
+    zero_points[m] = per_channel ? this->blobs_[3]->cpu_data()[m] :
+        Dtype(weight_zero_point_);
+    has_weight_zero_point_ = has_weight_zero_point_ || zero_points[m] != 0;
+  }
+  zero_point_ones_.Reshape(vector<int>(1,
+      std::max(kernel_dim_, conv_out_channels_ / group_)));
+  caffe_set(zero_point_ones_.count(), Dtype(1),
+      zero_point_ones_.mutable_cpu_data());
+  if (input_zero_point_ == 0) {
+    return;
+  }
+  // T is the layer applied with the weights W - zw to an image of -zx.
+  const int slice = weight.count() / conv_out_channels_;
+  vector<Dtype> shifted_weight(weight.count());
+  for (int m = 0; m < conv_out_channels_; ++m) {
+    caffe_add_scalar<Dtype>(slice, -zero_points[m],
+        weight.cpu_data() + m * slice, shifted_weight.data() + m * slice);
+  }
+  const vector<Dtype> image(bottom_dim_, Dtype(-input_zero_point_));
+  zero_point_bias_.Reshape(vector<int>(1, top_dim_));
+  if (reverse_dimensions()) {
+    backward_cpu_gemm(image.data(), shifted_weight.data(),
+        zero_point_bias_.mutable_cpu_data());
+  } else {
+    forward_cpu_gemm(image.data(), shifted_weight.data(),
+        zero_point_bias_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_weight_zero_point(
+    const Dtype* col_buff, const int group_begin, const int group_end,
+    Dtype* tap_sum, Dtype* output) {
+  const int out_channels = conv_out_channels_ / group_;
+  const Dtype* zero_points = weight_zero_points_.cpu_data();
+  const Dtype* ones = zero_point_ones_.cpu_data();
+  for (int g = group_begin; g < group_end; ++g) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, kernel_dim_, conv_out_spatial_dim_,
+        (Dtype)1., col_buff + col_offset_ * g, ones, (Dtype)0., tap_sum);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels,
+        conv_out_spatial_dim_, 1, (Dtype)-1., zero_points + out_channels * g,
+        tap_sum, (Dtype)1., output + output_offset_ * g);
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_deconv_gemm_batch(
+    const Dtype* input, const Dtype* weights, const Dtype* bias,
+    Dtype* output) {
+  const Dtype* zero_point_bias =
+      input_zero_point_ != 0 ? zero_point_bias_.cpu_data() : NULL;
+  const Dtype* zero_points =
+      has_weight_zero_point_ ? weight_zero_points_.cpu_data() : NULL;
+  const Dtype* ones =
+      has_weight_zero_point_ ? zero_point_ones_.cpu_data() : NULL;
+  const int in_channels = conv_out_channels_ / group_;
+  vector<Dtype> tap_sum(has_weight_zero_point_ ? conv_out_spatial_dim_ : 0);
+  for (int n = 0; n < num_; ++n) {
+    const Dtype* image = input + n * bottom_dim_;
+    Dtype* top = output + n * top_dim_;
+    if (!has_weight_zero_point_) {
+      backward_cpu_gemm(image, weights, top);
+    } else {
+      Dtype* col_buff = is_1x1_ ? top : col_buffer_.mutable_cpu_data();
+      for (int g = 0; g < group_; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, kernel_dim_,
+            conv_out_spatial_dim_, in_channels,
+            (Dtype)1., weights + weight_offset_ * g, image + output_offset_ * g,
+            (Dtype)0., col_buff + col_offset_ * g);
+        // Every column of the group takes zw times the sum of its inputs.
+        caffe_cpu_gemv<Dtype>(CblasTrans, in_channels, conv_out_spatial_dim_,
+            (Dtype)1., image + output_offset_ * g, ones, (Dtype)0.,
+            tap_sum.data());
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, kernel_dim_,
+            conv_out_spatial_dim_, 1, -zero_points[in_channels * g], ones,
+            tap_sum.data(), (Dtype)1., col_buff + col_offset_ * g);
+      }
+      if (!is_1x1_) {
+        conv_col2im_cpu(col_buff, top);
+      }
+    }
+    if (zero_point_bias) {
+      caffe_axpy<Dtype>(top_dim_, (Dtype)1., zero_point_bias, top);
+    }
+    if (bias) {
+      forward_cpu_bias(top, bias);
+    }
+    caffe_cpu_fused_activation(this->layer_param_.fused_activation_param(),
+        top_dim_, top);
+  }
+}
+
+template <typename Dtype>
+int BaseConvolutionLayer<Dtype>::num_threads() const {
+  return num_threads_ > 0 ? num_threads_ : Caffe::num_threads();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const Dtype* weights, const Dtype* bias, Dtype* output) {
+  // Split the groups of an image only as far as needed to keep the threads
+  // busy, as every chunk repeats the im2col setup and smaller gemms.
+  int group_chunks = 1;
+  const int threads = num_threads();
+  if (group_ > 1 && num_ < threads && !force_nd_im2col_ &&
+      num_spatial_axes_ == 2) {
+    group_chunks = std::min(group_, (threads + num_ - 1) / num_);
+  }
+  const int num_items = num_ * group_chunks;
+  const int num_tasks = std::min(threads, num_items);
+  const FusedActivationParameter& activation =
+      this->layer_param_.fused_activation_param();
+  // The zero points enter as -zw * (sum of the taps) and the bias T; see
+  // UpdateZeroPointBias.
+  const Dtype* zero_point_bias =
+      input_zero_point_ != 0 ? zero_point_bias_.cpu_data() : NULL;
+  if (num_tasks <= 1) {
+    vector<Dtype> tap_sum(has_weight_zero_point_ ? conv_out_spatial_dim_ : 0);
+    for (int n = 0; n < num_; ++n) {
+      Dtype* top = output + n * top_dim_;
+      forward_cpu_gemm(input + n * bottom_dim_, weights, top);
+      if (has_weight_zero_point_) {
+        forward_cpu_weight_zero_point(is_1x1_ ? input + n * bottom_dim_ :
+            col_buffer_.cpu_data(), 0, group_, tap_sum.data(), top);
+      }
+      if (zero_point_bias) {
+        caffe_axpy<Dtype>(top_dim_, (Dtype)1., zero_point_bias, top);
+      }
+      if (bias) {
+        forward_cpu_bias(top, bias);
+      }
+      caffe_cpu_fused_activation(activation, top_dim_, top);
+    }
+    return;
+  }
+  // Task t handles the items t, t + num_tasks, ... with buffer t, so each
+  // buffer is used by one thread at a time whatever the pool size.
+  vector<Dtype*> col_buffers(num_tasks, static_cast<Dtype*>(NULL));
+  if (!is_1x1_) {
+    col_buffers[0] = col_buffer_.mutable_cpu_data();
+  }
+  while (worker_col_buffers_.size() < num_tasks - 1) {
+    worker_col_buffers_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  for (int t = 1; !is_1x1_ && t < num_tasks; ++t) {
+    worker_col_buffers_[t - 1]->Reshape(col_buffer_shape_);
+    col_buffers[t] = worker_col_buffers_[t - 1]->mutable_cpu_data();
+  }
+  const Dtype* bias_multiplier = bias ? bias_multiplier_.cpu_data() : NULL;
+  const int out_channels = conv_out_channels_ / group_;
+  Caffe::thread_pool(num_tasks).Run(num_tasks, [&](int t, int /*worker*/) {
+    vector<Dtype> tap_sum(has_weight_zero_point_ ? conv_out_spatial_dim_ : 0);
+    for (int item = t; item < num_items; item += num_tasks) {
+      const int n = item / group_chunks;
+      const int chunk = item % group_chunks;
+      const int group_begin = group_ * chunk / group_chunks;
+      const int group_end = group_ * (chunk + 1) / group_chunks;
+      const Dtype* image = input + n * bottom_dim_;
+      const Dtype* col_buff = image;
+      if (!is_1x1_) {
+        if (group_chunks == 1) {
+          conv_im2col_cpu(image, col_buffers[t]);
+        } else {
+          conv_im2col_cpu(image, group_begin, group_end, col_buffers[t]);
+        }
+        col_buff = col_buffers[t];
+      }
+      Dtype* top = output + n * top_dim_;
+      for (int g = group_begin; g < group_end; ++g) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_channels,
+            conv_out_spatial_dim_, kernel_dim_,
+            (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
+            (Dtype)0., top + output_offset_ * g);
+      }
+      if (has_weight_zero_point_) {
+        forward_cpu_weight_zero_point(col_buff, group_begin, group_end,
+            tap_sum.data(), top);
+      }
+      const int channel_begin = num_output_ * group_begin / group_;
+      const int channel_end = num_output_ * group_end / group_;
+      if (zero_point_bias) {
+        caffe_axpy<Dtype>((channel_end - channel_begin) * out_spatial_dim_,
+            (Dtype)1., zero_point_bias + channel_begin * out_spatial_dim_,
+            top + channel_begin * out_spatial_dim_);
+      }
+      if (bias) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
+            channel_end - channel_begin, out_spatial_dim_, 1, (Dtype)1.,
+            bias + channel_begin, bias_multiplier,
+            (Dtype)1., top + channel_begin * out_spatial_dim_);
+      }
+      caffe_cpu_fused_activation(activation,
+          (channel_end - channel_begin) * out_spatial_dim_,
+          top + channel_begin * out_spatial_dim_);
+    }
+  });
+}
+
+template <typename Dtype>
+const Dtype* BaseConvolutionLayer<Dtype>::nhwc_weight_cpu(bool depthwise) {
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  if (weight.data_version() == nhwc_weight_version_) {
+    return nhwc_weight_.cpu_data();
+  }
+  // From (num_output, channels / group, kernel_h, kernel_w).
+  const int order[] = {0, 2, 3, 1};
+  const int depthwise_order[] = {1, 2, 3, 0};
+  nhwc_weight_.ReshapeLike(weight);
+  caffe_cpu_permute(weight.shape(),
+      depthwise ? vector<int>(depthwise_order, depthwise_order + 4) :
+      vector<int>(order, order + 4),
+      weight.cpu_data(), nhwc_weight_.mutable_cpu_data());
+  nhwc_weight_version_ = weight.data_version();
+  return nhwc_weight_.cpu_data();
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_nhwc_depthwise(
+    const Dtype* input, const Dtype* weights, const Dtype* bias,
+    const int row_begin, const int row_end, Dtype* output) {
+  const int channels = conv_in_channels_;
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int kernel_h = kernel_shape_.cpu_data()[0];
+  const int kernel_w = kernel_shape_.cpu_data()[1];
+  const int stride_h = stride_.cpu_data()[0];
+  const int stride_w = stride_.cpu_data()[1];
+  const int dilation_h = dilation_.cpu_data()[0];
+  const int dilation_w = dilation_.cpu_data()[1];
+  int output_h, output_w, pad_top, pad_left;
+  im2col_output_and_pad(height, width, kernel_h, kernel_w,
+      pad_.cpu_data()[0], pad_.cpu_data()[1], stride_h, stride_w,
+      pad_type_, pad_l_, pad_r_, pad_t_, pad_b_, dilation_h, dilation_w,
+      &output_h, &output_w, &pad_top, &pad_left);
+  for (int output_row = row_begin; output_row < row_end; ++output_row) {
+    for (int output_col = 0; output_col < output_w; ++output_col) {
+      Dtype* out = output + output_col * channels;
+      caffe_set(channels, Dtype(0), out);
+      for (int kernel_row = 0; kernel_row < kernel_h; ++kernel_row) {
+        const int input_row =
+            output_row * stride_h - pad_top + kernel_row * dilation_h;
+        if (input_row < 0 || input_row >= height) {
+          continue;
+        }
+        for (int kernel_col = 0; kernel_col < kernel_w; ++kernel_col) {
+          const int input_col =
+              output_col * stride_w - pad_left + kernel_col * dilation_w;
+          if (input_col < 0 || input_col >= width) {
+            continue;
+          }
+          const Dtype* in = input + (input_row * width + input_col) * channels;
+          const Dtype* w = weights + (kernel_row * kernel_w + kernel_col) *
+              channels;
+          for (int c = 0; c < channels; ++c) {
+            out[c] += in[c] * w[c];
+          }
+        }
+      }
+      if (bias) {
+        caffe_axpy(channels, Dtype(1), bias, out);
+      }
+    }
+    output += output_w * channels;
+  }
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_nhwc(const Dtype* input,
+    const Dtype* bias, Dtype* output) {
+  const int height = conv_input_shape_.cpu_data()[1];
+  const int width = conv_input_shape_.cpu_data()[2];
+  const int output_h = output_shape_[0];
+  const int output_w = output_shape_[1];
+  const bool depthwise =
+      group_ == conv_in_channels_ && group_ == conv_out_channels_;
+  // 1x1 convolutions multiply the input rows in place, a group reading its
+  // range of their channels.
+  const bool direct = is_1x1_;
+  const Dtype* weights = nhwc_weight_cpu(depthwise);
+  // As in forward_cpu_gemm_batch, split the images only as far as needed to
+  // keep the threads busy.
+  const int threads = num_threads();
+  int row_chunks = 1;
+  if (num_ < threads) {
+    row_chunks = std::min(output_h, (threads + num_ - 1) / num_);
+  }
+  const int num_items = num_ * row_chunks;
+  const int num_tasks = std::max(1, std::min(threads, num_items));
+  const int in_channels = conv_in_channels_ / group_;
+  const int out_channels = conv_out_channels_ / group_;
+  const int max_rows = (output_h + row_chunks - 1) / row_chunks * output_w;
+  const int taps_size = (depthwise || direct) ? 0 : max_rows * kernel_dim_;
+  while (nhwc_buffers_.size() < num_tasks) {
+    nhwc_buffers_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  vector<Dtype*> buffers(num_tasks, static_cast<Dtype*>(NULL));
+  if (taps_size > 0) {
+    for (int t = 0; t < num_tasks; ++t) {
+      nhwc_buffers_[t]->Reshape(vector<int>(1, taps_size));
+      buffers[t] = nhwc_buffers_[t]->mutable_cpu_data();
+    }
+  }
+  const Dtype* bias_multiplier = bias ? bias_multiplier_.cpu_data() : NULL;
+  const FusedActivationParameter& activation =
+      this->layer_param_.fused_activation_param();
+  auto run = [&](int t, int /*worker*/) {
+    for (int item = t; item < num_items; item += num_tasks) {
+      const int n = item / row_chunks;
+      const int chunk = item % row_chunks;
+      const int row_begin = output_h * chunk / row_chunks;
+      const int row_end = output_h * (chunk + 1) / row_chunks;
+      const int rows = (row_end - row_begin) * output_w;
+      const Dtype* image = input + n * bottom_dim_;
+      Dtype* top = output + n * top_dim_ + row_begin * output_w * num_output_;
+      if (depthwise) {
+        forward_cpu_nhwc_depthwise(image, weights, bias, row_begin, row_end,
+            top);
+        caffe_cpu_fused_activation(activation, rows * num_output_, top);
+        continue;
+      }
+      // Each group writes its range of the channels of the top rows.
+      for (int g = 0; g < group_; ++g) {
+        const Dtype* taps =
+            image + row_begin * output_w * conv_in_channels_ + g * in_channels;
+        int taps_stride = conv_in_channels_;
+        if (!direct) {
+          im2row_cpu(image + g * in_channels, in_channels, conv_in_channels_,
+              height, width,
+              kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+              pad_.cpu_data()[0], pad_.cpu_data()[1],
+              stride_.cpu_data()[0], stride_.cpu_data()[1],
+              pad_type_, pad_l_, pad_r_, pad_t_, pad_b_,
+              dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+              row_begin, row_end, buffers[t]);
+          taps = buffers[t];
+          taps_stride = kernel_dim_;
+        }
+        caffe_cpu_strided_gemm<Dtype>(CblasNoTrans, CblasTrans, rows,
+            out_channels, kernel_dim_, (Dtype)1., taps, taps_stride,
+            weights + weight_offset_ * g, kernel_dim_, (Dtype)0.,
+            top + g * out_channels, num_output_);
+      }
+      if (bias) {
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, rows, num_output_,
+            1, (Dtype)1., bias_multiplier, bias, (Dtype)1., top);
+      }
+      caffe_cpu_fused_activation(activation, rows * num_output_, top);
+    }
+  };
+  if (num_tasks == 1) {
+    run(0, 0);
+  } else {
+    Caffe::thread_pool(num_tasks).Run(num_tasks, run);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
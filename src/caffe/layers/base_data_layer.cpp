@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,7 +8,10 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -37,7 +41,10 @@ BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
       prefetch_(param.data_param().prefetch()),
-      prefetch_free_(), prefetch_full_(), prefetch_current_() {
+      prefetch_free_(), prefetch_full_(), prefetch_current_(),
+      transform_threads_(param.data_param().transform_threads()),
+      data_wait_us_(0) {
+  CHECK_GE(transform_threads_, 1) << "transform_threads must be positive.";
   for (int i = 0; i < prefetch_.size(); ++i) {
     prefetch_[i].reset(new Batch<Dtype>());
     prefetch_free_.push(prefetch_[i].get());
@@ -86,6 +93,22 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
 #endif
   DLOG(INFO) << "Initializing prefetch";
   this->data_transformer_->InitRand();
+  if (transform_threads_ > 1 && !TransformsInParallel()) {
+    LOG(WARNING) << "Layer " << this->layer_param_.name() << " of type "
+        << this->type() << " transforms its items serially, ignoring "
+        << "transform_threads: " << transform_threads_;
+    transform_threads_ = 1;
+  }
+  worker_transformers_.clear();
+  worker_transformed_data_.clear();
+  worker_transformers_.push_back(this->data_transformer_);
+  for (int i = 1; i < transform_threads_; ++i) {
+    worker_transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(this->transform_param_, this->phase_)));
+    worker_transformers_[i]->InitRand();
+    worker_transformed_data_.push_back(
+        shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
   StartInternalThread();
   DLOG(INFO) << "Prefetch initialized.";
 }
@@ -131,13 +154,67 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::TransformBatch(const int batch_size,
+    const boost::function<void(int, DataTransformer<Dtype>*, Blob<Dtype>*)>&
+    transform) {
+  // Layers that set up without BasePrefetchingDataLayer::LayerSetUp have no
+  // worker transformers and run serially.
+  const int num_workers = std::min<int>(worker_transformers_.size(),
+                                        batch_size);
+  // Every item draws its random numbers, those of the transformer and those
+  // of the thread's Caffe RNG (caffe_rng_uniform, as for expansion, crops,
+  // resizing, noise and distortion), from streams seeded for it on this
+  // thread, so the batch only depends on the seed of the layer and not on
+  // the pool threads, whose Caffe RNGs are not seeded.
+  vector<unsigned int> seeds(batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    seeds[item_id] = caffe_rng_rand();
+  }
+  const auto transform_items = [&](const int task, const int num_tasks,
+      DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data) {
+    Caffe::RNG thread_rng;
+    thread_rng = Caffe::rng_stream();
+    for (int item_id = task; item_id < batch_size; item_id += num_tasks) {
+      Caffe::rng_stream() = Caffe::RNG(seeds[item_id]);
+      transformer->InitRand();
+      transform(item_id, transformer, transformed_data);
+    }
+    Caffe::rng_stream() = thread_rng;
+  };
+  if (num_workers <= 1) {
+    transform_items(0, 1, this->data_transformer_.get(), &transformed_data_);
+    return;
+  }
+  for (int i = 1; i < num_workers; ++i) {
+    worker_transformed_data_[i - 1]->ReshapeLike(transformed_data_);
+  }
+  Caffe::thread_pool(num_workers).Run(num_workers,
+      [&](const int task, const int) {
+    // Task i plays transform worker i, whichever thread runs it.
+    transform_items(task, num_workers, worker_transformers_[task].get(),
+        task == 0 ? &transformed_data_ :
+        worker_transformed_data_[task - 1].get());
+  });
+}
+
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::PopFullBatch(
+    const string& log_on_wait) {
+  CPUTimer timer;
+  timer.Start();
+  Batch<Dtype>* batch = prefetch_full_.pop(log_on_wait);
+  data_wait_us_ = timer.MicroSeconds();
+  return batch;
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   if (prefetch_current_) {
     prefetch_free_.push(prefetch_current_);
   }
-  prefetch_current_ = prefetch_full_.pop("Waiting for data");
+  prefetch_current_ = PopFullBatch("Waiting for data");
   // Reshape to loaded data.
   top[0]->ReshapeLike(prefetch_current_->data_);
   top[0]->set_cpu_data(prefetch_current_->data_.mutable_cpu_data());
@@ -197,7 +274,7 @@ template <typename Dtype>
 void ImageDimPrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   Batch<Dtype>* batch =
-    this->prefetch_full_.pop("Data layer prefetch queue empty");
+    this->PopFullBatch("Data layer prefetch queue empty");
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
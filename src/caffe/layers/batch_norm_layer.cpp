@@ -15,10 +15,11 @@ void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   use_global_stats_ = this->phase_ == TEST;
   if (param.has_use_global_stats())
     use_global_stats_ = param.use_global_stats();
+  nhwc_ = this->layer_param_.data_format() == "NHWC"; //CUSTOMIZATION
   if (bottom[0]->num_axes() == 1)
     channels_ = 1;
   else
-    channels_ = bottom[0]->shape(1);
+    channels_ = bottom[0]->shape(nhwc_ ? -1 : 1);
   eps_ = param.eps();
   add_eps_before_sqrt_ = param.add_eps_before_sqrt();
   update_global_stats_ = param.update_global_stats();
@@ -56,7 +57,7 @@ template <typename Dtype>
 void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (bottom[0]->num_axes() >= 1)
-    CHECK_EQ(bottom[0]->shape(1), channels_);
+    CHECK_EQ(bottom[0]->shape(nhwc_ ? -1 : 1), channels_);
   top[0]->ReshapeLike(*bottom[0]);
 
   vector<int> sz;
@@ -96,6 +97,11 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num = bottom[0]->shape(0);
   int spatial_dim = bottom[0]->count()/(bottom[0]->shape(0)*channels_);
 
+  if (nhwc_) { //CUSTOMIZATION
+    Forward_cpu_nhwc(bottom, top);
+    return;
+  }
+
   if (bottom[0] != top[0]) {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
   }
@@ -176,10 +182,45 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       x_norm_.mutable_cpu_data());
 }
 
+template <typename Dtype>
+void BatchNormLayer<Dtype>::Forward_cpu_nhwc(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK(use_global_stats_) << "NHWC batch norm needs use_global_stats.";
+  const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0 ?
+      0 : 1 / this->blobs_[2]->cpu_data()[0];
+  caffe_cpu_scale(variance_.count(), scale_factor,
+      this->blobs_[0]->cpu_data(), mean_.mutable_cpu_data());
+  caffe_cpu_scale(variance_.count(), scale_factor,
+      this->blobs_[1]->cpu_data(), variance_.mutable_cpu_data());
+  if (add_eps_before_sqrt_) {
+    caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
+    caffe_sqrt(variance_.count(), variance_.cpu_data(),
+              variance_.mutable_cpu_data());
+  } else {
+    caffe_sqrt(variance_.count(), variance_.cpu_data(),
+              variance_.mutable_cpu_data());
+    caffe_add_scalar(variance_.count(), eps_, variance_.mutable_cpu_data());
+  }
+  // (x - mean) / std, as Forward_cpu computes it with the broadcasts.
+  const Dtype* mean = mean_.cpu_data();
+  const Dtype* std = variance_.cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int rows = bottom[0]->count() / channels_;
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < channels_; ++c) {
+      top_data[c] = (bottom_data[c] - mean[c]) / std[c];
+    }
+    bottom_data += channels_;
+    top_data += channels_;
+  }
+}
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!nhwc_) << "NHWC batch norm only runs forward.";
   const Dtype* top_diff;
   if (bottom[0] != top[0]) {
     top_diff = top[0]->cpu_diff();
@@ -1,3 +1,5 @@
+#include <climits>
+#include <cstdlib>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -51,6 +53,196 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
   }
 }
 
+template <typename Dtype>
+bool ConvolutionLayer<Dtype>::PackQuantizedWeights() {
+  vector<uint64_t> version(this->blobs_.size());
+  for (int i = 0; i < this->blobs_.size(); ++i) {
+    version[i] = this->blobs_[i]->data_version();
+  }
+  if (version == qweight_version_) {
+    return qweight_valid_;
+  }
+  qweight_version_ = version;
+  qweight_valid_ = false;
+  const Dtype* weight = W->cpu_data();
+  const int num_output = this->num_output_;
+  const int kernel_dim = W->count(1);
+  if (kernel_dim > kQuantizedGemmMaxDepth) {
+    return false;
+  }
+  // Weights are stored as uint8; int8 weights are moved up by 128 and so is
+  // their zero point, which leaves every (weight - zero_point) unchanged.
+  qweight_.resize(W->count());
+  int offset = 0;
+  if (!caffe_cpu_quantize_u8(W->count(), weight, offset, qweight_.data())) {
+    offset = 128;
+    if (!caffe_cpu_quantize_u8(W->count(), weight, offset, qweight_.data())) {
+      return false;
+    }
+  }
+  const Dtype* zero_point_data =
+      (this->weight_zero_point_ == 0 && this->per_channel_scale_weight_) ?
+      this->blobs_[3]->cpu_data() : NULL;
+  qweight_zero_point_.resize(num_output);
+  qweight_row_sum_.resize(num_output);
+  for (int m = 0; m < num_output; ++m) {
+    const Dtype zero_point = zero_point_data ? zero_point_data[m] :
+        Dtype(this->weight_zero_point_);
+    const int z = static_cast<int>(zero_point) + offset;
+    if (Dtype(z - offset) != zero_point || z < 0 || z > 255) {
+      return false;
+    }
+    qweight_zero_point_[m] = z;
+    const uint8_t* row = qweight_.data() + m * kernel_dim;
+    int sum = 0;
+    for (int k = 0; k < kernel_dim; ++k) {
+      sum += row[k];
+    }
+    qweight_row_sum_[m] = sum;
+  }
+  if (this->bias_term_) {
+    const Dtype* bias = B->cpu_data();
+    qbias_.resize(num_output);
+    for (int m = 0; m < num_output; ++m) {
+      if (std::fabs(bias[m]) >= Dtype(INT_MAX) ||
+          Dtype(static_cast<int>(bias[m])) != bias[m]) {
+        return false;
+      }
+      qbias_[m] = static_cast<int>(bias[m]);
+    }
+  }
+  qweight_valid_ = true;
+  return true;
+}
+
+// Mirrors the scale selection of the float path in Forward_cpu below, so that
+// both paths quantize the output with the same multipliers.
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::ComputeRequantizers(vector<Requantizer>* rq) {
+  const double input_scale = this->input_scale_;
+  const double output_scale = this->output_scale_;
+  const double weight_scale = this->weight_scale_;
+  const bool per_channel_scale_weight = this->per_channel_scale_weight_;
+  const bool per_channel_scale_output = this->per_channel_scale_output_;
+  const bool scale_output = (input_scale != Dtype(1.0) || weight_scale != Dtype(1.0) ||
+                             output_scale != Dtype(1.0)) || per_channel_scale_weight || per_channel_scale_output;
+  const bool is_depthwise = (this->group_ == this->num_output_);
+  const bool is_pointwise = (W->count(2) == 1);
+  const Dtype* weight_scale_data = per_channel_scale_weight ? this->blobs_[2]->cpu_data() : NULL;
+  const Dtype* output_scale_data = per_channel_scale_output ? this->blobs_[4]->cpu_data() : NULL;
+  const Dtype* output_zero_point_data = per_channel_scale_output ? this->blobs_[5]->cpu_data() : NULL;
+
+  rq->resize(this->num_output_);
+  for (int j = 0; j < this->num_output_; ++j) {
+    Requantizer& r = (*rq)[j];
+    r.mode = Requantizer::NONE;
+    r.mul = 0;
+    r.shift = 0;
+    r.scale = 1.f;
+    if (this->output_zero_point_ != 0) {
+      r.zero_point = this->output_zero_point_;
+    } else if (per_channel_scale_output) {
+      r.zero_point = static_cast<int>(output_zero_point_data[j]);
+    } else {
+      r.zero_point = 0;
+    }
+    if (!scale_output) {
+      continue;
+    }
+    if (this->quantize_method_ == ConvolutionParameter_QuantizeMethod_tflite) {
+      double out_scal;
+      if (per_channel_scale_weight) {
+        if (per_channel_scale_output)
+          out_scal = input_scale * (double)weight_scale_data[j] / (double)output_scale_data[j];
+        else
+          out_scal = input_scale * (double)weight_scale_data[j] / output_scale;
+        r.mode = is_depthwise ? Requantizer::DOUBLE_ROUND : Requantizer::SINGLE_ROUND;
+      } else if (is_depthwise || is_pointwise) {
+        double ref_scal = (float)input_scale * (float)weight_scale;
+        ref_scal /= (float) output_scale;
+        out_scal = ref_scal;
+        r.mode = Requantizer::DOUBLE_ROUND;
+      } else {
+        out_scal = (double)input_scale * weight_scale;
+        out_scal /= output_scale;
+        r.mode = Requantizer::DOUBLE_ROUND;
+      }
+      r.mul = tfl_QuantizeMultiplier(out_scal, &r.shift);
+    } else if (this->quantize_method_ == ConvolutionParameter_QuantizeMethod_ONNX) {
+      if (per_channel_scale_weight) {
+        if (per_channel_scale_output)
+          r.scale = input_scale * weight_scale_data[j] / output_scale_data[j];
+        else
+          r.scale = input_scale * weight_scale_data[j] / output_scale;
+      } else {
+        r.scale = (float) input_scale * (float) weight_scale / (float) output_scale;
+      }
+      r.mode = Requantizer::FLOAT_SCALE;
+    } else { // Caffe2
+      float out_scal = (float)input_scale * weight_scale;
+      out_scal /= output_scale;
+      r.mul = tfl_QuantizeMultiplier((double)out_scal, &r.shift);
+      r.mode = Requantizer::DOUBLE_ROUND;
+    }
+  }
+}
+
+template <typename Dtype>
+bool ConvolutionLayer<Dtype>::Forward_cpu_quantized(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const bool quantized = this->input_scale_ != 1.0 ||
+      this->weight_scale_ != 1.0 || this->output_scale_ != 1.0 ||
+      this->per_channel_scale_weight_ || this->per_channel_scale_output_ ||
+      this->input_zero_point_ != 0 || this->weight_zero_point_ != 0 ||
+      this->output_zero_point_ != 0 ||
+      this->saturate_ != ConvolutionParameter_SaturateMethod_None;
+  // The EV rounding of conv_layer.ev.inc only exists on the float path.
+  if (!this->layer_param_.convolution_param().integer_engine() || !quantized ||
+      this->force_nd_im2col_ || this->num_spatial_axes_ != 2 ||
+      getenv("CAFFE_QUANTIZED_ROUND") != NULL) {
+    return false;
+  }
+  if (this->per_channel_scale_output_ && !this->per_channel_scale_weight_) {
+    return false;
+  }
+  if (!PackQuantizedWeights()) {
+    return false;
+  }
+  vector<Requantizer> rq;
+  ComputeRequantizers(&rq);
+  const int* bias = this->bias_term_ ? qbias_.data() : NULL;
+  const int out_spatial_dim = this->top_dim_ / this->num_output_;
+  qoutput_.resize(this->top_dim_);
+  for (int i = 0; i < bottom.size(); ++i) {
+    const int count = bottom[i]->count();
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    qinput_.resize(count);
+    if (!caffe_cpu_quantize_u8(count, bottom_data, qinput_offset_,
+        qinput_.data())) {
+      qinput_offset_ = 128 - qinput_offset_;
+      if (!caffe_cpu_quantize_u8(count, bottom_data, qinput_offset_,
+          qinput_.data())) {
+        return false;
+      }
+    }
+    // The padding is filled with the zero point, so it has to fit as well.
+    const int input_zero_point = this->input_zero_point_ + qinput_offset_;
+    if (input_zero_point < 0 || input_zero_point > 255) {
+      return false;
+    }
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      this->forward_cpu_qgemm(qinput_.data() + n * this->bottom_dim_,
+          input_zero_point, qweight_.data(), qweight_zero_point_.data(),
+          qweight_row_sum_.data(), qoutput_.data());
+      caffe_cpu_requantize(this->num_output_, out_spatial_dim,
+          qoutput_.data(), bias, rq.data(), this->saturate_,
+          top_data + n * this->top_dim_);
+    }
+  }
+  return true;
+}
+
 #include "conv_layer.ev.inc"
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -59,9 +251,7 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const double output_scale = this->output_scale_;
   const double weight_scale = this->weight_scale_;
   // bias_scale = input_scale * weight_scale
-  const int input_zero_point = this->input_zero_point_;
   const int output_zero_point = this->output_zero_point_;
-  const int weight_zero_point = this->weight_zero_point_;
   const Dtype saturate = this->saturate_;
   const int quantize_method = this->quantize_method_;
   // weight scale will retrieve the default values if per-channel is set
@@ -75,8 +265,6 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   *Assumption is that bias_scale = input_scale*weight_scale
   For a floating-value model, only (2) is computed with floating values
   ***/
-  const bool shift_input = (input_zero_point != 0);
-  const bool shift_weight = (weight_zero_point != 0);
   const bool scale_output = (input_scale != Dtype(1.0) || weight_scale != Dtype(1.0) ||
                              output_scale != Dtype(1.0)) || per_channel_scale_weight || per_channel_scale_output;
   const bool shift_output = (output_zero_point != 0);
@@ -86,7 +274,6 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 
   const int quant_num_ch = per_channel_scale_weight ? this->num_output_ : 1;
   const Dtype* weight_scale_data = per_channel_scale_weight ? this->blobs_[2]->cpu_data() : NULL;
-  const Dtype* weight_zero_point_data = per_channel_scale_weight ? this->blobs_[3]->cpu_data() : NULL;
 
   if(per_channel_scale_output)
     CHECK_EQ(per_channel_scale_weight, true)
@@ -94,35 +281,34 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* output_scale_data = per_channel_scale_output ? this->blobs_[4]->cpu_data() : NULL;
   const Dtype* output_zero_point_data = per_channel_scale_output ? this->blobs_[5]->cpu_data() : NULL;
 
-  if (shift_weight) { // shift the quantized weight
-    caffe_add_scalar<Dtype>(W->count(), Dtype(-weight_zero_point), W->mutable_cpu_data());
-  }
-  else if(per_channel_scale_weight) {
-    const int slice = W->count() / quant_num_ch;
-    Dtype* weight_mutable = W->mutable_cpu_data();
-    for (int i = 0; i < quant_num_ch; ++i) {
-      caffe_add_scalar<Dtype>(slice, -weight_zero_point_data[i], weight_mutable);
-      weight_mutable += slice;
-    }
+  //<--CUSTOMIZATION
+  if (this->nhwc_) {
+    CHECK(!scale_output && !shift_output && !per_channel_scale_output &&
+        this->input_zero_point_ == 0 && this->weight_zero_point_ == 0 &&
+        saturate == ConvolutionParameter_SaturateMethod_None &&
+        !this->submanifold_sparse_)
+        << "NHWC convolutions do not support quantized or sparse models.";
+    this->forward_cpu_nhwc(bottom[0]->cpu_data(),
+        this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+        top[0]->mutable_cpu_data());
+    return;
   }
+  //CUSTOMIZATION-->
 
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  for (int i = 0; i < bottom.size(); ++i) {
-    if (shift_input) {
-      caffe_add_scalar<Dtype>(bottom[i]->count(),
-        Dtype(-input_zero_point), bottom[i]->mutable_cpu_data());
-    }
+  const bool integer_path = Forward_cpu_quantized(bottom, top);
 
+  // The zero points are folded into a bias correction, so the forward pass
+  // reads the weights and bottoms as they are; see UpdateZeroPointBias, which
+  // only rebuilds the correction here if the weights changed since Reshape.
+  if (!integer_path) {
+    this->UpdateZeroPointBias();
+  }
+  const Dtype* weight = integer_path ? NULL : this->blobs_[0]->cpu_data();
+  for (int i = 0; !integer_path && i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
-      }
-    }
+    this->forward_cpu_gemm_batch(bottom_data, weight,
+        this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data);
 
     const int count_t = top[i]->count();
     if (scale_output) {
@@ -215,23 +401,6 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
 
     caffe_cpu_saturate(count_t, top_data, saturate); // if None nothing happens
-
-    if (shift_input) { // shift the quantized input blob back to correct range
-      caffe_add_scalar<Dtype>(bottom[i]->count(),
-        Dtype(input_zero_point), bottom[i]->mutable_cpu_data());
-    }
-  }
-  // shift quantized weight/bias back to correct range
-  if (shift_weight) {
-    caffe_add_scalar<Dtype>(W->count(), Dtype(weight_zero_point), W->mutable_cpu_data());
-  }
-  else if(per_channel_scale_weight) {
-    const int slice = W->count() / quant_num_ch;
-    Dtype* weight_mutable = W->mutable_cpu_data();
-    for (int i = 0; i < quant_num_ch; ++i) {
-      caffe_add_scalar<Dtype>(slice, weight_zero_point_data[i], weight_mutable);
-      weight_mutable += slice;
-    }
   }
 
   if(this->submanifold_sparse_)
@@ -270,6 +439,7 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->nhwc_) << "NHWC convolutions only run forward.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   //default update_weight =true
   bool update_weight = !this->layer_param_.convolution_param().weight_fixed();
@@ -4,6 +4,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/util/correlation.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -11,137 +12,6 @@
 
 namespace caffe {
 
-template<typename Dtype>
-void blob_rearrange_kernel2(Dtype *dout, const Dtype *din, int num, int channels, int height, int width, int pheight, int pwidth, int padding)
-{
-    // dout[num][pwidthheight][widthheight][channels]
-    // din[num][channels][height][width]
-
-    for (int n = 0; n < num; ++n)
-        for (int ch = 0; ch < channels; ++ch)
-            for (int y = 0; y < height; ++y)
-                for (int x = 0; x < width; ++x)
-                    dout[((n * pheight + y + padding) * pwidth + x + padding) * channels + ch] =
-                        din[((n * channels + ch) * height + y) * width + x];
-}
-
-template <typename Dtype>
-void CorrelateData(int num, int topwidth, int topheight, int topchannels, int topcount,
-                   int max_displacement, int neighborhood_grid_radius, int neighborhood_grid_width, int kernel_radius, int kernel_size, int stride1, int stride2,
-                   int bottomwidth, int bottomheight, int bottomchannels,
-                   const Dtype *bottom0, const Dtype *bottom1, Dtype *top)
-{
-
-
-    for (int n = 0; n < num; ++n)
-    {
-        Dtype* patch_data = new Dtype[kernel_size * kernel_size * bottomchannels];
-
-        for (int y = 0; y < topheight; ++y)
-            for (int x = 0; x < topwidth; ++x)
-            {
-                int x1 = x * stride1 + max_displacement;
-                int y1 = y * stride1 + max_displacement;
-
-                // Load 3D patch into shared shared memory
-                for (int j = 0; j < kernel_size; j++) // HEIGHT
-                    for (int i = 0; i < kernel_size; i++) // WIDTH
-                    {
-                        int ji_off = ((j * kernel_size) + i) * bottomchannels;
-                        for (int ch = 0; ch < bottomchannels; ch++) // CHANNELS
-                        {
-                            int idx1 = ((n * bottomheight + y1 + j) * bottomwidth + x1 + i) * bottomchannels + ch;
-                            int idxPatchData = ji_off + ch;
-                            patch_data[idxPatchData] = bottom0[idx1];
-                        }
-                    }
-
-                // Compute correlation
-                for (int top_channel = 0; top_channel < topchannels; top_channel++)
-                {
-                    Dtype sum = 0;
-
-                    int s2o = (top_channel % neighborhood_grid_width - neighborhood_grid_radius) * stride2;
-                    int s2p = (top_channel / neighborhood_grid_width - neighborhood_grid_radius) * stride2;
-
-                    for (int j = 0; j < kernel_size; j++) // HEIGHT
-                        for (int i = 0; i < kernel_size; i++) // WIDTH
-                        {
-                            int ji_off = ((j * kernel_size) + i) * bottomchannels;
-                            for (int ch = 0; ch < bottomchannels; ch++) // CHANNELS
-                            {
-                                int x2 = x1 + s2o;
-                                int y2 = y1 + s2p;
-
-                                int idxPatchData = ji_off + ch;
-                                int idx2 = ((n * bottomheight + y2 + j) * bottomwidth + x2 + i) * bottomchannels + ch;
-
-                                sum += patch_data[idxPatchData] * bottom1[idx2];
-                            }
-                        }
-
-
-
-
-                    const int sumelems = kernel_size * kernel_size * bottomchannels;
-                    const int index = ((top_channel * topheight + y) * topwidth) + x;
-
-                    //                    printf("%f\n", sum / (float) sumelems);
-
-                    top[index + n * topcount] = sum / (float) sumelems;
-                }
-            }
-            delete [] patch_data;
-    }
-    // Aggregate  
-}
-
-template <typename Dtype>
-void CorrelateDataSubtract(const int nthreads, int num, int item, int topwidth, int topheight, int topchannels, int topcount,
-                           int max_displacement, int neighborhood_grid_radius, int neighborhood_grid_width, int kernel_radius, int stride1, int stride2,
-                           int bottomwidth, int bottomheight, int bottomchannels,
-                           const Dtype *bottom0, const Dtype *bottom1, Dtype *top)
-{
-    for (int index = 0; index < nthreads; index++)
-    {
-        int x = index % topwidth; //w-pos
-        int y = (index / topwidth) % topheight; //h-pos
-        int c = (index / topwidth / topheight) % topchannels; //channels
-
-        // Offset of patch in image 2
-        int s2o = (c % neighborhood_grid_width - neighborhood_grid_radius) * stride2;
-        int s2p = (c / neighborhood_grid_width - neighborhood_grid_radius) * stride2;
-
-        // First (upper left) position of kernel center in current neighborhood in image 1
-        int x1 = x * stride1 + kernel_radius + max_displacement;
-        int y1 = y * stride1 + kernel_radius + max_displacement;
-
-        // Iterate through 3D patch
-        Dtype sum = 0;
-        for (int j = -kernel_radius; j <= kernel_radius; j++)
-        { // HEIGHT
-            for (int i = -kernel_radius; i <= kernel_radius; i++)
-            { // WIDTH
-                for (int l = 0; l < bottomchannels; l++)
-                { // CHANNELS
-                    // Calculate position in image 2
-                    int x2 = x1 + s2o;
-                    int y2 = y1 + s2p;
-
-                    // Indices in bottom data: (CH=l,W=x2,H=y2,N)
-                    int idx1 = ((item * bottomheight + y1 + j) * bottomwidth + x1 + i) * bottomchannels + l;
-                    int idx2 = ((item * bottomheight + y2 + j) * bottomwidth + x2 + i) * bottomchannels + l;
-
-                    // Do the correlation:
-                    sum += fabs(bottom0[idx1] - bottom1[idx2]);
-                }
-            }
-        }
-        const int sumelems = (kernel_radius * 2 + 1)*(kernel_radius * 2 + 1) * bottomchannels;
-        top[index + item * topcount] = sum / (float) sumelems;
-    }
-}
-
 template <typename Dtype>
 void CorrelationLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -168,6 +38,9 @@ void CorrelationLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   LOG(INFO) << "Stride 2: " << stride2_;
   LOG(INFO) << "Max Displacement: " << max_displacement_;
   
+  rbot1_.reset(new Blob<Dtype>());
+  rbot2_.reset(new Blob<Dtype>());
+  rtopdiff_.reset(new Blob<Dtype>());
 }
 
 template <typename Dtype>
@@ -206,12 +79,9 @@ void CorrelationLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top[0]->Reshape(num_, top_channels_, top_height_, top_width_);
 
   // rbots (These are the blobs that store the padded and dimension rearranged data
-  rbot1_.reset(new Blob<Dtype>());
-  rbot2_.reset(new Blob<Dtype>());
   rbot1_->Reshape(num_, paddedbottomheight, paddedbottomwidth, bottomchannels);
   rbot2_->Reshape(num_, paddedbottomheight, paddedbottomwidth, bottomchannels);
   
-  rtopdiff_.reset(new Blob<Dtype>());
   rtopdiff_->Reshape(num_, top_height_, top_width_, top_channels_);
 
 }
@@ -227,47 +97,31 @@ void CorrelationLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const int bchannels = bottom[0]->channels();
     const int bheight = bottom[0]->height();
     const int bwidth = bottom[0]->width();
-    
-    const int topcount = top_width_ * top_height_ * top_channels_;
-    const int pheight = bheight + 2 * pad_size_;
-    const int pwidth = bwidth + 2 * pad_size_;
-    
-    memset(rbot1_->mutable_cpu_data(), 0, sizeof(Dtype) * rbot1_->count());
-    memset(rbot2_->mutable_cpu_data(), 0, sizeof(Dtype) * rbot2_->count());
-
-    blob_rearrange_kernel2<Dtype>(rbot1_->mutable_cpu_data(), bottom[0]->cpu_data(), bnum, bchannels, bheight, bwidth, pheight, pwidth, pad_size_);
-    blob_rearrange_kernel2<Dtype>(rbot2_->mutable_cpu_data(), bottom[1]->cpu_data(), bnum, bchannels, bheight, bwidth, pheight, pwidth, pad_size_);
 
-    const int num = bnum;
-    const int channels = bchannels;
-    const int height = bheight + 2 * pad_size_;
-    const int width = bwidth + 2 * pad_size_;
-    
-    if(corr_type_ == CorrelationParameter_CorrelationType_MULTIPLY) {
-        // CorrelationLayer      
-        
-        CorrelateData<Dtype>(
-            num, top_width_, top_height_, top_channels_, topcount,
-            max_displacement_, neighborhood_grid_radius_, neighborhood_grid_width_, kernel_radius_, kernel_size_,
-            stride1_, stride2_,
-            width, height, channels,
-            rbot1_->cpu_data(), rbot2_->cpu_data(), top[0]->mutable_cpu_data()
-            );
-        
-    } else if(corr_type_ == CorrelationParameter_CorrelationType_SUBTRACT) {
-        // CorrelationLayer
-        for(int n = 0; n < num; n++) {
-            
-            int topThreadCount = topcount;
-            CorrelateDataSubtract<Dtype>(
-                topThreadCount, num, n, top_width_, top_height_, top_channels_, topcount,
-                max_displacement_, neighborhood_grid_radius_, neighborhood_grid_width_, kernel_radius_,
-                stride1_, stride2_,
-                width, height, channels,
-                rbot1_->cpu_data(), rbot2_->cpu_data(), top[0]->mutable_cpu_data()
-                );
-        }
-    }
+    caffe_cpu_pad_nhwc(bnum, bchannels, bheight, bwidth, pad_size_, pad_size_,
+        bottom[0]->cpu_data(), rbot1_->mutable_cpu_data());
+    caffe_cpu_pad_nhwc(bnum, bchannels, bheight, bwidth, pad_size_, pad_size_,
+        bottom[1]->cpu_data(), rbot2_->mutable_cpu_data());
+
+    CorrelationGeometry geometry;
+    geometry.num = bnum;
+    geometry.channels = bchannels;
+    geometry.height = bheight + 2 * pad_size_;
+    geometry.width = bwidth + 2 * pad_size_;
+    geometry.top_height = top_height_;
+    geometry.top_width = top_width_;
+    geometry.kernel_size = kernel_size_;
+    geometry.stride1 = stride1_;
+    geometry.stride2 = stride2_;
+    geometry.y_offset = max_displacement_;
+    geometry.x_offset = max_displacement_;
+    geometry.grid_y_begin = -neighborhood_grid_radius_;
+    geometry.grid_height = neighborhood_grid_width_;
+    geometry.grid_x_begin = -neighborhood_grid_radius_;
+    geometry.grid_width = neighborhood_grid_width_;
+    caffe_cpu_correlate(geometry,
+        corr_type_ == CorrelationParameter_CorrelationType_SUBTRACT,
+        rbot1_->cpu_data(), rbot2_->cpu_data(), top[0]->mutable_cpu_data());
 }
 
 template <typename Dtype>
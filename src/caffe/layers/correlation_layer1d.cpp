@@ -2,6 +2,7 @@
 
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/util/correlation.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
 
@@ -37,6 +38,9 @@ void Correlation1DLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   LOG(INFO) << "Stride 2: " << stride2_;
   LOG(INFO) << "Max Displacement: " << max_displacement_;
   
+  rbot1_.reset(new Blob<Dtype>());
+  rbot2_.reset(new Blob<Dtype>());
+  rtopdiff_.reset(new Blob<Dtype>());
 }
 
 template <typename Dtype>
@@ -81,12 +85,9 @@ void Correlation1DLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top[0]->Reshape(num_, top_channels_, top_height_, top_width_);
 
   // rbots (These are the blobs that store the padded and dimension rearranged data
-  rbot1_.reset(new Blob<Dtype>());
-  rbot2_.reset(new Blob<Dtype>());
   rbot1_->Reshape(num_, paddedbottomheight, paddedbottomwidth, bottomchannels);
   rbot2_->Reshape(num_, paddedbottomheight, paddedbottomwidth, bottomchannels);
   
-  rtopdiff_.reset(new Blob<Dtype>());
   rtopdiff_->Reshape(num_, top_height_, top_width_, top_channels_);
 
 }
@@ -94,7 +95,48 @@ void Correlation1DLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void Correlation1DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  NOT_IMPLEMENTED;
+  CHECK_EQ(bottom.size(), 2);
+  CHECK_EQ(top.size(), 1);
+
+  const int bnum = bottom[0]->num();
+  const int bchannels = bottom[0]->channels();
+  const int bheight = bottom[0]->height();
+  const int bwidth = bottom[0]->width();
+
+  // Only the width is padded.
+  caffe_cpu_pad_nhwc(bnum, bchannels, bheight, bwidth, 0, pad_size_,
+      bottom[0]->cpu_data(), rbot1_->mutable_cpu_data());
+  caffe_cpu_pad_nhwc(bnum, bchannels, bheight, bwidth, 0, pad_size_,
+      bottom[1]->cpu_data(), rbot2_->mutable_cpu_data());
+
+  // The same displacements as Forward_gpu. Those to the left of the padded
+  // row, which single_direction -1 can reach, count as zeros.
+  int x_shift = - neighborhood_grid_radius_;
+  if(single_direction_ == -1) { // to the left
+    x_shift = -neighborhood_grid_width_;
+  } else if(single_direction_ == 1) { // to the right
+    x_shift = 0;
+  }
+
+  CorrelationGeometry geometry;
+  geometry.num = bnum;
+  geometry.channels = bchannels;
+  geometry.height = bheight;
+  geometry.width = bwidth + 2 * pad_size_;
+  geometry.top_height = top_height_;
+  geometry.top_width = top_width_;
+  geometry.kernel_size = kernel_size_;
+  geometry.stride1 = stride1_;
+  geometry.stride2 = stride2_;
+  geometry.y_offset = 0;
+  geometry.x_offset = max_displacement_;
+  geometry.grid_y_begin = 0;
+  geometry.grid_height = 1;
+  geometry.grid_x_begin = x_shift;
+  geometry.grid_width = neighborhood_grid_width_;
+  caffe_cpu_correlate(geometry,
+      corr_type_ == CorrelationParameter_CorrelationType_SUBTRACT,
+      rbot1_->cpu_data(), rbot2_->cpu_data(), top[0]->mutable_cpu_data());
 }
 
 template <typename Dtype>
@@ -10,6 +10,9 @@ __global__ void sync_deconv_groups() {}
 template <typename Dtype>
 void CuDNNDeconvolutionLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(this->layer_param_.fused_activation_param().type(),
+      FusedActivationParameter_Type_NONE)
+      << "Fused activations only run on the CPU."; //CUSTOMIZATION
   const Dtype* weight = this->blobs_[0]->gpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->gpu_data();
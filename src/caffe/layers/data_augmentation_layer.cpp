@@ -132,6 +132,10 @@ void DataAugmentationLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         LOG(INFO) << "Emitting " << num_params_ << " augmentation params";
     }
 
+    // Share as in Forward already, so Net::PlanBlobMemory sees the aliases
+    if (input_params_)   all_coeffs_.ShareData(*bottom[1]);
+    if (output_params_)  top[1]->ShareData(all_coeffs_);
+
     // Coeff transformation matrix cache for one batch
     coeff_matrices_.reset(new SyncedMemory(num * sizeof(typename AugmentationLayerBase<Dtype>::tTransMat)));
     
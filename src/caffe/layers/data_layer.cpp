@@ -14,10 +14,21 @@ namespace caffe {
 template <typename Dtype>
 DataLayer<Dtype>::DataLayer(const LayerParameter& param)
   : BasePrefetchingDataLayer<Dtype>(param),
-    offset_() {
+    offset_(), sharded_(false) {
   db_.reset(db::GetDB(param.data_param().backend()));
   db_->Open(param.data_param().source(), db::READ);
-  cursor_.reset(db_->NewCursor());
+  //<--CUSTOMIZATION
+  // In test mode only rank 0 runs, and reads all the records.
+  const int shards_per_solver = param.data_param().shards_per_solver();
+  sharded_ = shards_per_solver > 0 && Caffe::solver_count() > 1 &&
+      param.phase() == TRAIN;
+  if (sharded_) {
+    cursor_.reset(new db::ShardedCursor(db_->NewCursor(),
+        Caffe::solver_count(), Caffe::solver_rank(), shards_per_solver));
+  } else {
+    cursor_.reset(db_->NewCursor());
+  }
+  //CUSTOMIZATION-->
 }
 
 template <typename Dtype>
@@ -62,7 +73,8 @@ bool DataLayer<Dtype>::Skip() {
   int rank = Caffe::solver_rank();
   bool keep = (offset_ % size) == rank ||
               // In test mode, only rank 0 runs, so avoid skipping
-              this->layer_param_.phase() == TEST;
+              this->layer_param_.phase() == TEST ||
+              sharded_;  //CUSTOMIZATION
   return !keep;
 }
 
@@ -89,40 +101,47 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CHECK(this->transformed_data_.count());
   const int batch_size = this->layer_param_.data_param().batch_size();
 
-  Datum datum;
+  // The cursor is read in order here; parsing and transforming the datums,
+  // which decodes encoded images, is left to the transform workers.
+  timer.Start();
+  vector<string> values(batch_size);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
     while (Skip()) {
       Next();
     }
-    datum.ParseFromString(cursor_->value());
-    read_time += timer.MicroSeconds();
+    values[item_id] = cursor_->value();
+    Next();
+  }
+  read_time += timer.MicroSeconds();
 
-    if (item_id == 0) {
-      // Reshape according to the first datum of each batch
-      // on single input batches allows for inputs of varying dimension.
-      // Use data_transformer to infer the expected blob shape from datum.
-      vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
-      this->transformed_data_.Reshape(top_shape);
-      // Reshape batch according to the batch_size.
-      top_shape[0] = batch_size;
-      batch->data_.Reshape(top_shape);
-    }
+  // Reshape according to the first datum of each batch
+  // on single input batches allows for inputs of varying dimension.
+  // Use data_transformer to infer the expected blob shape from datum.
+  Datum datum;
+  datum.ParseFromString(values[0]);
+  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  this->transformed_data_.Reshape(top_shape);
+  // Reshape batch according to the batch_size.
+  top_shape[0] = batch_size;
+  batch->data_.Reshape(top_shape);
 
-    // Apply data transformations (mirror, scale, crop...)
-    timer.Start();
-    int offset = batch->data_.offset(item_id);
-    Dtype* top_data = batch->data_.mutable_cpu_data();
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
+  // Apply data transformations (mirror, scale, crop...)
+  timer.Start();
+  Dtype* top_data = batch->data_.mutable_cpu_data();
+  Dtype* top_label = this->output_labels_ ?
+      batch->label_.mutable_cpu_data() : NULL;
+  this->TransformBatch(batch_size, [&](const int item_id,
+      DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data) {
+    Datum datum;
+    datum.ParseFromString(values[item_id]);
+    transformed_data->set_cpu_data(top_data + batch->data_.offset(item_id));
+    transformer->Transform(datum, transformed_data);
     // Copy label.
-    if (this->output_labels_) {
-      Dtype* top_label = batch->label_.mutable_cpu_data();
+    if (top_label) {
       top_label[item_id] = datum.label();
     }
-    trans_time += timer.MicroSeconds();
-    Next();
-  }
+  });
+  trans_time += timer.MicroSeconds();
   timer.Stop();
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/util/fold_layers.hpp"
 #define W this->blobs_[0]
 #define B this->blobs_[1]
 
@@ -48,37 +49,20 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const double input_scale = this->input_scale_;
   const double output_scale = this->output_scale_;
   const double weight_scale = this->weight_scale_;
-  const int input_zero_point = this->input_zero_point_;
   const int output_zero_point = this->output_zero_point_;
-  const int weight_zero_point = this->weight_zero_point_;
   const Dtype saturate = this->saturate_;
-  const bool shift_input = (input_zero_point != 0);
-  const bool shift_weight = (weight_zero_point != 0);
   const bool scale_output = (input_scale != Dtype(1.0) || weight_scale != Dtype(1.0) ||
                              output_scale != Dtype(1.0));
   const bool shift_output = (output_zero_point != 0);
-  
-  if (shift_weight) { // shift the quantized weight
-    caffe_add_scalar<Dtype>(W->count(), Dtype(-weight_zero_point), W->mutable_cpu_data());
-  }
 
+  // The zero points are folded into a bias correction; see
+  // UpdateZeroPointBias.
+  this->UpdateZeroPointBias();
   const Dtype* weight = this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
-    if (shift_input) {
-      caffe_add_scalar<Dtype>(bottom[i]->count(),
-        Dtype(-input_zero_point), bottom[i]->mutable_cpu_data());
-    }
-
-    const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->backward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
-        const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
-      }
-    }
+    this->forward_cpu_deconv_gemm_batch(bottom[i]->cpu_data(), weight,
+        this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data);
     const int count_t = top[i]->count();
     if (scale_output) {
       Dtype out_scal = double(input_scale * weight_scale) / output_scale;
@@ -95,14 +79,6 @@ void DeconvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       caffe_cpu_signed_8bit_saturate(count_t, top_data);
     if (saturate == ConvolutionParameter_SaturateMethod_Unsigned_8bit)
       caffe_cpu_unsigned_8bit_saturate(count_t, top_data);
-    if (shift_input) { // shift the quantized input blob back to correct range
-      caffe_add_scalar<Dtype>(bottom[i]->count(),
-        Dtype(input_zero_point), bottom[i]->mutable_cpu_data());
-    }
-  }
-  // shift quantized weight/bias back to correct range
-  if (shift_weight) {
-    caffe_add_scalar<Dtype>(W->count(), Dtype(weight_zero_point), W->mutable_cpu_data());
   }
 }
 
@@ -7,6 +7,9 @@ namespace caffe {
 template <typename Dtype>
 void DeconvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(this->layer_param_.fused_activation_param().type(),
+      FusedActivationParameter_Type_NONE)
+      << "Fused activations only run on the CPU."; //CUSTOMIZATION
   const Dtype* weight = this->blobs_[0]->gpu_data();
   Dtype input_scale = this->input_scale_; //CUSTOMIZATION
   Dtype output_scale = this->output_scale_; //CUSTOMIZATION
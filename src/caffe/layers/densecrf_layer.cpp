@@ -7,6 +7,7 @@
 #include "caffe/util/densecrf_util.hpp"
 #include "caffe/util/densecrf_pairwise.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 // TODO: Add SemiMetricFunction
 
@@ -55,13 +56,6 @@ void DenseCRFLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     CHECK_EQ(bottom[2]->channels(), 3)
       << "Can Only support color images for now.";
   }
-  
-  unary_element_ = 0;
-  map_element_   = 0;
-  unary_   = NULL;
-  current_ = NULL;
-  next_    = NULL;
-  tmp_     = NULL;  
 
   output_prob_ = dense_crf_param.output_probability();
 }
@@ -82,28 +76,16 @@ void DenseCRFLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 
   CHECK_EQ(bottom[0]->num(), bottom[1]->num())
     << "The DCNN output and data should have the same number.";
-  CHECK_EQ(bottom[1]->num(), bottom[2]->num())
-    << "The data and data dimension should have the same number.";
 
   if (has_image) {
+    CHECK_EQ(bottom[1]->num(), bottom[2]->num())
+      << "The data and data dimension should have the same number.";
     CHECK_EQ(bottom[0]->height(), bottom[2]->height())
       << "DCNN output after upsampling should have the same height as image.";
     CHECK_EQ(bottom[0]->width(), bottom[2]->width())
       << "DCNN output after upsampling should have the same width as image.";
   }
 
-  int num_pixel  = pad_height_ * pad_width_;
-  int cur_unary_element = num_pixel * M_;
-
-  if (unary_element_ < cur_unary_element) {
-    unary_element_ = cur_unary_element;
-    map_element_   = num_pixel;
-    
-    // allocate largest possible size for data arrays
-    DeAllocateAllData();
-    AllocateAllData();
-  }
-
   // allocate largest possible size for top
   top[0]->Reshape(num_, M_, pad_height_, pad_width_);
 
@@ -116,6 +98,23 @@ void DenseCRFLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   norm_data_.Reshape(1, M_, pad_height_, pad_width_);
 }
 
+template <typename Dtype>
+DenseCRFLayer<Dtype>::Workspace::Workspace()
+  : W(0), H(0), N(0), num_threads(1), size(0),
+    unary(NULL), current(NULL), next(NULL), tmp(NULL) {
+}
+
+template <typename Dtype>
+DenseCRFLayer<Dtype>::Workspace::~Workspace() {
+  for (size_t i = 0; i < pairwise.size(); ++i) {
+    delete pairwise[i];
+  }
+  deallocate(unary);
+  deallocate(current);
+  deallocate(next);
+  deallocate(tmp);
+}
+
 template <typename Dtype>
 void DenseCRFLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 				       const vector<Blob<Dtype>*>& top) {
@@ -127,52 +126,76 @@ void DenseCRFLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* data_dims   = bottom[1]->cpu_data();
+  const Dtype* images      = has_image ? bottom[2]->cpu_data() : NULL;
 
   Dtype* top_data = top[0]->mutable_cpu_data();
 
-  int bottom_data_offset;
-  int data_dim_offset;
-  int top_data_offset;
-
-  for (int n = 0; n < num_; ++n) {
-    bottom_data_offset  = bottom[0]->offset(n);
-    data_dim_offset     = bottom[1]->offset(n);
-    top_data_offset     = top[0]->offset(n);
-
-    // check dimension of data arrays
-    // if too small, reallocate memory
-    int real_img_height = *(data_dims + data_dim_offset);
-    int real_img_width  = *(data_dims + data_dim_offset + 1);     
-    // Get N, W, H, M
-    if (pad_height_ <= real_img_height && pad_width_ <= real_img_width) {
-      // image may be cropped
-      H_ = pad_height_;
-      W_ = pad_width_;
-    } else {
-      // image is padded with redundant values
-      H_ = real_img_height;
-      W_ = real_img_width;
-    }
-    N_ = W_ * H_;
-    
-    // check if the pre-allocated memory is not enough
-    CHECK_LE(N_, map_element_)
-      << "The pre-allocated memory is not enough!";
-
-    /*
-    if (N_ > map_element_) {
-      DeAllocateAllData();
-      map_element_   = N_;
-      unary_element_ = N_ * M_;
-      AllocateAllData();
+  // With at least as many images as threads, each worker runs whole images;
+  // otherwise the images run in turn, each step split over all the threads.
+  const int num_threads = Caffe::num_threads();
+  const bool per_image = num_threads > 1 && num_ >= num_threads;
+  ThreadPool* pool = per_image ? &Caffe::thread_pool(num_threads) : NULL;
+  const int num_workspaces = per_image ? pool->num_threads() : 1;
+  while (workspaces_.size() < num_workspaces) {
+    workspaces_.push_back(shared_ptr<Workspace>(new Workspace()));
+  }
+  auto infer = [&](int n, int worker) {
+    Workspace* ws = workspaces_[worker].get();
+    ws->num_threads = per_image ? 1 : num_threads;
+    InferImage(bottom_data + bottom[0]->offset(n),
+        data_dims + bottom[1]->offset(n),
+        has_image ? images + bottom[2]->offset(n) : NULL,
+        top_data + top[0]->offset(n), ws);
+  };
+  if (per_image) {
+    pool->Run(num_, infer);
+  } else {
+    for (int n = 0; n < num_; ++n) {
+      infer(n, 0);
     }
-    */
+  }
+}
 
-    SetupUnaryEnergy(bottom_data + bottom_data_offset);
-    SetupPairwiseFunctions(bottom);
-    ComputeMap(top_data + top_data_offset);
-    ClearPairwiseFunctions();
+template <typename Dtype>
+void DenseCRFLayer<Dtype>::InferImage(const Dtype* bottom_data,
+    const Dtype* data_dim, const Dtype* image, Dtype* top_data,
+    Workspace* ws) {
+  // check dimension of data arrays
+  int real_img_height = data_dim[0];
+  int real_img_width  = data_dim[1];
+  // Get N, W, H
+  if (pad_height_ <= real_img_height && pad_width_ <= real_img_width) {
+    // image may be cropped
+    ws->H = pad_height_;
+    ws->W = pad_width_;
+  } else {
+    // image is padded with redundant values
+    ws->H = real_img_height;
+    ws->W = real_img_width;
   }
+  ws->N = ws->W * ws->H;
+
+  // check if the pre-allocated memory is not enough
+  CHECK_LE(ws->N, pad_height_ * pad_width_)
+    << "The pre-allocated memory is not enough!";
+
+  // allocate largest possible size for data arrays
+  const int size = pad_height_ * pad_width_ * M_;
+  if (ws->size < size) {
+    deallocate(ws->unary);
+    deallocate(ws->current);
+    deallocate(ws->next);
+    deallocate(ws->tmp);
+    ws->unary   = allocate(size);
+    ws->current = allocate(size);
+    ws->next    = allocate(size);
+    ws->tmp     = allocate(size);
+    ws->size = size;
+  }
+
+  SetupUnaryEnergy(bottom_data, ws);
+  SetupPairwiseFunctions(image, ws);
+  ComputeMap(top_data, ws);
 }
 
 template <typename Dtype>
@@ -183,130 +206,97 @@ void DenseCRFLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
 }
 
 template <typename Dtype>
-DenseCRFLayer<Dtype>::~DenseCRFLayer() {
-  ClearPairwiseFunctions();
-  //DeAllocateAllData(); //CUSTOMIZATION
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::DeAllocateAllData() {
-  deallocate(unary_);
-  deallocate(current_);
-  deallocate(next_);
-  deallocate(tmp_);
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::AllocateAllData() {
-  unary_   = allocate(unary_element_);
-  current_ = allocate(unary_element_);
-  next_    = allocate(unary_element_);
-  tmp_     = allocate(unary_element_);  
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::ExpAndNormalize(float* out, const float* in, float scale) {
-  float* V = new float[M_];
-
-  for (int i = 0; i < N_; ++i) {
-    const float* b = in + i*M_;
-    // Find the max and subtract it so that the exp doesn't explode
-    float mx = scale*b[0];
-    for (int j = 1; j < M_; ++j)
-      if( mx < scale*b[j] )
-	mx = scale*b[j];
-    float tt = 0;
-    for (int j = 0; j < M_; ++j) {
-      V[j] = fast_exp(scale*b[j]-mx);
-      tt += V[j];
+void DenseCRFLayer<Dtype>::ExpAndNormalize(float* out, const float* in,
+    float scale, Workspace* ws) {
+  parallel_for(ws->N, ws->num_threads, 256, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      const float* b = in + i*M_;
+      // Find the max and subtract it so that the exp doesn't explode
+      float mx = scale*b[0];
+      for (int j = 1; j < M_; ++j)
+	if( mx < scale*b[j] )
+	  mx = scale*b[j];
+      // Make it a probability, in out directly as in may be out
+      float* a = out + i*M_;
+      float tt = 0;
+      for (int j = 0; j < M_; ++j) {
+	a[j] = fast_exp(scale*b[j]-mx);
+	tt += a[j];
+      }
+      for (int j = 0; j < M_; ++j)
+	a[j] /= tt;
     }
-    // Make it a probability
-    for (int j=0; j < M_; ++j)
-      V[j] /= tt;
-    
-    float* a = out + i*M_;
-    for (int j = 0; j < M_; ++j)
-      a[j] = V[j];
-  }
-  delete[] V;
+  });
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::StartInference() {
-  ExpAndNormalize(current_, unary_, -1.0);
+void DenseCRFLayer<Dtype>::StartInference(Workspace* ws) {
+  ExpAndNormalize(ws->current, ws->unary, -1.0, ws);
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::StepInference() {
+void DenseCRFLayer<Dtype>::StepInference(Workspace* ws) {
 #ifdef SSE_DENSE_CRF
-  __m128 * sse_next_ = (__m128*)next_;
-  __m128 * sse_unary_ = (__m128*)unary_;
+  __m128 * sse_next_ = (__m128*)ws->next;
+  __m128 * sse_unary_ = (__m128*)ws->unary;
 #endif
   // Set the unary potential
 #ifdef SSE_DENSE_CRF
-  for (int i = 0; i < (N_*M_-1)/4+1; ++i)
+  for (int i = 0; i < (ws->N*M_-1)/4+1; ++i)
     sse_next_[i] = - sse_unary_[i];
 #else
-  for (int i = 0; i < N_*M_; ++i)
-    next_[i] = -unary_[i];
+  for (int i = 0; i < ws->N*M_; ++i)
+    ws->next[i] = -ws->unary[i];
 #endif
     
   // Add up all pairwise potentials
-  for (size_t i=0; i < pairwise_.size(); ++i)
-    pairwise_[i]->apply(next_, current_, tmp_, M_);
+  for (size_t i=0; i < ws->pairwise.size(); ++i)
+    ws->pairwise[i]->apply(ws->next, ws->current, ws->tmp, M_);
     
   // Exponentiate and normalize
-  ExpAndNormalize(current_, next_, 1.0);
-}
-
-template <typename Dtype>
-void DenseCRFLayer<Dtype>::ClearPairwiseFunctions() {
-  for (size_t i = 0; i < pairwise_.size(); ++i) {
-    delete pairwise_[i];
-  }
-  pairwise_.clear();
+  ExpAndNormalize(ws->current, ws->next, 1.0, ws);
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::RunInference() {
-  StartInference();
+void DenseCRFLayer<Dtype>::RunInference(Workspace* ws) {
+  StartInference(ws);
   for (int i = 0; i < max_iter_; ++i) {
-    StepInference();
+    StepInference(ws);
   }
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf) {
+void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf, Workspace* ws) {
   // compute map 
   //
 
   memset(top_inf, 0, sizeof(Dtype)*M_*pad_height_*pad_width_);
 
-  // results are saved to current_ after call RunInference()
-  RunInference();
+  // results are saved to ws->current after call RunInference()
+  RunInference(ws);
 
   int in_index;
   int out_index;
 
-  // copy current_ to top
+  // copy ws->current to top
   if (output_prob_) {
-    for (int h = 0; h < H_; ++h) {
-      for (int w = 0; w < W_; ++w) {      
+    for (int h = 0; h < ws->H; ++h) {
+      for (int w = 0; w < ws->W; ++w) {      
 	for (int c = 0; c < M_; ++c) {
-	  in_index  = (h * W_ + w) * M_ + c;
+	  in_index  = (h * ws->W + w) * M_ + c;
 	  out_index = (c * pad_height_ + h) * pad_width_ + w;
-	  top_inf[out_index] = static_cast<Dtype>(current_[in_index]);
+	  top_inf[out_index] = static_cast<Dtype>(ws->current[in_index]);
 	}
       } 
     }
   } else {
-    for (int h = 0; h < H_; ++h) {
-      for (int w = 0; w < W_; ++w) {      
+    for (int h = 0; h < ws->H; ++h) {
+      for (int w = 0; w < ws->W; ++w) {      
 	for (int c = 0; c < M_; ++c) {
-	  in_index  = (h * W_ + w) * M_ + c;
+	  in_index  = (h * ws->W + w) * M_ + c;
 	  out_index = (c * pad_height_ + h) * pad_width_ + w;
 	  top_inf[out_index] = log(
-  	     std::max(static_cast<Dtype>(current_[in_index]), Dtype(FLT_MIN)));
+  	     std::max(static_cast<Dtype>(ws->current[in_index]), Dtype(FLT_MIN)));
 	}
       } 
     }
@@ -314,60 +304,77 @@ void DenseCRFLayer<Dtype>::ComputeMap(Dtype* top_inf) {
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::SetupPairwiseFunctions(const vector<Blob<Dtype>*>& bottom) {
-  ClearPairwiseFunctions();
+void DenseCRFLayer<Dtype>::SetupPairwiseFunctions(const Dtype* im,
+    Workspace* ws) {
+  const int N = ws->N;
+  const int H = ws->H;
+  const int W = ws->W;
+  // The potentials of the previous image are rebuilt in place, on the
+  // threads of this image: those of the previous one may have been split
+  // over the pool this image now runs on a worker of.
+  size_t num_pairwise = 0;
+  auto add_potential = [&](const float* features, int D, float w) {
+    if (num_pairwise < ws->pairwise.size()) {
+      ws->pairwise[num_pairwise]->set_num_threads(ws->num_threads);
+      ws->pairwise[num_pairwise]->init(features, D, N);
+    } else {
+      ws->pairwise.push_back(new PottsPotential(features, D, N, w));
+      ws->pairwise[num_pairwise]->set_num_threads(ws->num_threads);
+    }
+    ++num_pairwise;
+  };
 
   // add pairwise Gaussian
   for (size_t k = 0; k < pos_w_.size(); ++k) {
-    float* features = new float[N_*2];
-    for (int j = 0; j < H_; ++j) {
-      for (int i = 0; i < W_; ++i) {
-	features[(j*W_+i)*2+0] = i / pos_xy_std_[k];
-	features[(j*W_+i)*2+1] = j / pos_xy_std_[k];
+    ws->features.resize(N*2);
+    float* features = &ws->features[0];
+    for (int j = 0; j < H; ++j) {
+      for (int i = 0; i < W; ++i) {
+	features[(j*W+i)*2+0] = i / pos_xy_std_[k];
+	features[(j*W+i)*2+1] = j / pos_xy_std_[k];
       }
     }
-    pairwise_.push_back(new PottsPotential(features, 2, N_, pos_w_[k]));
-    delete[] features;
+    add_potential(features, 2, pos_w_[k]);
   }
 
-  if (has_image) {
-    const Dtype* im = bottom[2]->cpu_data();
+  if (im) {
     int channel_offset = pad_height_ * pad_width_;
 
     // add pairwise Bilateral
     for (size_t k = 0; k < bi_w_.size(); ++k) {
-      float* features = new float[N_*5];
+      ws->features.resize(N*5);
+      float* features = &ws->features[0];
       
-      // Note H_ and W_ are the effective dimension of image (not padded dimensions)
-      for (int j = 0; j < H_; j++) {
-	for (int i = 0; i < W_; i++){
-	  features[(j*W_+i)*5+0] = i / bi_xy_std_[k];
-	  features[(j*W_+i)*5+1] = j / bi_xy_std_[k];
+      // Note H and W are the effective dimension of image (not padded dimensions)
+      for (int j = 0; j < H; j++) {
+	for (int i = 0; i < W; i++){
+	  features[(j*W+i)*5+0] = i / bi_xy_std_[k];
+	  features[(j*W+i)*5+1] = j / bi_xy_std_[k];
 
 	  int img_index = j * pad_width_ + i;
 
 	  // im is BGR
 	  // Assume im is mean-centered (not affect gaussian blur)
 	  // and assume im is proprocessing by scale = 1 (may cause problem if not 1)
-	  features[(j*W_+i)*5+2] = im[img_index] / bi_rgb_std_[k];
-	  features[(j*W_+i)*5+3] = im[img_index + channel_offset] / bi_rgb_std_[k];
-	  features[(j*W_+i)*5+4] = im[img_index + 2*channel_offset] / bi_rgb_std_[k];
+	  features[(j*W+i)*5+2] = im[img_index] / bi_rgb_std_[k];
+	  features[(j*W+i)*5+3] = im[img_index + channel_offset] / bi_rgb_std_[k];
+	  features[(j*W+i)*5+4] = im[img_index + 2*channel_offset] / bi_rgb_std_[k];
 	}
       }
-      pairwise_.push_back(new PottsPotential(features, 5, N_, bi_w_[k]));
-      delete[] features;
+      add_potential(features, 5, bi_w_[k]);
     }
   }
 }
 
 template <typename Dtype>
-void DenseCRFLayer<Dtype>::SetupUnaryEnergy(const Dtype* bottom_data) {
+void DenseCRFLayer<Dtype>::SetupUnaryEnergy(const Dtype* bottom_data,
+    Workspace* ws) {
   for (int c = 0; c < M_; ++c) {
-    for (int h = 0; h < H_; ++h) {
-      for (int w = 0; w < W_; ++w) {
+    for (int h = 0; h < ws->H; ++h) {
+      for (int w = 0; w < ws->W; ++w) {
 	int in_index  = (c * pad_height_ + h) * pad_width_ + w;
-	int out_index = (h * W_ + w) * M_ + c;
-	unary_[out_index] = -bottom_data[in_index];
+	int out_index = (h * ws->W + w) * M_ + c;
+	ws->unary[out_index] = -bottom_data[in_index];
       }
     }
   }
@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/depth_to_space_layer.hpp"
+#include "caffe/util/permute.hpp"
 
 namespace caffe {
 
@@ -38,111 +39,37 @@ void DepthToSpaceLayer<Dtype>::Reshape(const vector<Blob<Dtype> *> &bottom,
 template <typename Dtype>
 void DepthToSpaceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype> *> &bottom,
                                            const vector<Blob<Dtype> *> &top) {
+  // The depth of bottom is split into (block row, block column, depth) or,
+  // for CRD, (depth, block row, block column), and the block axes are moved
+  // next to the height and width axes they expand.
+  const int batch_size = this->output_top_shape[0];
+  const int bs = this->block_size;
+  vector<int> bottom_shape = bottom[0]->shape();
+  vector<int> shape(6);
+  vector<int> order(6);
   if (this->data_format == "NHWC") {
-    const int batch_size = this->output_top_shape[0];
-    const int output_height = this->output_top_shape[1];
-    const int output_width = this->output_top_shape[2];
-    const int output_depth = this->output_top_shape[3];
-
-    vector<int> bottom_shape = bottom[0]->shape();
-    const int input_height = bottom_shape[1];
-    const int input_width = bottom_shape[2];
-    const int input_depth = bottom_shape[3];
-
-    const Dtype *bottom_data = bottom[0]->cpu_data();
-    Dtype *top_data = top[0]->mutable_cpu_data();
-
-    for (int b = 0; b < batch_size; ++b) {
-      for (int h = 0; h < output_height; ++h) {
-        const int in_h = h / this->block_size;
-        const int offset_h = (h % this->block_size);
-        for (int w = 0; w < output_width; ++w) {
-          const int in_w = w / this->block_size;
-          const int offset_w = (w % this->block_size);
-          const int offset_d =
-              (offset_h * this->block_size + offset_w) * output_depth;
-          for (int d = 0; d < output_depth; ++d) {
-            const int in_d = d + offset_d;
-            const int out_index =
-                ((b * output_height + h) * output_width + w) * output_depth + d;
-            const int in_index =
-                ((b * input_height + in_h) * input_width + in_w) * input_depth +
-                in_d;
-            top_data[out_index] = bottom_data[in_index];
-          }
-        }
-      }
-    }
+    const int shape_nhwc[] = {batch_size, bottom_shape[1], bottom_shape[2],
+                              bs, bs, this->output_top_shape[3]};
+    const int order_nhwc[] = {0, 1, 3, 2, 4, 5};
+    shape.assign(shape_nhwc, shape_nhwc + 6);
+    order.assign(order_nhwc, order_nhwc + 6);
   } else if (this->data_format == "NCHW" || this->data_format == "DCR") {
-    const int batch_size = this->output_top_shape[0];
-    const int output_depth = this->output_top_shape[1];
-    const int output_height = this->output_top_shape[2];
-    const int output_width = this->output_top_shape[3];
-
-    vector<int> bottom_shape = bottom[0]->shape();
-    const int input_depth = bottom_shape[1];
-    const int input_height = bottom_shape[2];
-    const int input_width = bottom_shape[3];
-
-    const Dtype *bottom_data = bottom[0]->cpu_data();
-    Dtype *top_data = top[0]->mutable_cpu_data();
-
-    for (int b = 0; b < batch_size; ++b) {
-      for (int h = 0; h < output_height; ++h) {
-        const int in_h = h / this->block_size;
-        const int offset_h = (h % this->block_size);
-        for (int w = 0; w < output_width; ++w) {
-          const int in_w = w / this->block_size;
-          const int offset_w = (w % this->block_size);
-          const int offset_d =
-              (offset_h * this->block_size + offset_w) * output_depth;
-          for (int d = 0; d < output_depth; ++d) {
-            const int in_d = d + offset_d;
-            const int out_index =
-                ((b * output_depth + d) * output_height + h) * output_width + w;
-            const int in_index =
-                ((b * input_depth + in_d) * input_height + in_h) * input_width +
-                in_w;
-            top_data[out_index] = bottom_data[in_index];
-          }
-        }
-      }
-    }
+    const int shape_dcr[] = {batch_size, bs, bs, this->output_top_shape[1],
+                             bottom_shape[2], bottom_shape[3]};
+    const int order_dcr[] = {0, 3, 4, 1, 5, 2};
+    shape.assign(shape_dcr, shape_dcr + 6);
+    order.assign(order_dcr, order_dcr + 6);
   } else if (this->data_format == "CRD") {
-    const int batch_size = this->output_top_shape[0];
-    const int output_depth = this->output_top_shape[1];
-    const int output_height = this->output_top_shape[2];
-    const int output_width = this->output_top_shape[3];
-
-    vector<int> bottom_shape = bottom[0]->shape();
-    const int input_depth = bottom_shape[1];
-    const int input_height = bottom_shape[2];
-    const int input_width = bottom_shape[3];
-
-    const Dtype *bottom_data = bottom[0]->cpu_data();
-    Dtype *top_data = top[0]->mutable_cpu_data();
-
-    for (int b = 0; b < batch_size; ++b) {
-      for (int h = 0; h < output_height; ++h) {
-        const int in_h = h / this->block_size;
-        const int offset_h = (h % this->block_size);
-        for (int w = 0; w < output_width; ++w) {
-          const int in_w = w / this->block_size;
-          const int offset_w = (w % this->block_size);
-          for (int d = 0; d < output_depth; ++d) {
-            const int in_d =
-                (d * this->block_size + offset_h) * this->block_size + offset_w;
-            const int out_index =
-                ((b * output_depth + d) * output_height + h) * output_width + w;
-            const int in_index =
-                ((b * input_depth + in_d) * input_height + in_h) * input_width +
-                in_w;
-            top_data[out_index] = bottom_data[in_index];
-          }
-        }
-      }
-    }
+    const int shape_crd[] = {batch_size, this->output_top_shape[1], bs, bs,
+                             bottom_shape[2], bottom_shape[3]};
+    const int order_crd[] = {0, 1, 4, 2, 5, 3};
+    shape.assign(shape_crd, shape_crd + 6);
+    order.assign(order_crd, order_crd + 6);
+  } else {
+    return;
   }
+  caffe_cpu_permute(shape, order, bottom[0]->cpu_data(),
+                    top[0]->mutable_cpu_data());
 }
 
 INSTANTIATE_CLASS(DepthToSpaceLayer);
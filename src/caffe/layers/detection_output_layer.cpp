@@ -293,8 +293,9 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
                       share_location_, &all_arm_loc_preds);
   }
 
-  // Retrieve all location predictions.
-  vector<LabelBBox> all_loc_preds;
+  // Retrieve all location predictions. The boxes of this layer are kept in
+  // BBoxArray form; only the cascade and TFLite decoders take messages.
+  vector<LabelBBoxArray> all_loc_preds;
   if (loc_concat_) {
     const Dtype *loc_data = bottom[0]->cpu_data();
     GetLocPredictions(loc_data, num, num_priors_, num_loc_classes_,
@@ -309,7 +310,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
     for (int i = 0; i < num; ++i) {
       for (int n = 0; n < nbottom_; n++) {
         const Dtype *loc_data = bottom[n + nbottom_]->cpu_data();
-        LabelBBox &label_bbox = all_loc_preds[i];
+        LabelBBoxArray &label_bbox = all_loc_preds[i];
         if (!ratio_permute_ && !no_permute_) // original caffe ssd
         {
           for (int p = 0;
@@ -321,14 +322,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
               // if (label_bbox.find(label) == label_bbox.end()) {
               //  label_bbox[label].resize(num_priors_);
               //}
-              NormalizedBBox locbox;
-              locbox.set_xmin(loc_data[start_idx + c * 4]);
-              locbox.set_ymin(loc_data[start_idx + c * 4 + 1]);
-              locbox.set_xmax(loc_data[start_idx + c * 4 + 2]);
-              locbox.set_ymax(loc_data[start_idx + c * 4 + 3]);
-              float locbox_size = BBoxSize(locbox);
-              locbox.set_size(locbox_size);
-              label_bbox[label].push_back(locbox);
+              label_bbox[label].push_back(loc_data[start_idx + c * 4],
+                  loc_data[start_idx + c * 4 + 1],
+                  loc_data[start_idx + c * 4 + 2],
+                  loc_data[start_idx + c * 4 + 3]);
               // LOG(INFO)<<"origin p="<<p<<" ,xmin="<<loc_data[start_idx + c *
               // 4]<<" ,ymin="<<loc_data[start_idx + c * 4 + 1]<<
               //    " ,xmax="<<loc_data[start_idx + c * 4 + 2]<<"
@@ -345,14 +342,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
               // if (label_bbox.find(label) == label_bbox.end()) {
               //  label_bbox[label].resize(num_priors_);
               //}
-              NormalizedBBox locbox;
-              locbox.set_xmin(loc_data[start_idx + c * count]);
-              locbox.set_ymin(loc_data[start_idx + c * count + 1 * count]);
-              locbox.set_xmax(loc_data[start_idx + c * count + 2 * count]);
-              locbox.set_ymax(loc_data[start_idx + c * count + 3 * count]);
-              float locbox_size = BBoxSize(locbox);
-              locbox.set_size(locbox_size);
-              label_bbox[label].push_back(locbox);
+              label_bbox[label].push_back(loc_data[start_idx + c * count],
+                  loc_data[start_idx + c * count + 1 * count],
+                  loc_data[start_idx + c * count + 2 * count],
+                  loc_data[start_idx + c * count + 3 * count]);
               // LOG(INFO)<<"ratio p="<<p<<" ,xmin="<<loc_data[start_idx + c *
               // count]<<" ,ymin="<<loc_data[start_idx + c * count + 1 *
               // count]<<
@@ -374,17 +367,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
                 // if (label_bbox.find(label) == label_bbox.end()) {
                 //  label_bbox[label].resize(num_priors_);
                 //}
-                NormalizedBBox locbox;
-                locbox.set_xmin(loc_data[start_idx + c * 4 * count + p]);
-                locbox.set_ymin(
-                    loc_data[start_idx + c * 4 * count + p + count]);
-                locbox.set_xmax(
-                    loc_data[start_idx + c * 4 * count + p + 2 * count]);
-                locbox.set_ymax(
+                label_bbox[label].push_back(loc_data[start_idx + c * 4 * count + p],
+                    loc_data[start_idx + c * 4 * count + p + count],
+                    loc_data[start_idx + c * 4 * count + p + 2 * count],
                     loc_data[start_idx + c * 4 * count + p + 3 * count]);
-                float locbox_size = BBoxSize(locbox);
-                locbox.set_size(locbox_size);
-                label_bbox[label].push_back(locbox);
                 // LOG(INFO)<<"p="<<p<<", r="<<r<<" ,xmin="<<loc_data[start_idx
                 // + c * 4 * count + p]<<
                 //    " ,ymin="<<loc_data[start_idx + c * 4 * count + p + 1 *
@@ -519,8 +505,8 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 
   // Retrieve all prior bboxes. It is same within a batch since we assume all
   // images in a batch are of same dimension.
-  vector<NormalizedBBox> prior_bboxes;
-  vector<vector<float>> prior_variances;
+  BBoxArray prior_bboxes;
+  vector<float> prior_variances;
   if (priorbox_concat_) {
     if (!conf_concat_ && !loc_concat_) {
       const Dtype *prior_data = bottom[2 * nbottom_]->cpu_data();
@@ -542,14 +528,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
             int permute_index =
                 (i - sum) % xy_num * ratios[n] + (i - sum) / xy_num;
             int start_idx = (permute_index + sum) * 4; // i * 4;
-            NormalizedBBox bbox;
-            bbox.set_xmin(prior_data[start_idx]);
-            bbox.set_ymin(prior_data[start_idx + 1]);
-            bbox.set_xmax(prior_data[start_idx + 2]);
-            bbox.set_ymax(prior_data[start_idx + 3]);
-            float bbox_size = BBoxSize(bbox);
-            bbox.set_size(bbox_size);
-            prior_bboxes.push_back(bbox);
+            prior_bboxes.push_back(prior_data[start_idx],
+                prior_data[start_idx + 1],
+                prior_data[start_idx + 2],
+                prior_data[start_idx + 3]);
             // LOG(INFO)<<"i="<<i<<" ,xmin="<<prior_data[start_idx]<<"
             // ,ymin="<<prior_data[start_idx + 1]<<
             //    " ,xmax="<<prior_data[start_idx + 2]<<"
@@ -558,12 +540,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 
           for (int i = sum; i < count + sum; ++i) {
             int start_idx = (num_priors_ + i) * 4;
-            vector<float> var;
             for (int j = 0; j < 4; ++j) {
-              var.push_back(prior_data[start_idx + j]);
+              prior_variances.push_back(prior_data[start_idx + j]);
               // LOG(INFO)<<prior_data[start_idx + j]<<" ";
             }
-            prior_variances.push_back(var);
           }
           sum += count;
         }
@@ -619,14 +599,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
             int permute_index =
                 (i - sum) % xy_num * collect_ratios_[n] + (i - sum) / xy_num;
             int start_idx = (permute_index + sum) * 4;
-            NormalizedBBox bbox;
-            bbox.set_xmin(prior_data[start_idx]);
-            bbox.set_ymin(prior_data[start_idx + 1]);
-            bbox.set_xmax(prior_data[start_idx + 2]);
-            bbox.set_ymax(prior_data[start_idx + 3]);
-            float bbox_size = BBoxSize(bbox);
-            bbox.set_size(bbox_size);
-            prior_bboxes.push_back(bbox);
+            prior_bboxes.push_back(prior_data[start_idx],
+                prior_data[start_idx + 1],
+                prior_data[start_idx + 2],
+                prior_data[start_idx + 3]);
             // LOG(INFO)<<"i="<<i<<" ,xmin="<<prior_data[start_idx]<<"
             // ,ymin="<<prior_data[start_idx + 1]<<
             //    " ,xmax="<<prior_data[start_idx + 2]<<"
@@ -635,12 +611,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 
           for (int i = sum; i < count + sum; ++i) {
             int start_idx = (num_priors_ + i) * 4;
-            vector<float> var;
             for (int j = 0; j < 4; ++j) {
-              var.push_back(prior_data[start_idx + j]);
+              prior_variances.push_back(prior_data[start_idx + j]);
               // LOG(INFO)<<prior_data[start_idx + j]<<" ";
             }
-            prior_variances.push_back(var);
           }
           sum += count;
         }
@@ -651,7 +625,9 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
         GetPriorBBoxes(prior_data, num_priors_, &prior_bboxes,
                        &prior_variances);
       } else {
-        GetTFLiteBBoxes(prior_data, num_priors_, &prior_bboxes);
+        vector<NormalizedBBox> tflite_prior_bboxes;
+        GetTFLiteBBoxes(prior_data, num_priors_, &tflite_prior_bboxes);
+        ToBBoxArray(tflite_prior_bboxes, &prior_bboxes);
       }
     }
   } else {
@@ -663,14 +639,10 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
       {
         for (int i = 0; i < bottom[n + 2 * nbottom_]->height() / 4; ++i) {
           int start_idx = i * 4;
-          NormalizedBBox bbox;
-          bbox.set_xmin(prior_data[start_idx]);
-          bbox.set_ymin(prior_data[start_idx + 1]);
-          bbox.set_xmax(prior_data[start_idx + 2]);
-          bbox.set_ymax(prior_data[start_idx + 3]);
-          float bbox_size = BBoxSize(bbox);
-          bbox.set_size(bbox_size);
-          prior_bboxes.push_back(bbox);
+          prior_bboxes.push_back(prior_data[start_idx],
+              prior_data[start_idx + 1],
+              prior_data[start_idx + 2],
+              prior_data[start_idx + 3]);
           // LOG(INFO)<<"origin i="<<i<<" ,xmin="<<prior_data[start_idx]<<"
           // ,ymin="<<prior_data[start_idx + 1]<<
           //    " ,xmax="<<prior_data[start_idx + 2]<<"
@@ -679,26 +651,20 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 
         for (int i = 0; i < bottom[n + 2 * nbottom_]->height() / 4; ++i) {
           int start_idx = (bottom[n + 2 * nbottom_]->height() / 4 + i) * 4;
-          vector<float> var;
           for (int j = 0; j < 4; ++j) {
-            var.push_back(prior_data[start_idx + j]);
+            prior_variances.push_back(prior_data[start_idx + j]);
             // LOG(INFO)<<prior_data[start_idx + j]<<" ";
           }
-          prior_variances.push_back(var);
         }
         // LOG(INFO)<<"prior num: "<<prior_bboxes.size()<<"\n";
       } else if (ratio_permute_) {
         int count = bottom[n + 2 * nbottom_]->height() / 4;
         for (int i = 0; i < count; ++i) {
           int start_idx = i;
-          NormalizedBBox bbox;
-          bbox.set_xmin(prior_data[start_idx]);
-          bbox.set_ymin(prior_data[start_idx + 1 * count]);
-          bbox.set_xmax(prior_data[start_idx + 2 * count]);
-          bbox.set_ymax(prior_data[start_idx + 3 * count]);
-          float bbox_size = BBoxSize(bbox);
-          bbox.set_size(bbox_size);
-          prior_bboxes.push_back(bbox);
+          prior_bboxes.push_back(prior_data[start_idx],
+              prior_data[start_idx + 1 * count],
+              prior_data[start_idx + 2 * count],
+              prior_data[start_idx + 3 * count]);
           // LOG(INFO)<<"index i="<<i<<" ,xmin="<<prior_data[start_idx]<<"
           // ,ymin="<<prior_data[start_idx + 1 * count]<<
           //    " ,xmax="<<prior_data[start_idx + 2 * count]<<"
@@ -707,43 +673,52 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
 
         for (int i = 0; i < count; ++i) {
           int start_idx = count * 4 + i;
-          vector<float> var;
           for (int j = 0; j < 4; ++j) {
-            var.push_back(prior_data[start_idx + j * count]);
+            prior_variances.push_back(prior_data[start_idx + j * count]);
             // LOG(INFO)<<prior_data[start_idx + j * count]<<" ";
           }
-          prior_variances.push_back(var);
         }
       }
     }
   }
 
   // Decode all loc predictions to bboxes.
-  vector<LabelBBox> all_decode_bboxes;
+  vector<LabelBBoxArray> all_decode_bboxes;
   const bool clip_bbox = false;
-  if ((bottom.size() >= 5 && loc_concat_) || arm_loc_no_concat_) {
-    CasRegDecodeBBoxesAll(all_loc_preds, prior_bboxes, prior_variances, num,
-                          share_location_, num_loc_classes_,
-                          background_label_id_, code_type_,
-                          variance_encoded_in_target_, clip_bbox,
-                          &all_decode_bboxes, all_arm_loc_preds);
-  } else {
+  if (((bottom.size() >= 5 && loc_concat_) || arm_loc_no_concat_) ||
+      tflite_detection_) {
+    vector<LabelBBox> loc_preds, decode_bboxes;
+    vector<NormalizedBBox> priors;
+    FromBBoxArray(all_loc_preds, &loc_preds);
+    FromBBoxArray(prior_bboxes, &priors);
     if (!tflite_detection_) {
-      DecodeBBoxesAll(all_loc_preds, prior_bboxes, prior_variances, num,
-                      share_location_, num_loc_classes_, background_label_id_,
-                      code_type_, variance_encoded_in_target_, clip_bbox,
-                      &all_decode_bboxes);
+      vector<vector<float>> variances(prior_variances.size() / 4);
+      for (int i = 0; i < variances.size(); ++i) {
+        variances[i].assign(prior_variances.begin() + i * 4,
+                            prior_variances.begin() + i * 4 + 4);
+      }
+      CasRegDecodeBBoxesAll(loc_preds, priors, variances, num,
+                            share_location_, num_loc_classes_,
+                            background_label_id_, code_type_,
+                            variance_encoded_in_target_, clip_bbox,
+                            &decode_bboxes, all_arm_loc_preds);
     } else {
-      DecodeBBoxesTFLite(all_loc_preds, prior_bboxes, num, scale_xywh_,
-                         &all_decode_bboxes);
+      DecodeBBoxesTFLite(loc_preds, priors, num, scale_xywh_,
+                         &decode_bboxes);
     }
+    ToBBoxArray(decode_bboxes, &all_decode_bboxes);
+  } else {
+    DecodeBBoxesAll(all_loc_preds, prior_bboxes, prior_variances, num,
+                    share_location_, num_loc_classes_, background_label_id_,
+                    code_type_, variance_encoded_in_target_, clip_bbox,
+                    &all_decode_bboxes);
   }
 
   int num_kept = 0;
   if (!tflite_detection_) {
     vector<map<int, vector<int>>> all_indices;
     for (int i = 0; i < num; ++i) {
-      const LabelBBox &decode_bboxes = all_decode_bboxes[i];
+      const LabelBBoxArray &decode_bboxes = all_decode_bboxes[i];
       const map<int, vector<float>> &conf_scores = all_conf_scores[i];
       map<int, vector<int>> indices;
       int num_det = 0;
@@ -766,8 +741,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
                      << label;
           continue;
         }
-        const vector<NormalizedBBox> &bboxes =
-            decode_bboxes.find(label)->second;
+        const BBoxArray &bboxes = decode_bboxes.find(label)->second;
         ApplyNMSFast(bboxes, scores, confidence_threshold_, nms_threshold_,
                      eta_, top_k_, &(indices[c]));
         num_det += indices[c].size();
@@ -834,7 +808,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
     boost::filesystem::path output_directory(output_directory_);
     for (int i = 0; i < num; ++i) {
       const map<int, vector<float>> &conf_scores = all_conf_scores[i];
-      const LabelBBox &decode_bboxes = all_decode_bboxes[i];
+      const LabelBBoxArray &decode_bboxes = all_decode_bboxes[i];
       for (map<int, vector<int>>::iterator it = all_indices[i].begin();
            it != all_indices[i].end(); ++it) {
         int label = it->first;
@@ -852,8 +826,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
           LOG(FATAL) << "Could not find location predictions for " << loc_label;
           continue;
         }
-        const vector<NormalizedBBox> &bboxes =
-            decode_bboxes.find(loc_label)->second;
+        const BBoxArray &bboxes = decode_bboxes.find(loc_label)->second;
         vector<int> &indices = it->second;
         if (need_save_) {
           CHECK(label_to_name_.find(label) != label_to_name_.end())
@@ -865,12 +838,13 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
           top_data[count * 7] = i;
           top_data[count * 7 + 1] = label;
           top_data[count * 7 + 2] = scores[idx];
-          const NormalizedBBox &bbox = bboxes[idx];
-          top_data[count * 7 + 3] = bbox.xmin();
-          top_data[count * 7 + 4] = bbox.ymin();
-          top_data[count * 7 + 5] = bbox.xmax();
-          top_data[count * 7 + 6] = bbox.ymax();
+          top_data[count * 7 + 3] = bboxes.xmin[idx];
+          top_data[count * 7 + 4] = bboxes.ymin[idx];
+          top_data[count * 7 + 5] = bboxes.xmax[idx];
+          top_data[count * 7 + 6] = bboxes.ymax[idx];
           if (need_save_) {
+            NormalizedBBox bbox;
+            bboxes.Get(idx, &bbox);
             NormalizedBBox out_bbox;
             OutputBBox(bbox, sizes_[name_count_], has_resize_, resize_param_,
                        &out_bbox);
@@ -1013,7 +987,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
     const Dtype *conf_data = bottom[1]->cpu_data();
     Dtype *top_data = top[0]->mutable_cpu_data();
     for (int i = 0; i < num; ++i) {
-      const LabelBBox &decode_bboxes = all_decode_bboxes[i];
+      const LabelBBoxArray &decode_bboxes = all_decode_bboxes[i];
       map<int, vector<int>> indices;
       // tflite process
       vector<Dtype> max_scores(num_priors_);
@@ -1061,7 +1035,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
         LOG(FATAL) << "Could not find location predictions for label " << label;
         continue;
       }
-      const vector<NormalizedBBox> &bboxes = decode_bboxes.find(label)->second;
+      const BBoxArray &bboxes = decode_bboxes.find(label)->second;
 
       // nms part: for all boxes satisfying scores > score_threshold
       vector<int> select_indices;
@@ -1085,7 +1059,7 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
         for (int n = m + 1; n < num_scores_kept; n++) {
           if (active[n] == 1) {
             int n_idx = score_index_vec[n].second;
-            float overlap = JaccardOverlap(bboxes[idx], bboxes[n_idx]);
+            float overlap = JaccardOverlap(bboxes, idx, n_idx);
             if (overlap > nms_threshold_) {
               active[n] = 0;
               num_active_candidate -= 1;
@@ -1106,11 +1080,11 @@ void DetectionOutputLayer<Dtype>::Forward_cpu(
           top_data[count * 7] = i;
           top_data[count * 7 + 1] = d_class;
           top_data[count * 7 + 2] = d_score;
-          const NormalizedBBox &bbox = bboxes[select_indices[j]];
-          top_data[count * 7 + 3] = bbox.xmin();
-          top_data[count * 7 + 4] = bbox.ymin();
-          top_data[count * 7 + 5] = bbox.xmax();
-          top_data[count * 7 + 6] = bbox.ymax();
+          const int idx = select_indices[j];
+          top_data[count * 7 + 3] = bboxes.xmin[idx];
+          top_data[count * 7 + 4] = bboxes.ymin[idx];
+          top_data[count * 7 + 5] = bboxes.xmax[idx];
+          top_data[count * 7 + 6] = bboxes.ymax[idx];
 
           ++count;
         }
@@ -11,6 +11,7 @@
 #include "caffe/layers/flow_warp_layer.hpp"
 #include "caffe/util/rng.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/sampling.hpp"
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -58,62 +59,12 @@ template <typename Dtype>
 void FlowWarpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top)
 {
-    int width = top[0]->width();
-    int height = top[0]->height();
-    int channels = top[0]->channels();
-    int num = top[0]->num();
-    const int wh_size = width * height;
-    const int whc_size = width * height * channels;
-
-    Dtype* warped_data = top[0]->mutable_cpu_data(); // dest
-    const Dtype* image_data = bottom[0]->cpu_data(); // source image
-    const Dtype* flow_data = bottom[1]->cpu_data(); // source flow
-
     Dtype fillValue = this->layer_param().flow_warp_param().fill_value() == FlowWarpParameter_FillParameter_ZERO ? 0 : NAN;
 
-    for(int n=0; n<num; n++)
-    {
-        int off = whc_size * n;
-        for(int x=0; x<width; x++)
-            for(int y=0; y<height; y++)
-            {
-                float fx = flow_data[2*wh_size*n + y*width + x];
-                float fy = flow_data[2*wh_size*n + wh_size + y*width + x];
-
-                float x2 = float(x) + fx;
-                float y2 = float(y) + fy;
-
-                if(x2>=0 && y2>=0 && x2<width && y2<height)
-                {
-                    int ix2_L = int(x2);
-                    int iy2_T = int(y2);
-                    int ix2_R = min(ix2_L+1, width-1);
-                    int iy2_B = min(iy2_T+1, height-1);
-
-                    float alpha=x2-ix2_L;
-                    float beta=y2-iy2_T;
-
-                    for(int c=0; c<channels; c++)
-                    {
-                        float TL = image_data[off + c*wh_size + iy2_T*width + ix2_L];
-                        float TR = image_data[off + c*wh_size + iy2_T*width + ix2_R];
-                        float BL = image_data[off + c*wh_size + iy2_B*width + ix2_L];
-                        float BR = image_data[off + c*wh_size + iy2_B*width + ix2_R];
-
-                        warped_data[off + c*wh_size + y*width + x] =
-                            (1-alpha)*(1-beta)*TL +
-                            alpha*(1-beta)*TR +
-                            (1-alpha)*beta*BL +
-                            alpha*beta*BR;
-                    }
-                }
-                else
-                {
-                    for(int c=0; c<channels; c++)
-                        warped_data[off + c*wh_size + y*width + x] = fillValue;
-                }
-            }
-    }
+    caffe_cpu_flow_warp(top[0]->num(), top[0]->channels(), top[0]->height(),
+                        top[0]->width(), bottom[0]->cpu_data(),
+                        bottom[1]->cpu_data(), fillValue,
+                        top[0]->mutable_cpu_data());
 }
 
 template <typename Dtype>
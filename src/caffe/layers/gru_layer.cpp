@@ -361,6 +361,123 @@ void GRULayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void GRULayer<Dtype>::FusedSetUp(const vector<Blob<Dtype>*>& bottom) {
+  const RecurrentParameter& recurrent_param =
+      this->layer_param_.recurrent_param();
+  const int num_output = recurrent_param.num_output();
+  CHECK_GT(num_output, 0) << "num_output must be positive";
+  this->AddFusedInputParams(bottom, num_output * 3);
+  // R_z, R_r, R_h and, with linear_before_reset, Rb_h.
+  vector<int> R_shape(2, num_output);
+  for (int i = 0; i < 3; ++i) {
+    this->AddFusedParam(R_shape, recurrent_param.weight_filler());
+  }
+  if (recurrent_param.linear_before_reset() != 0) {
+    this->AddFusedParam(vector<int>(1, num_output),
+        recurrent_param.bias_filler());
+  }
+}
+
+template <typename Dtype>
+void GRULayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  typedef typename RecurrentLayer<Dtype>::FusedActivation Activation;
+  const Activation F = this->GetFusedActivation(0, "Sigmoid");
+  const Activation G = this->GetFusedActivation(1, "TanH");
+  const bool linear_before_reset =
+      this->layer_param_.recurrent_param().linear_before_reset() != 0;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int x_dim = hidden_dim * 3;
+  const int num = this->N_;
+  const int param_offset = 2 + this->static_input_;
+  this->FusedInputGates(bottom, x_dim);
+
+  // Stack R_z and R_r, so that both take a single GEMM; restacked only when
+  // one of them has been written since (see data_version()).
+  vector<uint64_t> version(2);
+  version[0] = this->blobs_[param_offset]->data_version();
+  version[1] = this->blobs_[param_offset + 1]->data_version();
+  if (version != fused_weights_version_) {
+    const int R_count = hidden_dim * hidden_dim;
+    vector<int> weights_shape(2);
+    weights_shape[0] = hidden_dim * 2;
+    weights_shape[1] = hidden_dim;
+    fused_weights_.Reshape(weights_shape);
+    caffe_copy(R_count, this->blobs_[param_offset]->cpu_data(),
+        fused_weights_.mutable_cpu_data());
+    caffe_copy(R_count, this->blobs_[param_offset + 1]->cpu_data(),
+        fused_weights_.mutable_cpu_data() + R_count);
+    fused_weights_version_ = version;
+  }
+  const Dtype* R_zr = fused_weights_.cpu_data();
+  const Dtype* R_h = this->blobs_[param_offset + 2]->cpu_data();
+  const Dtype* Rb_h = linear_before_reset ?
+      this->blobs_[param_offset + 3]->cpu_data() : NULL;
+
+  // Scratch: h_conted_{t-1}, [R_z; R_r] * h_conted_{t-1}, and the input and
+  // output of the R_h product.
+  vector<int> buffer_shape(2);
+  buffer_shape[0] = num;
+  buffer_shape[1] = hidden_dim * 5;
+  this->fused_buffer_.Reshape(buffer_shape);
+  Dtype* H_conted_buffer = this->fused_buffer_.mutable_cpu_data();
+  Dtype* R_zr_h = H_conted_buffer + num * hidden_dim;
+  Dtype* R_h_in = R_zr_h + num * hidden_dim * 2;
+  Dtype* R_h_out = R_h_in + num * hidden_dim;
+
+  const Dtype* cont = this->FusedCont(bottom);
+  const Dtype* H_prev = this->recur_input_blobs_[0]->cpu_data();
+  Dtype* X = this->fused_gates_.mutable_cpu_data();
+  Dtype* H = top[0]->mutable_cpu_data();
+  for (int t = 0; t < this->T_; ++t) {
+    const Dtype* cont_t = cont ? cont + t * num : NULL;
+    const Dtype* H_conted = this->FusedContHidden(H_prev, cont_t, hidden_dim,
+        H_conted_buffer);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, hidden_dim * 2,
+        hidden_dim, Dtype(1), H_conted, R_zr, Dtype(0), R_zr_h);
+    // z_t and r_t overwrite their gate inputs.
+    for (int n = 0; n < num; ++n) {
+      Dtype* X_n = X + n * x_dim;
+      const Dtype* R_zr_h_n = R_zr_h + n * hidden_dim * 2;
+      for (int d = 0; d < hidden_dim * 2; ++d) {
+        X_n[d] = this->FusedActivate(F, X_n[d] + R_zr_h_n[d]);
+      }
+      if (!linear_before_reset) {
+        //     r_t (.) h_conted_{t-1}
+        for (int d = 0; d < hidden_dim; ++d) {
+          R_h_in[n * hidden_dim + d] =
+              X_n[hidden_dim + d] * H_conted[n * hidden_dim + d];
+        }
+      }
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, hidden_dim,
+        hidden_dim, Dtype(1), linear_before_reset ? H_conted : R_h_in, R_h,
+        Dtype(0), R_h_out);
+    for (int n = 0; n < num; ++n) {
+      const Dtype* X_n = X + n * x_dim;
+      const Dtype* R_h_out_n = R_h_out + n * hidden_dim;
+      const Dtype* H_conted_n = H_conted + n * hidden_dim;
+      Dtype* H_n = H + n * hidden_dim;
+      for (int d = 0; d < hidden_dim; ++d) {
+        const Dtype z = X_n[d];
+        const Dtype r = X_n[hidden_dim + d];
+        const Dtype R_h_term = linear_before_reset ?
+            r * (R_h_out_n[d] + Rb_h[d]) : R_h_out_n[d];
+        const Dtype h = this->FusedActivate(G,
+            X_n[2 * hidden_dim + d] + R_h_term);
+        //     H_t = h_t + z_t (.) (H_conted_{t-1} - h_t)
+        H_n[d] = h + z * (H_conted_n[d] - h);
+      }
+    }
+    H_prev = H;
+    X += num * x_dim;
+    H += num * hidden_dim;
+  }
+  caffe_copy(num * hidden_dim, H_prev,
+      this->recur_output_blobs_[0]->mutable_cpu_data());
+}
+
 INSTANTIATE_CLASS(GRULayer);
 REGISTER_LAYER_CLASS(GRU);
 
@@ -1,13 +1,7 @@
 #ifdef USE_HDF5
-/*
-TODO:
-- load file in a separate thread ("prefetch")
-- can be smarter about the memcpy call instead of doing it row-by-row
-  :: use util functions caffe_copy, and Blob->offset()
-  :: don't forget to update hdf5_daa_layer.cu accordingly
-- add ability to shuffle filenames if flag is set
-*/
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
+#include <numeric>
 #include <string>
 #include <vector>
 
@@ -17,57 +11,127 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5ChunkReader<Dtype>::HDF5ChunkReader(const vector<string>& filenames,
+    const vector<string>& datasets, const int chunk_rows, const bool shuffle)
+    : filenames_(filenames), datasets_(datasets), chunk_rows_(chunk_rows),
+      shuffle_(shuffle) {
+  for (int c = 0; c < 2; ++c) {
+    for (int i = 0; i < datasets_.size(); ++i) {
+      chunks_[c].blobs_.push_back(
+          shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+    free_.push(&chunks_[c]);
+  }
+}
 
-// Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
-  DLOG(INFO) << "Loading HDF5 file: " << filename;
-  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
-  if (file_id < 0) {
-    LOG(FATAL) << "Failed opening HDF5 file: " << filename;
-  }
+HDF5ChunkReader<Dtype>::~HDF5ChunkReader() {
+  this->StopInternalThread();
+}
 
-  int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
+template <typename Dtype>
+void HDF5ChunkReader<Dtype>::InternalThreadEntry() {
+  vector<int> file_order(filenames_.size());
+  std::iota(file_order.begin(), file_order.end(), 0);
+  try {
+    while (!must_stop()) {
+      if (shuffle_) {
+        shuffle(file_order.begin(), file_order.end());
+      }
+      for (int f = 0; f < file_order.size(); ++f) {
+        ReadFile(file_order[f]);
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
 
+// Reads the chunks of a file, each into the next free buffer.
+template <typename Dtype>
+void HDF5ChunkReader<Dtype>::ReadFile(const int file) {
+  const char* filename = filenames_[file].c_str();
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
-
-  for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    // Allow reshape here, as we are loading data not params
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get(), true);
+  hid_t file_id;
+  int num_rows;
+  {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    num_rows = hdf5_get_nd_dataset_shape(file_id, datasets_[0].c_str(),
+        MIN_DATA_DIM, MAX_DATA_DIM)[0];
+    for (int i = 1; i < datasets_.size(); ++i) {
+      CHECK_EQ(hdf5_get_nd_dataset_shape(file_id, datasets_[i].c_str(),
+          MIN_DATA_DIM, MAX_DATA_DIM)[0], num_rows);
+    }
   }
-
+  CHECK_GT(num_rows, 0) << "No rows in HDF5 file: " << filename;
+  const int chunk_rows =
+      chunk_rows_ > 0 ? std::min(chunk_rows_, num_rows) : num_rows;
+  vector<int> begins;
+  for (int begin = 0; begin < num_rows; begin += chunk_rows) {
+    begins.push_back(begin);
+  }
+  if (shuffle_) {
+    shuffle(begins.begin(), begins.end());
+  }
+  try {
+    for (int b = 0; b < begins.size(); ++b) {
+      HDF5Chunk<Dtype>* chunk = free_.pop();
+      const int rows = std::min(chunk_rows, num_rows - begins[b]);
+      if (chunk->file_ != file || chunk->begin_ != begins[b] ||
+          chunk->num_rows() != rows) {
+        DLOG(INFO) << "Loading " << rows << " rows of HDF5 file: "
+                   << filename;
+        boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+        for (int i = 0; i < datasets_.size(); ++i) {
+          hdf5_load_nd_dataset_rows(file_id, datasets_[i].c_str(),
+              MIN_DATA_DIM, MAX_DATA_DIM, begins[b], rows,
+              chunk->blobs_[i].get());
+        }
+        chunk->file_ = file;
+        chunk->begin_ = begins[b];
+      }
+      chunk->permutation_.resize(rows);
+      std::iota(chunk->permutation_.begin(), chunk->permutation_.end(), 0);
+      if (shuffle_) {
+        shuffle(chunk->permutation_.begin(), chunk->permutation_.end());
+      }
+      full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    H5Fclose(file_id);
+    throw;
+  }
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   herr_t status = H5Fclose(file_id);
   CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+}
 
-  // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
-  }
-  // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
-    data_permutation_[i] = i;
-
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
-  } else {
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0) << " rows";
-  }
+template <typename Dtype>
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  StopPrefetch();
+}
+
+// Stops the prefetch thread, then the reader it pops chunks from.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::StopPrefetch() {
+  this->StopInternalThread();
+  reader_.reset();
+  HDF5Batch* batch;
+  while (prefetch_free_.try_pop(&batch)) {}
+  while (prefetch_full_.try_pop(&batch)) {}
+  prefetch_.clear();
 }
 
 template <typename Dtype>
@@ -76,8 +140,11 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Refuse transformation parameters since HDF5 is totally generic.
   CHECK(!this->layer_param_.has_transform_param()) <<
       this->type() << " does not transform data.";
+  // Start over when set up again.
+  StopPrefetch();
   // Read the source to parse the filenames.
-  const string& source = this->layer_param_.hdf5_data_param().source();
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  const string& source = param.source();
   LOG(INFO) << "Loading list of HDF5 filenames from: " << source;
   hdf_filenames_.clear();
   std::ifstream source_file(source.c_str());
@@ -91,38 +158,66 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   source_file.close();
   num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
   LOG(INFO) << "Number of HDF5 files: " << num_files_;
   CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
     << source;
 
-  file_permutation_.clear();
-  file_permutation_.resize(num_files_);
-  // Default to identity permutation.
-  for (int i = 0; i < num_files_; i++) {
-    file_permutation_[i] = i;
+  // Reshape blobs to the rows of the first file.
+  const int batch_size = param.batch_size();
+  const int top_size = this->layer_param_.top_size();
+  vector<string> datasets;
+  {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    const char* filename = hdf_filenames_[0].c_str();
+    hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    for (int i = 0; i < top_size; ++i) {
+      datasets.push_back(this->layer_param_.top(i));
+      vector<int> top_shape = hdf5_get_nd_dataset_shape(file_id,
+          datasets[i].c_str(), 1, INT_MAX);
+      top_shape[0] = batch_size;
+      top[i]->Reshape(top_shape);
+    }
+    herr_t status = H5Fclose(file_id);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
   }
 
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
+  // Allocate the batches here, so that the prefetch thread does not.
+  for (int b = 0; b < param.prefetch(); ++b) {
+    shared_ptr<HDF5Batch> batch(new HDF5Batch());
+    for (int i = 0; i < top_size; ++i) {
+      batch->push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      batch->back()->ReshapeLike(*top[i]);
+      batch->back()->mutable_cpu_data();
+    }
+    prefetch_.push_back(batch);
+    prefetch_free_.push(batch.get());
   }
+  CHECK_GT(prefetch_.size(), 0) << "HDF5Data needs prefetch > 0";
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  reader_.reset(new HDF5ChunkReader<Dtype>(hdf_filenames_, datasets,
+      param.chunk_rows(), param.shuffle()));
+  reader_->StartInternalThread();
+  current_chunk_ = NULL;
   current_row_ = 0;
+  offset_ = 0;
+  DLOG(INFO) << "Initializing prefetch";
+  this->StartInternalThread();
+}
 
-  // Reshape blobs.
-  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  const int top_size = this->layer_param_.top_size();
-  vector<int> top_shape;
-  for (int i = 0; i < top_size; ++i) {
-    top_shape.resize(hdf_blobs_[i]->num_axes());
-    top_shape[0] = batch_size;
-    for (int j = 1; j < top_shape.size(); ++j) {
-      top_shape[j] = hdf_blobs_[i]->shape(j);
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    current_chunk_ = reader_->full().pop("Waiting for HDF5 data");
+    while (!must_stop()) {
+      HDF5Batch* batch = prefetch_free_.pop();
+      LoadBatch(batch);
+      prefetch_full_.push(batch);
     }
-    top[i]->Reshape(top_shape);
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
   }
 }
 
@@ -138,49 +233,67 @@ bool HDF5DataLayer<Dtype>::Skip() {
 
 template<typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
-  if (++current_row_ == hdf_blobs_[0]->shape(0)) {
-    if (num_files_ > 1) {
-      ++current_file_;
-      if (current_file_ == num_files_) {
-        current_file_ = 0;
-        if (this->layer_param_.hdf5_data_param().shuffle()) {
-          std::random_shuffle(file_permutation_.begin(),
-                              file_permutation_.end());
-        }
-        DLOG(INFO) << "Looping around to first file.";
-      }
-      LoadHDF5FileData(
-        hdf_filenames_[file_permutation_[current_file_]].c_str());
-    }
+  if (++current_row_ == current_chunk_->num_rows()) {
+    reader_->free().push(current_chunk_);
+    current_chunk_ = reader_->full().pop("Waiting for HDF5 data");
     current_row_ = 0;
-    if (this->layer_param_.hdf5_data_param().shuffle())
-      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
   }
   offset_++;
 }
 
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
+void HDF5DataLayer<Dtype>::LoadBatch(HDF5Batch* batch) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i) {
+  // Without other solvers to skip rows for, the rows which follow each other
+  // in the chunk and in the permutation are copied at once.
+  const bool skipping = Caffe::solver_count() > 1 &&
+      this->layer_param_.phase() != TEST;
+  int i = 0;
+  while (i < batch_size) {
     while (Skip()) {
       Next();
     }
-    for (int j = 0; j < this->layer_param_.top_size(); ++j) {
-      int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-            * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
+    const vector<int>& permutation = current_chunk_->permutation_;
+    const int row = permutation[current_row_];
+    int run = 1;
+    while (!skipping && i + run < batch_size &&
+           current_row_ + run < permutation.size() &&
+           permutation[current_row_ + run] == row + run) {
+      ++run;
+    }
+    for (int j = 0; j < batch->size(); ++j) {
+      Blob<Dtype>* rows = current_chunk_->blobs_[j].get();
+      Blob<Dtype>* data = (*batch)[j].get();
+      const int data_dim = data->count(1);
+      CHECK_EQ(rows->count(1), data_dim)
+          << "HDF5 files must have the same shape of rows";
+      caffe_copy(run * data_dim, rows->cpu_data() + row * data_dim,
+          data->mutable_cpu_data() + i * data_dim);
+    }
+    for (int r = 0; r < run; ++r) {
+      Next();
     }
-    Next();
+    i += run;
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  HDF5Batch* batch = prefetch_full_.pop("Waiting for HDF5 data");
+  for (int j = 0; j < this->layer_param_.top_size(); ++j) {
+    top[j]->ReshapeLike(*(*batch)[j]);
+    caffe_copy((*batch)[j]->count(), (*batch)[j]->cpu_data(),
+        top[j]->mutable_cpu_data());
   }
+  prefetch_free_.push(batch);
 }
 
 #ifdef CPU_ONLY
 STUB_GPU_FORWARD(HDF5DataLayer, Forward);
 #endif
 
+INSTANTIATE_CLASS(HDF5ChunkReader);
 INSTANTIATE_CLASS(HDF5DataLayer);
 REGISTER_LAYER_CLASS(HDF5Data);
 
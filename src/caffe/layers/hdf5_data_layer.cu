@@ -1,9 +1,4 @@
 #ifdef USE_HDF5
-/*
-TODO:
-- only load parts of the file, in accordance with a prototxt param "max_mem"
-*/
-
 #include <stdint.h>
 #include <vector>
 
@@ -17,19 +12,13 @@ namespace caffe {
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i) {
-    while (Skip()) {
-      Next();
-    }
-    for (int j = 0; j < this->layer_param_.top_size(); ++j) {
-      int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-            * data_dim], &top[j]->mutable_gpu_data()[i * data_dim]);
-    }
-    Next();
+  HDF5Batch* batch = prefetch_full_.pop("Waiting for HDF5 data");
+  for (int j = 0; j < this->layer_param_.top_size(); ++j) {
+    top[j]->ReshapeLike(*(*batch)[j]);
+    caffe_copy((*batch)[j]->count(), (*batch)[j]->cpu_data(),
+        top[j]->mutable_gpu_data());
   }
+  prefetch_free_.push(batch);
 }
 
 INSTANTIATE_LAYER_GPU_FUNCS(HDF5DataLayer);
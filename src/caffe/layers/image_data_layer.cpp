@@ -137,24 +137,14 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   Dtype* prefetch_data = batch->data_.mutable_cpu_data();
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
-  // datum scales
+  // The list is walked, and reshuffled at its end, in order here; reading
+  // and transforming the images is left to the transform workers.
+  timer.Start();
   const int lines_size = lines_.size();
+  vector<std::pair<std::string, int> > items(batch_size);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a blob
-    timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply transformations (mirror, crop...) to the image
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
-    trans_time += timer.MicroSeconds();
-
-    prefetch_label[item_id] = lines_[lines_id_].second;
+    items[item_id] = lines_[lines_id_];
     // go to the next iter
     lines_id_++;
     if (lines_id_ >= lines_size) {
@@ -166,6 +156,21 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
       }
     }
   }
+  read_time += timer.MicroSeconds();
+
+  // Read the images and apply transformations (mirror, crop...) to them
+  timer.Start();
+  this->TransformBatch(batch_size, [&](const int item_id,
+      DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data) {
+    cv::Mat cv_img = ReadImageToCVMat(root_folder + items[item_id].first,
+        new_height, new_width, is_color);
+    CHECK(cv_img.data) << "Could not load " << items[item_id].first;
+    int offset = batch->data_.offset(item_id);
+    transformed_data->set_cpu_data(prefetch_data + offset);
+    transformer->Transform(cv_img, transformed_data);
+    prefetch_label[item_id] = items[item_id].second;
+  });
+  trans_time += timer.MicroSeconds();
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
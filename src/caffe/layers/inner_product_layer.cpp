@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/fold_layers.hpp"
 #include "caffe/util/math_functions.hpp"
 #define W this->blobs_[0]
 #define B this->blobs_[1]
@@ -84,37 +86,69 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   top_shape.resize(axis + 1);
   top_shape[axis] = N_;
   top[0]->Reshape(top_shape);
+  // Forward overwrites the whole top.
+  top[0]->set_zero_fill_data(false);
   // Set up the bias multiplier
   if (bias_term_) {
     vector<int> bias_shape(1, M_);
     bias_multiplier_.Reshape(bias_shape);
     caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
   }
+  if (input_zero_point_ != 0 || weight_zero_point_ != 0) {
+    zero_point_ones_.Reshape(vector<int>(1, std::max(M_, std::max(K_, N_))));
+    caffe_set(zero_point_ones_.count(), Dtype(1),
+        zero_point_ones_.mutable_cpu_data());
+    UpdateZeroPointBias();
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::UpdateZeroPointBias() {
+  if (input_zero_point_ == 0 || (zero_point_bias_.count() == N_ &&
+      zero_point_bias_version_ == W->data_version())) {
+    return;
+  }
+  // T = -zx * (W - zw) * ones(K_), with W of N_ x K_, or K_ x N_ if
+  // transposed.
+  zero_point_bias_.Reshape(vector<int>(1, N_));
+  Dtype* bias = zero_point_bias_.mutable_cpu_data();
+  caffe_cpu_gemv<Dtype>(transpose_ ? CblasTrans : CblasNoTrans,
+      transpose_ ? K_ : N_, transpose_ ? N_ : K_, Dtype(-input_zero_point_),
+      W->cpu_data(), zero_point_ones_.cpu_data(), (Dtype)0., bias);
+  caffe_add_scalar<Dtype>(N_,
+      Dtype(input_zero_point_) * Dtype(weight_zero_point_) * Dtype(K_), bias);
+  zero_point_bias_version_ = W->data_version();
 }
 
 #include "conv_layer.ev.inc"
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const bool shift_input = (input_zero_point_ != 0);
-  const bool shift_weight = (weight_zero_point_ != 0);
   const bool scale_output = (input_scale_ != Dtype(1.0) || weight_scale_ != Dtype(1.0) ||
                               output_scale_ != Dtype(1.0));
   const bool shift_output = (output_zero_point_ != 0);
-  if (shift_weight) { // shift the quantized weight
-    caffe_add_scalar<Dtype>(W->count(), Dtype(-weight_zero_point_), W->mutable_cpu_data());
-  }
-  if (shift_input) {
-    caffe_add_scalar<Dtype>(bottom[0]->count(),
-        Dtype(-input_zero_point_), bottom[0]->mutable_cpu_data());
-  }
-
+  const Dtype* weight = W->cpu_data();
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
   caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
       M_, N_, K_, (Dtype)1.,
       bottom_data, weight, (Dtype)0., top_data);
+  // The zero-point terms; see UpdateZeroPointBias, which only rebuilds T
+  // here if the weights changed since Reshape.
+  if (weight_zero_point_ != 0) {
+    vector<Dtype> input_sum(M_);
+    caffe_cpu_gemv<Dtype>(CblasNoTrans, M_, K_, (Dtype)1., bottom_data,
+        zero_point_ones_.cpu_data(), (Dtype)0., input_sum.data());
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1,
+        Dtype(-weight_zero_point_), input_sum.data(),
+        zero_point_ones_.cpu_data(), (Dtype)1., top_data);
+  }
+  if (input_zero_point_ != 0) {
+    UpdateZeroPointBias();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
+        zero_point_ones_.cpu_data(), zero_point_bias_.cpu_data(),
+        (Dtype)1., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -137,15 +171,8 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     caffe_add_scalar<Dtype>(count_t, Dtype(output_zero_point_), top_data);
   }
   caffe_cpu_saturate(count_t, top_data, saturate_); // if None nothing happens
-
-  if (shift_input) { // shift the quantized input blob back to correct range
-    caffe_add_scalar<Dtype>(bottom[0]->count(),
-        Dtype(input_zero_point_), bottom[0]->mutable_cpu_data());
-  }
-  // shift quantized weight/bias back to correct range
-  if (shift_weight) {
-    caffe_add_scalar<Dtype>(W->count(), Dtype(weight_zero_point_), W->mutable_cpu_data());
-  }
+  caffe_cpu_fused_activation(this->layer_param_.fused_activation_param(),
+      count_t, top_data); //CUSTOMIZATION
 }
 
 template <typename Dtype>
@@ -9,6 +9,9 @@ namespace caffe {
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(this->layer_param_.fused_activation_param().type(),
+      FusedActivationParameter_Type_NONE)
+      << "Fused activations only run on the CPU."; //CUSTOMIZATION
   const Dtype* bottom_data = bottom[0]->gpu_data();
   Dtype* top_data = top[0]->mutable_gpu_data();
   const Dtype* weight = this->blobs_[0]->gpu_data();
@@ -3,6 +3,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/interp.hpp"
+#include "caffe/util/sampling.hpp"
 #include "caffe/layers/interp_layer.hpp"
 
 namespace caffe {
@@ -65,14 +66,17 @@ void InterpLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   CHECK_GT(height_out_, 0) << "height should be positive";
   CHECK_GT(width_out_, 0) << "width should be positive";
   top[0]->Reshape(num_, channels_, height_out_, width_out_);
+  caffe_bilinear_axis(height_in_eff_, height_out_, &axis_y_);
+  caffe_bilinear_axis(width_in_eff_, width_out_, &axis_x_);
 }
 
 template <typename Dtype>
 void InterpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  caffe_cpu_interp2<Dtype,false>(num_ * channels_,
-    bottom[0]->cpu_data(), - pad_beg_, - pad_beg_, height_in_eff_, width_in_eff_, height_in_, width_in_,
-    top[0]->mutable_cpu_data(), 0, 0, height_out_, width_out_, height_out_, width_out_);
+  // caffe_cpu_interp2 on the taps computed by Reshape
+  caffe_cpu_resample(num_ * channels_, axis_y_, axis_x_,
+    bottom[0]->cpu_data() - pad_beg_ * width_in_ - pad_beg_, width_in_, height_in_ * width_in_,
+    top[0]->mutable_cpu_data(), width_out_, height_out_ * width_out_);
 }
 
 template <typename Dtype>
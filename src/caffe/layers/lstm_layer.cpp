@@ -238,6 +238,70 @@ void LSTMLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedSetUp(const vector<Blob<Dtype>*>& bottom) {
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  CHECK_GT(num_output, 0) << "num_output must be positive";
+  this->AddFusedInputParams(bottom, num_output * 4);
+  vector<int> W_hc_shape(2);
+  W_hc_shape[0] = num_output * 4;
+  W_hc_shape[1] = num_output;
+  this->AddFusedParam(W_hc_shape,
+      this->layer_param_.recurrent_param().weight_filler());
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int x_dim = hidden_dim * 4;
+  const int num = this->N_;
+  this->FusedInputGates(bottom, x_dim);
+  vector<int> buffer_shape(2);
+  buffer_shape[0] = num;
+  buffer_shape[1] = hidden_dim;
+  this->fused_buffer_.Reshape(buffer_shape);
+
+  const Dtype* W_hc = this->blobs_[2 + this->static_input_]->cpu_data();
+  const Dtype* cont = this->FusedCont(bottom);
+  const Dtype* H_prev = this->recur_input_blobs_[0]->cpu_data();
+  Dtype* C = this->recur_output_blobs_[1]->mutable_cpu_data();
+  caffe_copy(num * hidden_dim, this->recur_input_blobs_[1]->cpu_data(), C);
+  Dtype* X = this->fused_gates_.mutable_cpu_data();
+  Dtype* H = top[0]->mutable_cpu_data();
+  for (int t = 0; t < this->T_; ++t) {
+    const Dtype* cont_t = cont ? cont + t * num : NULL;
+    //     gate_input_t += W_hc * h_conted_{t-1}
+    const Dtype* H_conted = this->FusedContHidden(H_prev, cont_t, hidden_dim,
+        this->fused_buffer_.mutable_cpu_data());
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num, x_dim, hidden_dim,
+        Dtype(1), H_conted, W_hc, Dtype(1), X);
+    // The LSTMUnit of timestep t, updating C in place.
+    for (int n = 0; n < num; ++n) {
+      const Dtype cont_n = cont_t ? cont_t[n] : Dtype(1);
+      const Dtype* X_n = X + n * x_dim;
+      Dtype* C_n = C + n * hidden_dim;
+      Dtype* H_n = H + n * hidden_dim;
+      for (int d = 0; d < hidden_dim; ++d) {
+        const Dtype i = this->FusedActivate(this->FUSED_SIGMOID, X_n[d]);
+        const Dtype f = (cont_n == 0) ? 0 : (cont_n *
+            this->FusedActivate(this->FUSED_SIGMOID, X_n[hidden_dim + d]));
+        const Dtype o =
+            this->FusedActivate(this->FUSED_SIGMOID, X_n[2 * hidden_dim + d]);
+        const Dtype g = tanh(X_n[3 * hidden_dim + d]);
+        const Dtype c = f * C_n[d] + i * g;
+        C_n[d] = c;
+        H_n[d] = o * tanh(c);
+      }
+    }
+    H_prev = H;
+    X += num * x_dim;
+    H += num * hidden_dim;
+  }
+  caffe_copy(num * hidden_dim, H_prev,
+      this->recur_output_blobs_[0]->mutable_cpu_data());
+}
+
 INSTANTIATE_CLASS(LSTMLayer);
 REGISTER_LAYER_CLASS(LSTM);
 
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "caffe/layers/nms_gather_layer.hpp"
+#include "caffe/util/bbox_util.hpp"
 
 namespace caffe {
 
@@ -70,44 +71,49 @@ void NMSGatherLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void NMSGatherLayer<Dtype>::apply_nms(vector<vector<Dtype> > &pred_boxes, vector<int> &indices, float iou_threshold)
 {
-	for (int i = 0; i < indices.size()-1; i++)
+	// Corners and areas are computed once per box, and the boxes are suppressed
+	// in index order with ApplyNMSBitmask instead of erasing them one by one.
+	const int num = indices.size();
+	vector<Dtype> corners(num * 4);
+	vector<Dtype> areas(num);
+	for (int i = 0; i < num; i++)
 	{
-		Dtype ymin_i = std::min<Dtype>(pred_boxes[i][0], pred_boxes[i][2]);
-		Dtype xmin_i = std::min<Dtype>(pred_boxes[i][1], pred_boxes[i][3]);
-		Dtype ymax_i = std::max<Dtype>(pred_boxes[i][0], pred_boxes[i][2]);
-		Dtype xmax_i = std::max<Dtype>(pred_boxes[i][1], pred_boxes[i][3]);
-		Dtype area_i = (ymax_i - ymin_i) * (xmax_i - xmin_i);
-
-		for (int j = i + 1; j < indices.size(); j++)
-		{
-			Dtype ymin_j = std::min<Dtype>(pred_boxes[j][0], pred_boxes[j][2]);
-			Dtype xmin_j = std::min<Dtype>(pred_boxes[j][1], pred_boxes[j][3]);
-			Dtype ymax_j = std::max<Dtype>(pred_boxes[j][0], pred_boxes[j][2]);
-			Dtype xmax_j = std::max<Dtype>(pred_boxes[j][1], pred_boxes[j][3]);
-			Dtype area_j = (ymax_j - ymin_j) * (xmax_j - xmin_j);
-
-			Dtype intersection_ymin = std::max<Dtype>(ymin_i, ymin_j);
-			Dtype intersection_xmin = std::max<Dtype>(xmin_i, xmin_j);
-			Dtype intersection_ymax = std::min<Dtype>(ymax_i, ymax_j);
-			Dtype intersection_xmax = std::min<Dtype>(xmax_i, xmax_j);
+		Dtype* corner = &corners[i * 4];
+		corner[0] = std::min<Dtype>(pred_boxes[i][0], pred_boxes[i][2]); //ymin
+		corner[1] = std::min<Dtype>(pred_boxes[i][1], pred_boxes[i][3]); //xmin
+		corner[2] = std::max<Dtype>(pred_boxes[i][0], pred_boxes[i][2]); //ymax
+		corner[3] = std::max<Dtype>(pred_boxes[i][1], pred_boxes[i][3]); //xmax
+		areas[i] = (corner[2] - corner[0]) * (corner[3] - corner[1]);
+	}
+
+	vector<int> kept;
+	ApplyNMSBitmask(num, -1, MakePairwiseSuppressor(
+		[&](const int i, const int j) {
+			if (!(areas[i] > Dtype(0) && areas[j] > Dtype(0)))
+				return false;
+			const Dtype* corner_i = &corners[i * 4];
+			const Dtype* corner_j = &corners[j * 4];
+			Dtype intersection_ymin = std::max<Dtype>(corner_i[0], corner_j[0]);
+			Dtype intersection_xmin = std::max<Dtype>(corner_i[1], corner_j[1]);
+			Dtype intersection_ymax = std::min<Dtype>(corner_i[2], corner_j[2]);
+			Dtype intersection_xmax = std::min<Dtype>(corner_i[3], corner_j[3]);
 
 			Dtype intersection_area =
 			      std::max<Dtype>(intersection_ymax - intersection_ymin, Dtype(0)) *
 			      std::max<Dtype>(intersection_xmax - intersection_xmin, Dtype(0));
 
-			if (area_i > Dtype(0) && area_j > Dtype(0))
-			{
-				// intersection-over-union (IOU) overlap
-				Dtype IOU = intersection_area / (area_i + area_j - intersection_area);
-				if (IOU > iou_threshold)
-				{
-					indices.erase(indices.begin() + j);
-					pred_boxes.erase(pred_boxes.begin() + j); //must be consistent with indices
-					j--; //erase make the indices count decrease
-				}
-			}
-		}
+			// intersection-over-union (IOU) overlap
+			Dtype IOU = intersection_area / (areas[i] + areas[j] - intersection_area);
+			return IOU > iou_threshold;
+		}), &kept);
+
+	for (int k = 0; k < kept.size(); k++)
+	{
+		indices[k] = indices[kept[k]];
+		pred_boxes[k].swap(pred_boxes[kept[k]]); //must be consistent with indices
 	}
+	indices.resize(kept.size());
+	pred_boxes.resize(kept.size());
 }
 
 
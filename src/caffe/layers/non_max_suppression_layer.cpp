@@ -7,6 +7,7 @@
 #define HelperMax(a, b) std::max(a, b)
 
 #include "caffe/layers/non_max_suppression_layer.hpp"
+#include "caffe/util/bbox_util.hpp"
 
 namespace caffe {
 
@@ -141,35 +142,30 @@ void NonMaxSuppressionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bott
          }
        }
 
-       ScoreIndexPair next_top_score;
-       std::vector<int64_t> selected_indices_inside_class;
-       // Get the next box with top score, filter by iou_threshold
+       // Get the boxes in the order of their scores, filter by iou_threshold
+       std::vector<int64_t> sorted_indices;
+       sorted_indices.reserve(sorted_scores_with_index.size());
        while (!sorted_scores_with_index.empty()) {
-         next_top_score = sorted_scores_with_index.top();
+         sorted_indices.push_back(sorted_scores_with_index.top().index_);
          sorted_scores_with_index.pop();
+       }
 
-         bool selected = true;
-         // Check with existing selected boxes for this class, suppress if exceed the IOU (Intersection Over Union) threshold
-         for (int64_t selected_index : selected_indices_inside_class) {
-           if (SuppressByIOU(boxes_data + box_offset, selected_index, next_top_score.index_,
-                             center_point_box_, iou_threshold_)) {
-             selected = false;
-             break;
-           }
-         }
-
-         if (selected) {
-           if (max_output_boxes_per_class_ > 0 &&
-               static_cast<int64_t>(selected_indices_inside_class.size()) >= max_output_boxes_per_class_) {
-             break;
-           }
-           selected_indices_inside_class.push_back(next_top_score.index_);
-           //selected_indices.emplace_back(batch_index, class_index, next_top_score.index_);
-           selected_indices.emplace_back(batch_index);
-           selected_indices.emplace_back(class_index);
-           selected_indices.emplace_back(next_top_score.index_);
-         }
-       }  //while
+       // A box is selected unless it exceeds the IOU (Intersection Over Union)
+       // threshold with a box selected before it for this class
+       std::vector<int> selected_indices_inside_class;
+       ApplyNMSBitmask(sorted_indices.size(),
+           max_output_boxes_per_class_ > 0 ? max_output_boxes_per_class_ : -1,
+           MakePairwiseSuppressor([&](const int i, const int j) {
+             return SuppressByIOU(boxes_data + box_offset, sorted_indices[i],
+                                  sorted_indices[j], center_point_box_,
+                                  iou_threshold_);
+           }), &selected_indices_inside_class);
+
+       for (int i = 0; i < selected_indices_inside_class.size(); ++i) {
+         selected_indices.emplace_back(batch_index);
+         selected_indices.emplace_back(class_index);
+         selected_indices.emplace_back(sorted_indices[selected_indices_inside_class[i]]);
+       }
 
      }    //for class_index
    }      //for batch_index
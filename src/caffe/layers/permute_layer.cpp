@@ -2,6 +2,7 @@
 
 #include "caffe/layers/permute_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/permute.hpp"
 
 namespace caffe {
 
@@ -84,6 +85,11 @@ void PermuteLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     top_shape.push_back(bottom[0]->shape(permute_order_.cpu_data()[i]));
   }
   top[0]->Reshape(top_shape);
+  // Alias the top here and not only in Forward, so that Net::PlanBlobMemory
+  // plans top and bottom as one blob.
+  if (!need_permute_) {
+    top[0]->ShareData(*bottom[0]);
+  }
 
   for (int i = 0; i < num_axes_; ++i) {
     if (i == num_axes_ - 1) {
@@ -98,15 +104,10 @@ template <typename Dtype>
 void PermuteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   if (need_permute_) {
-    Dtype* bottom_data = bottom[0]->mutable_cpu_data();
-    Dtype* top_data = top[0]->mutable_cpu_data();
-    const int top_count = top[0]->count();
     const int* permute_order = permute_order_.cpu_data();
-    const int* old_steps = old_steps_.cpu_data();
-    const int* new_steps = new_steps_.cpu_data();
-    bool forward = true;
-    Permute(top_count, bottom_data, forward, permute_order, old_steps,
-            new_steps, num_axes_, top_data);
+    caffe_cpu_permute(bottom[0]->shape(),
+        vector<int>(permute_order, permute_order + num_axes_),
+        bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
   } else {
     // If there is no need to permute, we share data to save memory.
     top[0]->ShareData(*bottom[0]);
@@ -117,15 +118,11 @@ template <typename Dtype>
 void PermuteLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   if (need_permute_) {
-    Dtype* top_diff = top[0]->mutable_cpu_diff();
-    Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    const int top_count = top[0]->count();
+    // The bottom diff is the top diff permuted back.
     const int* permute_order = permute_order_.cpu_data();
-    const int* old_steps = old_steps_.cpu_data();
-    const int* new_steps = new_steps_.cpu_data();
-    bool forward = false;
-    Permute(top_count, bottom_diff, forward, permute_order, old_steps,
-            new_steps, num_axes_, top_diff);
+    caffe_cpu_permute(top[0]->shape(), caffe_inverse_permute_order(
+        vector<int>(permute_order, permute_order + num_axes_)),
+        top[0]->cpu_diff(), bottom[0]->mutable_cpu_diff());
   } else {
     // If there is no need to permute, we share diff to save memory.
     bottom[0]->ShareDiff(*top[0]);
@@ -37,10 +37,11 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   global_pooling_ = pool_param.global_pooling();
 
   ceil_mode_ = pool_param.ceil_mode();
+  nhwc_ = this->layer_param_.data_format() == "NHWC"; //CUSTOMIZATION
 
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = bottom[0]->shape(nhwc_ ? 1 : 2);
+    kernel_w_ = bottom[0]->shape(nhwc_ ? 2 : 3);
   } else {
     if (pool_param.has_kernel_size()) {
       kernel_h_ = kernel_w_ = pool_param.kernel_size();
@@ -147,12 +148,21 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
-  channels_ = bottom[0]->channels();
-  height_ = bottom[0]->height();
-  width_ = bottom[0]->width();
+  //<--CUSTOMIZATION
+  if (nhwc_) {
+    CHECK_EQ(top.size(), 1) << "NHWC pooling has no mask top.";
+    height_ = bottom[0]->shape(1);
+    width_ = bottom[0]->shape(2);
+    channels_ = bottom[0]->shape(3);
+  } else {
+    channels_ = bottom[0]->channels();
+    height_ = bottom[0]->height();
+    width_ = bottom[0]->width();
+  }
+  //CUSTOMIZATION-->
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = height_;
+    kernel_w_ = width_;
   }
 
   //<--CUSTOMIZATION
@@ -223,6 +233,13 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT((pooled_height_ - 1) * stride_h_, height_ + pad_h_);
     CHECK_LT((pooled_width_ - 1) * stride_w_, width_ + pad_w_);
   }
+  // Forward overwrites the whole top.
+  top[0]->set_zero_fill_data(false);
+  if (nhwc_) { //CUSTOMIZATION
+    top[0]->Reshape(bottom[0]->num(), pooled_height_, pooled_width_,
+        channels_);
+    return;
+  }
   top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
       pooled_width_);
   if (top.size() > 1) {
@@ -295,6 +312,11 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
   //CUSTOMIZATION-->
 
+  if (nhwc_) { //CUSTOMIZATION
+    Forward_cpu_nhwc(bottom, top, pad_top, pad_bottom, pad_left, pad_right);
+    return;
+  }
+
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
     // Initialize
@@ -503,12 +525,82 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   caffe_cpu_saturate(top[0]->count(), top[0]->mutable_cpu_data(), saturate_); // if None nothing happens
 }
 
+// The loops of Forward_cpu with the channels innermost, so that the
+// comparisons and sums are the same and give the same results.
+template <typename Dtype>
+void PoolingLayer<Dtype>::Forward_cpu_nhwc(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top, const int pad_top, const int pad_bottom,
+    const int pad_left, const int pad_right) {
+  const PoolingParameter_PoolMethod pool =
+      this->layer_param_.pooling_param().pool();
+  CHECK(pool == PoolingParameter_PoolMethod_MAX ||
+      pool == PoolingParameter_PoolMethod_AVE ||
+      pool == PoolingParameter_PoolMethod_AVE_EXC_PAD)
+      << "NHWC pooling supports MAX, AVE and AVE_EXC_PAD.";
+  CHECK(output_scale_ == 1.0 && output_zero_point_ == 0)
+      << "NHWC pooling does not support quantized outputs.";
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  const int channels = channels_;
+  for (int n = 0; n < bottom[0]->shape(0); ++n) {
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        int hstart = ph * stride_h_ - pad_top;
+        int wstart = pw * stride_w_ - pad_left;
+        int hend, wend;
+        int pool_size = 0;
+        if (pool == PoolingParameter_PoolMethod_MAX) {
+          hend = min(hstart + kernel_h_, height_);
+          wend = min(wstart + kernel_w_, width_);
+        } else {
+          hend = min(hstart + kernel_h_, height_ + pad_bottom);
+          wend = min(wstart + kernel_w_, width_ + pad_right);
+          pool_size = (hend - hstart) * (wend - wstart);
+          hend = min(hend, height_);
+          wend = min(wend, width_);
+        }
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        if (pool == PoolingParameter_PoolMethod_AVE_EXC_PAD) {
+          pool_size = (hend - hstart) * (wend - wstart);
+        }
+        Dtype* out = top_data + (ph * pooled_width_ + pw) * channels;
+        caffe_set(channels, pool == PoolingParameter_PoolMethod_MAX ?
+            Dtype(-FLT_MAX) : Dtype(0), out);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const Dtype* in = bottom_data + (h * width_ + w) * channels;
+            if (pool == PoolingParameter_PoolMethod_MAX) {
+              for (int c = 0; c < channels; ++c) {
+                out[c] = in[c] > out[c] ? in[c] : out[c];
+              }
+            } else {
+              for (int c = 0; c < channels; ++c) {
+                out[c] += in[c];
+              }
+            }
+          }
+        }
+        if (pool != PoolingParameter_PoolMethod_MAX) {
+          for (int c = 0; c < channels; ++c) {
+            out[c] /= pool_size;
+          }
+        }
+      }
+    }
+    bottom_data += bottom[0]->count(1);
+    top_data += top[0]->count(1);
+  }
+  caffe_cpu_saturate(top[0]->count(), top[0]->mutable_cpu_data(), saturate_); // if None nothing happens
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   if (!propagate_down[0]) {
     return;
   }
+  CHECK(!nhwc_) << "NHWC pooling only runs forward.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
@@ -1,4 +1,6 @@
 #include <vector>
+// Before proposal_layer.hpp, which defines max and min as macros.
+#include "caffe/util/bbox_util.hpp"
 #include "caffe/layers/proposal_layer.hpp"
 
 namespace caffe {
@@ -263,61 +265,62 @@ void ProposalLayer<Dtype>::bbox_transform_inv(int img_width, int img_height, vec
 template <typename Dtype>
 void ProposalLayer<Dtype>::filter_boxes(vector<vector<float> > &pred_boxes, vector<float> &confidence, float min_size)
 {
-  for (int i = 0; i < pred_boxes.size()-1; i++)
+  // The kept boxes are moved to the front instead of erasing the others; the
+  // last box is never checked.
+  const int num = pred_boxes.size();
+  int num_kept = 0;
+  for (int i = 0; i < num; i++)
   {
     float ws = pred_boxes[i][2] - pred_boxes[i][0] + 1;
     float hs = pred_boxes[i][3] - pred_boxes[i][1] + 1;
     bool keep = (ws >= min_size) && (hs >= min_size);
-    if(!keep)
+    if(keep || i == num - 1)
     {
-      pred_boxes.erase(pred_boxes.begin() + i);
-      confidence.erase(confidence.begin() + i);
-      i--;
+      pred_boxes[num_kept].swap(pred_boxes[i]);
+      confidence[num_kept] = confidence[i];
+      num_kept++;
     }
   }
+  pred_boxes.resize(num_kept);
+  confidence.resize(num_kept);
 }
 
 template <typename Dtype>
 void ProposalLayer<Dtype>::applynmsfast(vector<vector<float> > &pred_boxes, vector<pair<Dtype, int> > &score_index_vec,
     const float nms_threshold, const int top_k, vector<int> &indices) {
   // Do nms.
-  float adaptive_threshold = nms_threshold;
-  indices.clear();
-  while (score_index_vec.size() != 0) {
-    const int idx = score_index_vec.front().second;
+  const float adaptive_threshold = nms_threshold;
+  vector<int> kept;
+  ApplyNMSBitmask(score_index_vec.size(), -1, MakePairwiseSuppressor(
+      [&](const int k, const int s) {
+    const int idx = score_index_vec[s].second;
     float x1 = pred_boxes[idx][0];
     float y1 = pred_boxes[idx][1];
     float x2 = pred_boxes[idx][2];
     float y2 = pred_boxes[idx][3];
     float areas = (x2 - x1 + 1) * (y2 - y1 + 1);
-    bool keep = true;
-    for (int k = 0; k < indices.size(); ++k) {
-      if (keep) {
-        const int kept_idx = indices[k];
-        float x11 = pred_boxes[kept_idx][0];
-        float y11 = pred_boxes[kept_idx][1];
-        float x21 = pred_boxes[kept_idx][2];
-        float y21 = pred_boxes[kept_idx][3];
-        float areas1 = (x21 - x11 + 1) * (y21 - y11 + 1);
 
-        const Dtype inter_xmin = max(x1, x11);
-        const Dtype inter_ymin = max(y1, y11);
-        const Dtype inter_xmax = min(x2, x21);
-        const Dtype inter_ymax = min(y2, y21);
-        const Dtype inter_width = max(inter_xmax - inter_xmin + 1, 0);
-        const Dtype inter_height = max(inter_ymax - inter_ymin + 1, 0);
-        const Dtype inter_size = inter_width * inter_height;
+    const int kept_idx = score_index_vec[k].second;
+    float x11 = pred_boxes[kept_idx][0];
+    float y11 = pred_boxes[kept_idx][1];
+    float x21 = pred_boxes[kept_idx][2];
+    float y21 = pred_boxes[kept_idx][3];
+    float areas1 = (x21 - x11 + 1) * (y21 - y11 + 1);
 
-        float overlap = inter_size / (areas + areas1 - inter_size);
-        keep = overlap <= adaptive_threshold;
-      } else {
-        break;
-      }
-    }
-    if (keep) {
-      indices.push_back(idx);
-    }
-    score_index_vec.erase(score_index_vec.begin());
+    const Dtype inter_xmin = max(x1, x11);
+    const Dtype inter_ymin = max(y1, y11);
+    const Dtype inter_xmax = min(x2, x21);
+    const Dtype inter_ymax = min(y2, y21);
+    const Dtype inter_width = max(inter_xmax - inter_xmin + 1, 0);
+    const Dtype inter_height = max(inter_ymax - inter_ymin + 1, 0);
+    const Dtype inter_size = inter_width * inter_height;
+
+    float overlap = inter_size / (areas + areas1 - inter_size);
+    return !(overlap <= adaptive_threshold);
+  }), &kept);
+  indices.clear();
+  for (int k = 0; k < kept.size(); ++k) {
+    indices.push_back(score_index_vec[kept[k]].second);
   }
   if(indices.size()>top_k)
     indices.resize(top_k);
@@ -81,6 +81,33 @@ void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
+  // In the fused mode there is no unrolled net: the recurrent inputs and
+  // outputs are blobs of the layer, and so are the parameters.
+  fused_ = this->layer_param_.recurrent_param().fused();
+  if (fused_) {
+    vector<BlobShape> recur_input_shapes;
+    RecurrentInputShapes(&recur_input_shapes);
+    CHECK_EQ(num_recur_blobs, recur_input_shapes.size());
+    fused_state_.clear();
+    recur_input_blobs_.clear();
+    recur_output_blobs_.clear();
+    for (int i = 0; i < 2 * num_recur_blobs; ++i) {
+      fused_state_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      fused_state_[i]->Reshape(recur_input_shapes[i % num_recur_blobs]);
+      if (i < num_recur_blobs) {
+        recur_input_blobs_.push_back(fused_state_[i].get());
+      } else {
+        recur_output_blobs_.push_back(fused_state_[i].get());
+      }
+    }
+    this->blobs_.clear();
+    FusedSetUp(bottom);
+    this->param_propagate_down_.clear();
+    this->param_propagate_down_.resize(this->blobs_.size(), true);
+    Reset();
+    return;
+  }
+
   // Create a NetParameter; setup the inputs that aren't unique to particular
   // recurrent architectures.
   NetParameter net_param;
@@ -251,6 +278,10 @@ void RecurrentLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_EQ(T_, bottom[1]->shape(0));
     CHECK_EQ(N_, bottom[1]->shape(1));
   }
+  if (fused_) {
+    FusedReshape(bottom, top);
+    return;
+  }
   x_input_blob_->ReshapeLike(*bottom[0]);
   if(!continue_recur_)
   {
@@ -335,7 +366,7 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // currently point to a stale owner blob that was dropped when Solver::Test
   // called test_net->ShareTrainedLayersWith(net_.get()).
   // TODO: somehow make this work non-hackily.
-  if (this->phase_ == TEST) {
+  if (this->phase_ == TEST && !fused_) {
     unrolled_net_->ShareWeights();
   }
 
@@ -351,7 +382,11 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
-  unrolled_net_->ForwardTo(last_layer_index_);
+  if (fused_) {
+    FusedForward_cpu(bottom, top);
+  } else {
+    unrolled_net_->ForwardTo(last_layer_index_);
+  }
 
   if (expose_hidden_ || default_initial_) {
     const int top_offset = output_blobs_.size();
@@ -365,6 +400,8 @@ template <typename Dtype>
 void RecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   CHECK(!propagate_down[1]) << "Cannot backpropagate to sequence indicators.";
+  CHECK(!fused_) << type() << " layer " << this->layer_param_.name()
+      << " is fused and can only run Forward.";
 
   // TODO: skip backpropagation to inputs and parameters inside the unrolled
   // net according to propagate_down[0] and propagate_down[2]. For now just
@@ -374,6 +411,147 @@ void RecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   unrolled_net_->BackwardFrom(last_layer_index_);
 }
 
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedReshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  vector<BlobShape> recur_input_shapes;
+  RecurrentInputShapes(&recur_input_shapes);
+  CHECK_EQ(recur_input_shapes.size(), recur_input_blobs_.size());
+  for (int i = 0; i < recur_input_shapes.size(); ++i) {
+    recur_input_blobs_[i]->Reshape(recur_input_shapes[i]);
+    recur_output_blobs_[i]->Reshape(recur_input_shapes[i]);
+  }
+  if (expose_hidden_) {
+    const int bottom_offset = (continue_recur_ ? 1 : 2) + static_input_;
+    for (int i = bottom_offset, j = 0; i < bottom.size(); ++i, ++j) {
+      CHECK(recur_input_blobs_[j]->shape() == bottom[i]->shape())
+          << "shape mismatch - recur_input_blobs_[" << j << "]: "
+          << recur_input_blobs_[j]->shape_string()
+          << " vs. bottom[" << i << "]: " << bottom[i]->shape_string();
+      recur_input_blobs_[j]->ShareData(*bottom[i]);
+    }
+  }
+  vector<int> top_shape(3);
+  top_shape[0] = T_;
+  top_shape[1] = N_;
+  top_shape[2] = this->layer_param_.recurrent_param().num_output();
+  top[0]->Reshape(top_shape);
+  for (int i = 1, j = 0; i < top.size(); ++i, ++j) {
+    top[i]->ReshapeLike(*recur_output_blobs_[j]);
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedSetUp(const vector<Blob<Dtype>*>& bottom) {
+  LOG(FATAL) << type() << " layers have no fused mode.";
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  LOG(FATAL) << type() << " layers have no fused mode.";
+}
+
+template <typename Dtype>
+typename RecurrentLayer<Dtype>::FusedActivation
+RecurrentLayer<Dtype>::GetFusedActivation(int index,
+    const char* default_type) const {
+  const string activation =
+      index < activations_.size() ? activations_[index] : default_type;
+  if (activation == "Sigmoid") {
+    return FUSED_SIGMOID;
+  } else if (activation == "TanH") {
+    return FUSED_TANH;
+  } else if (activation == "ReLU") {
+    return FUSED_RELU;
+  }
+  LOG(FATAL) << "Activation " << activation
+      << " is not supported by fused recurrent layers.";
+  return FUSED_SIGMOID;
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::AddFusedParam(const vector<int>& shape,
+    const FillerParameter& filler) {
+  this->blobs_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+  shared_ptr<Filler<Dtype> > param_filler(GetFiller<Dtype>(filler));
+  param_filler->Fill(this->blobs_.back().get());
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::AddFusedInputParams(
+    const vector<Blob<Dtype>*>& bottom, int gate_dim) {
+  const RecurrentParameter& recurrent_param =
+      this->layer_param_.recurrent_param();
+  // The same as the InnerProduct layers of the unrolled net:
+  //     W_xc (gate_dim x input_dim), b_c (gate_dim)
+  //     and W_xc_static (gate_dim x static_dim).
+  vector<int> weight_shape(2);
+  weight_shape[0] = gate_dim;
+  weight_shape[1] = bottom[0]->count(2);
+  AddFusedParam(weight_shape, recurrent_param.weight_filler());
+  vector<int> bias_shape(1, gate_dim);
+  AddFusedParam(bias_shape, recurrent_param.bias_filler());
+  if (static_input_) {
+    weight_shape[1] = bottom[continue_recur_ ? 1 : 2]->count(1);
+    AddFusedParam(weight_shape, recurrent_param.weight_filler());
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::FusedInputGates(
+    const vector<Blob<Dtype>*>& bottom, int gate_dim) {
+  const int input_dim = bottom[0]->count(2);
+  vector<int> gates_shape(3);
+  gates_shape[0] = T_;
+  gates_shape[1] = N_;
+  gates_shape[2] = gate_dim;
+  fused_gates_.Reshape(gates_shape);
+  Dtype* gates = fused_gates_.mutable_cpu_data();
+  const Dtype* bias = this->blobs_[1]->cpu_data();
+  for (int i = 0; i < T_ * N_; ++i) {
+    caffe_copy(gate_dim, bias, gates + i * gate_dim);
+  }
+  if (static_input_) {
+    // W_xc_static * x_static is the same for every timestep.
+    const Blob<Dtype>* x_static = bottom[continue_recur_ ? 1 : 2];
+    vector<int> static_shape(2);
+    static_shape[0] = N_;
+    static_shape[1] = gate_dim;
+    fused_buffer_.Reshape(static_shape);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N_, gate_dim,
+        x_static->count(1), Dtype(1), x_static->cpu_data(),
+        this->blobs_[2]->cpu_data(), Dtype(0),
+        fused_buffer_.mutable_cpu_data());
+    for (int t = 0; t < T_; ++t) {
+      caffe_axpy<Dtype>(N_ * gate_dim, Dtype(1), fused_buffer_.cpu_data(),
+          gates + t * N_ * gate_dim);
+    }
+  }
+  // The input projection of all timesteps at once.
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T_ * N_, gate_dim,
+      input_dim, Dtype(1), bottom[0]->cpu_data(), this->blobs_[0]->cpu_data(),
+      Dtype(1), gates);
+}
+
+template <typename Dtype>
+const Dtype* RecurrentLayer<Dtype>::FusedCont(
+    const vector<Blob<Dtype>*>& bottom) const {
+  return continue_recur_ ? NULL : bottom[1]->cpu_data();
+}
+
+template <typename Dtype>
+const Dtype* RecurrentLayer<Dtype>::FusedContHidden(const Dtype* h_prev,
+    const Dtype* cont_t, int dim, Dtype* h_conted) const {
+  if (!cont_t) {
+    return h_prev;
+  }
+  for (int n = 0; n < N_; ++n) {
+    caffe_cpu_scale(dim, cont_t[n], h_prev + n * dim, h_conted + n * dim);
+  }
+  return h_conted;
+}
+
 #ifdef CPU_ONLY
 STUB_GPU_FORWARD(RecurrentLayer, Forward);
 #endif
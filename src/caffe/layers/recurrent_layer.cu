@@ -12,6 +12,11 @@ namespace caffe {
 template <typename Dtype>
 void RecurrentLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  // The fused kernels run on the CPU only.
+  if (fused_) {
+    Forward_cpu(bottom, top);
+    return;
+  }
   // Hacky fix for test time... reshare all the shared blobs.
   // TODO: somehow make this work non-hackily.
   if (this->phase_ == TEST) {
@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "caffe/layers/shuffle_channel_layer.hpp"
+#include "caffe/util/permute.hpp"
 
 namespace caffe {
 
@@ -14,21 +15,6 @@ void ShuffleChannelLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype> *> &bottom,
   top[0]->ReshapeLike(*bottom[0]);
 }
 
-template <typename Dtype>
-void ShuffleChannelLayer<Dtype>::Resize_cpu(Dtype *output, const Dtype *input, int group_row, int group_column, int len)
-{
-  for (int i = 0; i < group_row; ++i) // 2
-  {
-    for(int j = 0; j < group_column ; ++j) // 3
-    {
-      const Dtype* p_i = input + (i * group_column + j ) * len;
-      Dtype* p_o = output + (j * group_row + i ) * len;
-
-      caffe_copy(len, p_i, p_o);
-    }
-  }
-}
-
 template <typename Dtype>
 void ShuffleChannelLayer<Dtype>::Reshape(const vector<Blob<Dtype> *> &bottom, const vector<Blob<Dtype> *> &top)
 {
@@ -47,7 +33,6 @@ void ShuffleChannelLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
 
   const int num = bottom[0]->shape(0);
-  const int feature_map_size = bottom[0]->count(1);
   const int sp_sz = bottom[0]->count(2);
   const int chs = bottom[0]->shape(1);
 
@@ -55,12 +40,18 @@ void ShuffleChannelLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int group_column = int(chs / group_row);
   CHECK_EQ(chs, (group_column * group_row)) << "Wrong group size.";
 
-  //Dtype* temp_data = temp_blob_.mutable_cpu_data();
-  for(int n = 0; n < num; ++n)
-  {
-    Resize_cpu(top_data + n*feature_map_size, bottom_data + n*feature_map_size, group_row, group_column, sp_sz);
-  }
-  //caffe_copy(bottom[0]->count(), temp_blob_.cpu_data(), top_data);
+  // Transposes the group_row x group_column channels of each image.
+  vector<int> shape(4);
+  shape[0] = num;
+  shape[1] = group_row;
+  shape[2] = group_column;
+  shape[3] = sp_sz;
+  vector<int> order(4);
+  order[0] = 0;
+  order[1] = 2;
+  order[2] = 1;
+  order[3] = 3;
+  caffe_cpu_permute(shape, order, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -72,19 +63,23 @@ void ShuffleChannelLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
 
     const int num = bottom[0]->shape(0);
-    const int feature_map_size = bottom[0]->count(1);
     const int sp_sz = bottom[0]->count(2);
     const int chs = bottom[0]->shape(1);
 
     int group_row = int(chs / group_);
     int group_column = group_;
 
-    //Dtype* temp_diff = temp_blob_.mutable_cpu_diff();
-    for(int n = 0; n < num; ++n)
-    {
-      Resize_cpu(bottom_diff + n * feature_map_size, top_diff + n*feature_map_size, group_row, group_column, sp_sz);
-    }
-    //caffe_copy(top[0]->count(), temp_blob_.cpu_diff(), bottom_diff);
+    vector<int> shape(4);
+    shape[0] = num;
+    shape[1] = group_row;
+    shape[2] = group_column;
+    shape[3] = sp_sz;
+    vector<int> order(4);
+    order[0] = 0;
+    order[1] = 2;
+    order[2] = 1;
+    order[3] = 3;
+    caffe_cpu_permute(shape, order, top_diff, bottom_diff);
   }
 }
 
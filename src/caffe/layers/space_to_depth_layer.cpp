@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "caffe/layers/space_to_depth_layer.hpp"
+#include "caffe/util/permute.hpp"
 
 namespace caffe {
 
@@ -36,71 +37,29 @@ void SpaceToDepthLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void SpaceToDepthLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top){
+  // Height and width are split into (output size, block offset), and the
+  // block offsets are moved in front of the depth.
+  const int batch_size = this->output_top_shape[0];
+  const int bs = this->block_size;
+  vector<int> bottom_shape = bottom[0]->shape();
+  vector<int> shape(6);
+  vector<int> order(6);
   if (this->data_format == "NHWC"){
-    const int batch_size = this->output_top_shape[0];
-    const int output_height = this->output_top_shape[1];
-    const int output_width = this->output_top_shape[2];
-    const int output_depth = this->output_top_shape[3];
-
-    vector<int> bottom_shape = bottom[0]->shape();
-    const int input_height = bottom_shape[1];
-    const int input_width = bottom_shape[2];
-    const int input_depth = bottom_shape[3];
-
-    const Dtype* bottom_data = bottom[0]->cpu_data();
-    Dtype* top_data = top[0]->mutable_cpu_data();
-
-    for (int b = 0; b < batch_size; ++b) {
-      for (int h = 0; h < input_height; ++h) {
-        const int out_h = h / this->block_size;
-        const int offset_h = (h % this->block_size);
-        for (int w = 0; w < input_width; ++w) {
-          const int out_w = w / this->block_size;
-          const int offset_w = (w % this->block_size);
-          const int offset_d =
-            (offset_h * this->block_size + offset_w) * input_depth;
-          for (int d = 0; d < input_depth; ++d) {
-            const int out_d = d + offset_d;
-            const int in_index = ((b*input_height + h)*input_width + w)*input_depth + d;
-            const int out_index = ((b*output_height + out_h)*output_width + out_w)*output_depth + out_d;
-            top_data[out_index] = bottom_data[in_index];
-          }
-        }
-      }
-    }
+    const int shape_nhwc[] = {batch_size, this->output_top_shape[1], bs,
+                              this->output_top_shape[2], bs, bottom_shape[3]};
+    const int order_nhwc[] = {0, 1, 3, 2, 4, 5};
+    shape.assign(shape_nhwc, shape_nhwc + 6);
+    order.assign(order_nhwc, order_nhwc + 6);
   } else {
-    const int batch_size = this->output_top_shape[0];
-    const int output_depth = this->output_top_shape[1];
-    const int output_height = this->output_top_shape[2];
-    const int output_width = this->output_top_shape[3];
-
-    vector<int> bottom_shape = bottom[0]->shape();
-    const int input_depth = bottom_shape[1];
-    const int input_height = bottom_shape[2];
-    const int input_width = bottom_shape[3];
-
-    const Dtype* bottom_data = bottom[0]->cpu_data();
-    Dtype* top_data = top[0]->mutable_cpu_data();
-
-    for (int b = 0; b < batch_size; ++b) {
-      for (int h = 0; h < input_height; ++h) {
-        const int out_h = h / this->block_size;
-        const int offset_h = (h % this->block_size);
-        for (int w = 0; w < input_width; ++w) {
-          const int out_w = w / this->block_size;
-          const int offset_w = (w % this->block_size);
-          const int offset_d =
-            (offset_h * this->block_size + offset_w) * input_depth;
-          for (int d = 0; d < input_depth; ++d) {
-            const int out_d = d + offset_d;
-            const int in_index = ((b*input_depth + d)*input_height + h)*input_width + w;
-            const int out_index = ((b*output_depth + out_d)*output_height + out_h)*output_width + out_w;
-            top_data[out_index] = bottom_data[in_index];
-          }
-        }
-      }
-    }
+    const int shape_nchw[] = {batch_size, bottom_shape[1],
+                              this->output_top_shape[2], bs,
+                              this->output_top_shape[3], bs};
+    const int order_nchw[] = {0, 3, 5, 1, 2, 4};
+    shape.assign(shape_nchw, shape_nchw + 6);
+    order.assign(order_nchw, order_nchw + 6);
   }
+  caffe_cpu_permute(shape, order, bottom[0]->cpu_data(),
+                    top[0]->mutable_cpu_data());
 }
 
 
@@ -19,6 +19,9 @@ void SplitLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
         "allow in-place computation.";
     top[i]->ReshapeLike(*bottom[0]);
     CHECK_EQ(count_, top[i]->count());
+    // Share the data here and not only in Forward, so that
+    // Net::PlanBlobMemory plans the tops and the bottom as one blob.
+    top[i]->ShareData(*bottom[0]);
   }
 }
 
@@ -43,6 +43,10 @@ void SqueezeLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 
   top[0]->Reshape(top_shape);
   CHECK_EQ(top[0]->count(), bottom[0]->count());
+  // Alias the top here and not only in Forward, so that Net::PlanBlobMemory
+  // plans top and bottom as one blob.
+  top[0]->ShareData(*bottom[0]);
+  top[0]->ShareDiff(*bottom[0]);
 }
 
 template <typename Dtype>
@@ -11,11 +11,15 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fold_layers.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/insert_layouts.hpp"
 #include "caffe/util/insert_splits.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 #include "caffe/test/test_caffe_main.hpp"
@@ -53,6 +57,36 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
+  //<--CUSTOMIZATION
+  vector<vector<LayerParameter> > folded;
+  if (filtered_param.fold_inference_layers()) {
+    if (phase_ == TEST && !filtered_param.force_backward()) {
+      NetParameter folded_param;
+      FoldInferenceLayers(filtered_param, Caffe::mode() == Caffe::CPU,
+          &folded_param, &folded);
+      LOG_IF(INFO, Caffe::root_solver()) << "Folded "
+          << filtered_param.layer_size() - folded_param.layer_size()
+          << " layers into the ones before them.";
+      filtered_param.Swap(&folded_param);
+    } else {
+      LOG(WARNING) << "fold_inference_layers only applies to TEST nets "
+          << "without force_backward; ignored.";
+    }
+  }
+  if (filtered_param.data_format() == "NHWC") {
+    if (phase_ == TEST && !filtered_param.force_backward() &&
+        Caffe::mode() == Caffe::CPU) {
+      NetParameter nhwc_param;
+      InsertLayoutConversions(filtered_param, &nhwc_param);
+      filtered_param.Swap(&nhwc_param);
+    } else {
+      LOG(WARNING) << "data_format NHWC only applies to TEST nets without "
+          << "force_backward in CPU mode; ignored.";
+    }
+  } else if (filtered_param.data_format() != "NCHW") {
+    LOG(FATAL) << "Unknown data_format " << filtered_param.data_format();
+  }
+  //CUSTOMIZATION-->
   // Create a copy of filtered_param with splits added where necessary.
   NetParameter param;
   InsertSplits(filtered_param, &param);
@@ -262,7 +296,17 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  SetUpFoldedLayers(folded); //CUSTOMIZATION
   debug_info_ = param.debug_info();
+  profiling_ = false;
+  if (param.share_blob_memory()) {
+    if (phase_ == TEST && !param.force_backward()) {
+      PlanBlobMemory(param);
+    } else {
+      LOG(WARNING) << "share_blob_memory only applies to TEST nets without "
+          << "force_backward; ignored.";
+    }
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
@@ -544,7 +588,10 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
+    if (profiling_) { profiler_->Start(); }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    if (profiling_) { ProfileForward(i); }
+    if (!memory_plan_groups_.empty()) { CheckBlobMemoryAliases(i); }
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
     for (int c = 0; c < after_forward_.size(); ++c) {
@@ -590,13 +637,17 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  CHECK(memory_plan_groups_.empty())
+      << "Nets with share_blob_memory can only run Forward.";
   for (int i = start; i >= end; --i) {
     for (int c = 0; c < before_backward_.size(); ++c) {
       before_backward_[c]->run(i);
     }
     if (layer_need_backward_[i]) {
+      if (profiling_) { profiler_->Start(); }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      if (profiling_) { profiler_->Stop(i, Profiler::BACKWARD); }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
     for (int c = 0; c < after_backward_.size(); ++c) {
@@ -605,6 +656,271 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::PlanBlobMemory(const NetParameter& param) {
+  vector<bool> keep(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    keep[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    keep[net_output_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < param.keep_blob_size(); ++i) {
+    CHECK(has_blob(param.keep_blob(i))) << "Unknown keep_blob "
+        << param.keep_blob(i);
+    keep[blob_names_index_[param.keep_blob(i)]] = true;
+  }
+  // Data layers may point their tops at the memory of their prefetch batches.
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (bottom_vecs_[i].empty()) {
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        keep[top_id_vecs_[i][j]] = true;
+      }
+    }
+  }
+  // Group the blobs by the SyncedMemory they share after setup.
+  map<const SyncedMemory*, int> group_of_memory;
+  vector<int> group_of_blob(blobs_.size(), -1);
+  vector<vector<int> > groups;
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (blobs_[i]->count() == 0) {
+      continue;
+    }
+    const SyncedMemory* memory = blobs_[i]->data().get();
+    if (!group_of_memory.count(memory)) {
+      group_of_memory[memory] = groups.size();
+      groups.push_back(vector<int>());
+    }
+    group_of_blob[i] = group_of_memory[memory];
+    groups[group_of_blob[i]].push_back(i);
+  }
+  vector<pair<int, int> > lifetimes(groups.size(),
+      std::make_pair(static_cast<int>(layers_.size()), -1));
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int k = 0; k < 2; ++k) {
+      const vector<int>& ids = k ? top_id_vecs_[i] : bottom_id_vecs_[i];
+      for (int j = 0; j < ids.size(); ++j) {
+        if (group_of_blob[ids[j]] >= 0) {
+          pair<int, int>& lifetime = lifetimes[group_of_blob[ids[j]]];
+          lifetime.first = std::min(lifetime.first, i);
+          lifetime.second = std::max(lifetime.second, i);
+        }
+      }
+    }
+  }
+  for (int g = 0; g < groups.size(); ++g) {
+    const vector<int>& group = groups[g];
+    const shared_ptr<SyncedMemory>& memory = blobs_[group[0]]->data();
+    // A layer holding the memory as well (e.g. in an internal blob), or data
+    // written during setup, has to stay where it is.
+    bool plan = memory.use_count() == group.size() &&
+        memory->head() == SyncedMemory::UNINITIALIZED;
+    for (int j = 0; j < group.size(); ++j) {
+      plan = plan && !keep[group[j]];
+    }
+    if (plan) {
+      memory_plan_groups_.push_back(group);
+      memory_plan_lifetimes_.push_back(lifetimes[g]);
+    }
+  }
+  memory_plan_group_of_blob_.assign(blobs_.size(), -1);
+  for (int g = 0; g < memory_plan_groups_.size(); ++g) {
+    for (int j = 0; j < memory_plan_groups_[g].size(); ++j) {
+      memory_plan_group_of_blob_[memory_plan_groups_[g][j]] = g;
+    }
+  }
+  AssignBlobMemory();
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckBlobMemoryAliases(const int layer_id) {
+  const vector<int>& top_ids = top_id_vecs_[layer_id];
+  const vector<int>& bottom_ids = bottom_id_vecs_[layer_id];
+  for (int t = 0; t < top_ids.size(); ++t) {
+    const int top_group = memory_plan_group_of_blob_[top_ids[t]];
+    for (int b = 0; b < bottom_ids.size(); ++b) {
+      const int bottom_group = memory_plan_group_of_blob_[bottom_ids[b]];
+      if (top_group == bottom_group || blobs_[top_ids[t]]->count() == 0 ||
+          blobs_[top_ids[t]]->data() != blobs_[bottom_ids[b]]->data()) {
+        continue;
+      }
+      LOG(FATAL) << "Layer " << layer_names_[layer_id] << " points "
+          << blob_names_[top_ids[t]] << " at the memory of "
+          << blob_names_[bottom_ids[b]] << " in Forward, which "
+          << "share_blob_memory planned apart; the layer must already do so "
+          << "in Reshape.";
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::AssignBlobMemory() {
+  // Visit the groups by the layer they start at, giving each the smallest
+  // free buffer that holds it, else growing the largest free one.
+  vector<pair<int, int> > order(memory_plan_groups_.size());
+  for (int g = 0; g < order.size(); ++g) {
+    order[g] = std::make_pair(memory_plan_lifetimes_[g].first, g);
+  }
+  std::sort(order.begin(), order.end());
+  vector<size_t> buffer_bytes;
+  vector<int> buffer_end;
+  vector<int> buffer_of_group(order.size());
+  size_t unshared_bytes = 0;
+  for (int k = 0; k < order.size(); ++k) {
+    const int g = order[k].second;
+    const vector<int>& group = memory_plan_groups_[g];
+    size_t bytes = 0;
+    for (int j = 0; j < group.size(); ++j) {
+      bytes = std::max(bytes, blobs_[group[j]]->count() * sizeof(Dtype));
+    }
+    unshared_bytes += bytes;
+    int best = -1;
+    int largest = -1;
+    for (int b = 0; b < buffer_bytes.size(); ++b) {
+      if (buffer_end[b] >= memory_plan_lifetimes_[g].first) {
+        continue;
+      }
+      if (buffer_bytes[b] >= bytes) {
+        if (best < 0 || buffer_bytes[b] < buffer_bytes[best]) {
+          best = b;
+        }
+      } else if (largest < 0 || buffer_bytes[b] > buffer_bytes[largest]) {
+        largest = b;
+      }
+    }
+    if (best < 0) {
+      best = largest;
+    }
+    if (best < 0) {
+      best = buffer_bytes.size();
+      buffer_bytes.push_back(0);
+      buffer_end.push_back(-1);
+    }
+    buffer_bytes[best] = std::max(buffer_bytes[best], bytes);
+    buffer_end[best] = memory_plan_lifetimes_[g].second;
+    buffer_of_group[g] = best;
+  }
+  // Keep the buffers that are still large enough.
+  memory_plan_arena_.resize(buffer_bytes.size());
+  size_t shared_bytes = 0;
+  for (int b = 0; b < buffer_bytes.size(); ++b) {
+    if (!memory_plan_arena_[b] ||
+        memory_plan_arena_[b]->size() < buffer_bytes[b]) {
+      memory_plan_arena_[b].reset(new SyncedMemory(buffer_bytes[b]));
+    }
+    shared_bytes += memory_plan_arena_[b]->size();
+  }
+  for (int g = 0; g < memory_plan_groups_.size(); ++g) {
+    const vector<int>& group = memory_plan_groups_[g];
+    for (int j = 0; j < group.size(); ++j) {
+      blobs_[group[j]]->set_data_memory(
+          memory_plan_arena_[buffer_of_group[g]]);
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Shared the memory of "
+      << memory_plan_groups_.size() << " blobs in " << buffer_bytes.size()
+      << " buffers: " << shared_bytes << " instead of " << unshared_bytes
+      << " bytes.";
+}
+
+template <typename Dtype>
+void Net<Dtype>::SetUpFoldedLayers(
+    const vector<vector<LayerParameter> >& folded) {
+  for (int i = 0; i < folded.size(); ++i) {
+    const int host_id = layer_names_index_[folded[i][0].name()];
+    // The folded layers are set up on blobs of their own, which are never
+    // allocated and dropped afterwards, as the layers never run. The first
+    // is shaped as the host bottom before any NHWC conversion.
+    vector<int> shape = bottom_vecs_[host_id][0]->shape();
+    if (layers_[host_id]->layer_param().data_format() == "NHWC") {
+      const int nchw_shape[] = {shape[0], shape[3], shape[1], shape[2]};
+      shape.assign(nchw_shape, nchw_shape + 4);
+    }
+    vector<shared_ptr<Blob<Dtype> > > blobs(1,
+        shared_ptr<Blob<Dtype> >(new Blob<Dtype>(shape)));
+    vector<shared_ptr<Layer<Dtype> > > layers;
+    for (int j = 0; j < folded[i].size(); ++j) {
+      LayerParameter layer_param(folded[i][j]);
+      if (!layer_param.has_phase()) {
+        layer_param.set_phase(phase_);
+      }
+      layers.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
+      blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      layers[j]->SetUp(vector<Blob<Dtype>*>(1, blobs[j].get()),
+          vector<Blob<Dtype>*>(1, blobs[j + 1].get()));
+      folded_layer_names_index_[layer_param.name()] = layers[j].get();
+    }
+    folded_layers_.push_back(layers);
+    folded_host_ids_.push_back(host_id);
+  }
+  FoldLayers();
+}
+
+template <typename Dtype>
+Layer<Dtype>* Net<Dtype>::TrainedLayer(const string& layer_name,
+    const int layer_id) {
+  typename map<string, Layer<Dtype>*>::const_iterator it =
+      folded_layer_names_index_.find(layer_name);
+  if (it != folded_layer_names_index_.end()) {
+    return it->second;
+  }
+  return (layer_id >= 0 && layer_id < layers_.size()) ?
+      layers_[layer_id].get() : NULL;
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldLayers() {
+  for (int i = 0; i < folded_layers_.size(); ++i) {
+    FoldAffineLayers(folded_layers_[i], layers_[folded_host_ids_[i]].get());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::EnableProfiler(const bool enable) {
+  if (enable && !profiler_) {
+    vector<string> layer_types(layers_.size());
+    for (int i = 0; i < layers_.size(); ++i) {
+      layer_types[i] = layers_[i]->type();
+    }
+    profiler_.reset(new Profiler(layer_names_, layer_types));
+    for (int i = 0; i < layers_.size(); ++i) {
+      vector<string> bottom_names(bottom_id_vecs_[i].size());
+      for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+        bottom_names[j] = blob_names_[bottom_id_vecs_[i][j]];
+      }
+      vector<string> top_names(top_id_vecs_[i].size());
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        top_names[j] = blob_names_[top_id_vecs_[i][j]];
+      }
+      profiler_->SetBlobNames(i, bottom_names, top_names);
+    }
+  }
+  profiling_ = enable;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ProfileForward(const int layer_id) {
+  profiler_->Stop(layer_id, Profiler::FORWARD);
+  const BasePrefetchingDataLayer<Dtype>* data_layer =
+      dynamic_cast<const BasePrefetchingDataLayer<Dtype>*>(
+          layers_[layer_id].get());
+  if (data_layer) {
+    profiler_->Record(layer_id, Profiler::DATA_WAIT,
+        data_layer->data_wait_us());
+  }
+  const vector<Blob<Dtype>*>& bottom = bottom_vecs_[layer_id];
+  vector<int64_t> bottom_bytes(bottom.size());
+  for (int j = 0; j < bottom.size(); ++j) {
+    bottom_bytes[j] = static_cast<int64_t>(bottom[j]->count()) * sizeof(Dtype);
+  }
+  const vector<Blob<Dtype>*>& top = top_vecs_[layer_id];
+  vector<int64_t> top_bytes(top.size());
+  for (int j = 0; j < top.size(); ++j) {
+    top_bytes[j] = static_cast<int64_t>(top[j]->count()) * sizeof(Dtype);
+  }
+  profiler_->SetBlobBytes(layer_id, bottom_bytes, top_bytes);
+}
+
 template <typename Dtype>
 void Net<Dtype>::ForwardDebugInfo(const int layer_id) {
   for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -684,8 +1000,30 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
   }
 }
 
+// Points the blobs of target at those of source, named layer_name.
+template <typename Dtype>
+static void ShareLayerBlobs(const string& layer_name, Layer<Dtype>* source,
+    Layer<Dtype>* target) {
+  vector<shared_ptr<Blob<Dtype> > >& target_blobs = target->blobs();
+  CHECK_EQ(target_blobs.size(), source->blobs().size())
+      << "Incompatible number of blobs for layer " << layer_name;
+  for (int j = 0; j < target_blobs.size(); ++j) {
+    Blob<Dtype>* source_blob = source->blobs()[j].get();
+    CHECK(target_blobs[j]->shape() == source_blob->shape())
+        << "Cannot share param " << j << " weights from layer '"
+        << layer_name << "'; shape mismatch.  Source param shape is "
+        << source_blob->shape_string() << "; target param shape is "
+        << target_blobs[j]->shape_string();
+    target_blobs[j]->ShareData(*source_blob);
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
+  // CUSTOMIZATION: the layers other folds others into already hold folded
+  // weights, which are shared as they are, with the weights of the folded
+  // layers; only the layers folded here alone are refolded.
+  vector<bool> refold(folded_layers_.size(), true);
   int num_source_layers = other->layers().size();
   for (int i = 0; i < num_source_layers; ++i) {
     Layer<Dtype>* source_layer = other->layers()[i].get();
@@ -695,23 +1033,46 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
         layer_names_[target_layer_id] != source_layer_name) {
       ++target_layer_id;
     }
-    if (target_layer_id == layer_names_.size()) {
+    const int source_folded = std::find(other->folded_host_ids_.begin(),
+        other->folded_host_ids_.end(), i) - other->folded_host_ids_.begin();
+    if (source_folded < other->folded_host_ids_.size()) {
+      const int target_folded = std::find(folded_host_ids_.begin(),
+          folded_host_ids_.end(), target_layer_id) - folded_host_ids_.begin();
+      CHECK_LT(target_folded, folded_host_ids_.size())
+          << "Cannot share the folded weights of layer " << source_layer_name
+          << " with a net that does not fold the same layers into it";
+      DLOG(INFO) << "Sharing folded source layer " << source_layer_name;
+      ShareLayerBlobs(source_layer_name, source_layer,
+          layers_[target_layer_id].get());
+      const vector<shared_ptr<Layer<Dtype> > >& source_layers =
+          other->folded_layers_[source_folded];
+      for (int j = 0; j < source_layers.size(); ++j) {
+        const string& name = source_layers[j]->layer_param().name();
+        typename map<string, Layer<Dtype>*>::const_iterator it =
+            folded_layer_names_index_.find(name);
+        CHECK(it != folded_layer_names_index_.end())
+            << "Cannot share the weights of folded layer " << name
+            << " with a net that does not fold it";
+        ShareLayerBlobs(name, source_layers[j].get(), it->second);
+      }
+      refold[target_folded] = false;
+      continue;
+    }
+    Layer<Dtype>* target_layer = TrainedLayer(source_layer_name,
+        target_layer_id); //CUSTOMIZATION
+    if (!target_layer) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
     DLOG(INFO) << "Copying source layer " << source_layer_name;
-    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
-        layers_[target_layer_id]->blobs();
-    CHECK_EQ(target_blobs.size(), source_layer->blobs().size())
-        << "Incompatible number of blobs for layer " << source_layer_name;
-    for (int j = 0; j < target_blobs.size(); ++j) {
-      Blob<Dtype>* source_blob = source_layer->blobs()[j].get();
-      CHECK(target_blobs[j]->shape() == source_blob->shape())
-          << "Cannot share param " << j << " weights from layer '"
-          << source_layer_name << "'; shape mismatch.  Source param shape is "
-          << source_blob->shape_string() << "; target param shape is "
-          << target_blobs[j]->shape_string();
-      target_blobs[j]->ShareData(*source_blob);
+    ShareLayerBlobs(source_layer_name, source_layer, target_layer);
+  }
+  // The shared blobs may point into the mappings of other.
+  mapped_weights_.insert(mapped_weights_.end(),
+      other->mapped_weights_.begin(), other->mapped_weights_.end());
+  for (int i = 0; i < folded_layers_.size(); ++i) {
+    if (refold[i]) {
+      FoldAffineLayers(folded_layers_[i], layers_[folded_host_ids_[i]].get());
     }
   }
 }
@@ -748,7 +1109,12 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
+    if (profiling_) { profiler_->Start(); }
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    if (profiling_) { profiler_->Stop(i, Profiler::RESHAPE); }
+  }
+  if (!memory_plan_groups_.empty()) {
+    AssignBlobMemory();
   }
 }
 
@@ -763,14 +1129,15 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
         layer_names_[target_layer_id] != source_layer_name) {
       ++target_layer_id;
     }
-    if (target_layer_id == layer_names_.size()) {
+    Layer<Dtype>* target_layer = TrainedLayer(source_layer_name,
+        target_layer_id); //CUSTOMIZATION
+    if (!target_layer) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
     DLOG(INFO) << "Copying source layer " << source_layer_name;
-    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
-        layers_[target_layer_id]->blobs();
-    if( layers_[target_layer_id]->DoesUseCustomCopyBlobs() ) {
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs = target_layer->blobs();
+    if( target_layer->DoesUseCustomCopyBlobs() ) {
         vector<Blob<float>* > blobs;
         for(int i=0; i<source_layer.blobs().size(); i++)
         {
@@ -778,16 +1145,16 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
             blob->FromProto(source_layer.blobs(i));
             blobs.push_back(blob);
         }
-        layers_[target_layer_id]->CustomCopyBlobs(blobs);
+        target_layer->CustomCopyBlobs(blobs);
 
         for(int i=0; i<blobs.size(); i++)
             delete blobs[i];
     } else {
     /**************** MulticoreWare_Modified - Feature: Pruning / Splicing ****************/
     // Copy weight mask and bias mask from source to dest
-    if (strcmp(layers_[target_layer_id]->type(),"SqueezeInnerProduct")==0 ||
-        strcmp(layers_[target_layer_id]->type(),"SqueezeConvolution" )==0 ||
-        strcmp(layers_[target_layer_id]->type(),"SqueezeDeconvolution" ) == 0 ) {
+    if (strcmp(target_layer->type(),"SqueezeInnerProduct")==0 ||
+        strcmp(target_layer->type(),"SqueezeConvolution" )==0 ||
+        strcmp(target_layer->type(),"SqueezeDeconvolution" ) == 0 ) {
       if(target_blobs.size() > source_layer.blobs_size()) {
         for (int j = 0; j < source_layer.blobs_size(); ++j) {
           const bool kReshape = false;
@@ -816,11 +1183,14 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
     }
     }
   }
+  FoldLayers(); //CUSTOMIZATION
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string& trained_filename) {
-  if (H5Fis_hdf5(trained_filename.c_str())) {
+  if (MappedWeights::IsMappedWeights(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename); //CUSTOMIZATION
+  } else if (H5Fis_hdf5(trained_filename.c_str())) {
     CopyTrainedLayersFromHDF5(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
@@ -835,9 +1205,73 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
   CopyTrainedLayersFrom(param);
 }
 
+//<--CUSTOMIZATION
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string& trained_filename) {
+  shared_ptr<MappedWeights> weights(new MappedWeights(trained_filename));
+  const MappedWeightsIndex& index = weights->index();
+  for (int i = 0; i < index.layers_size(); ++i) {
+    const MappedWeightsIndex::Layer& source_layer = index.layers(i);
+    const string& source_layer_name = source_layer.name();
+    int target_layer_id = 0;
+    while (target_layer_id != layer_names_.size() &&
+        layer_names_[target_layer_id] != source_layer_name) {
+      ++target_layer_id;
+    }
+    Layer<Dtype>* target_layer = TrainedLayer(source_layer_name,
+        target_layer_id);
+    if (!target_layer) {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    DLOG(INFO) << "Copying source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs = target_layer->blobs();
+    if (target_layer->DoesUseCustomCopyBlobs()) {
+      vector<Blob<float>* > blobs;
+      for (int j = 0; j < source_layer.blobs_size(); ++j) {
+        Blob<float>* blob =
+            new Blob<float>(MappedBlobShape(source_layer.blobs(j)));
+        weights->Load(source_layer.blobs(j), blob);
+        blobs.push_back(blob);
+      }
+      target_layer->CustomCopyBlobs(blobs);
+      for (int j = 0; j < blobs.size(); ++j) {
+        delete blobs[j];
+      }
+      continue;
+    }
+    // Squeeze layers may have masks beyond the blobs they were trained with.
+    const bool partial =
+        (strcmp(target_layer->type(), "SqueezeInnerProduct") == 0 ||
+        strcmp(target_layer->type(), "SqueezeConvolution") == 0 ||
+        strcmp(target_layer->type(), "SqueezeDeconvolution") == 0) &&
+        target_blobs.size() > source_layer.blobs_size();
+    if (!partial) {
+      CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+          << "Incompatible number of blobs for layer " << source_layer_name;
+    }
+    for (int j = 0; j < source_layer.blobs_size(); ++j) {
+      const MappedWeightsIndex::Blob& source_blob = source_layer.blobs(j);
+      if (!MappedWeights::ShapeEquals(source_blob, *target_blobs[j])) {
+        LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
+            << source_layer_name << "'; shape mismatch.  Source param shape is "
+            << Blob<Dtype>(MappedBlobShape(source_blob)).shape_string()
+            << "; target param shape is " << target_blobs[j]->shape_string()
+            << ". To learn this layer's parameters from scratch rather than "
+            << "copying from a saved net, rename the layer.";
+      }
+      weights->Load(source_blob, target_blobs[j].get());
+    }
+  }
+  mapped_weights_.push_back(weights);
+  FoldLayers();
+}
+//CUSTOMIZATION-->
+
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
 #ifdef USE_HDF5
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex()); //CUSTOMIZATION
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -846,14 +1280,17 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
   int num_layers = hdf5_get_num_links(data_hid);
   for (int i = 0; i < num_layers; ++i) {
     string source_layer_name = hdf5_get_name_by_idx(data_hid, i);
-    if (!layer_names_index_.count(source_layer_name)) {
+    //<--CUSTOMIZATION
+    const bool folded = folded_layer_names_index_.count(source_layer_name);
+    if (!folded && !layer_names_index_.count(source_layer_name)) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
-    int target_layer_id = layer_names_index_[source_layer_name];
+    int target_layer_id = folded ? -1 : layer_names_index_[source_layer_name];
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
-        layers_[target_layer_id]->blobs();
+        TrainedLayer(source_layer_name, target_layer_id)->blobs();
+    //CUSTOMIZATION-->
     hid_t layer_hid = H5Gopen2(data_hid, source_layer_name.c_str(),
         H5P_DEFAULT);
     CHECK_GE(layer_hid, 0)
@@ -866,10 +1303,10 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
       ostringstream oss;
       oss << j;
       string dataset_name = oss.str();
-      int target_net_param_id = param_id_vecs_[target_layer_id][j];
       if (!H5Lexists(layer_hid, dataset_name.c_str(), H5P_DEFAULT)) {
         // Target param doesn't exist in source weights...
-        if (param_owners_[target_net_param_id] != -1) {
+        if (!folded &&
+            param_owners_[param_id_vecs_[target_layer_id][j]] != -1) {
           // ...but it's weight-shared in target, so that's fine.
           continue;
         } else {
@@ -884,6 +1321,7 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string& trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  FoldLayers(); //CUSTOMIZATION
 #else
   LOG(FATAL) << "CopyTrainedLayersFromHDF5 requires hdf5;"
              << " compile with USE_HDF5.";
@@ -906,6 +1344,7 @@ template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 // This code is taken from https://github.com/sh1r0/caffe-android-lib
 #ifdef USE_HDF5
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex()); //CUSTOMIZATION
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -970,14 +1409,19 @@ void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     /**************** MulticoreWare_Modified - Feature: Pruning / Splicing ****************/
     // Condition to update weights and biases
-    if (std::find(mask_param_ids_.begin(), mask_param_ids_.end(),
-          learnable_param_ids_[i]) != mask_param_ids_.end())
+    if (update_masked(i))
       continue;
     /************************************************************************************/
     learnable_params_[i]->Update();
   }
 }
 
+template <typename Dtype>
+bool Net<Dtype>::update_masked(int learnable_param_id) const {
+  return std::find(mask_param_ids_.begin(), mask_param_ids_.end(),
+      learnable_param_ids_[learnable_param_id]) != mask_param_ids_.end();
+}
+
 template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
@@ -106,6 +106,28 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaDeltaSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+    int end) {
+  const Dtype delta = this->param_.delta();
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  Dtype* diff = arrays.diff;
+  Dtype* history = arrays.history[0];
+  Dtype* update_history = arrays.history[1];
+  for (int i = begin; i < end; ++i) {
+    // history of gradients, then the RMS of both histories for the update
+    history[i] = (Dtype(1) - momentum) * diff[i] * diff[i] +
+        momentum * history[i];
+    const Dtype update = diff[i] *
+        std::sqrt((update_history[i] + delta) / (history[i] + delta));
+    update_history[i] = (Dtype(1) - momentum) * update * update +
+        momentum * update_history[i];
+    diff[i] = local_rate * update;
+  }
+}
+
 INSTANTIATE_CLASS(AdaDeltaSolver);
 REGISTER_SOLVER_CLASS(AdaDelta);
 
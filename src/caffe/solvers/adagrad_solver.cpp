@@ -63,6 +63,20 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdaGradSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+    int end) {
+  const Dtype delta = this->param_.delta();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  Dtype* diff = arrays.diff;
+  Dtype* history = arrays.history[0];
+  for (int i = begin; i < end; ++i) {
+    history[i] += diff[i] * diff[i];
+    diff[i] = local_rate * diff[i] / (std::sqrt(history[i]) + delta);
+  }
+}
+
 INSTANTIATE_CLASS(AdaGradSolver);
 REGISTER_SOLVER_CLASS(AdaGrad);
 
@@ -88,6 +88,28 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void AdamSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+    int end) {
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const Dtype eps_hat = this->param_.delta();
+  const int t = this->iter_ + 1;
+  const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
+      (Dtype(1.) - pow(beta1, t));
+  const Dtype local_rate =
+      rate * this->net_->params_lr()[param_id] * correction;
+  Dtype* diff = arrays.diff;
+  Dtype* val_m = arrays.history[0];
+  Dtype* val_v = arrays.history[1];
+  for (int i = begin; i < end; ++i) {
+    val_m[i] = (Dtype(1) - beta1) * diff[i] + beta1 * val_m[i];
+    val_v[i] = (Dtype(1) - beta2) * diff[i] * diff[i] + beta2 * val_v[i];
+    diff[i] = local_rate * val_m[i] / (std::sqrt(val_v[i]) + eps_hat);
+  }
+}
+
 INSTANTIATE_CLASS(AdamSolver);
 REGISTER_SOLVER_CLASS(Adam);
 
@@ -55,6 +55,22 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void NesterovSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+    int end) {
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  Dtype* diff = arrays.diff;
+  Dtype* history = arrays.history[0];
+  for (int i = begin; i < end; ++i) {
+    // step back then over step
+    const Dtype history_prev = history[i];
+    history[i] = local_rate * diff[i] + momentum * history[i];
+    diff[i] = (Dtype(1) + momentum) * history[i] - momentum * history_prev;
+  }
+}
+
 INSTANTIATE_CLASS(NesterovSolver);
 REGISTER_SOLVER_CLASS(Nesterov);
 
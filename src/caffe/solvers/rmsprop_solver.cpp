@@ -64,6 +64,22 @@ void RMSPropSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+void RMSPropSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const typename SGDSolver<Dtype>::UpdateArrays& arrays, int begin,
+    int end) {
+  const Dtype delta = this->param_.delta();
+  const Dtype rms_decay = this->param_.rms_decay();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  Dtype* diff = arrays.diff;
+  Dtype* history = arrays.history[0];
+  for (int i = begin; i < end; ++i) {
+    history[i] = (Dtype(1) - rms_decay) * diff[i] * diff[i] +
+        rms_decay * history[i];
+    diff[i] = local_rate * diff[i] / (std::sqrt(history[i]) + delta);
+  }
+}
+
 INSTANTIATE_CLASS(RMSPropSolver);
 REGISTER_SOLVER_CLASS(RMSProp);
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <limits>
 #include <string>
 #include <vector>
@@ -5,6 +6,7 @@
 #include "caffe/sgd_solvers.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
@@ -145,19 +147,115 @@ void SGDSolver<Dtype>::ApplyUpdate() {
         << ", lr = " << rate;
   }
   ClipGradients();
-  for (int param_id = 0; param_id < this->net_->learnable_params().size();
-       ++param_id) {
-    Normalize(param_id);
-    Regularize(param_id);
-    ComputeUpdateValue(param_id, rate);
+  if (this->param_.fused_update() && Caffe::mode() == Caffe::CPU) {
+    FusedApplyUpdate(rate);
+  } else {
+    for (int param_id = 0; param_id < this->net_->learnable_params().size();
+         ++param_id) {
+      Normalize(param_id);
+      Regularize(param_id);
+      ComputeUpdateValue(param_id, rate);
+    }
+    this->net_->Update();
   }
-  this->net_->Update();
 
   // Increment the internal iter_ counter -- its value should always indicate
   // the number of times the weights have been updated.
   ++this->iter_;
 }
 
+// The items of a block of FusedApplyUpdate: with the four arrays of Adam in
+// double, 256KB, about the size of an L2 cache.
+static const int kUpdateBlockSize = 8192;
+
+template <typename Dtype>
+void SGDSolver<Dtype>::FusedApplyUpdate(Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  vector<UpdateArrays> arrays(net_params.size());
+  vector<int> block_params, block_begins;
+  for (int param_id = 0; param_id < net_params.size(); ++param_id) {
+    // Move the blobs to the CPU here rather than from the threads.
+    UpdateArrays& param_arrays = arrays[param_id];
+    if (this->net_->update_masked(param_id)) {
+      param_arrays.mutable_data = NULL;
+      param_arrays.data = net_params[param_id]->cpu_data();
+    } else {
+      param_arrays.mutable_data = net_params[param_id]->mutable_cpu_data();
+      param_arrays.data = param_arrays.mutable_data;
+    }
+    param_arrays.diff = net_params[param_id]->mutable_cpu_diff();
+    for (int i = param_id; i < history_.size(); i += net_params.size()) {
+      param_arrays.history.push_back(history_[i]->mutable_cpu_data());
+    }
+    for (int begin = 0; begin < net_params[param_id]->count();
+         begin += kUpdateBlockSize) {
+      block_params.push_back(param_id);
+      block_begins.push_back(begin);
+    }
+  }
+  const int num_blocks = block_params.size();
+  const int num_threads = std::min(num_blocks, this->param_.update_threads() ?
+      static_cast<int>(this->param_.update_threads()) : Caffe::num_threads());
+  auto run = [&](int t, int /*worker*/) {
+    for (int b = t; b < num_blocks; b += num_threads) {
+      const int param_id = block_params[b];
+      const UpdateArrays& param_arrays = arrays[param_id];
+      const int begin = block_begins[b];
+      const int end = std::min(begin + kUpdateBlockSize,
+          net_params[param_id]->count());
+      RegularizeBlock(param_id, param_arrays, begin, end);
+      UpdateBlock(param_id, rate, param_arrays, begin, end);
+      if (param_arrays.mutable_data) {
+        caffe_axpy(end - begin, Dtype(-1), param_arrays.diff + begin,
+            param_arrays.mutable_data + begin);
+      }
+    }
+  };
+  if (num_threads <= 1) {
+    run(0, 0);
+  } else {
+    Caffe::thread_pool(num_threads).Run(num_threads, run);
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::RegularizeBlock(int param_id,
+    const UpdateArrays& arrays, int begin, int end) {
+  const Dtype* data = arrays.data;
+  Dtype* diff = arrays.diff;
+  if (this->param_.iter_size() != 1) {
+    caffe_scal(end - begin, Dtype(1.) / this->param_.iter_size(),
+        diff + begin);
+  }
+  const Dtype local_decay = this->param_.weight_decay() *
+      this->net_->params_weight_decay()[param_id];
+  if (local_decay) {
+    const string& regularization_type = this->param_.regularization_type();
+    if (regularization_type == "L2") {
+      caffe_axpy(end - begin, local_decay, data + begin, diff + begin);
+    } else if (regularization_type == "L1") {
+      for (int i = begin; i < end; ++i) {
+        diff[i] += local_decay *
+            ((Dtype(0) < data[i]) - (data[i] < Dtype(0)));
+      }
+    } else {
+      LOG(FATAL) << "Unknown regularization type: " << regularization_type;
+    }
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::UpdateBlock(int param_id, Dtype rate,
+    const UpdateArrays& arrays, int begin, int end) {
+  const Dtype momentum = this->param_.momentum();
+  const Dtype local_rate = rate * this->net_->params_lr()[param_id];
+  Dtype* diff = arrays.diff;
+  Dtype* history = arrays.history[0];
+  for (int i = begin; i < end; ++i) {
+    diff[i] = history[i] = local_rate * diff[i] + momentum * history[i];
+  }
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::Normalize(int param_id) {
   if (this->param_.iter_size() == 1) { return; }
@@ -328,6 +426,7 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
   string snapshot_filename =
       Solver<Dtype>::SnapshotFilename(".solverstate.h5");
   LOG(INFO) << "Snapshotting solver state to HDF5 file " << snapshot_filename;
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid = H5Fcreate(snapshot_filename.c_str(), H5F_ACC_TRUNC,
       H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -380,6 +479,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
 #ifdef USE_HDF5
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid = H5Fopen(state_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open solver state file " << state_file;
   this->iter_ = hdf5_load_int(file_hid, "iter");
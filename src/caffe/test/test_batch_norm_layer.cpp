@@ -8,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#include "caffe/util/permute.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -130,4 +131,64 @@ namespace caffe {
         this->blob_top_vec_);
   }
 
+  template <typename Dtype>
+  class NHWCBatchNormLayerTest : public CPUDeviceTest<Dtype> {
+   protected:
+    NHWCBatchNormLayerTest()
+        : blob_bottom_(new Blob<Dtype>(5, 2, 3, 4)),
+          blob_top_(new Blob<Dtype>()) {
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(this->blob_bottom_);
+      blob_bottom_vec_.push_back(blob_bottom_);
+      blob_top_vec_.push_back(blob_top_);
+    }
+    virtual ~NHWCBatchNormLayerTest() { delete blob_bottom_; delete blob_top_; }
+    Blob<Dtype>* const blob_bottom_;
+    Blob<Dtype>* const blob_top_;
+    vector<Blob<Dtype>*> blob_bottom_vec_;
+    vector<Blob<Dtype>*> blob_top_vec_;
+  };
+
+  TYPED_TEST_CASE(NHWCBatchNormLayerTest, TestDtypes);
+
+  TYPED_TEST(NHWCBatchNormLayerTest, TestForwardGlobalStats) {
+    typedef TypeParam Dtype;
+    LayerParameter layer_param;
+    layer_param.mutable_batch_norm_param()->set_use_global_stats(true);
+    BatchNormLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    FillerParameter filler_param;
+    filler_param.set_min(0.5);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> filler(filler_param);
+    for (int i = 0; i < 3; ++i) {
+      filler.Fill(layer.blobs()[i].get());
+    }
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    const int to_nhwc[] = {0, 2, 3, 1};
+    const vector<int> order(to_nhwc, to_nhwc + 4);
+    Blob<Dtype> bottom_nhwc(5, 3, 4, 2);
+    caffe_cpu_permute(this->blob_bottom_->shape(), order,
+        this->blob_bottom_->cpu_data(), bottom_nhwc.mutable_cpu_data());
+    Blob<Dtype> expected(5, 3, 4, 2);
+    caffe_cpu_permute(this->blob_top_->shape(), order,
+        this->blob_top_->cpu_data(), expected.mutable_cpu_data());
+    layer_param.set_data_format("NHWC");
+    BatchNormLayer<Dtype> nhwc_layer(layer_param);
+    Blob<Dtype> top_nhwc;
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom_nhwc);
+    vector<Blob<Dtype>*> top_vec(1, &top_nhwc);
+    nhwc_layer.SetUp(bottom_vec, top_vec);
+    for (int i = 0; i < 3; ++i) {
+      nhwc_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+    }
+    nhwc_layer.Forward(bottom_vec, top_vec);
+    ASSERT_TRUE(top_nhwc.shape() == expected.shape());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], top_nhwc.cpu_data()[i]);
+    }
+  }
+
 }  // namespace caffe
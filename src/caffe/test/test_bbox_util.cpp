@@ -6,6 +6,8 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/bbox_util.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -90,6 +92,24 @@ class BBoxUtilTest : public MultiDeviceTest<TypeParam> {
 };
 
 class CPUBBoxUtilTest : public BBoxUtilTest<CPUDevice<float> > {
+ protected:
+  // Random boxes of mixed sizes, some of them invalid (xmax < xmin).
+  void FillRandomBBoxes(const int num, vector<NormalizedBBox>* bboxes) {
+    vector<float> data(num * 4);
+    caffe_rng_uniform<float>(data.size(), -0.1, 1.1, data.data());
+    bboxes->clear();
+    NormalizedBBox bbox;
+    for (int i = 0; i < num; ++i) {
+      const float* d = &data[i * 4];
+      bbox.set_xmin(d[0]);
+      bbox.set_ymin(d[1]);
+      bbox.set_xmax(i % 17 ? d[0] + 0.3 * d[2] : d[0] - 0.1);
+      bbox.set_ymax(d[1] + 0.3 * d[3]);
+      bbox.clear_size();
+      bbox.set_size(BBoxSize(bbox));
+      bboxes->push_back(bbox);
+    }
+  }
 };
 
 TEST_F(CPUBBoxUtilTest, TestIntersectBBox) {
@@ -574,6 +594,52 @@ TEST_F(CPUBBoxUtilTest, TestDecodeBBoxesCenterSize) {
   }
 }
 
+TEST_F(CPUBBoxUtilTest, TestDecodeBBoxesArray) {
+  const int num = 100;
+  vector<NormalizedBBox> prior_bboxes, bboxes;
+  FillRandomBBoxes(num, &prior_bboxes);
+  for (int i = 0; i < num; ++i) {
+    // The size-based code types require valid priors.
+    prior_bboxes[i].set_xmax(prior_bboxes[i].xmin() + 0.05 + 0.01 * (i % 7));
+    prior_bboxes[i].set_ymax(prior_bboxes[i].ymin() + 0.05 + 0.01 * (i % 5));
+  }
+  FillRandomBBoxes(num, &bboxes);
+  vector<vector<float> > prior_variances(num, vector<float>(4));
+  vector<float> flat_variances;
+  for (int i = 0; i < num; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      prior_variances[i][j] = 0.1 + 0.05 * j + 0.001 * i;
+      flat_variances.push_back(prior_variances[i][j]);
+    }
+  }
+  BBoxArray prior_array, bbox_array, decode_array;
+  ToBBoxArray(prior_bboxes, &prior_array);
+  ToBBoxArray(bboxes, &bbox_array);
+  const CodeType code_types[] = {PriorBoxParameter_CodeType_CORNER,
+      PriorBoxParameter_CodeType_CENTER_SIZE,
+      PriorBoxParameter_CodeType_CORNER_SIZE};
+  for (int t = 0; t < 3; ++t) {
+    for (int flags = 0; flags < 4; ++flags) {
+      const bool variance_encoded_in_target = flags & 1;
+      const bool clip = flags & 2;
+      vector<NormalizedBBox> decode_bboxes;
+      DecodeBBoxes(prior_bboxes, prior_variances, code_types[t],
+                   variance_encoded_in_target, clip, bboxes, &decode_bboxes);
+      DecodeBBoxes(prior_array, flat_variances, code_types[t],
+                   variance_encoded_in_target, clip, bbox_array,
+                   &decode_array);
+      ASSERT_EQ(decode_array.num(), num);
+      for (int i = 0; i < num; ++i) {
+        EXPECT_EQ(decode_bboxes[i].xmin(), decode_array.xmin[i]);
+        EXPECT_EQ(decode_bboxes[i].ymin(), decode_array.ymin[i]);
+        EXPECT_EQ(decode_bboxes[i].xmax(), decode_array.xmax[i]);
+        EXPECT_EQ(decode_bboxes[i].ymax(), decode_array.ymax[i]);
+        EXPECT_EQ(decode_bboxes[i].size(), decode_array.size[i]);
+      }
+    }
+  }
+}
+
 TEST_F(CPUBBoxUtilTest, TestMatchBBoxLableOneBipartite) {
   vector<NormalizedBBox> gt_bboxes;
   vector<NormalizedBBox> pred_bboxes;
@@ -1351,6 +1417,78 @@ TEST_F(CPUBBoxUtilTest, TestApplyNMS) {
   }
 }
 
+TEST_F(CPUBBoxUtilTest, TestApplyNMSRandom) {
+  const int num = 300;
+  vector<NormalizedBBox> bboxes;
+  FillRandomBBoxes(num, &bboxes);
+  vector<float> scores(num);
+  caffe_rng_uniform<float>(num, 0, 1, scores.data());
+  vector<pair<float, int> > score_index_vec;
+  for (int i = 0; i < num; ++i) {
+    score_index_vec.push_back(std::make_pair(scores[i], i));
+  }
+  std::stable_sort(score_index_vec.begin(), score_index_vec.end(),
+                   SortScorePairDescend<int>);
+  const int top_ks[] = {-1, 20};
+  for (int k = 0; k < 2; ++k) {
+    const int top_k = top_ks[k];
+    // Greedy reference: a box is picked unless it is small or overlaps a box
+    // picked before it by more than the threshold.
+    vector<int> expected;
+    for (int s = 0; s < num && (top_k < 0 || s < top_k); ++s) {
+      const int idx = score_index_vec[s].second;
+      bool keep = BBoxSize(bboxes[idx]) >= 1e-5;
+      for (int j = 0; keep && j < expected.size(); ++j) {
+        keep = JaccardOverlap(bboxes[expected[j]], bboxes[idx]) <= 0.3;
+      }
+      if (keep) {
+        expected.push_back(idx);
+      }
+    }
+    EXPECT_GT(expected.size(), 10);
+
+    vector<int> indices;
+    ApplyNMS(bboxes, scores, 0.3, top_k, &indices);
+    EXPECT_EQ(expected, indices);
+
+    map<int, map<int, float> > overlaps;
+    ApplyNMS(bboxes, scores, 0.3, top_k, true, &overlaps, &indices);
+    EXPECT_EQ(expected, indices);
+    for (map<int, map<int, float> >::iterator it = overlaps.begin();
+         it != overlaps.end(); ++it) {
+      for (map<int, float>::iterator jt = it->second.begin();
+           jt != it->second.end(); ++jt) {
+        EXPECT_EQ(JaccardOverlap(bboxes[it->first], bboxes[jt->first]),
+                  jt->second);
+      }
+    }
+    // The stored overlaps give the same result.
+    ApplyNMS(bboxes, scores, 0.3, top_k, true, &overlaps, &indices);
+    EXPECT_EQ(expected, indices);
+  }
+
+  vector<float> rand(num * num);
+  caffe_rng_uniform<float>(rand.size(), 0, 1, rand.data());
+  bool* overlapped = new bool[num * num];
+  for (int i = 0; i < num * num; ++i) {
+    overlapped[i] = rand[i] < 0.02;
+  }
+  vector<int> expected;
+  for (int i = 0; i < num; ++i) {
+    bool keep = true;
+    for (int j = 0; keep && j < expected.size(); ++j) {
+      keep = !overlapped[expected[j] * num + i];
+    }
+    if (keep) {
+      expected.push_back(i);
+    }
+  }
+  vector<int> indices;
+  ApplyNMS(overlapped, num, &indices);
+  EXPECT_EQ(expected, indices);
+  delete [] overlapped;
+}
+
 TEST_F(CPUBBoxUtilTest, TestApplyNMSFast) {
   vector<NormalizedBBox> bboxes;
   vector<float> scores;
@@ -1419,6 +1557,39 @@ TEST_F(CPUBBoxUtilTest, TestApplyNMSFast) {
   EXPECT_EQ(indices[0], 0);
 }
 
+TEST_F(CPUBBoxUtilTest, TestApplyNMSFastArray) {
+  const int num = 500;
+  vector<NormalizedBBox> bboxes;
+  FillRandomBBoxes(num, &bboxes);
+  vector<float> scores(num);
+  caffe_rng_uniform<float>(num, 0, 1, scores.data());
+  BBoxArray bbox_array;
+  ToBBoxArray(bboxes, &bbox_array);
+  for (int i = 0; i < num; i += 37) {
+    for (int j = 0; j < num; j += 11) {
+      EXPECT_EQ(JaccardOverlap(bboxes[i], bboxes[j]),
+                JaccardOverlap(bbox_array, i, j));
+    }
+  }
+  const float etas[] = {1., 0.9};
+  const int top_ks[] = {-1, 100};
+  const SimdLevel level = caffe_simd_level();
+  for (int l = SIMD_SCALAR; l <= level; ++l) {
+    caffe_set_simd_level(static_cast<SimdLevel>(l));
+    for (int e = 0; e < 2; ++e) {
+      for (int k = 0; k < 2; ++k) {
+        vector<int> indices, array_indices;
+        ApplyNMSFast(bboxes, scores, 0.1, 0.45, etas[e], top_ks[k], &indices);
+        ApplyNMSFast(bbox_array, scores, 0.1, 0.45, etas[e], top_ks[k],
+                     &array_indices);
+        EXPECT_GT(indices.size(), 1);
+        EXPECT_EQ(indices, array_indices);
+      }
+    }
+  }
+  caffe_set_simd_level(level);
+}
+
 TEST_F(CPUBBoxUtilTest, TestCumSum) {
   vector<pair<float, int> > pairs;
   vector<int> cumsum;
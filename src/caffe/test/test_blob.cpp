@@ -61,6 +61,17 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestZeroFillData) {
+  EXPECT_TRUE(this->blob_->zero_fill_data());
+  this->blob_->Reshape(2, 3, 4, 5);
+  this->blob_->set_zero_fill_data(false);
+  EXPECT_FALSE(this->blob_->data()->zero_fill());
+  // The setting carries over to the memory of a larger shape.
+  this->blob_->Reshape(4, 3, 4, 5);
+  EXPECT_FALSE(this->blob_->data()->zero_fill());
+  EXPECT_TRUE(this->blob_->diff()->zero_fill());
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
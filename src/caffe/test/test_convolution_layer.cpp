@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,8 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/permute.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -811,6 +815,380 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+template <typename Dtype>
+class QuantizedConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  QuantizedConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 7, 6)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~QuantizedConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  void FillIntegers(Blob<Dtype>* blob, const int lo, const int hi) {
+    Dtype* data = blob->mutable_cpu_data();
+    caffe_rng_uniform<Dtype>(blob->count(), Dtype(lo), Dtype(hi + 1), data);
+    for (int i = 0; i < blob->count(); ++i) {
+      data[i] = std::min(std::floor(data[i]), Dtype(hi));
+    }
+  }
+
+  // Runs the layer once on the float-emulated path and once on the integer
+  // engine with identical blobs and expects bit-identical tops.
+  void CheckIntegerEngine(LayerParameter layer_param, const int data_lo,
+      const int data_hi) {
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->set_integer_engine(false);
+    ConvolutionLayer<Dtype> float_layer(layer_param);
+    float_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    FillIntegers(blob_bottom_, data_lo, data_hi);
+    FillIntegers(float_layer.blobs()[0].get(), data_lo, data_hi);
+    if (convolution_param->bias_term()) {
+      FillIntegers(float_layer.blobs()[1].get(), -2000, 2000);
+    }
+    const int num_output = convolution_param->num_output();
+    const int scale_blob = 1 + convolution_param->bias_term();
+    if (convolution_param->per_channel_scale_weight()) {
+      Dtype* weight_scale =
+          float_layer.blobs()[scale_blob]->mutable_cpu_data();
+      for (int c = 0; c < num_output; ++c) {
+        weight_scale[c] = Dtype(0.002 + 0.001 * c);
+      }
+    }
+    if (convolution_param->per_channel_scale_output()) {
+      Dtype* output_scale =
+          float_layer.blobs()[scale_blob + 2]->mutable_cpu_data();
+      Dtype* output_zero_point =
+          float_layer.blobs()[scale_blob + 3]->mutable_cpu_data();
+      for (int c = 0; c < num_output; ++c) {
+        output_scale[c] = Dtype(0.05 + 0.01 * c);
+        output_zero_point[c] = Dtype(c - 2);
+      }
+    }
+    Blob<Dtype> bottom_copy;
+    bottom_copy.CopyFrom(*blob_bottom_, false, true);
+    float_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> float_top;
+    float_top.CopyFrom(*blob_top_, false, true);
+
+    convolution_param->set_integer_engine(true);
+    ConvolutionLayer<Dtype> integer_layer(layer_param);
+    integer_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < float_layer.blobs().size(); ++i) {
+      integer_layer.blobs()[i]->CopyFrom(*float_layer.blobs()[i]);
+    }
+    caffe_set(blob_top_->count(), Dtype(-12345), blob_top_->mutable_cpu_data());
+    integer_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_EQ(float_top.cpu_data()[i], blob_top_->cpu_data()[i]);
+    }
+    for (int i = 0; i < blob_bottom_->count(); ++i) {
+      EXPECT_EQ(bottom_copy.cpu_data()[i], blob_bottom_->cpu_data()[i]);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(QuantizedConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestIntegerEngineTFLiteUint8) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->set_input_scale(0.0235);
+  convolution_param->set_weight_scale(0.0041);
+  convolution_param->set_output_scale(0.0517);
+  convolution_param->set_input_zero_point(117);
+  convolution_param->set_weight_zero_point(131);
+  convolution_param->set_output_zero_point(121);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Unsigned_8bit);
+  this->CheckIntegerEngine(layer_param, 0, 255);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestIntegerEngineTFLitePerChannel) {
+  vector<int> bottom_shape(4, 1);
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 7;
+  bottom_shape[3] = 6;
+  this->blob_bottom_->Reshape(bottom_shape);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_pad_type(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_input_scale(0.031);
+  convolution_param->set_input_zero_point(-3);
+  convolution_param->set_per_channel_scale_weight(true);
+  convolution_param->set_per_channel_scale_output(true);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Signed_8bit);
+  this->CheckIntegerEngine(layer_param, -128, 127);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestIntegerEngineDepthwise) {
+  vector<int> bottom_shape(4, 1);
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 7;
+  bottom_shape[3] = 6;
+  this->blob_bottom_->Reshape(bottom_shape);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->set_group(4);
+  convolution_param->set_input_scale(0.02);
+  convolution_param->set_output_scale(0.04);
+  convolution_param->set_input_zero_point(5);
+  convolution_param->set_per_channel_scale_weight(true);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Signed_8bit);
+  this->CheckIntegerEngine(layer_param, -128, 127);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestIntegerEngineONNX) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->set_num_output(3);
+  convolution_param->set_input_scale(0.0235);
+  convolution_param->set_weight_scale(0.0041);
+  convolution_param->set_output_scale(0.0517);
+  convolution_param->set_input_zero_point(128);
+  convolution_param->set_weight_zero_point(120);
+  convolution_param->set_output_zero_point(100);
+  convolution_param->set_quantize_method(ConvolutionParameter_QuantizeMethod_ONNX);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Unsigned_8bit);
+  this->CheckIntegerEngine(layer_param, 0, 255);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestIntegerEngineCaffe2) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_bias_term(false);
+  convolution_param->set_num_output(4);
+  convolution_param->set_input_scale(0.0235);
+  convolution_param->set_weight_scale(0.0041);
+  convolution_param->set_output_scale(0.0517);
+  convolution_param->set_input_zero_point(3);
+  convolution_param->set_weight_zero_point(128);
+  convolution_param->set_quantize_method(ConvolutionParameter_QuantizeMethod_Caffe2);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Unsigned_8bit);
+  this->CheckIntegerEngine(layer_param, 0, 255);
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestZeroPointForwardReadOnly) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->set_input_scale(0.0235);
+  convolution_param->set_weight_scale(0.0041);
+  convolution_param->set_output_scale(0.0517);
+  convolution_param->set_input_zero_point(117);
+  convolution_param->set_weight_zero_point(131);
+  convolution_param->set_output_zero_point(121);
+  convolution_param->set_saturate(ConvolutionParameter_SaturateMethod_Unsigned_8bit);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->FillIntegers(this->blob_bottom_, 0, 255);
+  this->FillIntegers(layer.blobs()[0].get(), 0, 255);
+  this->FillIntegers(layer.blobs()[1].get(), -2000, 2000);
+  Blob<Dtype> bottom_copy, weight_copy;
+  bottom_copy.CopyFrom(*this->blob_bottom_, false, true);
+  weight_copy.CopyFrom(*layer.blobs()[0], false, true);
+  const uint64_t bottom_version = this->blob_bottom_->data_version();
+  const uint64_t weight_version = layer.blobs()[0]->data_version();
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(bottom_version, this->blob_bottom_->data_version());
+  EXPECT_EQ(weight_version, layer.blobs()[0]->data_version());
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(bottom_copy.cpu_data()[i], this->blob_bottom_->cpu_data()[i]);
+  }
+  for (int i = 0; i < weight_copy.count(); ++i) {
+    EXPECT_EQ(weight_copy.cpu_data()[i], layer.blobs()[0]->cpu_data()[i]);
+  }
+  // Writing the weights has to invalidate the cached shifted copy.
+  this->FillIntegers(layer.blobs()[0].get(), 0, 255);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top;
+  top.CopyFrom(*this->blob_top_, false, true);
+  ConvolutionLayer<Dtype> fresh_layer(layer_param);
+  fresh_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    fresh_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  fresh_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_EQ(this->blob_top_->cpu_data()[i], top.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(QuantizedConvolutionLayerTest, TestMultiThreadedForward) {
+  typedef TypeParam Dtype;
+  // Dense, depthwise (split by groups within an image) and grouped 1x1.
+  const int kernel_size[] = {3, 3, 1};
+  const int group[] = {1, 4, 2};
+  const int num_output[] = {6, 4, 6};
+  for (int c = 0; c < 3; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_size[c]);
+    convolution_param->add_pad(kernel_size[c] / 2);
+    convolution_param->set_group(group[c]);
+    convolution_param->set_num_output(num_output[c]);
+    convolution_param->set_input_zero_point(c == 1 ? 117 : 0);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    convolution_param->set_num_threads(1);
+    ConvolutionLayer<Dtype> serial_layer(layer_param);
+    serial_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    this->FillIntegers(this->blob_bottom_, 0, 255);
+    serial_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> serial_top;
+    serial_top.CopyFrom(*this->blob_top_, false, true);
+    for (int threads = 3; threads <= 8; threads += 5) {
+      // The layer setting is left at 0 so the context's default applies.
+      convolution_param->clear_num_threads();
+      Caffe::set_num_threads(threads);
+      ConvolutionLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        layer.blobs()[i]->CopyFrom(*serial_layer.blobs()[i]);
+      }
+      caffe_set(this->blob_top_->count(), Dtype(-12345),
+          this->blob_top_->mutable_cpu_data());
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      Caffe::set_num_threads(1);
+      for (int i = 0; i < serial_top.count(); ++i) {
+        EXPECT_EQ(serial_top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class NHWCConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  NHWCConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 8, 9, 7)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~NHWCConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Runs the layer on the NCHW bottom and on its NHWC copy with the same
+  // weights, and expects the NHWC top to be the NCHW one transposed.
+  void CheckNHWC(LayerParameter layer_param) {
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const int to_nhwc[] = {0, 2, 3, 1};
+    const vector<int> order(to_nhwc, to_nhwc + 4);
+    Blob<Dtype> bottom_nhwc(blob_bottom_->shape(0), blob_bottom_->shape(2),
+        blob_bottom_->shape(3), blob_bottom_->shape(1));
+    caffe_cpu_permute(blob_bottom_->shape(), order, blob_bottom_->cpu_data(),
+        bottom_nhwc.mutable_cpu_data());
+    Blob<Dtype> expected(blob_top_->shape(0), blob_top_->shape(2),
+        blob_top_->shape(3), blob_top_->shape(1));
+    caffe_cpu_permute(blob_top_->shape(), order, blob_top_->cpu_data(),
+        expected.mutable_cpu_data());
+    layer_param.set_data_format("NHWC");
+    for (int threads = 1; threads <= 4; threads += 3) {
+      Caffe::set_num_threads(threads);
+      ConvolutionLayer<Dtype> nhwc_layer(layer_param);
+      Blob<Dtype> top_nhwc;
+      vector<Blob<Dtype>*> bottom_vec(1, &bottom_nhwc);
+      vector<Blob<Dtype>*> top_vec(1, &top_nhwc);
+      nhwc_layer.SetUp(bottom_vec, top_vec);
+      for (int i = 0; i < layer.blobs().size(); ++i) {
+        nhwc_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+      }
+      nhwc_layer.Forward(bottom_vec, top_vec);
+      Caffe::set_num_threads(1);
+      ASSERT_TRUE(top_nhwc.shape() == expected.shape());
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_data()[i], top_nhwc.cpu_data()[i],
+            1e-4 * std::max(Dtype(1), std::fabs(expected.cpu_data()[i])));
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(NHWCConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(NHWCConvolutionLayerTest, TestForward) {
+  // Dense, strided with uneven padding, 1x1, grouped, dilated depthwise,
+  // grouped 1x1 and "SAME" padding.
+  const int kernel_size[] = {3, 3, 1, 3, 3, 1, 3};
+  const int stride[] = {1, 2, 1, 1, 1, 1, 2};
+  const int pad[] = {1, -1, 0, 1, 2, 0, 0};
+  const int dilation[] = {1, 1, 1, 1, 2, 1, 1};
+  const int group[] = {1, 1, 1, 2, 8, 4, 1};
+  const int num_output[] = {5, 6, 4, 6, 8, 8, 3};
+  for (int c = 0; c < 7; ++c) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_size[c]);
+    convolution_param->add_stride(stride[c]);
+    if (c == 6) {
+      convolution_param->set_pad_type(1);
+    } else if (pad[c] >= 0) {
+      convolution_param->add_pad(pad[c]);
+    } else {
+      convolution_param->set_pad_t(0);
+      convolution_param->set_pad_b(2);
+      convolution_param->set_pad_l(1);
+      convolution_param->set_pad_r(0);
+    }
+    convolution_param->add_dilation(dilation[c]);
+    convolution_param->set_group(group[c]);
+    convolution_param->set_num_output(num_output[c]);
+    convolution_param->set_bias_term(c != 2);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    this->CheckNHWC(layer_param);
+  }
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/correlation_1d_layer.hpp"
+#include "caffe/layers/correlation_layer.hpp"
+#include "caffe/util/math_functions_simd.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class CorrelationLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  CorrelationLayerTest()
+      : blob_bottom_0_(new Blob<Dtype>(2, 10, 9, 11)),
+        blob_bottom_1_(new Blob<Dtype>(2, 10, 9, 11)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_0_);
+    filler.Fill(this->blob_bottom_1_);
+    blob_bottom_vec_.push_back(blob_bottom_0_);
+    blob_bottom_vec_.push_back(blob_bottom_1_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~CorrelationLayerTest() {
+    delete blob_bottom_0_;
+    delete blob_bottom_1_;
+    delete blob_top_;
+  }
+
+  // The pixel (y, x) of a bottom padded by (pad_h, pad_w), and zero outside
+  // the bottom.
+  Dtype Pixel(const Blob<Dtype>& blob, int n, int c, int y, int x,
+      int pad_h, int pad_w) {
+    y -= pad_h;
+    x -= pad_w;
+    if (y < 0 || y >= blob.height() || x < 0 || x >= blob.width()) {
+      return 0;
+    }
+    return blob.data_at(n, c, y, x);
+  }
+
+  // Checks the top against the definition of the correlation: top channel c
+  // compares patches displaced by ((grid_y_begin + c / grid_width) * stride2,
+  // (grid_x_begin + c % grid_width) * stride2).
+  void CheckCorrelation(const CorrelationParameter& param, int pad_h,
+      int y_offset, int grid_y_begin, int grid_x_begin, int grid_width) {
+    const int kernel_size = param.kernel_size();
+    const bool subtract = param.correlation_type() ==
+        CorrelationParameter_CorrelationType_SUBTRACT;
+    const int channels = blob_bottom_0_->channels();
+    for (int n = 0; n < blob_top_->num(); ++n) {
+      for (int c = 0; c < blob_top_->channels(); ++c) {
+        const int dy = (grid_y_begin + c / grid_width) * param.stride_2();
+        const int dx = (grid_x_begin + c % grid_width) * param.stride_2();
+        for (int y = 0; y < blob_top_->height(); ++y) {
+          for (int x = 0; x < blob_top_->width(); ++x) {
+            const int y1 = y * param.stride_1() + y_offset;
+            const int x1 = x * param.stride_1() + param.max_displacement();
+            Dtype sum = 0;
+            for (int j = 0; j < kernel_size; ++j) {
+              for (int i = 0; i < kernel_size; ++i) {
+                for (int l = 0; l < channels; ++l) {
+                  const Dtype a = Pixel(*blob_bottom_0_, n, l, y1 + j, x1 + i,
+                      pad_h, param.pad());
+                  const Dtype b = Pixel(*blob_bottom_1_, n, l, y1 + j + dy,
+                      x1 + i + dx, pad_h, param.pad());
+                  sum += subtract ? std::fabs(a - b) : a * b;
+                }
+              }
+            }
+            const Dtype expected = sum / (kernel_size * kernel_size * channels);
+            EXPECT_NEAR(expected, blob_top_->data_at(n, c, y, x), 1e-5);
+          }
+        }
+      }
+    }
+  }
+
+  void TestForward2D(const CorrelationParameter& corr_param) {
+    LayerParameter layer_param;
+    layer_param.mutable_correlation_param()->CopyFrom(corr_param);
+    const SimdLevel level = caffe_simd_level();
+    for (int l = SIMD_SCALAR; l <= level; ++l) {
+      caffe_set_simd_level(static_cast<SimdLevel>(l));
+      // Rows of the top are split among the threads.
+      Caffe::set_num_threads(l + 1);
+      CorrelationLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int radius = corr_param.max_displacement() / corr_param.stride_2();
+      EXPECT_EQ((2 * radius + 1) * (2 * radius + 1),
+          this->blob_top_->channels());
+      CheckCorrelation(corr_param, corr_param.pad(),
+          corr_param.max_displacement(), -radius, -radius, 2 * radius + 1);
+    }
+    Caffe::set_num_threads(1);
+  }
+
+  void TestForward1D(const CorrelationParameter& corr_param) {
+    LayerParameter layer_param;
+    layer_param.mutable_correlation_param()->CopyFrom(corr_param);
+    const SimdLevel level = caffe_simd_level();
+    for (int l = SIMD_SCALAR; l <= level; ++l) {
+      caffe_set_simd_level(static_cast<SimdLevel>(l));
+      // Rows of the top are split among the threads.
+      Caffe::set_num_threads(l + 1);
+      Correlation1DLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const int radius = corr_param.max_displacement() / corr_param.stride_2();
+      int grid_x_begin = -radius;
+      int grid_width = 2 * radius + 1;
+      if (corr_param.single_direction() != 0) {
+        grid_width = radius + 1;
+        grid_x_begin = corr_param.single_direction() < 0 ? -grid_width : 0;
+      }
+      EXPECT_EQ(grid_width, this->blob_top_->channels());
+      CheckCorrelation(corr_param, 0, 0, 0, grid_x_begin, grid_width);
+    }
+    Caffe::set_num_threads(1);
+  }
+
+  Blob<Dtype>* const blob_bottom_0_;
+  Blob<Dtype>* const blob_bottom_1_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(CorrelationLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(CorrelationLayerTest, TestForwardMultiply) {
+  CorrelationParameter corr_param;
+  corr_param.set_pad(2);
+  corr_param.set_kernel_size(3);
+  corr_param.set_max_displacement(2);
+  this->TestForward2D(corr_param);
+}
+
+TYPED_TEST(CorrelationLayerTest, TestForwardMultiplyStrided) {
+  // The FlowNetC setting: one pixel kernels, with both strides.
+  this->blob_bottom_0_->Reshape(1, 16, 12, 14);
+  this->blob_bottom_1_->Reshape(1, 16, 12, 14);
+  FillerParameter filler_param;
+  GaussianFiller<typename TypeParam::Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_0_);
+  filler.Fill(this->blob_bottom_1_);
+  CorrelationParameter corr_param;
+  corr_param.set_pad(4);
+  corr_param.set_kernel_size(1);
+  corr_param.set_max_displacement(4);
+  corr_param.set_stride_1(2);
+  corr_param.set_stride_2(2);
+  this->TestForward2D(corr_param);
+}
+
+TYPED_TEST(CorrelationLayerTest, TestForwardSubtract) {
+  CorrelationParameter corr_param;
+  corr_param.set_pad(1);
+  corr_param.set_kernel_size(3);
+  corr_param.set_max_displacement(2);
+  corr_param.set_correlation_type(
+      CorrelationParameter_CorrelationType_SUBTRACT);
+  this->TestForward2D(corr_param);
+}
+
+TYPED_TEST(CorrelationLayerTest, TestForward1D) {
+  CorrelationParameter corr_param;
+  corr_param.set_pad(3);
+  corr_param.set_kernel_size(1);
+  corr_param.set_max_displacement(3);
+  this->TestForward1D(corr_param);
+  corr_param.set_kernel_size(3);
+  corr_param.set_max_displacement(4);
+  corr_param.set_stride_2(2);
+  this->TestForward1D(corr_param);
+  corr_param.set_correlation_type(
+      CorrelationParameter_CorrelationType_SUBTRACT);
+  this->TestForward1D(corr_param);
+}
+
+TYPED_TEST(CorrelationLayerTest, TestForward1DSingleDirection) {
+  if (Caffe::mode() == Caffe::GPU) {
+    // To the left, Forward_gpu reads outside the padded row instead.
+    return;
+  }
+  CorrelationParameter corr_param;
+  corr_param.set_pad(2);
+  corr_param.set_kernel_size(1);
+  corr_param.set_max_displacement(2);
+  corr_param.set_single_direction(1);
+  this->TestForward1D(corr_param);
+  // To the left, the first displacements leave the padded row.
+  corr_param.set_single_direction(-1);
+  this->TestForward1D(corr_param);
+}
+
+}  // namespace caffe
@@ -11,6 +11,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -346,6 +347,91 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestTransformKernels) {
+  // Rows longer than, and not a multiple of, the vector width.
+  const int channels = 3;
+  const int size = 37;
+  const int crop_size = 35;
+  const int count = channels * size * size;
+  // The AnnotatedDatum overload returns whether the image was mirrored.
+  AnnotatedDatum uint8_datum;
+  uint8_datum.mutable_datum()->set_channels(channels);
+  uint8_datum.mutable_datum()->set_height(size);
+  uint8_datum.mutable_datum()->set_width(size);
+  AnnotatedDatum float_datum(uint8_datum);
+  for (int j = 0; j < count; ++j) {
+    uint8_datum.mutable_datum()->mutable_data()->push_back(
+        static_cast<uint8_t>(j * 7));
+    float_datum.mutable_datum()->add_float_data(j * 0.37 - 100);
+  }
+  BlobProto blob_mean;
+  blob_mean.set_num(1);
+  blob_mean.set_channels(channels);
+  blob_mean.set_height(size);
+  blob_mean.set_width(size);
+  for (int j = 0; j < count; ++j) {
+    blob_mean.add_data(j * 0.05);
+  }
+  string mean_file;
+  MakeTempFilename(&mean_file);
+  WriteProtoToBinaryFile(blob_mean, mean_file);
+  const float mean_values[] = { 10, 20.5, 30 };
+
+  const SimdLevel level = caffe_simd_level();
+  for (int l = SIMD_SCALAR; l <= level; ++l) {
+    caffe_set_simd_level(static_cast<SimdLevel>(l));
+    // Without a mean, with a mean file and with mean values.
+    for (int m = 0; m < 3; ++m) {
+      for (int f = 0; f < 2; ++f) {
+        const AnnotatedDatum& anno_datum = f ? float_datum : uint8_datum;
+        const Datum& datum = anno_datum.datum();
+        TransformationParameter transform_param;
+        transform_param.set_crop_size(crop_size);
+        transform_param.set_mirror(true);
+        transform_param.set_scale(0.25);
+        if (m == 1) {
+          transform_param.set_mean_file(mean_file);
+        } else if (m == 2) {
+          for (int c = 0; c < channels; ++c) {
+            transform_param.add_mean_value(mean_values[c]);
+          }
+        }
+        DataTransformer<TypeParam> transformer(transform_param, TEST);
+        Caffe::set_random_seed(this->seed_);
+        transformer.InitRand();
+        Blob<TypeParam> blob(1, channels, crop_size, crop_size);
+        for (int iter = 0; iter < this->num_iter_; ++iter) {
+          vector<AnnotationGroup> anno_vec;
+          bool do_mirror;
+          transformer.Transform(anno_datum, &blob, &anno_vec, &do_mirror);
+          // The center crop of the TEST phase.
+          const int h_off = (size - crop_size) / 2;
+          const int w_off = (size - crop_size) / 2;
+          for (int c = 0; c < channels; ++c) {
+            for (int h = 0; h < crop_size; ++h) {
+              for (int w = 0; w < crop_size; ++w) {
+                const int index = (c * size + h_off + h) * size + w_off + w;
+                const TypeParam pixel = f ? datum.float_data(index) :
+                    static_cast<uint8_t>(datum.data()[index]);
+                TypeParam mean = 0;
+                if (m == 1) {
+                  mean = static_cast<TypeParam>(blob_mean.data(index));
+                } else if (m == 2) {
+                  mean = mean_values[c];
+                }
+                const int w_top = do_mirror ? crop_size - 1 - w : w;
+                EXPECT_EQ((pixel - mean) * TypeParam(0.25),
+                    blob.data_at(0, c, h, w_top));
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  caffe_set_simd_level(level);
+}
+
 TYPED_TEST(DataTransformTest, TestRichLabel) {
   TransformationParameter transform_param;
   const bool unique_pixels = false;  // all pixels the same equal to label
@@ -1,5 +1,9 @@
 #if defined(USE_LEVELDB) && defined(USE_LMDB) && defined(USE_OPENCV)
+#include <algorithm>
+#include <cstdlib>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "boost/scoped_ptr.hpp"
 #include "gtest/gtest.h"
@@ -7,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -42,6 +47,24 @@ class DBTest : public ::testing::Test {
 
   virtual ~DBTest() { }
 
+  // A new db of num_records records, the keys and values of which are their
+  // numbers, open for reading.
+  db::DB* OpenNumberedDB(const int num_records) {
+    string source;
+    MakeTempDir(&source);
+    source += "/db";
+    db::DB* db = db::GetDB(TypeParam::backend);
+    db->Open(source, db::NEW);
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = 0; i < num_records; ++i) {
+      txn->Put(format_int(i, 5), format_int(i));
+    }
+    txn->Commit();
+    db->Close();
+    db->Open(source, db::READ);
+    return db;
+  }
+
   DataParameter_DB backend_;
   string source_;
   string root_images_;
@@ -117,6 +140,104 @@ TYPED_TEST(DBTest, TestKeyValue) {
   EXPECT_FALSE(cursor->valid());
 }
 
+TYPED_TEST(DBTest, TestSeek) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  cursor->Seek("fish-bike.jpg");
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ(cursor->key(), "fish-bike.jpg");
+  cursor->Seek("dog.jpg");
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ(cursor->key(), "fish-bike.jpg");
+  cursor->Next();
+  EXPECT_FALSE(cursor->valid());
+  cursor->Seek("a");
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ(cursor->key(), "cat.jpg");
+  cursor->Seek("zebra.jpg");
+  EXPECT_FALSE(cursor->valid());
+}
+
+TYPED_TEST(DBTest, TestShardedCursor) {
+  const int num_records = 100;
+  scoped_ptr<db::DB> db(this->OpenNumberedDB(num_records));
+  const int num_solvers = 3;
+  vector<shared_ptr<db::ShardedCursor> > cursors;
+  for (int rank = 0; rank < num_solvers; ++rank) {
+    cursors.push_back(shared_ptr<db::ShardedCursor>(new db::ShardedCursor(
+        db->NewCursor(), num_solvers, rank, 2)));
+  }
+  vector<vector<int> > first_shards;
+  bool dealt_anew = false;
+  for (int epoch = 0; epoch < 4; ++epoch) {
+    // Each record is read by one solver, in runs of consecutive keys.
+    std::set<string> keys;
+    for (int rank = 0; rank < num_solvers; ++rank) {
+      db::ShardedCursor* cursor = cursors[rank].get();
+      EXPECT_EQ(epoch, cursor->epoch());
+      EXPECT_EQ(2, cursor->shards().size());
+      if (epoch == 0) {
+        first_shards.push_back(cursor->shards());
+      } else if (cursor->shards() != first_shards[rank]) {
+        dealt_anew = true;
+      }
+      int num_runs = 0;
+      string last_key;
+      for (; cursor->valid(); cursor->Next()) {
+        EXPECT_EQ(cursor->key(), format_int(atoi(cursor->value().c_str()), 5));
+        EXPECT_TRUE(keys.insert(cursor->key()).second);
+        if (last_key.empty() || cursor->key() != format_int(
+            atoi(last_key.c_str()) + 1, 5)) {
+          ++num_runs;
+        }
+        last_key = cursor->key();
+      }
+      EXPECT_LE(num_runs, 2);
+      cursor->SeekToFirst();
+    }
+    EXPECT_EQ(num_records, keys.size());
+  }
+  EXPECT_TRUE(dealt_anew);
+}
+
+TYPED_TEST(DBTest, TestShardedCursorSeek) {
+  const int num_records = 100;
+  scoped_ptr<db::DB> db(this->OpenNumberedDB(num_records));
+  db::ShardedCursor cursor(db->NewCursor(), 3, 1, 2);
+  vector<string> keys;
+  for (; cursor.valid(); cursor.Next()) {
+    keys.push_back(cursor.key());
+  }
+  vector<string> sorted_keys(keys);
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  // Each seek finds the first key of this solver not less than the key, and
+  // reads on from there as the epoch does.
+  for (int i = 0; i <= num_records; ++i) {
+    const string key = format_int(i, 5);
+    cursor.Seek(key);
+    vector<string>::const_iterator it =
+        std::lower_bound(sorted_keys.begin(), sorted_keys.end(), key);
+    ASSERT_EQ(it != sorted_keys.end(), cursor.valid());
+    if (it == sorted_keys.end()) {
+      continue;
+    }
+    for (vector<string>::const_iterator next =
+        std::find(keys.begin(), keys.end(), *it); next != keys.end();
+        ++next) {
+      ASSERT_TRUE(cursor.valid());
+      EXPECT_EQ(*next, cursor.key());
+      cursor.Next();
+    }
+    EXPECT_FALSE(cursor.valid());
+  }
+  cursor.Seek("");
+  EXPECT_EQ(sorted_keys[0], cursor.key());
+  cursor.SeekToFirst();
+  EXPECT_EQ(1, cursor.epoch());
+  EXPECT_TRUE(cursor.valid());
+}
+
 TYPED_TEST(DBTest, TestWrite) {
   scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
   db->Open(this->source_, db::WRITE);
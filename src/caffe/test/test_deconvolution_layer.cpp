@@ -302,6 +302,61 @@ TYPED_TEST(DeconvolutionLayerTest, TestGradient3D) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(DeconvolutionLayerTest, TestForwardZeroPoint) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // A quantized deconvolution must match a float one run on the shifted
+  // input and weights, for a strided, padded kernel and for a 1x1 one.
+  for (int kernel = 1; kernel <= 3; kernel += 2) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel);
+    convolution_param->add_stride(kernel == 1 ? 1 : 2);
+    convolution_param->add_pad(kernel / 2);
+    convolution_param->set_num_output(kernel == 1 ? 4 : 6);
+    convolution_param->set_group(kernel == 1 ? 1 : 3);
+    LayerParameter shifted_param(layer_param);
+    convolution_param->set_input_zero_point(3);
+    convolution_param->set_weight_zero_point(-2);
+    DeconvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> shifted_bottom;
+    shifted_bottom.ReshapeLike(*this->blob_bottom_);
+    Dtype* bottom_data = this->blob_bottom_->mutable_cpu_data();
+    for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+      bottom_data[i] = Dtype(i % 7);
+      shifted_bottom.mutable_cpu_data()[i] = bottom_data[i] - 3;
+    }
+    vector<Blob<Dtype>*> shifted_bottom_vec(1, &shifted_bottom);
+    Blob<Dtype> shifted_top;
+    vector<Blob<Dtype>*> shifted_top_vec(1, &shifted_top);
+    DeconvolutionLayer<Dtype> shifted_layer(shifted_param);
+    shifted_layer.SetUp(shifted_bottom_vec, shifted_top_vec);
+    Blob<Dtype>& weight = *layer.blobs()[0];
+    for (int i = 0; i < weight.count(); ++i) {
+      weight.mutable_cpu_data()[i] = Dtype(i % 5) - 2;
+      shifted_layer.blobs()[0]->mutable_cpu_data()[i] = Dtype(i % 5);
+    }
+    caffe_set(layer.blobs()[1]->count(), Dtype(1),
+        layer.blobs()[1]->mutable_cpu_data());
+    caffe_set(layer.blobs()[1]->count(), Dtype(1),
+        shifted_layer.blobs()[1]->mutable_cpu_data());
+    const uint64_t bottom_version = this->blob_bottom_->data_version();
+    const uint64_t weight_version = weight.data_version();
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    shifted_layer.Forward(shifted_bottom_vec, shifted_top_vec);
+    EXPECT_EQ(bottom_version, this->blob_bottom_->data_version());
+    EXPECT_EQ(weight_version, weight.data_version());
+    ASSERT_EQ(shifted_top.count(), this->blob_top_->count());
+    for (int i = 0; i < shifted_top.count(); ++i) {
+      EXPECT_EQ(shifted_top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 
 // Since ConvolutionLayerTest checks the shared conv/deconv code in detail,
@@ -0,0 +1,178 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/densecrf_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class DenseCRFLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  DenseCRFLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 40, 36)),
+        blob_bottom_dim_(new Blob<Dtype>(2, 2, 1, 1)),
+        blob_bottom_image_(new Blob<Dtype>(2, 3, 40, 36)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    filler_param.set_std(2);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    filler_param.set_std(40);
+    GaussianFiller<Dtype> image_filler(filler_param);
+    image_filler.Fill(this->blob_bottom_image_);
+    // The second image is padded.
+    Dtype* dim = blob_bottom_dim_->mutable_cpu_data();
+    dim[0] = 40;
+    dim[1] = 36;
+    dim[2] = 34;
+    dim[3] = 29;
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_dim_);
+    blob_bottom_vec_.push_back(blob_bottom_image_);
+    blob_top_vec_.push_back(blob_top_);
+    DenseCRFParameter* dense_crf_param =
+        layer_param_.mutable_dense_crf_param();
+    dense_crf_param->set_max_iter(5);
+    dense_crf_param->add_pos_xy_std(3);
+    dense_crf_param->add_pos_w(3);
+    dense_crf_param->add_bi_xy_std(20);
+    dense_crf_param->add_bi_rgb_std(10);
+    dense_crf_param->add_bi_w(5);
+  }
+  virtual ~DenseCRFLayerTest() {
+    delete blob_bottom_;
+    delete blob_bottom_dim_;
+    delete blob_bottom_image_;
+    delete blob_top_;
+  }
+
+  // Runs the layer twice on the bottoms with the given number of threads.
+  void Infer(int num_threads, const vector<Blob<Dtype>*>& bottom,
+      Blob<Dtype>* top) {
+    Caffe::set_num_threads(num_threads);
+    vector<Blob<Dtype>*> top_vec(1, top);
+    DenseCRFLayer<Dtype> layer(layer_param_);
+    layer.SetUp(bottom, top_vec);
+    layer.Forward(bottom, top_vec);
+    Blob<Dtype> first;
+    first.CopyFrom(*top, false, true);
+    layer.Forward(bottom, top_vec);
+    Caffe::set_num_threads(1);
+    for (int i = 0; i < top->count(); ++i) {
+      EXPECT_EQ(first.cpu_data()[i], top->cpu_data()[i]);
+    }
+  }
+
+  // New bottoms holding image n of the bottoms of the test alone.
+  vector<Blob<Dtype>*> ImageOfBatch(int n) {
+    vector<Blob<Dtype>*> bottom;
+    for (int i = 0; i < blob_bottom_vec_.size(); ++i) {
+      const Blob<Dtype>& blob = *blob_bottom_vec_[i];
+      vector<int> shape = blob.shape();
+      shape[0] = 1;
+      bottom.push_back(new Blob<Dtype>(shape));
+      caffe_copy(blob.count(1), blob.cpu_data() + blob.offset(n),
+          bottom[i]->mutable_cpu_data());
+    }
+    return bottom;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_bottom_dim_;
+  Blob<Dtype>* const blob_bottom_image_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  LayerParameter layer_param_;
+};
+
+TYPED_TEST_CASE(DenseCRFLayerTest, TestDtypes);
+
+TYPED_TEST(DenseCRFLayerTest, TestProbabilities) {
+  this->Infer(1, this->blob_bottom_vec_, this->blob_top_);
+  const Blob<TypeParam>& top = *this->blob_top_;
+  ASSERT_TRUE(top.shape() == this->blob_bottom_->shape());
+  for (int n = 0; n < 2; ++n) {
+    const int height = n == 0 ? 40 : 34;
+    const int width = n == 0 ? 36 : 29;
+    for (int h = 0; h < top.height(); ++h) {
+      for (int w = 0; w < top.width(); ++w) {
+        TypeParam sum = 0;
+        for (int c = 0; c < top.channels(); ++c) {
+          sum += top.data_at(n, c, h, w);
+        }
+        EXPECT_NEAR(h < height && w < width ? 1 : 0, sum, 1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(DenseCRFLayerTest, TestThreads) {
+  this->Infer(1, this->blob_bottom_vec_, this->blob_top_);
+  // With 2 threads each image runs on its own, with 3 each splits its
+  // filtering over the threads.
+  for (int num_threads = 2; num_threads <= 3; ++num_threads) {
+    Blob<TypeParam> top;
+    this->Infer(num_threads, this->blob_bottom_vec_, &top);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_EQ(this->blob_top_->cpu_data()[i], top.cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(DenseCRFLayerTest, TestImagesOfBatch) {
+  this->Infer(2, this->blob_bottom_vec_, this->blob_top_);
+  // Each image of the batch gives the result it gives alone.
+  for (int n = 0; n < 2; ++n) {
+    vector<Blob<TypeParam>*> bottom = this->ImageOfBatch(n);
+    Blob<TypeParam> top;
+    this->Infer(1, bottom, &top);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_EQ(this->blob_top_->cpu_data()[this->blob_top_->offset(n) + i],
+          top.cpu_data()[i]);
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      delete bottom[i];
+    }
+  }
+}
+
+TYPED_TEST(DenseCRFLayerTest, TestReshapeAcrossThreads) {
+  this->Infer(1, this->blob_bottom_vec_, this->blob_top_);
+  vector<Blob<TypeParam>*> image = this->ImageOfBatch(0);
+  Blob<TypeParam> image_top;
+  this->Infer(1, image, &image_top);
+  // One layer with 2 threads runs a single image split over the threads,
+  // then both images on a worker each, reusing the potentials of the first.
+  Caffe::set_num_threads(2);
+  Blob<TypeParam> top;
+  vector<Blob<TypeParam>*> top_vec(1, &top);
+  DenseCRFLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(image, top_vec);
+  for (int pass = 0; pass < 2; ++pass) {
+    layer.Reshape(image, top_vec);
+    layer.Forward(image, top_vec);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_EQ(image_top.cpu_data()[i], top.cpu_data()[i]);
+    }
+    layer.Reshape(this->blob_bottom_vec_, top_vec);
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_EQ(this->blob_top_->cpu_data()[i], top.cpu_data()[i]);
+    }
+  }
+  Caffe::set_num_threads(1);
+  for (int i = 0; i < image.size(); ++i) {
+    delete image[i];
+  }
+}
+
+}  // namespace caffe
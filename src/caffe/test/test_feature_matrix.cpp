@@ -0,0 +1,113 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/feature_matrix.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FeatureMatrixTest : public ::testing::Test {
+ protected:
+  // Writes two blobs of 2 and 3 rows of shape (3, 7, 1) as a matrix of type,
+  // and checks the index and the rows of the file against them.
+  void TestWrite(const FeatureMatrixIndex::Type type) {
+    Caffe::set_random_seed(1701);
+    Blob<float> first(2, 3, 7, 1);
+    Blob<float> second(3, 3, 7, 1);
+    FillerParameter filler_param;
+    GaussianFiller<float> filler(filler_param);
+    filler.Fill(&first);
+    filler.Fill(&second);
+    string filename;
+    MakeTempFilename(&filename);
+    {
+      FeatureMatrixWriter writer(filename, type);
+      writer.Write(first);
+      writer.Write(second);
+    }
+    const bool half = type == FeatureMatrixIndex_Type_FLOAT16;
+    FeatureMatrixIndex index;
+    ASSERT_TRUE(ReadProtoFromTextFile(filename + ".index", &index));
+    EXPECT_EQ(type, index.type());
+    EXPECT_EQ(5, index.rows());
+    EXPECT_EQ(21, index.cols());
+    EXPECT_EQ(half ? 64 : 128, index.stride());
+    ASSERT_EQ(3, index.shape().dim_size());
+    EXPECT_EQ(3, index.shape().dim(0));
+    EXPECT_EQ(7, index.shape().dim(1));
+    EXPECT_EQ(1, index.shape().dim(2));
+
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    const string bytes((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    ASSERT_EQ(5 * index.stride(), bytes.size());
+    for (int r = 0; r < 5; ++r) {
+      const Blob<float>& blob = r < 2 ? first : second;
+      const float* features = blob.cpu_data() + (r < 2 ? r : r - 2) * 21;
+      const char* row = bytes.data() + r * index.stride();
+      for (int d = 0; d < 21; ++d) {
+        if (half) {
+          uint16_t value;
+          memcpy(&value, row + d * sizeof(value), sizeof(value));
+          EXPECT_EQ(FloatToHalf(features[d]), value);
+        } else {
+          float value;
+          memcpy(&value, row + d * sizeof(value), sizeof(value));
+          EXPECT_EQ(features[d], value);
+        }
+      }
+      // The padding of the row is zero.
+      const int bytes_used = 21 * (half ? 2 : 4);
+      for (int b = bytes_used; b < index.stride(); ++b) {
+        EXPECT_EQ(0, row[b]);
+      }
+    }
+  }
+};
+
+TEST_F(FeatureMatrixTest, TestFloatToHalf) {
+  EXPECT_EQ(0x0000, FloatToHalf(0.f));
+  EXPECT_EQ(0x8000, FloatToHalf(-0.f));
+  EXPECT_EQ(0x3c00, FloatToHalf(1.f));
+  EXPECT_EQ(0xc000, FloatToHalf(-2.f));
+  EXPECT_EQ(0x3555, FloatToHalf(1.f / 3));
+  // The largest half, and the first float to round to infinity.
+  EXPECT_EQ(0x7bff, FloatToHalf(65504.f));
+  EXPECT_EQ(0x7bff, FloatToHalf(65519.f));
+  EXPECT_EQ(0x7c00, FloatToHalf(65520.f));
+  EXPECT_EQ(0xfc00, FloatToHalf(-std::numeric_limits<float>::infinity()));
+  EXPECT_EQ(0x7e00, FloatToHalf(std::numeric_limits<float>::quiet_NaN()));
+  // Ties round to even.
+  EXPECT_EQ(0x3c00, FloatToHalf(1.f + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, FloatToHalf(1.f + 3 * std::ldexp(1.f, -11)));
+  // The smallest normal, and subnormals.
+  EXPECT_EQ(0x0400, FloatToHalf(std::ldexp(1.f, -14)));
+  EXPECT_EQ(0x03ff, FloatToHalf(std::ldexp(1023.f, -24)));
+  EXPECT_EQ(0x0001, FloatToHalf(std::ldexp(1.f, -24)));
+  EXPECT_EQ(0x0000, FloatToHalf(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0002, FloatToHalf(std::ldexp(3.f, -25)));
+}
+
+TEST_F(FeatureMatrixTest, TestWriteFloat) {
+  this->TestWrite(FeatureMatrixIndex_Type_FLOAT);
+}
+
+TEST_F(FeatureMatrixTest, TestWriteFloat16) {
+  this->TestWrite(FeatureMatrixIndex_Type_FLOAT16);
+}
+
+}  // namespace caffe
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/flow_warp_layer.hpp"
+#include "caffe/util/math_functions_simd.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class FlowWarpLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  FlowWarpLayerTest()
+      : blob_bottom_image_(new Blob<Dtype>(2, 3, 7, 13)),
+        blob_bottom_flow_(new Blob<Dtype>(2, 2, 7, 13)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_image_);
+    // Far enough that some of the pixels leave the image.
+    filler_param.set_std(3);
+    GaussianFiller<Dtype> flow_filler(filler_param);
+    flow_filler.Fill(this->blob_bottom_flow_);
+    blob_bottom_vec_.push_back(blob_bottom_image_);
+    blob_bottom_vec_.push_back(blob_bottom_flow_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~FlowWarpLayerTest() {
+    delete blob_bottom_image_;
+    delete blob_bottom_flow_;
+    delete blob_top_;
+  }
+
+  // Checks the top against the bilinear samples of the image at the pixels
+  // moved by the flow, or against the fill outside the image.
+  void CheckWarp(const bool nan_fill) {
+    const int height = blob_top_->height();
+    const int width = blob_top_->width();
+    int outside = 0;
+    for (int n = 0; n < blob_top_->num(); ++n) {
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          const float x2 = x + blob_bottom_flow_->data_at(n, 0, y, x);
+          const float y2 = y + blob_bottom_flow_->data_at(n, 1, y, x);
+          const bool inside = x2 >= 0 && y2 >= 0 && x2 < width && y2 < height;
+          outside += !inside;
+          for (int c = 0; c < blob_top_->channels(); ++c) {
+            const Dtype warped = blob_top_->data_at(n, c, y, x);
+            if (!inside) {
+              if (nan_fill) {
+                EXPECT_TRUE(std::isnan(warped));
+              } else {
+                EXPECT_EQ(0, warped);
+              }
+              continue;
+            }
+            const int x_l = x2;
+            const int y_t = y2;
+            const int x_r = std::min(x_l + 1, width - 1);
+            const int y_b = std::min(y_t + 1, height - 1);
+            const float alpha = x2 - x_l;
+            const float beta = y2 - y_t;
+            const Blob<Dtype>& image = *blob_bottom_image_;
+            const Dtype expected =
+                (1 - alpha) * (1 - beta) * image.data_at(n, c, y_t, x_l) +
+                alpha * (1 - beta) * image.data_at(n, c, y_t, x_r) +
+                (1 - alpha) * beta * image.data_at(n, c, y_b, x_l) +
+                alpha * beta * image.data_at(n, c, y_b, x_r);
+            EXPECT_NEAR(expected, warped, 1e-5);
+          }
+        }
+      }
+    }
+    EXPECT_GT(outside, 0);
+  }
+
+  void TestForward(const bool nan_fill) {
+    LayerParameter layer_param;
+    if (nan_fill) {
+      layer_param.mutable_flow_warp_param()->set_fill_value(
+          FlowWarpParameter_FillParameter_NOT_A_NUMBER);
+    }
+    const SimdLevel level = caffe_simd_level();
+    for (int l = SIMD_SCALAR; l <= level; ++l) {
+      caffe_set_simd_level(static_cast<SimdLevel>(l));
+      // Rows of the images are split among the threads.
+      Caffe::set_num_threads(l + 1);
+      FlowWarpLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      CheckWarp(nan_fill);
+    }
+    Caffe::set_num_threads(1);
+  }
+
+  Blob<Dtype>* const blob_bottom_image_;
+  Blob<Dtype>* const blob_bottom_flow_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(FlowWarpLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(FlowWarpLayerTest, TestForwardZeroFill) {
+  this->TestForward(false);
+}
+
+TYPED_TEST(FlowWarpLayerTest, TestForwardNaNFill) {
+  this->TestForward(true);
+}
+
+}  // namespace caffe
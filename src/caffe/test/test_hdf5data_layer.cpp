@@ -133,6 +133,77 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestReadChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Chunks of 3, 3, 3 and 1 rows give the rows of TestRead: row r of file f
+  // has the label 1 + r and the data from f * 2400 + r * 240 on.
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 4;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_rows(3);
+  hdf5_data_param->set_prefetch(1);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int data_size = 8 * 6 * 5;
+  int row = 0;
+  for (int iter = 0; iter < 15; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < batch_size; ++i, ++row) {
+      const int file_offset = (row % 20 < 10) ? 0 : 2400;
+      EXPECT_EQ(1 + row % 10, this->blob_top_label_->cpu_data()[i]);
+      for (int j = 0; j < data_size; ++j) {
+        EXPECT_EQ(file_offset + (row % 10) * data_size + j,
+            this->blob_top_data_->cpu_data()[i * data_size + j]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestShuffleChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_rows(4);
+  hdf5_data_param->set_shuffle(true);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int data_size = 8 * 6 * 5;
+  // Every epoch of 4 batches outputs each row of the 2 files once, with its
+  // label, and all the rows of a file before those of the other one.
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    vector<int> seen(20, 0);
+    vector<int> files;
+    for (int iter = 0; iter < 4; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < batch_size; ++i) {
+        const Dtype* data = this->blob_top_data_->cpu_data() + i * data_size;
+        const int file = static_cast<int>(data[0]) / 2400;
+        const int row = (static_cast<int>(data[0]) % 2400) / data_size;
+        ASSERT_GE(file, 0);
+        ASSERT_LT(file, 2);
+        EXPECT_EQ(1 + row, this->blob_top_label_->cpu_data()[i]);
+        EXPECT_EQ(file * 2400 + row * data_size + data_size - 1,
+            data[data_size - 1]);
+        ++seen[file * 10 + row];
+        if (files.empty() || files.back() != file) {
+          files.push_back(file);
+        }
+      }
+    }
+    EXPECT_EQ(vector<int>(20, 1), seen);
+    EXPECT_EQ(2, files.size());
+  }
+}
+
 TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
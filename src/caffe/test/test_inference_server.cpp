@@ -0,0 +1,128 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_server.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceServerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceServerTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 1 dim: 3 dim: 2 dim: 2 } } "
+        "} "
+        "layer { "
+        "  name: 'power' "
+        "  type: 'Power' "
+        "  bottom: 'data' "
+        "  top: 'power' "
+        "  power_param { scale: 2 shift: 1 } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'power' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    axis: 3 "
+        "    weight_filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    Caffe::set_random_seed(1701);
+    Net<Dtype> net(param_);
+    NetParameter trained_param;
+    net.ToProto(&trained_param, false);
+    MakeTempFilename(&weights_);
+    WriteProtoToBinaryFile(trained_param, weights_);
+  }
+
+  // Runs the request on a net of its own, and checks the outputs it got.
+  void CheckOutputs(const InferenceRequest<Dtype>& request) {
+    ASSERT_TRUE(request.done());
+    Net<Dtype> net(param_);
+    net.CopyTrainedLayersFrom(weights_);
+    net.input_blobs()[0]->CopyFrom(request.input(), false, true);
+    net.Reshape();
+    const vector<Blob<Dtype>*>& outputs = net.Forward();
+    ASSERT_EQ(outputs.size(), request.outputs().size());
+    for (int i = 0; i < outputs.size(); ++i) {
+      const Blob<Dtype>& output = *request.outputs()[i];
+      ASSERT_TRUE(outputs[i]->shape() == output.shape());
+      for (int j = 0; j < output.count(); ++j) {
+        EXPECT_NEAR(outputs[i]->cpu_data()[j], output.cpu_data()[j], 1e-4);
+      }
+    }
+  }
+
+  NetParameter param_;
+  string weights_;
+};
+
+TYPED_TEST_CASE(InferenceServerTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceServerTest, TestBatching) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Long enough a delay that every batch fills up.
+  InferenceServer<Dtype> server(this->param_, this->weights_, 2, 4, 10000000);
+  vector<shared_ptr<InferenceRequest<Dtype> > > requests;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < 8; ++i) {
+    vector<int> shape(4, 1);
+    shape[1] = 3;
+    shape[2] = 2 + i % 2;
+    shape[3] = 2;
+    requests.push_back(shared_ptr<InferenceRequest<Dtype> >(
+        new InferenceRequest<Dtype>(shape)));
+    filler.Fill(requests[i]->mutable_input());
+    server.Submit(requests[i]);
+  }
+  for (int i = 0; i < requests.size(); ++i) {
+    requests[i]->Wait();
+    this->CheckOutputs(*requests[i]);
+  }
+  // A batch for each of the two shapes of inputs.
+  EXPECT_EQ(2, server.num_batches());
+}
+
+TYPED_TEST(InferenceServerTest, TestDelay) {
+  typedef typename TypeParam::Dtype Dtype;
+  InferenceServer<Dtype> server(this->param_, this->weights_, 1, 4, 0);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  vector<int> shape(4, 2);
+  shape[0] = 1;
+  shape[1] = 3;
+  for (int i = 0; i < 3; ++i) {
+    shared_ptr<InferenceRequest<Dtype> > request(
+        new InferenceRequest<Dtype>(shape));
+    filler.Fill(request->mutable_input());
+    server.Submit(request);
+    request->Wait();
+    this->CheckOutputs(*request);
+    EXPECT_EQ(i + 1, server.num_batches());
+  }
+}
+
+}  // namespace caffe
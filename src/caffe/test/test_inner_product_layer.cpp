@@ -135,6 +135,48 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardZeroPoint) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  LayerParameter layer_param;
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_input_zero_point(3);
+  inner_product_param->set_weight_zero_point(-2);
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Dtype* bottom_data = this->blob_bottom_->mutable_cpu_data();
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    bottom_data[i] = Dtype(i % 7);
+  }
+  Dtype* weight = layer.blobs()[0]->mutable_cpu_data();
+  for (int i = 0; i < layer.blobs()[0]->count(); ++i) {
+    weight[i] = Dtype(i % 5) - 2;
+  }
+  caffe_set(10, Dtype(1), layer.blobs()[1]->mutable_cpu_data());
+  const uint64_t bottom_version = this->blob_bottom_->data_version();
+  const uint64_t weight_version = layer.blobs()[0]->data_version();
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Forward must neither shift the bottom nor the weights in place.
+  EXPECT_EQ(bottom_version, this->blob_bottom_->data_version());
+  EXPECT_EQ(weight_version, layer.blobs()[0]->data_version());
+  const int K = this->blob_bottom_->count(1);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  for (int m = 0; m < this->blob_bottom_->num(); ++m) {
+    for (int n = 0; n < 10; ++n) {
+      Dtype expected = 1;
+      for (int k = 0; k < K; ++k) {
+        expected += (bottom_data[m * K + k] - 3) * (weight[n * K + k] + 2);
+      }
+      EXPECT_EQ(expected, top_data[m * 10 + n]);
+    }
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/interp_layer.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -28,6 +30,56 @@ class InterpLayerTest : public MultiDeviceTest<TypeParam> {
     blob_top_vec_.push_back(blob_top_);
   }
   virtual ~InterpLayerTest() { delete blob_bottom_; delete blob_top_; }
+
+  // Checks the top against the bilinear samples of the bottom cropped by
+  // pad, whose corner pixels line up with the ones of the top.
+  void CheckInterp(const int pad) {
+    const int height = blob_bottom_->height() + 2 * pad;
+    const int width = blob_bottom_->width() + 2 * pad;
+    const int top_height = blob_top_->height();
+    const int top_width = blob_top_->width();
+    for (int n = 0; n < blob_top_->num(); ++n) {
+      for (int c = 0; c < blob_top_->channels(); ++c) {
+        for (int y = 0; y < top_height; ++y) {
+          const float ry = top_height > 1 ?
+              float(height - 1) * y / (top_height - 1) : 0;
+          const int y0 = ry;
+          const int y1 = std::min(y0 + 1, height - 1);
+          for (int x = 0; x < top_width; ++x) {
+            const float rx = top_width > 1 ?
+                float(width - 1) * x / (top_width - 1) : 0;
+            const int x0 = rx;
+            const int x1 = std::min(x0 + 1, width - 1);
+            const Dtype expected =
+                (y0 + 1 - ry) * ((x0 + 1 - rx) * Bottom(n, c, y0, x0, pad) +
+                    (rx - x0) * Bottom(n, c, y0, x1, pad)) +
+                (ry - y0) * ((x0 + 1 - rx) * Bottom(n, c, y1, x0, pad) +
+                    (rx - x0) * Bottom(n, c, y1, x1, pad));
+            EXPECT_NEAR(expected, blob_top_->data_at(n, c, y, x), 1e-5);
+          }
+        }
+      }
+    }
+  }
+
+  Dtype Bottom(int n, int c, int y, int x, int pad) {
+    return blob_bottom_->data_at(n, c, y - pad, x - pad);
+  }
+
+  void TestForward(const LayerParameter& layer_param) {
+    const SimdLevel level = caffe_simd_level();
+    for (int l = SIMD_SCALAR; l <= level; ++l) {
+      caffe_set_simd_level(static_cast<SimdLevel>(l));
+      // Rows of the planes are split among the threads.
+      Caffe::set_num_threads(l + 1);
+      InterpLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      CheckInterp(layer_param.interp_param().pad_beg());
+    }
+    Caffe::set_num_threads(1);
+  }
+
   Blob<Dtype>* const blob_bottom_;
   Blob<Dtype>* const blob_top_;
   vector<Blob<Dtype>*> blob_bottom_vec_;
@@ -51,6 +103,32 @@ TYPED_TEST(InterpLayerTest, TestSetup) {
   EXPECT_EQ(this->blob_top_->width(), 9);
 }
 
+TYPED_TEST(InterpLayerTest, TestForward) {
+  LayerParameter layer_param;
+  InterpParameter* interp_param =
+      layer_param.mutable_interp_param();
+  interp_param->set_height(11);
+  interp_param->set_width(9);
+  this->TestForward(layer_param);
+  interp_param->set_height(4);
+  interp_param->set_width(3);
+  this->TestForward(layer_param);
+}
+
+TYPED_TEST(InterpLayerTest, TestForwardZoomCropped) {
+  LayerParameter layer_param;
+  InterpParameter* interp_param =
+      layer_param.mutable_interp_param();
+  interp_param->set_zoom_factor(3);
+  interp_param->set_pad_beg(-1);
+  interp_param->set_pad_end(-1);
+  this->TestForward(layer_param);
+  interp_param->clear_zoom_factor();
+  interp_param->set_height(4);
+  interp_param->set_width(3);
+  this->TestForward(layer_param);
+}
+
 TYPED_TEST(InterpLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
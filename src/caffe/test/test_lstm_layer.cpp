@@ -6,7 +6,9 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layers/gru_layer.hpp"
 #include "caffe/layers/lstm_layer.hpp"
+#include "caffe/layers/lstm_v2_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -69,6 +71,60 @@ class LSTMLayerTest : public MultiDeviceTest<TypeParam> {
     filler.Fill(&unit_blob_bottom_x_);
   }
 
+  // Checks that the fused mode computes what the unrolled net does, given
+  // the same parameters, over two batches of a sequence.
+  template <typename LayerType>
+  void CheckFusedForward(LayerParameter layer_param, bool static_input) {
+    const int kNumTimesteps = 4;
+    const int num = blob_bottom_.shape(1);
+    ReshapeBlobs(kNumTimesteps, num);
+    // Stream 0 continues across batches; the others begin at timestep 0,
+    // and stream 1 begins another sequence at timestep 2.
+    for (int t = 0; t < kNumTimesteps; ++t) {
+      for (int n = 0; n < num; ++n) {
+        blob_bottom_cont_.mutable_cpu_data()[t * num + n] =
+            !((t == 0 && n > 0) || (t == 2 && n == 1));
+      }
+    }
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&blob_bottom_);
+    filler.Fill(&blob_bottom_static_);
+    vector<Blob<Dtype>*> bottom_vec(blob_bottom_vec_);
+    if (static_input) {
+      bottom_vec.push_back(&blob_bottom_static_);
+    }
+
+    LayerType unrolled(layer_param);
+    unrolled.SetUp(bottom_vec, blob_top_vec_);
+    layer_param.mutable_recurrent_param()->set_fused(true);
+    LayerType fused(layer_param);
+    Blob<Dtype> fused_top;
+    vector<Blob<Dtype>*> fused_top_vec(1, &fused_top);
+    fused.SetUp(bottom_vec, fused_top_vec);
+    ASSERT_EQ(unrolled.blobs().size(), fused.blobs().size());
+    for (int i = 0; i < fused.blobs().size(); ++i) {
+      ASSERT_TRUE(unrolled.blobs()[i]->shape() == fused.blobs()[i]->shape());
+      fused.blobs()[i]->CopyFrom(*unrolled.blobs()[i]);
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass > 0) {
+        // New weights, which the fused layer must pick up.
+        for (int i = 0; i < fused.blobs().size(); ++i) {
+          filler.Fill(unrolled.blobs()[i].get());
+          fused.blobs()[i]->CopyFrom(*unrolled.blobs()[i]);
+        }
+      }
+      unrolled.Forward(bottom_vec, blob_top_vec_);
+      fused.Forward(bottom_vec, fused_top_vec);
+      ASSERT_TRUE(blob_top_.shape() == fused_top.shape());
+      for (int i = 0; i < fused_top.count(); ++i) {
+        EXPECT_NEAR(blob_top_.cpu_data()[i], fused_top.cpu_data()[i], 1e-5);
+      }
+    }
+  }
+
   int num_output_;
   LayerParameter layer_param_;
   Blob<Dtype> blob_bottom_;
@@ -284,5 +340,35 @@ TYPED_TEST(LSTMLayerTest, TestGradientNonZeroContBufferSize2WithStaticInput) {
       this->blob_top_vec_, 2);
 }
 
+TYPED_TEST(LSTMLayerTest, TestFusedForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->template CheckFusedForward<LSTMLayer<Dtype> >(this->layer_param_,
+      false);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedForwardWithStaticInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->template CheckFusedForward<LSTMLayer<Dtype> >(this->layer_param_,
+      true);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedForwardLSTMV2) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->template CheckFusedForward<LSTMV2Layer<Dtype> >(this->layer_param_,
+      true);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedForwardGRU) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->template CheckFusedForward<GRULayer<Dtype> >(this->layer_param_,
+      true);
+}
+
+TYPED_TEST(LSTMLayerTest, TestFusedForwardGRULinearBeforeReset) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->layer_param_.mutable_recurrent_param()->set_linear_before_reset(1);
+  this->template CheckFusedForward<GRULayer<Dtype> >(this->layer_param_,
+      false);
+}
 
 }  // namespace caffe
@@ -1,6 +1,9 @@
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <climits>
 #include <cmath>  // for std::fabs
+#include <limits>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -8,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -119,6 +123,69 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+// The vectorized kernels must reproduce the scalar code bit for bit, so
+// both run on the same integer-valued data and the results are compared.
+TYPED_TEST(CPUMathFunctionsTest, TestMultiplyByQuantizedMultiplierSimd) {
+  const int n = 1000 + 13;  // leaves a tail for the scalar loop
+  vector<TypeParam> data(n);
+  caffe_rng_uniform<TypeParam>(n, TypeParam(-3e6), TypeParam(3e6), &data[0]);
+  for (int i = 0; i < n; ++i) {
+    data[i] = std::floor(data[i]);
+  }
+  data[5] = TypeParam(INT_MAX);
+  data[6] = TypeParam(-2147483648.0);
+  data[n - 20] = TypeParam(5e9);  // out of the int32 range
+  const double scales[] = {1.7e-5, 3.1e-3, 0.0472, 0.37, 0.5, 0.99};
+  for (int round_mode = 1; round_mode <= 2; ++round_mode) {
+    for (int s = 0; s < sizeof(scales) / sizeof(scales[0]); ++s) {
+      int shift;
+      const int mul = tfl_QuantizeMultiplier(scales[s], &shift);
+      vector<TypeParam> expected(data), actual(data);
+      vector<int> expected_int(n), actual_int(n);
+      for (int i = 0; i < n; ++i) {
+        expected_int[i] = actual_int[i] = static_cast<int>(data[i] / 64);
+      }
+      const SimdLevel level = caffe_simd_level();
+      caffe_set_simd_level(SIMD_SCALAR);
+      MultiplyByQuantizedMultiplierVR(n, &expected[0], mul, shift, round_mode);
+      MultiplyByQuantizedMultiplierVR(n, &expected_int[0], mul, shift,
+          round_mode);
+      caffe_set_simd_level(level);
+      MultiplyByQuantizedMultiplierVR(n, &actual[0], mul, shift, round_mode);
+      MultiplyByQuantizedMultiplierVR(n, &actual_int[0], mul, shift,
+          round_mode);
+      for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(expected[i], actual[i])
+            << "round_mode " << round_mode << " scale " << scales[s];
+        EXPECT_EQ(expected_int[i], actual_int[i])
+            << "round_mode " << round_mode << " scale " << scales[s];
+      }
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestSaturateSimd) {
+  const int n = this->blob_bottom_->count();
+  TypeParam* x = this->blob_bottom_->mutable_cpu_data();
+  caffe_scal<TypeParam>(n, TypeParam(300), x);
+  x[3] = std::numeric_limits<TypeParam>::quiet_NaN();
+  x[4] = TypeParam(-0.0);
+  vector<TypeParam> expected(x, x + n);
+  const SimdLevel level = caffe_simd_level();
+  caffe_set_simd_level(SIMD_SCALAR);
+  caffe_cpu_signed_8bit_saturate(n, &expected[0]);
+  caffe_set_simd_level(level);
+  caffe_cpu_signed_8bit_saturate(n, x);
+  for (int i = 0; i < n; ++i) {
+    if (std::isnan(expected[i])) {
+      EXPECT_TRUE(std::isnan(x[i]));
+    } else {
+      EXPECT_EQ(expected[i], x[i]);
+      EXPECT_EQ(std::signbit(expected[i]), std::signbit(x[i]));
+    }
+  }
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
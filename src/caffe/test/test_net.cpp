@@ -1,3 +1,4 @@
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -10,6 +11,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -564,8 +566,8 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
-  virtual void InitReshapableNet() {
-    const string& proto =
+  virtual void InitReshapableNet(const string& net_options = "") {
+    const string& proto = net_options +
         "name: 'ReshapableNetwork' "
         "layer { "
         "  name: 'data' "
@@ -629,6 +631,248 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitFoldNet(const string& net_options = "") {
+    const string& proto = net_options +
+        "name: 'FoldNetwork' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 9 dim: 7 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'scale1' "
+        "  type: 'Scale' "
+        "  bottom: 'conv1' "
+        "  top: 'scale1' "
+        "  scale_param { "
+        "    bias_term: true "
+        "    filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'scale1' "
+        "  top: 'scale1' "
+        "  relu_param { negative_slope: 0.1 relu6: true } "
+        "} "
+        "layer { "
+        "  name: 'deconv' "
+        "  type: 'Deconvolution' "
+        "  bottom: 'scale1' "
+        "  top: 'deconv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'scale2' "
+        "  type: 'Scale' "
+        "  bottom: 'deconv' "
+        "  top: 'deconv' "
+        "  scale_param { filler { type: 'gaussian' } } "
+        "} "
+        "layer { "
+        "  name: 'hswish' "
+        "  type: 'HardSwish' "
+        "  bottom: 'deconv' "
+        "  top: 'deconv' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'deconv' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bias' "
+        "  type: 'Bias' "
+        "  bottom: 'ip' "
+        "  top: 'ip' "
+        "  bias_param { filler { type: 'gaussian' } } "
+        "} "
+        "layer { "
+        "  name: 'clip' "
+        "  type: 'Clip' "
+        "  bottom: 'ip' "
+        "  top: 'ip' "
+        "  clip_param { min: -1 max: 1.5 } "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'scale1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 2 "
+        "    kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitNHWCNet(const string& net_options = "") {
+    const string& proto = net_options +
+        "name: 'NHWCNetwork' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 13 dim: 11 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'scale1' "
+        "  type: 'Scale' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "  scale_param { "
+        "    bias_term: true "
+        "    filler { type: 'gaussian' } "
+        "    bias_filler { type: 'gaussian' } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 3 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv_dw' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv_dw' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    group: 8 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv_pw' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv_dw' "
+        "  top: 'conv_pw' "
+        "  convolution_param { "
+        "    num_output: 8 "
+        "    kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'pool1' "
+        "  bottom: 'conv_pw' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'sum' "
+        "  bottom: 'conv_dw' "
+        "  top: 'concat' "
+        "} "
+        "layer { "
+        "  name: 'norm' "
+        "  type: 'LRN' "
+        "  bottom: 'concat' "
+        "  top: 'norm' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'norm' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    stride: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'conv2' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { type: 'gaussian' } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
   virtual void InitSkipPropNet(bool test_skip_true) {
     string proto =
       "name: 'SkipPropTestNetwork' "
@@ -1423,6 +1667,62 @@ TYPED_TEST(NetTest, TestParamPropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestProfiler) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet(true);
+  EXPECT_FALSE(this->net_->profiler());
+  this->net_->EnableProfiler(true);
+  const int kIterations = 3;
+  for (int i = 0; i < kIterations; ++i) {
+    this->net_->Forward();
+    this->net_->Backward();
+  }
+  this->net_->Reshape();
+  this->net_->EnableProfiler(false);
+  // Nothing is recorded once profiling stops.
+  this->net_->Forward();
+  const Profiler& profiler = *this->net_->profiler();
+  ASSERT_EQ(this->net_->layers().size(), profiler.num_layers());
+  for (int i = 0; i < profiler.num_layers(); ++i) {
+    EXPECT_EQ(kIterations,
+        profiler.LayerStats(i, Profiler::FORWARD).count);
+    EXPECT_EQ(this->net_->layer_need_backward()[i] ? kIterations : 0,
+        profiler.LayerStats(i, Profiler::BACKWARD).count);
+    EXPECT_EQ(1, profiler.LayerStats(i, Profiler::RESHAPE).count);
+    EXPECT_EQ(0, profiler.LayerStats(i, Profiler::DATA_WAIT).count);
+  }
+  const string report = profiler.Report();
+  const string top = "\"tops\": [{\"name\": \"innerproduct\", \"bytes\": ";
+  std::ostringstream bytes;
+  bytes << 5 * 1000 * sizeof(Dtype) << "}]";
+  EXPECT_NE(string::npos, report.find(top + bytes.str()));
+  EXPECT_NE(string::npos, report.find("\"p99_ms\""));
+  const string trace = profiler.ChromeTrace();
+  EXPECT_NE(string::npos, trace.find("\"cat\": \"backward\""));
+  this->net_->profiler()->Clear();
+  EXPECT_EQ(0, profiler.LayerStats(0, Profiler::FORWARD).count);
+}
+
+TEST(ProfilerTest, TestComputeStats) {
+  vector<float> samples;
+  for (int i = 100; i >= 1; --i) {
+    samples.push_back(i * 1000);
+  }
+  Profiler::Stats stats = Profiler::ComputeStats(samples);
+  EXPECT_EQ(100, stats.count);
+  EXPECT_DOUBLE_EQ(50.5, stats.mean_ms);
+  EXPECT_DOUBLE_EQ(5050, stats.total_ms);
+  EXPECT_DOUBLE_EQ(50, stats.p50_ms);
+  EXPECT_DOUBLE_EQ(90, stats.p90_ms);
+  EXPECT_DOUBLE_EQ(99, stats.p99_ms);
+  EXPECT_DOUBLE_EQ(100, stats.max_ms);
+  samples.resize(1);
+  stats = Profiler::ComputeStats(samples);
+  EXPECT_DOUBLE_EQ(100, stats.p50_ms);
+  EXPECT_DOUBLE_EQ(100, stats.p99_ms);
+  EXPECT_EQ(0, Profiler::ComputeStats(vector<float>()).count);
+}
+
 TYPED_TEST(NetTest, TestFromTo) {
   typedef typename TypeParam::Dtype Dtype;
   this->InitTinyNet();
@@ -2446,6 +2746,434 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestShareBlobMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> blob1(2, 3, 12, 10);
+  Blob<Dtype> blob2(4, 3, 9, 11);
+  filler.Fill(&blob1);
+  filler.Fill(&blob2);
+
+  this->InitReshapableNet();
+  shared_ptr<Net<Dtype> > net = this->net_;
+  this->InitReshapableNet("share_blob_memory: true ");
+  shared_ptr<Net<Dtype> > shared_net = this->net_;
+  shared_net->ShareTrainedLayersWith(net.get());
+  // conv1 is last read by pool1, before norm1 is written. pool1 is also held
+  // by the internal layers of LRN, and data and softmax are net blobs.
+  EXPECT_EQ(shared_net->blob_by_name("conv1")->data(),
+      shared_net->blob_by_name("norm1")->data());
+  EXPECT_NE(shared_net->blob_by_name("conv1")->data(),
+      shared_net->blob_by_name("pool1")->data());
+  EXPECT_NE(shared_net->blob_by_name("conv1")->data(),
+      shared_net->blob_by_name("data")->data());
+  EXPECT_NE(shared_net->blob_by_name("norm1")->data(),
+      shared_net->blob_by_name("softmax")->data());
+
+  Blob<Dtype>* blobs[] = { &blob1, &blob2 };
+  for (int i = 0; i < 2; ++i) {
+    for (int k = 0; k < 2; ++k) {
+      Net<Dtype>* current = k ? shared_net.get() : net.get();
+      Blob<Dtype>* input_blob = current->blob_by_name("data").get();
+      input_blob->ReshapeLike(*blobs[i]);
+      caffe_copy(blobs[i]->count(), blobs[i]->cpu_data(),
+          input_blob->mutable_cpu_data());
+      // The second shape is larger, so Forward first gives the blobs that
+      // grow memory of their own and Reshape then shares it again.
+      current->Forward();
+      if (k) {
+        const Blob<Dtype>& output = *net->output_blobs()[0];
+        const Blob<Dtype>& shared_output = *shared_net->output_blobs()[0];
+        ASSERT_EQ(output.count(), shared_output.count());
+        for (int j = 0; j < output.count(); ++j) {
+          EXPECT_EQ(output.cpu_data()[j], shared_output.cpu_data()[j]);
+        }
+      }
+    }
+  }
+  shared_net->Reshape();
+  EXPECT_EQ(shared_net->blob_by_name("conv1")->data(),
+      shared_net->blob_by_name("norm1")->data());
+  shared_net->Forward();
+  const Blob<Dtype>& output = *net->output_blobs()[0];
+  const Blob<Dtype>& shared_output = *shared_net->output_blobs()[0];
+  for (int j = 0; j < output.count(); ++j) {
+    EXPECT_EQ(output.cpu_data()[j], shared_output.cpu_data()[j]);
+  }
+}
+
+TYPED_TEST(NetTest, TestShareBlobMemoryAliasedTop) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The no-op Permute points permuted at the memory of doubled, which must
+  // then stay alive until sum reads permuted, after tripled is written.
+  const string& proto =
+      "share_blob_memory: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } "
+      "} "
+      "layer { "
+      "  name: 'double' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'doubled' "
+      "  power_param { scale: 2 } "
+      "} "
+      "layer { "
+      "  name: 'permute' "
+      "  type: 'Permute' "
+      "  bottom: 'doubled' "
+      "  top: 'permuted' "
+      "  permute_param { order: 0 order: 1 order: 2 order: 3 } "
+      "} "
+      "layer { "
+      "  name: 'triple' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'tripled' "
+      "  power_param { scale: 3 } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'permuted' "
+      "  bottom: 'tripled' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  EXPECT_EQ(this->net_->blob_by_name("doubled")->data(),
+      this->net_->blob_by_name("permuted")->data());
+  EXPECT_NE(this->net_->blob_by_name("doubled")->data(),
+      this->net_->blob_by_name("tripled")->data());
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  for (int i = 0; i < data->count(); ++i) {
+    data->mutable_cpu_data()[i] = i;
+  }
+  this->net_->Forward();
+  const Blob<Dtype>& sum = *this->net_->blob_by_name("sum");
+  for (int i = 0; i < sum.count(); ++i) {
+    EXPECT_EQ(5 * i, sum.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestShareBlobMemoryReshapingLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Flatten, ExpandDimsND and Squeeze point their top at the memory of their
+  // bottom, which the plan must then keep alive until sum reads squeezed.
+  const string& layers =
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } "
+      "} "
+      "layer { "
+      "  name: 'double' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'doubled' "
+      "  power_param { scale: 2 } "
+      "} "
+      "layer { "
+      "  name: 'flatten' "
+      "  type: 'Flatten' "
+      "  bottom: 'doubled' "
+      "  top: 'flattened' "
+      "} "
+      "layer { "
+      "  name: 'expand' "
+      "  type: 'ExpandDimsND' "
+      "  bottom: 'flattened' "
+      "  top: 'expanded' "
+      "  expand_dims_nd_param { axis: 1 } "
+      "} "
+      "layer { "
+      "  name: 'squeeze' "
+      "  type: 'Squeeze' "
+      "  bottom: 'expanded' "
+      "  top: 'squeezed' "
+      "  squeeze_param { axis: 1 } "
+      "} "
+      "layer { "
+      "  name: 'triple' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'tripled' "
+      "  power_param { scale: 3 } "
+      "} "
+      "layer { "
+      "  name: 'flatten_tripled' "
+      "  type: 'Flatten' "
+      "  bottom: 'tripled' "
+      "  top: 'flattened_tripled' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'squeezed' "
+      "  bottom: 'flattened_tripled' "
+      "  top: 'sum' "
+      "} ";
+  vector<Dtype> sums[2];
+  for (int planned = 0; planned < 2; ++planned) {
+    this->InitNetFromProtoString(
+        (planned ? "share_blob_memory: true " : "") + layers);
+    EXPECT_EQ(this->net_->blob_by_name("doubled")->data(),
+        this->net_->blob_by_name("squeezed")->data());
+    Blob<Dtype>* data = this->net_->input_blobs()[0];
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = i;
+    }
+    this->net_->Forward();
+    const Blob<Dtype>& sum = *this->net_->blob_by_name("sum");
+    sums[planned].assign(sum.cpu_data(), sum.cpu_data() + sum.count());
+  }
+  ASSERT_EQ(sums[0].size(), sums[1].size());
+  for (int i = 0; i < sums[0].size(); ++i) {
+    EXPECT_EQ(5 * i, sums[0][i]);
+    EXPECT_EQ(sums[0][i], sums[1][i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestNHWCDataFormat) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitNHWCNet();
+  shared_ptr<Net<Dtype> > net = this->net_;
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> uniform_filler(filler_param);
+  const vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      net->layer_by_name("bn1")->blobs();
+  for (int i = 0; i < bn_blobs.size(); ++i) {
+    uniform_filler.Fill(bn_blobs[i].get());
+  }
+  this->InitNHWCNet("data_format: 'NHWC' ");
+  shared_ptr<Net<Dtype> > nhwc_net = this->net_;
+  nhwc_net->ShareTrainedLayersWith(net.get());
+
+  // In NHWC from conv1 to concat, which LRN needs back in NCHW, and from
+  // conv2 until InnerProduct.
+  int num_permutes = 0;
+  set<string> layer_names;
+  for (int i = 0; i < nhwc_net->layers().size(); ++i) {
+    const LayerParameter& layer_param = nhwc_net->layers()[i]->layer_param();
+    if (layer_param.type() == "Permute") {
+      ++num_permutes;
+    }
+    EXPECT_TRUE(layer_names.insert(layer_param.name()).second)
+        << "Duplicate layer " << layer_param.name();
+    const bool nhwc = layer_param.data_format() == "NHWC";
+    const string& name = layer_param.name();
+    EXPECT_EQ(Caffe::mode() == Caffe::CPU && name != "norm" && name != "ip" &&
+        name != "data" && layer_param.type() != "Permute" &&
+        layer_param.type() != "Split", nhwc) << name;
+  }
+  if (Caffe::mode() == Caffe::CPU) {
+    EXPECT_EQ(4, num_permutes);
+    EXPECT_TRUE(nhwc_net->has_blob("conv1_nhwc"));
+    EXPECT_TRUE(nhwc_net->has_blob("concat"));
+    EXPECT_FALSE(nhwc_net->has_blob("conv1"));
+    // The Permute back to the blob concat is not named after it, as the
+    // layer concat is.
+    EXPECT_EQ(string("Concat"), nhwc_net->layer_by_name("concat")->type());
+  } else {
+    EXPECT_EQ(0, num_permutes);
+  }
+
+  FillerParameter data_filler_param;
+  GaussianFiller<Dtype> filler(data_filler_param);
+  filler.Fill(net->blob_by_name("data").get());
+  nhwc_net->blob_by_name("data")->CopyFrom(*net->blob_by_name("data"));
+  net->Forward();
+  nhwc_net->Forward();
+  const Blob<Dtype>& output = *net->output_blobs()[0];
+  const Blob<Dtype>& nhwc_output = *nhwc_net->output_blobs()[0];
+  ASSERT_TRUE(output.shape() == nhwc_output.shape());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_NEAR(output.cpu_data()[i], nhwc_output.cpu_data()[i],
+        1e-4 * std::max(Dtype(1), std::fabs(output.cpu_data()[i])));
+  }
+}
+
+TYPED_TEST(NetTest, TestFoldInferenceLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitFoldNet();
+  shared_ptr<Net<Dtype> > net = this->net_;
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> uniform_filler(filler_param);
+  const vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      net->layer_by_name("bn1")->blobs();
+  for (int i = 0; i < bn_blobs.size(); ++i) {
+    uniform_filler.Fill(bn_blobs[i].get());
+  }
+  NetParameter trained_param;
+  net->ToProto(&trained_param, false);
+  this->InitFoldNet("fold_inference_layers: true ");
+  shared_ptr<Net<Dtype> > folded_net = this->net_;
+  folded_net->CopyTrainedLayersFrom(trained_param);
+
+  // The affine layers are gone everywhere, the activations on the CPU.
+  const bool cpu = Caffe::mode() == Caffe::CPU;
+  EXPECT_FALSE(folded_net->has_layer("bn1"));
+  EXPECT_FALSE(folded_net->has_layer("scale1"));
+  EXPECT_FALSE(folded_net->has_layer("scale2"));
+  EXPECT_FALSE(folded_net->has_layer("bias"));
+  EXPECT_EQ(!cpu, folded_net->has_layer("relu1"));
+  EXPECT_EQ(!cpu, folded_net->has_layer("hswish"));
+  EXPECT_EQ(!cpu, folded_net->has_layer("clip"));
+  EXPECT_FALSE(folded_net->has_blob("conv1"));
+  EXPECT_TRUE(folded_net->has_blob("scale1"));
+  const LayerParameter& conv1_param =
+      folded_net->layer_by_name("conv1")->layer_param();
+  EXPECT_TRUE(conv1_param.convolution_param().bias_term());
+  EXPECT_EQ(cpu ? FusedActivationParameter_Type_RELU :
+      FusedActivationParameter_Type_NONE,
+      conv1_param.fused_activation_param().type());
+  EXPECT_EQ(2, folded_net->layer_by_name("conv1")->blobs().size());
+
+  FillerParameter data_filler_param;
+  GaussianFiller<Dtype> filler(data_filler_param);
+  filler.Fill(net->blob_by_name("data").get());
+  folded_net->blob_by_name("data")->CopyFrom(*net->blob_by_name("data"));
+  net->Forward();
+  folded_net->Forward();
+  for (int i = 0; i < net->output_blobs().size(); ++i) {
+    const Blob<Dtype>& output = *net->output_blobs()[i];
+    const Blob<Dtype>& folded_output =
+        *folded_net->blob_by_name(net->blob_names()[
+        net->output_blob_indices()[i]]);
+    ASSERT_TRUE(output.shape() == folded_output.shape());
+    for (int j = 0; j < output.count(); ++j) {
+      EXPECT_NEAR(output.cpu_data()[j], folded_output.cpu_data()[j],
+          1e-4 * std::max(Dtype(1), std::fabs(output.cpu_data()[j])));
+    }
+  }
+
+  // Sharing refolds the weights.
+  const vector<shared_ptr<Blob<Dtype> > >& scale_blobs =
+      net->layer_by_name("scale2")->blobs();
+  caffe_scal(scale_blobs[0]->count(), Dtype(-2),
+      scale_blobs[0]->mutable_cpu_data());
+  folded_net->ShareTrainedLayersWith(net.get());
+  net->Forward();
+  folded_net->Forward();
+  const Blob<Dtype>& output = *net->blob_by_name("ip");
+  const Blob<Dtype>& folded_output = *folded_net->blob_by_name("ip");
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_NEAR(output.cpu_data()[i], folded_output.cpu_data()[i],
+        1e-4 * std::max(Dtype(1), std::fabs(output.cpu_data()[i])));
+  }
+
+  // Sharing with a folded net shares its folded weights as they are, though
+  // conv1 has a bias only once folded.
+  this->InitFoldNet("fold_inference_layers: true ");
+  shared_ptr<Net<Dtype> > shared_net = this->net_;
+  shared_net->ShareTrainedLayersWith(folded_net.get());
+  const vector<shared_ptr<Blob<Dtype> > >& conv1_blobs =
+      folded_net->layer_by_name("conv1")->blobs();
+  const vector<shared_ptr<Blob<Dtype> > >& shared_conv1_blobs =
+      shared_net->layer_by_name("conv1")->blobs();
+  ASSERT_EQ(conv1_blobs.size(), shared_conv1_blobs.size());
+  for (int i = 0; i < conv1_blobs.size(); ++i) {
+    EXPECT_EQ(conv1_blobs[i]->cpu_data(), shared_conv1_blobs[i]->cpu_data());
+  }
+  shared_net->blob_by_name("data")->CopyFrom(*net->blob_by_name("data"));
+  shared_net->Forward();
+  const Blob<Dtype>& shared_output = *shared_net->blob_by_name("ip");
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_NEAR(output.cpu_data()[i], shared_output.cpu_data()[i],
+        1e-4 * std::max(Dtype(1), std::fabs(output.cpu_data()[i])));
+  }
+}
+
+TYPED_TEST(NetTest, TestCopyTrainedLayersFromMapped) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitTinyNet();
+  shared_ptr<Net<Dtype> > net = this->net_;
+  NetParameter trained_param;
+  net->ToProto(&trained_param, false);
+  string filename;
+  MakeTempFilename(&filename);
+  WriteMappedWeights(trained_param, filename);
+  // The weights in the deprecated 4D shapes, as floats.
+  NetParameter legacy_param(trained_param);
+  for (int i = 0; i < legacy_param.layer_size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        net->layer_by_name(legacy_param.layer(i).name())->blobs();
+    for (int j = 0; j < legacy_param.layer(i).blobs_size(); ++j) {
+      BlobProto* blob_proto = legacy_param.mutable_layer(i)->mutable_blobs(j);
+      blob_proto->Clear();
+      blob_proto->set_num(blobs[j]->LegacyShape(-4));
+      blob_proto->set_channels(blobs[j]->LegacyShape(-3));
+      blob_proto->set_height(blobs[j]->LegacyShape(-2));
+      blob_proto->set_width(blobs[j]->LegacyShape(-1));
+      for (int k = 0; k < blobs[j]->count(); ++k) {
+        blob_proto->add_data(blobs[j]->cpu_data()[k]);
+      }
+    }
+  }
+  string legacy_filename;
+  MakeTempFilename(&legacy_filename);
+  WriteMappedWeights(legacy_param, legacy_filename);
+
+  const string filenames[] = {filename, legacy_filename};
+  for (int f = 0; f < 2; ++f) {
+    Caffe::set_random_seed(this->seed_ + 1);
+    this->InitTinyNet();
+    shared_ptr<Net<Dtype> > mapped_net = this->net_;
+    mapped_net->CopyTrainedLayersFrom(filenames[f]);
+    Caffe::set_random_seed(this->seed_ + 2);
+    this->InitTinyNet();
+    shared_ptr<Net<Dtype> > other_mapped_net = this->net_;
+    other_mapped_net->CopyTrainedLayersFrom(filenames[f]);
+    const vector<shared_ptr<Blob<Dtype> > >& params = net->params();
+    const vector<shared_ptr<Blob<Dtype> > >& mapped_params =
+        mapped_net->params();
+    ASSERT_EQ(params.size(), mapped_params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      ASSERT_TRUE(params[i]->shape() == mapped_params[i]->shape());
+      for (int j = 0; j < params[i]->count(); ++j) {
+        const Dtype expected = f == 0 ? params[i]->cpu_data()[j] :
+            static_cast<float>(params[i]->cpu_data()[j]);
+        EXPECT_EQ(expected, mapped_params[i]->cpu_data()[j]);
+      }
+    }
+    // Writing the weights of a net leaves the file, and so other nets
+    // mapping it, unchanged.
+    caffe_set(mapped_params[0]->count(), Dtype(1),
+        mapped_params[0]->mutable_cpu_data());
+    const Blob<Dtype>& other_weights = *other_mapped_net->params()[0];
+    for (int j = 0; j < other_weights.count(); ++j) {
+      EXPECT_NE(Dtype(1), other_weights.cpu_data()[j]);
+    }
+    // The mapping outlives the net the weights were shared from.
+    Caffe::set_random_seed(this->seed_ + 3);
+    this->InitTinyNet();
+    shared_ptr<Net<Dtype> > shared_net = this->net_;
+    shared_net->ShareTrainedLayersWith(other_mapped_net.get());
+    other_mapped_net.reset();
+    shared_net->blob_by_name("data")->CopyFrom(*net->blob_by_name("data"));
+    shared_net->blob_by_name("label")->CopyFrom(*net->blob_by_name("label"));
+    net->ForwardFromTo(1, 2);
+    shared_net->ForwardFromTo(1, 2);
+    for (int j = 0; j < shared_net->output_blobs()[0]->count(); ++j) {
+      EXPECT_NEAR(net->output_blobs()[0]->cpu_data()[j],
+          shared_net->output_blobs()[0]->cpu_data()[j], 1e-5);
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
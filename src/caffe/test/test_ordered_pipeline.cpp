@@ -0,0 +1,51 @@
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class OrderedPipelineTest : public ::testing::Test {
+ protected:
+  // Produces the squares of [0, n) into the slots, and checks that they are
+  // consumed in order, from the slot they were produced in, and that no item
+  // runs further ahead of the consumer than the window.
+  void TestRun(const int n, const int num_workers, const int window) {
+    vector<int> slots(window, -1);
+    std::atomic<int> consumed(0);
+    RunOrderedPipeline(n, num_workers, window,
+        [&](int i, int slot) {
+          EXPECT_EQ(i % window, slot);
+          EXPECT_LT(i, consumed + window);
+          slots[slot] = i * i;
+        },
+        [&](int i, int slot) {
+          EXPECT_EQ(consumed, i);
+          EXPECT_EQ(i * i, slots[slot]);
+          slots[slot] = -1;
+          ++consumed;
+        });
+    EXPECT_EQ(n, consumed);
+  }
+};
+
+TEST_F(OrderedPipelineTest, TestSerial) {
+  this->TestRun(100, 0, 1);
+  this->TestRun(100, 0, 7);
+}
+
+TEST_F(OrderedPipelineTest, TestWorkers) {
+  this->TestRun(1000, 1, 1);
+  this->TestRun(1000, 4, 3);
+  this->TestRun(1000, 8, 32);
+  // More workers and slots than items.
+  this->TestRun(5, 8, 16);
+  this->TestRun(0, 4, 4);
+}
+
+}  // namespace caffe
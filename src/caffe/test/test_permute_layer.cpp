@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/permute_layer.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -242,6 +243,64 @@ TYPED_TEST(PermuteLayerTest, TestTwoPermute) {
   }
 }
 
+TYPED_TEST(PermuteLayerTest, TestForwardBackwardOrders) {
+  typedef typename TypeParam::Dtype Dtype;
+  // NCHW -> NHWC, NHWC -> NCHW, swapping the last two axes, a transpose of
+  // blocks and an order only the generic path handles, on blobs larger than
+  // a tile.
+  const int orders[][4] = {
+    {0, 2, 3, 1}, {0, 3, 1, 2}, {0, 1, 3, 2}, {1, 0, 2, 3}, {3, 1, 0, 2}
+  };
+  const int shape[] = {2, 37, 9, 35};
+  vector<int> steps(4, 1);
+  for (int i = 2; i >= 0; --i) {
+    steps[i] = steps[i + 1] * shape[i + 1];
+  }
+  this->blob_bottom_->Reshape(vector<int>(shape, shape + 4));
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  const SimdLevel level = caffe_simd_level();
+  for (int l = SIMD_SCALAR; l <= level; ++l) {
+    caffe_set_simd_level(static_cast<SimdLevel>(l));
+    for (int o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o) {
+      LayerParameter layer_param;
+      PermuteParameter* permute_param = layer_param.mutable_permute_param();
+      for (int i = 0; i < 4; ++i) {
+        permute_param->add_order(orders[o][i]);
+      }
+      PermuteLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      const Dtype* top_data = this->blob_top_->cpu_data();
+      int index = 0;
+      for (int i0 = 0; i0 < shape[orders[o][0]]; ++i0) {
+        for (int i1 = 0; i1 < shape[orders[o][1]]; ++i1) {
+          for (int i2 = 0; i2 < shape[orders[o][2]]; ++i2) {
+            for (int i3 = 0; i3 < shape[orders[o][3]]; ++i3, ++index) {
+              const int offset = i0 * steps[orders[o][0]] +
+                  i1 * steps[orders[o][1]] + i2 * steps[orders[o][2]] +
+                  i3 * steps[orders[o][3]];
+              ASSERT_EQ(bottom_data[offset], top_data[index]);
+            }
+          }
+        }
+      }
+      // Permuting the top back restores the bottom.
+      caffe_copy(this->blob_top_->count(), top_data,
+          this->blob_top_->mutable_cpu_diff());
+      vector<bool> propagate_down(1, true);
+      layer.Backward(this->blob_top_vec_, propagate_down,
+          this->blob_bottom_vec_);
+      for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+        ASSERT_EQ(bottom_data[i], this->blob_bottom_->cpu_diff()[i]);
+      }
+    }
+  }
+  caffe_set_simd_level(level);
+}
+
 TYPED_TEST(PermuteLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/permute.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -609,6 +610,95 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+template <typename Dtype>
+class NHWCPoolingLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  NHWCPoolingLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 5, 9, 8)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~NHWCPoolingLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Pools the NCHW bottom and its NHWC copy, and expects the NHWC top to be
+  // the NCHW one transposed, bit for bit.
+  void CheckNHWC(LayerParameter layer_param) {
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    const int to_nhwc[] = {0, 2, 3, 1};
+    const vector<int> order(to_nhwc, to_nhwc + 4);
+    Blob<Dtype> bottom_nhwc(blob_bottom_->shape(0), blob_bottom_->shape(2),
+        blob_bottom_->shape(3), blob_bottom_->shape(1));
+    caffe_cpu_permute(blob_bottom_->shape(), order, blob_bottom_->cpu_data(),
+        bottom_nhwc.mutable_cpu_data());
+    Blob<Dtype> expected(blob_top_->shape(0), blob_top_->shape(2),
+        blob_top_->shape(3), blob_top_->shape(1));
+    caffe_cpu_permute(blob_top_->shape(), order, blob_top_->cpu_data(),
+        expected.mutable_cpu_data());
+    layer_param.set_data_format("NHWC");
+    PoolingLayer<Dtype> nhwc_layer(layer_param);
+    Blob<Dtype> top_nhwc;
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom_nhwc);
+    vector<Blob<Dtype>*> top_vec(1, &top_nhwc);
+    nhwc_layer.SetUp(bottom_vec, top_vec);
+    nhwc_layer.Forward(bottom_vec, top_vec);
+    ASSERT_TRUE(top_nhwc.shape() == expected.shape());
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_EQ(expected.cpu_data()[i], top_nhwc.cpu_data()[i]);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(NHWCPoolingLayerTest, TestDtypes);
+
+TYPED_TEST(NHWCPoolingLayerTest, TestForward) {
+  const PoolingParameter_PoolMethod pool[] = {PoolingParameter_PoolMethod_MAX,
+      PoolingParameter_PoolMethod_AVE, PoolingParameter_PoolMethod_AVE_EXC_PAD};
+  for (int p = 0; p < 3; ++p) {
+    // Padded with ceil rounding, uneven padding with floor rounding, "SAME"
+    // padding and global pooling.
+    for (int c = 0; c < 4; ++c) {
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      pooling_param->set_pool(pool[p]);
+      if (c == 3) {
+        pooling_param->set_global_pooling(true);
+      } else {
+        pooling_param->set_kernel_h(3);
+        pooling_param->set_kernel_w(2);
+        pooling_param->set_stride(2);
+      }
+      if (c == 0) {
+        pooling_param->set_pad(1);
+      } else if (c == 1) {
+        pooling_param->set_ceil_mode(false);
+        pooling_param->set_pad_t(1);
+        pooling_param->set_pad_b(2);
+        pooling_param->set_pad_l(0);
+        pooling_param->set_pad_r(1);
+      } else if (c == 2) {
+        pooling_param->set_pad_type(1);
+      }
+      this->CheckNHWC(layer_param);
+    }
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
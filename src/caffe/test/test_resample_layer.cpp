@@ -0,0 +1,154 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/resample_layer.hpp"
+#include "caffe/util/math_functions_simd.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class ResampleLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  ResampleLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 9, 12)),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~ResampleLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  static float Coeff(const ResampleParameter_ResampleType type, float x) {
+    x = std::fabs(x);
+    if (type == ResampleParameter_ResampleType_CUBIC) {
+      if (x <= 1) return x * x * (1.5f * x - 2.5f) + 1;
+      if (x < 2) return x * (x * (-0.5f * x + 2.5f) - 4) + 2;
+      return 0;
+    }
+    return x <= 1 ? 1 - x : 0;
+  }
+
+  // The top pixel (y, x) as the filter of its window of the bottom,
+  // normalized by the sum of its weights.
+  Dtype Expected(const ResampleParameter& param, int n, int c, int y, int x) {
+    const int height = blob_bottom_->height();
+    const int width = blob_bottom_->width();
+    const float fx = float(width) / blob_top_->width();
+    const float fy = float(height) / blob_top_->height();
+    const float x_in = x * fx + fy / 2 - 0.5f;
+    const float y_in = y * fy + fx / 2 - 0.5f;
+    const int x_round = round(x_in);
+    const int y_round = round(y_in);
+    if (param.type() == ResampleParameter_ResampleType_NEAREST) {
+      return blob_bottom_->data_at(n, c, y_round, x_round);
+    }
+    const bool antialias = param.antialias() && (fx > 1 || fy > 1);
+    const float ax = antialias ? 1 / fx : 1;
+    const float ay = antialias ? 1 / fy : 1;
+    const int kernel_width =
+        param.type() == ResampleParameter_ResampleType_CUBIC ? 4 : 2;
+    const int rx = fx < 1 ? 2 : ceil(kernel_width / ax);
+    const int ry = fy < 1 ? 2 : ceil(kernel_width / ay);
+    Dtype sum = 0;
+    Dtype wsum = 0;
+    for (int j = y_round - ry; j <= y_round + ry; ++j) {
+      for (int i = x_round - rx; i <= x_round + rx; ++i) {
+        if (j < 0 || i < 0 || j >= height || i >= width) {
+          continue;
+        }
+        const float w = ax * Coeff(param.type(), ax * (x_in - i)) *
+            ay * Coeff(param.type(), ay * (y_in - j));
+        sum += w * blob_bottom_->data_at(n, c, j, i);
+        wsum += w;
+      }
+    }
+    return wsum ? sum / wsum : 0;
+  }
+
+  void TestForward(const ResampleParameter& param) {
+    LayerParameter layer_param;
+    layer_param.mutable_resample_param()->CopyFrom(param);
+    const SimdLevel level = caffe_simd_level();
+    for (int l = SIMD_SCALAR; l <= level; ++l) {
+      caffe_set_simd_level(static_cast<SimdLevel>(l));
+      // Rows of the planes are split among the threads.
+      Caffe::set_num_threads(l + 1);
+      ResampleLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      ASSERT_EQ(param.height(), blob_top_->height());
+      ASSERT_EQ(param.width(), blob_top_->width());
+      for (int n = 0; n < blob_top_->num(); ++n) {
+        for (int c = 0; c < blob_top_->channels(); ++c) {
+          for (int y = 0; y < blob_top_->height(); ++y) {
+            for (int x = 0; x < blob_top_->width(); ++x) {
+              EXPECT_NEAR(Expected(param, n, c, y, x),
+                  blob_top_->data_at(n, c, y, x), 1e-5);
+            }
+          }
+        }
+      }
+    }
+    Caffe::set_num_threads(1);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ResampleLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(ResampleLayerTest, TestForwardNearest) {
+  ResampleParameter param;
+  param.set_type(ResampleParameter_ResampleType_NEAREST);
+  param.set_height(18);
+  param.set_width(24);
+  this->TestForward(param);
+  param.set_height(3);
+  param.set_width(4);
+  this->TestForward(param);
+}
+
+TYPED_TEST(ResampleLayerTest, TestForwardLinear) {
+  ResampleParameter param;
+  param.set_type(ResampleParameter_ResampleType_LINEAR);
+  param.set_height(20);
+  param.set_width(17);
+  this->TestForward(param);
+  param.set_height(4);
+  param.set_width(5);
+  this->TestForward(param);
+  param.set_antialias(false);
+  this->TestForward(param);
+}
+
+TYPED_TEST(ResampleLayerTest, TestForwardCubic) {
+  ResampleParameter param;
+  param.set_type(ResampleParameter_ResampleType_CUBIC);
+  param.set_height(20);
+  param.set_width(17);
+  this->TestForward(param);
+  param.set_height(4);
+  param.set_width(5);
+  this->TestForward(param);
+}
+
+}  // namespace caffe
@@ -67,6 +67,99 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  SyncedMemory other(10);
+  EXPECT_NE(mem.version(), other.version());
+  const uint64_t version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), version);
+  mem.mutable_cpu_data();
+  EXPECT_NE(mem.version(), version);
+  EXPECT_NE(mem.version(), other.version());
+}
+
+TEST_F(SyncedMemoryTest, TestHostSizeClass) {
+  EXPECT_EQ(64, HostAllocator::SizeClass(0));
+  EXPECT_EQ(64, HostAllocator::SizeClass(64));
+  EXPECT_EQ(80, HostAllocator::SizeClass(65));
+  EXPECT_EQ(128, HostAllocator::SizeClass(128));
+  EXPECT_EQ(160, HostAllocator::SizeClass(129));
+  EXPECT_EQ(1280, HostAllocator::SizeClass(1100));
+  EXPECT_EQ(1 << 20, HostAllocator::SizeClass(1 << 20));
+  for (size_t size = 1; size < 100000; size = size * 3 / 2 + 1) {
+    const size_t size_class = HostAllocator::SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_LE(size_class, size * 5 / 4 + 64);
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestHostPool) {
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  HostAllocator& allocator = HostAllocator::Get();
+  allocator.set_max_retained_bytes(1 << 20);
+  allocator.ResetStats();
+  void* data;
+  {
+    SyncedMemory mem(1000);
+    data = mem.mutable_cpu_data();
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(data) % 64);
+    caffe_memset(mem.size(), 1, data);
+  }
+  EXPECT_EQ(1024, allocator.stats().retained_bytes);
+  {
+    // A buffer of the same size class is reused, and zeroed again.
+    SyncedMemory mem(1010);
+    EXPECT_EQ(data, mem.cpu_data());
+    for (int i = 0; i < mem.size(); ++i) {
+      EXPECT_EQ(0, (static_cast<const char*>(mem.cpu_data()))[i]);
+    }
+    SyncedMemory other(1010);
+    EXPECT_NE(data, other.cpu_data());
+  }
+  HostAllocator::Stats stats = allocator.stats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(2, stats.misses);
+  EXPECT_EQ(2048, stats.retained_bytes);
+  // Buffers that don't fit in the pool are freed.
+  allocator.set_max_retained_bytes(1024);
+  EXPECT_EQ(1024, allocator.stats().retained_bytes);
+  {
+    SyncedMemory mem(4096);
+    mem.cpu_data();
+  }
+  EXPECT_EQ(1024, allocator.stats().retained_bytes);
+  allocator.Trim();
+  EXPECT_EQ(0, allocator.stats().retained_bytes);
+  allocator.set_max_retained_bytes(0);
+}
+
+TEST_F(SyncedMemoryTest, TestHostNoZeroFill) {
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  HostAllocator& allocator = HostAllocator::Get();
+  allocator.set_max_retained_bytes(1 << 20);
+  {
+    SyncedMemory mem(100);
+    caffe_memset(mem.size(), 3, mem.mutable_cpu_data());
+  }
+  {
+    // Only the memory that opts out skips the zeroing.
+    SyncedMemory mem(100);
+    mem.set_zero_fill(false);
+    EXPECT_EQ(3, (static_cast<const char*>(mem.cpu_data()))[0]);
+    caffe_memset(mem.size(), 3, mem.mutable_cpu_data());
+  }
+  {
+    SyncedMemory mem(100);
+    EXPECT_EQ(0, (static_cast<const char*>(mem.cpu_data()))[0]);
+  }
+  allocator.set_max_retained_bytes(0);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
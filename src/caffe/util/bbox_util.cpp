@@ -11,6 +11,7 @@
 #include "boost/iterator/counting_iterator.hpp"
 
 #include "caffe/util/bbox_util.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 
 namespace caffe {
 
@@ -118,6 +119,80 @@ Dtype BBoxSize(const Dtype *bbox, const bool normalized) {
 template float BBoxSize(const float *bbox, const bool normalized);
 template double BBoxSize(const double *bbox, const bool normalized);
 
+void BBoxArray::clear() {
+  xmin.clear();
+  ymin.clear();
+  xmax.clear();
+  ymax.clear();
+  size.clear();
+}
+
+void BBoxArray::reserve(const int n) {
+  xmin.reserve(n);
+  ymin.reserve(n);
+  xmax.reserve(n);
+  ymax.reserve(n);
+  size.reserve(n);
+}
+
+void BBoxArray::push_back(const NormalizedBBox &bbox) {
+  xmin.push_back(bbox.xmin());
+  ymin.push_back(bbox.ymin());
+  xmax.push_back(bbox.xmax());
+  ymax.push_back(bbox.ymax());
+  size.push_back(BBoxSize(bbox));
+}
+
+void BBoxArray::Get(const int i, NormalizedBBox *bbox) const {
+  bbox->Clear();
+  bbox->set_xmin(xmin[i]);
+  bbox->set_ymin(ymin[i]);
+  bbox->set_xmax(xmax[i]);
+  bbox->set_ymax(ymax[i]);
+  bbox->set_size(size[i]);
+}
+
+void ToBBoxArray(const vector<NormalizedBBox> &bboxes,
+                 BBoxArray *bbox_array) {
+  bbox_array->clear();
+  bbox_array->reserve(bboxes.size());
+  for (int i = 0; i < bboxes.size(); ++i) {
+    bbox_array->push_back(bboxes[i]);
+  }
+}
+
+void FromBBoxArray(const BBoxArray &bbox_array,
+                   vector<NormalizedBBox> *bboxes) {
+  bboxes->resize(bbox_array.num());
+  for (int i = 0; i < bbox_array.num(); ++i) {
+    bbox_array.Get(i, &(*bboxes)[i]);
+  }
+}
+
+void ToBBoxArray(const vector<LabelBBox> &all_bboxes,
+                 vector<LabelBBoxArray> *all_bbox_arrays) {
+  all_bbox_arrays->clear();
+  all_bbox_arrays->resize(all_bboxes.size());
+  for (int i = 0; i < all_bboxes.size(); ++i) {
+    for (LabelBBox::const_iterator it = all_bboxes[i].begin();
+         it != all_bboxes[i].end(); ++it) {
+      ToBBoxArray(it->second, &(*all_bbox_arrays)[i][it->first]);
+    }
+  }
+}
+
+void FromBBoxArray(const vector<LabelBBoxArray> &all_bbox_arrays,
+                   vector<LabelBBox> *all_bboxes) {
+  all_bboxes->clear();
+  all_bboxes->resize(all_bbox_arrays.size());
+  for (int i = 0; i < all_bbox_arrays.size(); ++i) {
+    for (LabelBBoxArray::const_iterator it = all_bbox_arrays[i].begin();
+         it != all_bbox_arrays[i].end(); ++it) {
+      FromBBoxArray(it->second, &(*all_bboxes)[i][it->first]);
+    }
+  }
+}
+
 void ClipBBox(const NormalizedBBox &bbox, NormalizedBBox *clip_bbox) {
   clip_bbox->set_xmin(std::max(std::min(bbox.xmin(), 1.f), 0.f));
   clip_bbox->set_ymin(std::max(std::min(bbox.ymin(), 1.f), 0.f));
@@ -318,6 +393,58 @@ Dtype JaccardOverlap(const Dtype *bbox1, const Dtype *bbox2) {
 template float JaccardOverlap(const float *bbox1, const float *bbox2);
 template double JaccardOverlap(const double *bbox1, const double *bbox2);
 
+// Same arithmetic as JaccardOverlap(const NormalizedBBox&, ...): when the
+// boxes do not intersect, one of the clipped sides is <= 0 as well.
+static inline float JaccardOverlap(const float x1, const float y1,
+                                   const float x2, const float y2,
+                                   const float size1, const float xmin,
+                                   const float ymin, const float xmax,
+                                   const float ymax, const float size2) {
+  const float intersect_width = std::min(x2, xmax) - std::max(x1, xmin);
+  const float intersect_height = std::min(y2, ymax) - std::max(y1, ymin);
+  if (intersect_width > 0 && intersect_height > 0) {
+    const float intersect_size = intersect_width * intersect_height;
+    return intersect_size / (size1 + size2 - intersect_size);
+  } else {
+    return 0.;
+  }
+}
+
+float JaccardOverlap(const BBoxArray &bboxes, const int i, const int j) {
+  return JaccardOverlap(bboxes.xmin[i], bboxes.ymin[i], bboxes.xmax[i],
+                        bboxes.ymax[i], bboxes.size[i], bboxes.xmin[j],
+                        bboxes.ymin[j], bboxes.xmax[j], bboxes.ymax[j],
+                        bboxes.size[j]);
+}
+
+// Overlaps of box i of bboxes with the boxes [begin, end) of others.
+static void JaccardOverlap(const BBoxArray &bboxes, const int i,
+                           const BBoxArray &others, const int begin,
+                           const int end, float *overlaps) {
+  const int n = end - begin;
+  if (n <= 0) {
+    return;
+  }
+  const float bbox[5] = {bboxes.xmin[i], bboxes.ymin[i], bboxes.xmax[i],
+                         bboxes.ymax[i], bboxes.size[i]};
+  int k = caffe_simd_jaccard_overlap(n, bbox, &others.xmin[begin],
+                                     &others.ymin[begin], &others.xmax[begin],
+                                     &others.ymax[begin], &others.size[begin],
+                                     overlaps);
+  for (; k < n; ++k) {
+    const int j = begin + k;
+    overlaps[k] = JaccardOverlap(bbox[0], bbox[1], bbox[2], bbox[3], bbox[4],
+                                 others.xmin[j], others.ymin[j],
+                                 others.xmax[j], others.ymax[j],
+                                 others.size[j]);
+  }
+}
+
+void JaccardOverlap(const BBoxArray &bboxes, const int i,
+                    const BBoxArray &others, float *overlaps) {
+  JaccardOverlap(bboxes, i, others, 0, others.num(), overlaps);
+}
+
 float BBoxCoverage(const NormalizedBBox &bbox1, const NormalizedBBox &bbox2) {
   NormalizedBBox intersect_bbox;
   IntersectBBox(bbox1, bbox2, &intersect_bbox);
@@ -578,6 +705,122 @@ void DecodeBBoxesAll(const vector<LabelBBox> &all_loc_preds,
   }
 }
 
+void DecodeBBoxes(const BBoxArray &prior_bboxes,
+                  const vector<float> &prior_variances,
+                  const CodeType code_type,
+                  const bool variance_encoded_in_target, const bool clip_bbox,
+                  const BBoxArray &bboxes, BBoxArray *decode_bboxes) {
+  const int num_bboxes = prior_bboxes.num();
+  CHECK_EQ(num_bboxes * 4, prior_variances.size());
+  CHECK_EQ(num_bboxes, bboxes.num());
+  decode_bboxes->clear();
+  decode_bboxes->reserve(num_bboxes);
+  // The expressions follow DecodeBBox term by term, including its double
+  // precision halving, so the decoded boxes are identical.
+  for (int i = 0; i < num_bboxes; ++i) {
+    const float prior_xmin = prior_bboxes.xmin[i];
+    const float prior_ymin = prior_bboxes.ymin[i];
+    const float prior_xmax = prior_bboxes.xmax[i];
+    const float prior_ymax = prior_bboxes.ymax[i];
+    const float *var = &prior_variances[i * 4];
+    float bbox_xmin = bboxes.xmin[i];
+    float bbox_ymin = bboxes.ymin[i];
+    float bbox_xmax = bboxes.xmax[i];
+    float bbox_ymax = bboxes.ymax[i];
+    if (!variance_encoded_in_target &&
+        code_type != PriorBoxParameter_CodeType_CENTER_SIZE) {
+      bbox_xmin *= var[0];
+      bbox_ymin *= var[1];
+      bbox_xmax *= var[2];
+      bbox_ymax *= var[3];
+    }
+    float xmin, ymin, xmax, ymax;
+    if (code_type == PriorBoxParameter_CodeType_CORNER) {
+      xmin = prior_xmin + bbox_xmin;
+      ymin = prior_ymin + bbox_ymin;
+      xmax = prior_xmax + bbox_xmax;
+      ymax = prior_ymax + bbox_ymax;
+    } else if (code_type == PriorBoxParameter_CodeType_CENTER_SIZE) {
+      float prior_width = prior_xmax - prior_xmin;
+      CHECK_GT(prior_width, 0);
+      float prior_height = prior_ymax - prior_ymin;
+      CHECK_GT(prior_height, 0);
+      float prior_center_x = (prior_xmin + prior_xmax) / 2.;
+      float prior_center_y = (prior_ymin + prior_ymax) / 2.;
+
+      float decode_bbox_center_x, decode_bbox_center_y;
+      float decode_bbox_width, decode_bbox_height;
+      if (variance_encoded_in_target) {
+        decode_bbox_center_x = bbox_xmin * prior_width + prior_center_x;
+        decode_bbox_center_y = bbox_ymin * prior_height + prior_center_y;
+        decode_bbox_width = exp(bbox_xmax) * prior_width;
+        decode_bbox_height = exp(bbox_ymax) * prior_height;
+      } else {
+        decode_bbox_center_x =
+            var[0] * bbox_xmin * prior_width + prior_center_x;
+        decode_bbox_center_y =
+            var[1] * bbox_ymin * prior_height + prior_center_y;
+        decode_bbox_width = exp(var[2] * bbox_xmax) * prior_width;
+        decode_bbox_height = exp(var[3] * bbox_ymax) * prior_height;
+      }
+      xmin = decode_bbox_center_x - decode_bbox_width / 2.;
+      ymin = decode_bbox_center_y - decode_bbox_height / 2.;
+      xmax = decode_bbox_center_x + decode_bbox_width / 2.;
+      ymax = decode_bbox_center_y + decode_bbox_height / 2.;
+    } else if (code_type == PriorBoxParameter_CodeType_CORNER_SIZE) {
+      float prior_width = prior_xmax - prior_xmin;
+      CHECK_GT(prior_width, 0);
+      float prior_height = prior_ymax - prior_ymin;
+      CHECK_GT(prior_height, 0);
+      xmin = prior_xmin + bbox_xmin * prior_width;
+      ymin = prior_ymin + bbox_ymin * prior_height;
+      xmax = prior_xmax + bbox_xmax * prior_width;
+      ymax = prior_ymax + bbox_ymax * prior_height;
+    } else {
+      LOG(FATAL) << "Unknown LocLossType.";
+    }
+    if (clip_bbox) {
+      xmin = std::max(std::min(xmin, 1.f), 0.f);
+      ymin = std::max(std::min(ymin, 1.f), 0.f);
+      xmax = std::max(std::min(xmax, 1.f), 0.f);
+      ymax = std::max(std::min(ymax, 1.f), 0.f);
+    }
+    decode_bboxes->push_back(xmin, ymin, xmax, ymax);
+  }
+}
+
+void DecodeBBoxesAll(const vector<LabelBBoxArray> &all_loc_preds,
+                     const BBoxArray &prior_bboxes,
+                     const vector<float> &prior_variances,
+                     const int num, const bool share_location,
+                     const int num_loc_classes, const int background_label_id,
+                     const CodeType code_type,
+                     const bool variance_encoded_in_target, const bool clip,
+                     vector<LabelBBoxArray> *all_decode_bboxes) {
+  CHECK_EQ(all_loc_preds.size(), num);
+  all_decode_bboxes->clear();
+  all_decode_bboxes->resize(num);
+  for (int i = 0; i < num; ++i) {
+    // Decode predictions into bboxes.
+    LabelBBoxArray &decode_bboxes = (*all_decode_bboxes)[i];
+    for (int c = 0; c < num_loc_classes; ++c) {
+      int label = share_location ? -1 : c;
+      if (label == background_label_id) {
+        // Ignore background class.
+        continue;
+      }
+      if (all_loc_preds[i].find(label) == all_loc_preds[i].end()) {
+        // Something bad happened if there are no predictions for current label.
+        LOG(FATAL) << "Could not find location predictions for label " << label;
+      }
+      const BBoxArray &label_loc_preds = all_loc_preds[i].find(label)->second;
+      DecodeBBoxes(prior_bboxes, prior_variances, code_type,
+                   variance_encoded_in_target, clip, label_loc_preds,
+                   &(decode_bboxes[label]));
+    }
+  }
+}
+
 // special for TFLite_Detection_Postprocess
 void DecodeBBoxesTFLite(const vector<LabelBBox> &all_loc_preds,
                         const vector<NormalizedBBox> &prior_bboxes,
@@ -1437,6 +1680,43 @@ template void GetLocPredictions(const double *loc_data, const int num,
                                 const bool share_location,
                                 vector<LabelBBox> *loc_preds);
 
+template <typename Dtype>
+void GetLocPredictions(const Dtype *loc_data, const int num,
+                       const int num_preds_per_class, const int num_loc_classes,
+                       const bool share_location,
+                       vector<LabelBBoxArray> *loc_preds) {
+  loc_preds->clear();
+  if (share_location) {
+    CHECK_EQ(num_loc_classes, 1);
+  }
+  loc_preds->resize(num);
+  for (int i = 0; i < num; ++i) {
+    LabelBBoxArray &label_bbox = (*loc_preds)[i];
+    for (int c = 0; c < num_loc_classes; ++c) {
+      int label = share_location ? -1 : c;
+      BBoxArray &bboxes = label_bbox[label];
+      bboxes.reserve(num_preds_per_class);
+      for (int p = 0; p < num_preds_per_class; ++p) {
+        const Dtype *loc = loc_data + (p * num_loc_classes + c) * 4;
+        bboxes.push_back(loc[0], loc[1], loc[2], loc[3]);
+      }
+    }
+    loc_data += num_preds_per_class * num_loc_classes * 4;
+  }
+}
+
+// Explicit initialization.
+template void GetLocPredictions(const float *loc_data, const int num,
+                                const int num_preds_per_class,
+                                const int num_loc_classes,
+                                const bool share_location,
+                                vector<LabelBBoxArray> *loc_preds);
+template void GetLocPredictions(const double *loc_data, const int num,
+                                const int num_preds_per_class,
+                                const int num_loc_classes,
+                                const bool share_location,
+                                vector<LabelBBoxArray> *loc_preds);
+
 template <typename Dtype>
 void EncodeLocPrediction(const vector<LabelBBox> &all_loc_preds,
                          const map<int, vector<NormalizedBBox>> &all_gt_bboxes,
@@ -2148,6 +2428,27 @@ template void GetPriorBBoxes(const double *prior_data, const int num_priors,
                              vector<NormalizedBBox> *prior_bboxes,
                              vector<vector<float>> *prior_variances);
 
+template <typename Dtype>
+void GetPriorBBoxes(const Dtype *prior_data, const int num_priors,
+                    BBoxArray *prior_bboxes, vector<float> *prior_variances) {
+  prior_bboxes->clear();
+  prior_bboxes->reserve(num_priors);
+  for (int i = 0; i < num_priors; ++i) {
+    const Dtype *prior = prior_data + i * 4;
+    prior_bboxes->push_back(prior[0], prior[1], prior[2], prior[3]);
+  }
+  prior_variances->assign(prior_data + num_priors * 4,
+                          prior_data + num_priors * 8);
+}
+
+// Explicit initialization.
+template void GetPriorBBoxes(const float *prior_data, const int num_priors,
+                             BBoxArray *prior_bboxes,
+                             vector<float> *prior_variances);
+template void GetPriorBBoxes(const double *prior_data, const int num_priors,
+                             BBoxArray *prior_bboxes,
+                             vector<float> *prior_variances);
+
 template <typename Dtype>
 void GetDetectionResults(
     const Dtype *det_data, const int num_det, const int background_label_id,
@@ -2252,6 +2553,36 @@ template void GetMaxScoreIndex(const double *scores, const int num,
                                const float threshold, const int top_k,
                                vector<pair<double, int>> *score_index_vec);
 
+// Suppress function of ApplyNMSBitmask for candidates stored in a BBoxArray:
+// the overlaps of a kept box with a whole block are computed at once, and a
+// candidate is suppressed if its overlap is above threshold. With
+// suppress_nan, a NaN overlap suppresses as well, as in ApplyNMSFast.
+class BBoxArraySuppressor {
+ public:
+  BBoxArraySuppressor(const BBoxArray &bboxes, const float threshold,
+                      const bool suppress_nan)
+      : bboxes_(bboxes), threshold_(threshold), suppress_nan_(suppress_nan) {}
+
+  uint64_t operator()(const int i, const int begin, const int end,
+                      const uint64_t alive) const {
+    float overlaps[64];
+    JaccardOverlap(bboxes_, i, bboxes_, begin, end, overlaps);
+    uint64_t suppressed = 0;
+    for (int k = 0; k < end - begin; ++k) {
+      if (suppress_nan_ ? !(overlaps[k] <= threshold_)
+                        : overlaps[k] > threshold_) {
+        suppressed |= uint64_t(1) << k;
+      }
+    }
+    return suppressed & alive;
+  }
+
+ private:
+  const BBoxArray &bboxes_;
+  const float threshold_;
+  const bool suppress_nan_;
+};
+
 void ApplyNMS(const vector<NormalizedBBox> &bboxes, const vector<float> &scores,
               const float threshold, const int top_k, const bool reuse_overlaps,
               map<int, map<int, float>> *overlaps, vector<int> *indices) {
@@ -2265,65 +2596,54 @@ void ApplyNMS(const vector<NormalizedBBox> &bboxes, const vector<float> &scores,
   vector<pair<float, int>> score_index_vec;
   GetTopKScoreIndex(scores, idx, top_k, &score_index_vec);
 
-  // Do nms.
-  indices->clear();
-  while (score_index_vec.size() != 0) {
-    // Get the current highest score box.
-    int best_idx = score_index_vec.front().second;
-    const NormalizedBBox &best_bbox = bboxes[best_idx];
-    if (BBoxSize(best_bbox) < 1e-5) {
-      // Erase small box.
-      score_index_vec.erase(score_index_vec.begin());
-      continue;
-    }
-    indices->push_back(best_idx);
-    // Erase the best box.
-    score_index_vec.erase(score_index_vec.begin());
-
-    if (top_k > -1 && indices->size() >= top_k) {
-      // Stop if finding enough bboxes for nms.
-      break;
+  // Small boxes are never picked and never suppress another box, so they are
+  // dropped before nms.
+  vector<int> order;
+  order.reserve(score_index_vec.size());
+  for (int s = 0; s < score_index_vec.size(); ++s) {
+    const int cur_idx = score_index_vec[s].second;
+    if (!(BBoxSize(bboxes[cur_idx]) < 1e-5)) {
+      order.push_back(cur_idx);
     }
+  }
 
-    // Compute overlap between best_bbox and other remaining bboxes.
-    // Remove a bbox if the overlap with best_bbox is larger than nms_threshold.
-    for (vector<pair<float, int>>::iterator it = score_index_vec.begin();
-         it != score_index_vec.end();) {
-      int cur_idx = it->second;
-      const NormalizedBBox &cur_bbox = bboxes[cur_idx];
-      if (BBoxSize(cur_bbox) < 1e-5) {
-        // Erase small box.
-        it = score_index_vec.erase(it);
-        continue;
-      }
-      float cur_overlap = 0.;
-      if (reuse_overlaps) {
-        if (overlaps->find(best_idx) != overlaps->end() &&
-            overlaps->find(best_idx)->second.find(cur_idx) !=
-                (*overlaps)[best_idx].end()) {
-          // Use the computed overlap.
-          cur_overlap = (*overlaps)[best_idx][cur_idx];
-        } else if (overlaps->find(cur_idx) != overlaps->end() &&
-                   overlaps->find(cur_idx)->second.find(best_idx) !=
-                       (*overlaps)[cur_idx].end()) {
-          // Use the computed overlap.
-          cur_overlap = (*overlaps)[cur_idx][best_idx];
-        } else {
-          cur_overlap = JaccardOverlap(best_bbox, cur_bbox);
-          // Store the overlap for future use.
-          (*overlaps)[best_idx][cur_idx] = cur_overlap;
-        }
-      } else {
-        cur_overlap = JaccardOverlap(best_bbox, cur_bbox);
-      }
-
-      // Remove it if necessary
-      if (cur_overlap > threshold) {
-        it = score_index_vec.erase(it);
-      } else {
-        ++it;
-      }
+  // Do nms.
+  vector<int> kept;
+  if (reuse_overlaps) {
+    ApplyNMSBitmask(order.size(), top_k, MakePairwiseSuppressor(
+        [&](const int i, const int j) {
+          const int best_idx = order[i];
+          const int cur_idx = order[j];
+          float cur_overlap = 0.;
+          if (overlaps->find(best_idx) != overlaps->end() &&
+              overlaps->find(best_idx)->second.find(cur_idx) !=
+                  (*overlaps)[best_idx].end()) {
+            // Use the computed overlap.
+            cur_overlap = (*overlaps)[best_idx][cur_idx];
+          } else if (overlaps->find(cur_idx) != overlaps->end() &&
+                     overlaps->find(cur_idx)->second.find(best_idx) !=
+                         (*overlaps)[cur_idx].end()) {
+            // Use the computed overlap.
+            cur_overlap = (*overlaps)[cur_idx][best_idx];
+          } else {
+            cur_overlap = JaccardOverlap(bboxes[best_idx], bboxes[cur_idx]);
+            // Store the overlap for future use.
+            (*overlaps)[best_idx][cur_idx] = cur_overlap;
+          }
+          return cur_overlap > threshold;
+        }), &kept);
+  } else {
+    BBoxArray candidates;
+    candidates.reserve(order.size());
+    for (int s = 0; s < order.size(); ++s) {
+      candidates.push_back(bboxes[order[s]]);
     }
+    ApplyNMSBitmask(candidates.num(), top_k,
+                    BBoxArraySuppressor(candidates, threshold, false), &kept);
+  }
+  indices->clear();
+  for (int k = 0; k < kept.size(); ++k) {
+    indices->push_back(order[kept[k]]);
   }
 }
 
@@ -2335,28 +2655,10 @@ void ApplyNMS(const vector<NormalizedBBox> &bboxes, const vector<float> &scores,
 }
 
 void ApplyNMS(const bool *overlapped, const int num, vector<int> *indices) {
-  vector<int> index_vec(boost::counting_iterator<int>(0),
-                        boost::counting_iterator<int>(num));
-  // Do nms.
-  indices->clear();
-  while (index_vec.size() != 0) {
-    // Get the current highest score box.
-    int best_idx = index_vec.front();
-    indices->push_back(best_idx);
-    // Erase the best box.
-    index_vec.erase(index_vec.begin());
-
-    for (vector<int>::iterator it = index_vec.begin(); it != index_vec.end();) {
-      int cur_idx = *it;
-
-      // Remove it if necessary
-      if (overlapped[best_idx * num + cur_idx]) {
-        it = index_vec.erase(it);
-      } else {
-        ++it;
-      }
-    }
-  }
+  ApplyNMSBitmask(num, -1, MakePairwiseSuppressor(
+      [overlapped, num](const int i, const int j) {
+        return overlapped[i * num + j];
+      }), indices);
 }
 
 inline int clamp(const int v, const int a, const int b) {
@@ -2378,8 +2680,8 @@ void ApplyNMSFast(const vector<NormalizedBBox> &bboxes,
   // Do nms.
   float adaptive_threshold = nms_threshold;
   indices->clear();
-  while (score_index_vec.size() != 0) {
-    const int idx = score_index_vec.front().second;
+  for (int s = 0; s < score_index_vec.size(); ++s) {
+    const int idx = score_index_vec[s].second;
     bool keep = true;
     for (int k = 0; k < indices->size(); ++k) {
       if (keep) {
@@ -2393,7 +2695,72 @@ void ApplyNMSFast(const vector<NormalizedBBox> &bboxes,
     if (keep) {
       indices->push_back(idx);
     }
-    score_index_vec.erase(score_index_vec.begin());
+    if (keep && eta < 1 && adaptive_threshold > 0.5) {
+      adaptive_threshold *= eta;
+    }
+  }
+}
+
+void ApplyNMSFast(const BBoxArray &bboxes, const vector<float> &scores,
+                  const float score_threshold, const float nms_threshold,
+                  const float eta, const int top_k, vector<int> *indices) {
+  // Sanity check.
+  CHECK_EQ(bboxes.num(), scores.size())
+      << "bboxes and scores have different size.";
+
+  // Get top_k scores (with corresponding indices).
+  vector<pair<float, int>> score_index_vec;
+  GetMaxScoreIndex(scores, score_threshold, top_k, &score_index_vec);
+
+  if (!(eta < 1)) {
+    // The threshold stays fixed, so nms is a plain greedy pass over the
+    // candidates gathered in score order.
+    BBoxArray candidates;
+    candidates.reserve(score_index_vec.size());
+    for (int s = 0; s < score_index_vec.size(); ++s) {
+      const int idx = score_index_vec[s].second;
+      candidates.xmin.push_back(bboxes.xmin[idx]);
+      candidates.ymin.push_back(bboxes.ymin[idx]);
+      candidates.xmax.push_back(bboxes.xmax[idx]);
+      candidates.ymax.push_back(bboxes.ymax[idx]);
+      candidates.size.push_back(bboxes.size[idx]);
+    }
+    vector<int> kept;
+    ApplyNMSBitmask(candidates.num(), -1,
+                    BBoxArraySuppressor(candidates, nms_threshold, true),
+                    &kept);
+    indices->clear();
+    for (int k = 0; k < kept.size(); ++k) {
+      indices->push_back(score_index_vec[kept[k]].second);
+    }
+    return;
+  }
+
+  // Do nms. The kept boxes are copied into a BBoxArray of their own, so each
+  // candidate is checked against all of them in one contiguous pass.
+  float adaptive_threshold = nms_threshold;
+  indices->clear();
+  BBoxArray kept;
+  kept.reserve(score_index_vec.size());
+  vector<float> overlaps(score_index_vec.size());
+  for (int s = 0; s < score_index_vec.size(); ++s) {
+    const int idx = score_index_vec[s].second;
+    JaccardOverlap(bboxes, idx, kept, overlaps.data());
+    bool keep = true;
+    for (int k = 0; k < kept.num(); ++k) {
+      if (!(overlaps[k] <= adaptive_threshold)) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) {
+      indices->push_back(idx);
+      kept.xmin.push_back(bboxes.xmin[idx]);
+      kept.ymin.push_back(bboxes.ymin[idx]);
+      kept.xmax.push_back(bboxes.xmax[idx]);
+      kept.ymax.push_back(bboxes.ymax[idx]);
+      kept.size.push_back(bboxes.size[idx]);
+    }
     if (keep && eta < 1 && adaptive_threshold > 0.5) {
       adaptive_threshold *= eta;
     }
@@ -2411,8 +2778,8 @@ void ApplyNMSFast(const Dtype *bboxes, const Dtype *scores, const int num,
   // Do nms.
   float adaptive_threshold = nms_threshold;
   indices->clear();
-  while (score_index_vec.size() != 0) {
-    const int idx = score_index_vec.front().second;
+  for (int s = 0; s < score_index_vec.size(); ++s) {
+    const int idx = score_index_vec[s].second;
     bool keep = true;
     for (int k = 0; k < indices->size(); ++k) {
       if (keep) {
@@ -2426,7 +2793,6 @@ void ApplyNMSFast(const Dtype *bboxes, const Dtype *scores, const int num,
     if (keep) {
       indices->push_back(idx);
     }
-    score_index_vec.erase(score_index_vec.begin());
     if (keep && eta < 1 && adaptive_threshold > 0.5) {
       adaptive_threshold *= eta;
     }
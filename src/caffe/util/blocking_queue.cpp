@@ -2,6 +2,7 @@
 #include <string>
 
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
@@ -87,6 +88,10 @@ size_t BlockingQueue<T>::size() const {
 
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
+template class BlockingQueue<HDF5Chunk<float>*>;
+template class BlockingQueue<HDF5Chunk<double>*>;
+template class BlockingQueue<vector<shared_ptr<Blob<float> > >*>;
+template class BlockingQueue<vector<shared_ptr<Blob<double> > >*>;
 //template class BlockingQueue<Datum*>;
 //template class BlockingQueue<AnnotatedDatum*>;
 //template class BlockingQueue<shared_ptr<DataReader<Datum>::QueuePair> >;
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cmath>
+
+#include "caffe/util/correlation.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Calls task(i) for i in [0, n), interleaved among Caffe::num_threads()
+// threads.
+template <typename Task>
+static void ParallelFor(const int n, const Task& task) {
+  const int num_tasks = std::min(n, Caffe::num_threads());
+  if (num_tasks <= 1) {
+    for (int i = 0; i < n; ++i) {
+      task(i);
+    }
+    return;
+  }
+  Caffe::thread_pool(num_tasks).Run(num_tasks, [&](int t, int /*worker*/) {
+    for (int i = t; i < n; i += num_tasks) {
+      task(i);
+    }
+  });
+}
+
+static inline int SimdTransposeRows8(const int cols, const float* src,
+    const int lds, float* dst, const int ldd) {
+  return caffe_simd_transpose_rows8(cols, src, lds, dst, ldd);
+}
+
+static inline int SimdTransposeRows8(const int cols, const double* src,
+    const int lds, double* dst, const int ldd) {
+  return 0;
+}
+
+static inline int SimdDotRows(const int n, const float* a, const float* b,
+    const int ldb, const int m, float* dots, const int ldd) {
+  return caffe_simd_dot_rows(n, a, b, ldb, m, dots, ldd);
+}
+
+static inline int SimdDotRows(const int n, const double* a, const double* b,
+    const int ldb, const int m, double* dots, const int ldd) {
+  return 0;
+}
+
+template <typename Dtype>
+void caffe_cpu_pad_nhwc(const int num, const int channels, const int height,
+    const int width, const int pad_h, const int pad_w, const Dtype* src,
+    Dtype* dst) {
+  const int pheight = height + 2 * pad_h;
+  const int pwidth = width + 2 * pad_w;
+  const int spatial_dim = height * width;
+  ParallelFor(num * pheight, [&](int row) {
+    const int n = row / pheight;
+    const int y = row % pheight - pad_h;
+    Dtype* dst_row = dst + row * pwidth * channels;
+    if (y < 0 || y >= height) {
+      caffe_set(pwidth * channels, Dtype(0), dst_row);
+      return;
+    }
+    caffe_set(pad_w * channels, Dtype(0), dst_row);
+    caffe_set(pad_w * channels, Dtype(0),
+        dst_row + (pad_w + width) * channels);
+    dst_row += pad_w * channels;
+    const Dtype* src_row = src + n * channels * spatial_dim + y * width;
+    // Eight channels at a time, one row of each becoming eight columns.
+    int c = 0;
+    for (; c + 8 <= channels; c += 8) {
+      const Dtype* block = src_row + c * spatial_dim;
+      const int done =
+          SimdTransposeRows8(width, block, spatial_dim, dst_row + c, channels);
+      for (int r = 0; r < 8; ++r) {
+        for (int x = done; x < width; ++x) {
+          dst_row[x * channels + c + r] = block[r * spatial_dim + x];
+        }
+      }
+    }
+    for (; c < channels; ++c) {
+      for (int x = 0; x < width; ++x) {
+        dst_row[x * channels + c] = src_row[c * spatial_dim + x];
+      }
+    }
+  });
+}
+
+// dots[d * ldd] += the dot product of a and row d of b, for d < m.
+template <typename Dtype>
+static void DotRows(const int n, const Dtype* a, const Dtype* b,
+    const int ldb, const int m, Dtype* dots, const int ldd) {
+  const int done = SimdDotRows(n, a, b, ldb, m, dots, ldd);
+  if (done == n) {
+    return;
+  }
+  for (int d = 0; d < m; ++d) {
+    const Dtype* row = b + d * ldb;
+    Dtype sum = 0;
+    for (int c = done; c < n; ++c) {
+      sum += a[c] * row[c];
+    }
+    dots[d * ldd] += sum;
+  }
+}
+
+// dots[d * ldd] += the sum of |a - row d of b|, for d < m.
+template <typename Dtype>
+static void AbsDiffRows(const int n, const Dtype* a, const Dtype* b,
+    const int ldb, const int m, Dtype* dots, const int ldd) {
+  for (int d = 0; d < m; ++d) {
+    const Dtype* row = b + d * ldb;
+    Dtype sum = 0;
+    for (int c = 0; c < n; ++c) {
+      sum += std::fabs(a[c] - row[c]);
+    }
+    dots[d * ldd] += sum;
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_correlate(const CorrelationGeometry& g, const bool subtract,
+    const Dtype* bottom0, const Dtype* bottom1, Dtype* top) {
+  const int channels = g.channels;
+  const int top_channels = g.grid_height * g.grid_width;
+  const int top_dim = g.top_height * g.top_width;
+  const int sumelems = g.kernel_size * g.kernel_size * channels;
+  // Each task fills one row of every top channel of an item.
+  ParallelFor(g.num * g.top_height, [&](int row) {
+    const int n = row / g.top_height;
+    const int y = row % g.top_height;
+    Dtype* top_row = top + n * top_channels * top_dim + y * g.top_width;
+    for (int c = 0; c < top_channels; ++c) {
+      caffe_set(g.top_width, Dtype(0), top_row + c * top_dim);
+    }
+    const int y1 = y * g.stride1 + g.y_offset;
+    for (int p = 0; p < g.grid_height; ++p) {
+      Dtype* top_p = top_row + p * g.grid_width * top_dim;
+      for (int j = 0; j < g.kernel_size; ++j) {
+        const int y2 = y1 + j + (g.grid_y_begin + p) * g.stride2;
+        if (y2 < 0 || y2 >= g.height) {
+          continue;
+        }
+        const Dtype* row0 = bottom0 + (n * g.height + y1 + j) * g.width *
+            channels;
+        const Dtype* row1 = bottom1 + (n * g.height + y2) * g.width *
+            channels;
+        for (int x = 0; x < g.top_width; ++x) {
+          const int x1 = x * g.stride1 + g.x_offset;
+          for (int i = 0; i < g.kernel_size; ++i) {
+            // The displacements [d_begin, d_end) stay within the row.
+            const int x2 = x1 + i + g.grid_x_begin * g.stride2;
+            const int d_begin =
+                x2 >= 0 ? 0 : (g.stride2 - 1 - x2) / g.stride2;
+            const int d_end = x2 < g.width ?
+                std::min(g.grid_width, (g.width - 1 - x2) / g.stride2 + 1) :
+                0;
+            if (d_begin >= d_end) {
+              continue;
+            }
+            const Dtype* a = row0 + (x1 + i) * channels;
+            const Dtype* b = row1 + (x2 + d_begin * g.stride2) * channels;
+            Dtype* dots = top_p + d_begin * top_dim + x;
+            if (subtract) {
+              AbsDiffRows(channels, a, b, g.stride2 * channels,
+                  d_end - d_begin, dots, top_dim);
+            } else {
+              DotRows(channels, a, b, g.stride2 * channels,
+                  d_end - d_begin, dots, top_dim);
+            }
+          }
+        }
+      }
+    }
+    for (int c = 0; c < top_channels; ++c) {
+      Dtype* out = top_row + c * top_dim;
+      for (int x = 0; x < g.top_width; ++x) {
+        out[x] /= sumelems;
+      }
+    }
+  });
+}
+
+template void caffe_cpu_pad_nhwc<float>(const int num, const int channels,
+    const int height, const int width, const int pad_h, const int pad_w,
+    const float* src, float* dst);
+template void caffe_cpu_pad_nhwc<double>(const int num, const int channels,
+    const int height, const int width, const int pad_h, const int pad_w,
+    const double* src, double* dst);
+template void caffe_cpu_correlate<float>(const CorrelationGeometry& geometry,
+    const bool subtract, const float* bottom0, const float* bottom1,
+    float* top);
+template void caffe_cpu_correlate<double>(const CorrelationGeometry& geometry,
+    const bool subtract, const double* bottom0, const double* bottom1,
+    double* top);
+
+}  // namespace caffe
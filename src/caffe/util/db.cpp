@@ -2,7 +2,11 @@
 #include "caffe/util/db_leveldb.hpp"
 #include "caffe/util/db_lmdb.hpp"
 
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#include "caffe/util/rng.hpp"
 
 namespace caffe { namespace db {
 
@@ -37,5 +41,122 @@ DB* GetDB(const string& backend) {
   return NULL;
 }
 
+//<--CUSTOMIZATION
+ShardedCursor::ShardedCursor(Cursor* cursor, int num_solvers, int rank,
+    int shards_per_solver)
+    : cursor_(cursor), num_solvers_(num_solvers), rank_(rank), epoch_(-1),
+      shard_(0), position_(0), valid_(false) {
+  CHECK_GT(num_solvers, 0);
+  CHECK_GE(rank, 0);
+  CHECK_LT(rank, num_solvers);
+  CHECK_GT(shards_per_solver, 0);
+  const int num_shards = num_solvers * shards_per_solver;
+  // Keeps the keys of every step-th record, halving them as they fill up.
+  const size_t max_samples = 128 * num_shards;
+  vector<string> samples;
+  size_t step = 1;
+  size_t count = 0;
+  for (cursor_->SeekToFirst(); cursor_->valid(); cursor_->Next(), ++count) {
+    if (count % step == 0) {
+      samples.push_back(cursor_->key());
+      if (samples.size() == max_samples) {
+        for (size_t i = 0; i < max_samples / 2; ++i) {
+          samples[i].swap(samples[2 * i]);
+        }
+        samples.resize(max_samples / 2);
+        step *= 2;
+      }
+    }
+  }
+  CHECK_GE(count, num_shards) << "Fewer records than shards";
+  // Each range starts at the sample closest to its share of the records.
+  vector<size_t> begin(num_shards + 1, count);
+  shard_keys_.resize(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    const size_t target = i * count / num_shards;
+    const size_t sample = std::min((target + step / 2) / step,
+        samples.size() - 1);
+    begin[i] = sample * step;
+    shard_keys_[i] = samples[sample];
+  }
+  shard_sizes_.resize(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    shard_sizes_[i] = begin[i + 1] - begin[i];
+  }
+  LOG_IF(INFO, Caffe::root_solver()) << "Split " << count
+      << " records into " << num_shards << " ranges of keys";
+  SeekToFirst();
+}
+
+void ShardedCursor::SeekToFirst() {
+  ++epoch_;
+  const int num_shards = shard_keys_.size();
+  vector<int> order(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    order[i] = i;
+  }
+  rng_t rng(epoch_);
+  shuffle(order.begin(), order.end(), &rng);
+  shards_.clear();
+  for (int i = rank_; i < num_shards; i += num_solvers_) {
+    shards_.push_back(order[i]);
+  }
+  shard_ = 0;
+  StartShard();
+}
+
+void ShardedCursor::Next() {
+  if (++position_ < shard_sizes_[shards_[shard_]]) {
+    cursor_->Next();
+    valid_ = cursor_->valid();
+  } else {
+    ++shard_;
+    StartShard();
+  }
+}
+
+void ShardedCursor::Seek(const string& key) {
+  // The ranges are in the order of their keys, so key falls in the last one
+  // starting at or before it, or else before the first.
+  const int num_shards = shard_keys_.size();
+  const int first = std::max<int>(std::upper_bound(shard_keys_.begin(),
+      shard_keys_.end(), key) - shard_keys_.begin() - 1, 0);
+  for (int shard = first; shard < num_shards; ++shard) {
+    shard_ = std::find(shards_.begin(), shards_.end(), shard) -
+        shards_.begin();
+    if (shard_ == shards_.size()) {
+      continue;
+    }
+    // Steps over the keys of the range before key.
+    position_ = 0;
+    cursor_->Seek(shard_keys_[shard]);
+    while (position_ < shard_sizes_[shard] && cursor_->valid() &&
+        cursor_->key() < key) {
+      cursor_->Next();
+      ++position_;
+    }
+    if (position_ < shard_sizes_[shard] && cursor_->valid()) {
+      valid_ = true;
+      return;
+    }
+  }
+  shard_ = shards_.size();
+  valid_ = false;
+}
+
+void ShardedCursor::StartShard() {
+  while (shard_ < shards_.size() && shard_sizes_[shards_[shard_]] == 0) {
+    ++shard_;
+  }
+  position_ = 0;
+  if (shard_ == shards_.size()) {
+    valid_ = false;
+    return;
+  }
+  cursor_->Seek(shard_keys_[shards_[shard_]]);
+  valid_ = cursor_->valid();
+}
+//CUSTOMIZATION-->
+
 }  // namespace db
 }  // namespace caffe
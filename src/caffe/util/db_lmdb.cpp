@@ -63,6 +63,7 @@ void LMDBTransaction::Commit() {
   MDB_val mdb_key, mdb_data;
   MDB_txn *mdb_txn;
 
+  ReserveMapSize();
   // Initialize MDB variables
   MDB_CHECK(mdb_txn_begin(mdb_env_, NULL, 0, &mdb_txn));
   MDB_CHECK(mdb_dbi_open(mdb_txn, NULL, 0, &mdb_dbi));
@@ -113,6 +114,33 @@ void LMDBTransaction::DoubleMapSize() {
   MDB_CHECK(mdb_env_set_mapsize(mdb_env_, new_size));
 }
 
+// Grows the map ahead of the transaction, so that a large batch of puts is
+// not aborted and written again for every doubling of the map size. The
+// MDB_MAP_FULL retries of Commit remain for the batches it underestimates.
+void LMDBTransaction::ReserveMapSize() {
+  size_t pending = 0;
+  for (int i = 0; i < keys.size(); i++) {
+    pending += keys[i].size() + values[i].size();
+  }
+  struct MDB_envinfo current_info;
+  struct MDB_stat current_stat;
+  MDB_CHECK(mdb_env_info(mdb_env_, &current_info));
+  MDB_CHECK(mdb_env_stat(mdb_env_, &current_stat));
+  const size_t used = (current_info.me_last_pgno + 1) *
+      static_cast<size_t>(current_stat.ms_psize);
+  // Twice the payload leaves room for the page headers and the half full
+  // pages of the B-tree.
+  const size_t needed = used + 2 * pending;
+  size_t new_size = current_info.me_mapsize;
+  while (new_size < needed) {
+    new_size *= 2;
+  }
+  if (new_size != current_info.me_mapsize) {
+    DLOG(INFO) << "Growing LMDB map size to " << (new_size>>20) << "MB ...";
+    MDB_CHECK(mdb_env_set_mapsize(mdb_env_, new_size));
+  }
+}
+
 }  // namespace db
 }  // namespace caffe
 #endif  // USE_LMDB
@@ -22,9 +22,19 @@ PottsPotential::~PottsPotential() {
 
 PottsPotential::PottsPotential(const float* features, int D, int N, 
 		  float w, bool per_pixel_normalization) 
-  : N_(N), w_(w) {
+  : N_(0), w_(w), norm_(NULL), norm_size_(0) {
+  init(features, D, N, per_pixel_normalization);
+}
+
+void PottsPotential::init(const float* features, int D, int N,
+		  bool per_pixel_normalization) {
+  N_ = N;
   lattice_.init( features, D, N );
-  norm_ = allocate( N );
+  if ( N > norm_size_ ) {
+    deallocate(norm_);
+    norm_ = allocate( N );
+    norm_size_ = N;
+  }
   for ( int i=0; i<N; i++ )
     norm_[i] = 1;
   // Compute the normalization factor
@@ -47,9 +57,11 @@ PottsPotential::PottsPotential(const float* features, int D, int N,
 
 void PottsPotential::apply(float* out_values, const float* in_values, float* tmp, int value_size) const {
   lattice_.compute( tmp, in_values, value_size );
-  for ( int i=0,k=0; i<N_; i++ )
-    for ( int j=0; j<value_size; j++, k++ )
-      out_values[k] += w_*norm_[i]*tmp[k];
+  parallel_for( N_, lattice_.num_threads(), 1024, [&]( int begin, int end ) {
+    for ( int i=begin; i<end; i++ )
+      for ( int j=0, k=i*value_size; j<value_size; j++, k++ )
+        out_values[k] += w_*norm_[i]*tmp[k];
+  });
 }
 
 SemiMetricPotential::SemiMetricPotential(const float* features, int D, int N, 
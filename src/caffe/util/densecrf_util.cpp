@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cstring>
 
 #include "caffe/util/densecrf_util.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 float* allocate(size_t N) {
   float * r = NULL;
@@ -26,3 +28,20 @@ void deallocate(float*& ptr) {
   ptr = NULL;
 }
 
+
+void parallel_for(int n, int num_threads, int min_chunk,
+    const boost::function<void(int, int)>& task) {
+  const int num_tasks = std::min(num_threads,
+      (n + min_chunk - 1) / std::max(min_chunk, 1));
+  if (num_tasks <= 1) {
+    if (n > 0) {
+      task(0, n);
+    }
+    return;
+  }
+  caffe::Caffe::thread_pool(num_tasks).Run(num_tasks,
+      [&](int t, int /*worker*/) {
+    task(static_cast<int64_t>(n) * t / num_tasks,
+        static_cast<int64_t>(n) * (t + 1) / num_tasks);
+  });
+}
@@ -0,0 +1,117 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/feature_matrix.hpp"
+#include "caffe/util/io.hpp"
+
+namespace caffe {
+
+static const size_t kRowAlignment = 64;
+
+static bool IsLittleEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+uint16_t FloatToHalf(const float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  const uint32_t magnitude = bits & 0x7fffffff;
+  if (magnitude >= 0x7f800000) {
+    // Infinity, or a quiet NaN.
+    return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+  }
+  if (magnitude >= 0x477ff000) {
+    // 65520 and above round to infinity.
+    return sign | 0x7c00;
+  }
+  if (magnitude < 0x38800000) {
+    // Below 2^-14, the subnormals count multiples of 2^-24; the product is
+    // exact and nearbyint rounds ties to even.
+    return sign | static_cast<uint16_t>(
+        std::nearbyint(std::fabs(value) * 16777216.f));
+  }
+  // Rebias the exponent from 127 to 15 and round the mantissa from 23 to 10
+  // bits, ties to even; a carry out of the mantissa bumps the exponent.
+  const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+  return sign | ((rounded - 0x38000000) >> 13);
+}
+
+FeatureMatrixWriter::FeatureMatrixWriter(const string& filename,
+    const FeatureMatrixIndex::Type type)
+    : filename_(filename),
+      file_(filename.c_str(),
+          std::ios::out | std::ios::binary | std::ios::trunc) {
+  CHECK(IsLittleEndian())
+      << "Feature matrices are only written on little-endian hosts.";
+  CHECK(file_) << "Couldn't open " << filename;
+  index_.set_type(type);
+  index_.set_rows(0);
+}
+
+FeatureMatrixWriter::~FeatureMatrixWriter() {
+  Close();
+}
+
+template <typename Dtype>
+void FeatureMatrixWriter::Write(const Blob<Dtype>& blob) {
+  CHECK(file_.is_open()) << "Writing to closed feature matrix " << filename_;
+  CHECK_GE(blob.num_axes(), 1) << "Feature rows need a first axis";
+  const int num = blob.shape(0);
+  const int cols = num ? blob.count(1) : 0;
+  const bool half = index_.type() == FeatureMatrixIndex_Type_FLOAT16;
+  if (!index_.has_shape()) {
+    BlobShape* shape = index_.mutable_shape();
+    for (int i = 1; i < blob.num_axes(); ++i) {
+      shape->add_dim(blob.shape(i));
+    }
+    index_.set_cols(cols);
+    const size_t bytes = cols * (half ? sizeof(uint16_t) : sizeof(float));
+    index_.set_stride((bytes + kRowAlignment - 1) / kRowAlignment *
+        kRowAlignment);
+    row_.assign(index_.stride(), 0);
+  }
+  CHECK_EQ(blob.num_axes() - 1, index_.shape().dim_size())
+      << "Feature rows of " << filename_ << " change shape";
+  for (int i = 1; i < blob.num_axes(); ++i) {
+    CHECK_EQ(blob.shape(i), index_.shape().dim(i - 1))
+        << "Feature rows of " << filename_ << " change shape";
+  }
+  const Dtype* data = blob.cpu_data();
+  for (int n = 0; n < num; ++n) {
+    const Dtype* features = data + n * cols;
+    if (half) {
+      uint16_t* row = reinterpret_cast<uint16_t*>(row_.data());
+      for (int d = 0; d < cols; ++d) {
+        row[d] = FloatToHalf(features[d]);
+      }
+    } else {
+      float* row = reinterpret_cast<float*>(row_.data());
+      for (int d = 0; d < cols; ++d) {
+        row[d] = features[d];
+      }
+    }
+    file_.write(row_.data(), row_.size());
+  }
+  CHECK(file_) << "Error writing " << filename_;
+  index_.set_rows(index_.rows() + num);
+}
+
+template void FeatureMatrixWriter::Write(const Blob<float>& blob);
+template void FeatureMatrixWriter::Write(const Blob<double>& blob);
+
+void FeatureMatrixWriter::Close() {
+  if (!file_.is_open()) {
+    return;
+  }
+  file_.close();
+  CHECK(file_) << "Error writing " << filename_;
+  WriteProtoToTextFile(index_, filename_ + ".index");
+}
+
+}  // namespace caffe
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/util/fold_layers.hpp"
+
+namespace caffe {
+
+// Whether some parameter of the layer is shared with other layers by name.
+static bool HasSharedParams(const LayerParameter& layer_param) {
+  for (int i = 0; i < layer_param.param_size(); ++i) {
+    if (layer_param.param(i).has_name()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool IsFoldHostLayer(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1 ||
+      layer_param.fused_activation_param().type() !=
+      FusedActivationParameter_Type_NONE || HasSharedParams(layer_param)) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  if (type == "Convolution" || type == "Deconvolution") {
+    const ConvolutionParameter& param = layer_param.convolution_param();
+    return param.axis() == 1 && !param.submanifold_sparse() &&
+        param.input_scale() == 1 && param.weight_scale() == 1 &&
+        param.output_scale() == 1 && param.input_zero_point() == 0 &&
+        param.weight_zero_point() == 0 && param.output_zero_point() == 0 &&
+        !param.per_channel_scale_weight() &&
+        !param.per_channel_scale_output() &&
+        param.saturate() == ConvolutionParameter_SaturateMethod_None;
+  }
+  if (type == "InnerProduct") {
+    const InnerProductParameter& param = layer_param.inner_product_param();
+    return param.axis() == 1 &&
+        param.input_scale() == 1 && param.weight_scale() == 1 &&
+        param.output_scale() == 1 && param.input_zero_point() == 0 &&
+        param.weight_zero_point() == 0 && param.output_zero_point() == 0 &&
+        param.saturate() == InnerProductParameter_SaturateMethod_None;
+  }
+  return false;
+}
+
+// Whether the layer computes scale[c] * x + shift[c] on each channel c, or
+// on all of them, from its own blobs.
+static bool IsFoldableAffineLayer(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1 ||
+      HasSharedParams(layer_param)) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  if (type == "BatchNorm") {
+    const BatchNormParameter& param = layer_param.batch_norm_param();
+    return !param.has_use_global_stats() || param.use_global_stats();
+  }
+  if (type == "BN") {
+    // Other than the icnet variant, only the INFERENCE mode uses fixed
+    // statistics in the TEST phase.
+    const BNParameter& param = layer_param.bn_param();
+    return param.icnet() || param.bn_mode() == BNParameter_BNMode_INFERENCE;
+  }
+  if (type == "Scale") {
+    const ScaleParameter& param = layer_param.scale_param();
+    return param.axis() == 1 &&
+        (param.num_axes() == 0 || param.num_axes() == 1);
+  }
+  if (type == "Bias") {
+    const BiasParameter& param = layer_param.bias_param();
+    return param.axis() == 1 &&
+        (param.num_axes() == 0 || param.num_axes() == 1) &&
+        param.input_scale() == 1 && param.output_scale() == 1 &&
+        param.bias_scale() == 1 && param.input_zero_point() == 0 &&
+        param.output_zero_point() == 0 && param.bias_zero_point() == 0 &&
+        param.saturate() == BiasParameter_SaturateMethod_None;
+  }
+  return false;
+}
+
+// Whether the layer is an activation that can be fused, and which.
+static bool GetFusedActivation(const LayerParameter& layer_param,
+    FusedActivationParameter* activation) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) {
+    return false;
+  }
+  const string& type = layer_param.type();
+  activation->Clear();
+  if (type == "ReLU") {
+    const ReLUParameter& param = layer_param.relu_param();
+    if (param.input_scale() != 1 || param.output_scale() != 1 ||
+        param.input_zero_point() != 0 || param.output_zero_point() != 0 ||
+        param.saturate() != ReLUParameter_SaturateMethod_None) {
+      return false;
+    }
+    activation->set_type(FusedActivationParameter_Type_RELU);
+    activation->set_negative_slope(param.negative_slope());
+    if (param.relu6()) {
+      activation->set_max(6);
+    }
+    if (param.maximum() > 0) {
+      activation->set_max(activation->has_max() ?
+          std::min(activation->max(), param.maximum()) : param.maximum());
+    }
+    if (param.minimum() != 0) {
+      activation->set_min(param.minimum());
+    }
+    return true;
+  }
+  if (type == "Clip") {
+    activation->set_type(FusedActivationParameter_Type_CLIP);
+    activation->set_min(layer_param.clip_param().min());
+    activation->set_max(layer_param.clip_param().max());
+    return true;
+  }
+  if (type == "HardSwish") {
+    activation->set_type(FusedActivationParameter_Type_HARD_SWISH);
+    return true;
+  }
+  return false;
+}
+
+static bool Reads(const LayerParameter& layer_param, const string& blob_name) {
+  for (int i = 0; i < layer_param.bottom_size(); ++i) {
+    if (layer_param.bottom(i) == blob_name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool Touches(const LayerParameter& layer_param,
+    const string& blob_name) {
+  for (int i = 0; i < layer_param.top_size(); ++i) {
+    if (layer_param.top(i) == blob_name) {
+      return true;
+    }
+  }
+  return Reads(layer_param, blob_name);
+}
+
+void FoldInferenceLayers(const NetParameter& param, bool fuse_activations,
+    NetParameter* param_folded, vector<vector<LayerParameter> >* folded) {
+  param_folded->CopyFrom(param);
+  param_folded->clear_layer();
+  folded->clear();
+  const int num_layers = param.layer_size();
+  vector<bool> removed(num_layers, false);
+  for (int i = 0; i < num_layers; ++i) {
+    if (removed[i]) {
+      continue;
+    }
+    LayerParameter layer_param(param.layer(i));
+    if (!IsFoldHostLayer(layer_param)) {
+      param_folded->add_layer()->CopyFrom(layer_param);
+      continue;
+    }
+    vector<LayerParameter> absorbed(1, layer_param);
+    FusedActivationParameter activation;
+    // The blob holding the output of the layer and of those it absorbed.
+    string top = layer_param.top(0);
+    for (int k = i + 1; k < num_layers &&
+         activation.type() == FusedActivationParameter_Type_NONE; ++k) {
+      const LayerParameter& next = param.layer(k);
+      if (!Touches(next, top)) {
+        continue;
+      }
+      // The first layer to use top has to be its only reader, unless it
+      // computes in place, and the layers it is moved over must not use its
+      // top.
+      if (next.bottom_size() != 1 || next.bottom(0) != top ||
+          next.top_size() != 1 || next.loss_weight_size() > 0) {
+        break;
+      }
+      const string& next_top = next.top(0);
+      bool movable = true;
+      if (next_top != top) {
+        for (int m = k + 1; m < num_layers && movable; ++m) {
+          movable = !Reads(param.layer(m), top);
+        }
+        for (int m = i + 1; m < k && movable; ++m) {
+          movable = !Touches(param.layer(m), next_top);
+        }
+      }
+      if (!movable) {
+        break;
+      }
+      FusedActivationParameter next_activation;
+      if (IsFoldableAffineLayer(next)) {
+        absorbed.push_back(next);
+      } else if (fuse_activations &&
+          GetFusedActivation(next, &next_activation)) {
+        activation.CopyFrom(next_activation);
+      } else {
+        break;
+      }
+      removed[k] = true;
+      top = next_top;
+    }
+    layer_param.set_top(0, top);
+    if (absorbed.size() > 1) {
+      if (layer_param.type() == "InnerProduct") {
+        layer_param.mutable_inner_product_param()->set_bias_term(true);
+      } else {
+        layer_param.mutable_convolution_param()->set_bias_term(true);
+      }
+      folded->push_back(absorbed);
+    }
+    if (activation.type() != FusedActivationParameter_Type_NONE) {
+      layer_param.mutable_fused_activation_param()->CopyFrom(activation);
+    }
+    param_folded->add_layer()->CopyFrom(layer_param);
+  }
+}
+
+// The scale and shift the layer applies to each of the channels.
+template <typename Dtype>
+static void GetAffineTransform(Layer<Dtype>* layer, const int channels,
+    vector<double>* scale, vector<double>* shift) {
+  const LayerParameter& layer_param = layer->layer_param();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = layer->blobs();
+  const string& type = layer_param.type();
+  scale->assign(channels, 1);
+  shift->assign(channels, 0);
+  if (type == "BatchNorm") {
+    const BatchNormParameter& param = layer_param.batch_norm_param();
+    CHECK_EQ(blobs[0]->count(), channels);
+    const Dtype* mean = blobs[0]->cpu_data();
+    const Dtype* variance = blobs[1]->cpu_data();
+    const double factor = blobs[2]->cpu_data()[0] == 0 ?
+        0 : 1 / static_cast<double>(blobs[2]->cpu_data()[0]);
+    for (int c = 0; c < channels; ++c) {
+      const double std = param.add_eps_before_sqrt() ?
+          std::sqrt(variance[c] * factor + param.eps()) :
+          std::sqrt(variance[c] * factor) + param.eps();
+      (*scale)[c] = 1 / std;
+      (*shift)[c] = -mean[c] * factor / std;
+    }
+  } else if (type == "BN") {
+    const BNParameter& param = layer_param.bn_param();
+    CHECK_EQ(blobs[0]->count(), channels);
+    const Dtype* slope = blobs[0]->cpu_data();
+    const Dtype* bias = blobs[1]->cpu_data();
+    for (int c = 0; c < channels; ++c) {
+      if (param.icnet()) {
+        const Dtype* mean = blobs[2]->cpu_data();
+        const Dtype* variance = blobs[3]->cpu_data();
+        const double inv_std = 1 / std::sqrt(variance[c] + param.eps());
+        (*scale)[c] = slope[c] * inv_std;
+        (*shift)[c] = bias[c] - mean[c] * slope[c] * inv_std;
+      } else {
+        (*scale)[c] = slope[c];
+        (*shift)[c] = bias[c];
+      }
+    }
+  } else if (type == "Scale" || type == "Bias") {
+    const bool scalar = blobs[0]->count() == 1;
+    CHECK(scalar || blobs[0]->count() == channels);
+    for (int c = 0; c < channels; ++c) {
+      const int index = scalar ? 0 : c;
+      if (type == "Bias") {
+        (*shift)[c] = blobs[0]->cpu_data()[index];
+        continue;
+      }
+      (*scale)[c] = blobs[0]->cpu_data()[index];
+      if (layer_param.scale_param().bias_term()) {
+        (*shift)[c] = blobs[1]->cpu_data()[index];
+      }
+    }
+  } else {
+    LOG(FATAL) << "Cannot fold layer " << layer_param.name() << " of type "
+        << type;
+  }
+}
+
+template <typename Dtype>
+void FoldAffineLayers(const vector<shared_ptr<Layer<Dtype> > >& layers,
+    Layer<Dtype>* host) {
+  const LayerParameter& layer_param = layers[0]->layer_param();
+  const vector<shared_ptr<Blob<Dtype> > >& source_blobs = layers[0]->blobs();
+  vector<shared_ptr<Blob<Dtype> > >& blobs = host->blobs();
+  CHECK_EQ(blobs.size(), 2) << "Layer " << layer_param.name()
+      << " needs a bias to fold layers into.";
+  CHECK(source_blobs[0]->shape() == blobs[0]->shape());
+  const int channels = blobs[1]->count();
+  vector<double> scale(channels, 1);
+  vector<double> shift(channels, 0);
+  vector<double> layer_scale;
+  vector<double> layer_shift;
+  for (int i = 1; i < layers.size(); ++i) {
+    GetAffineTransform(layers[i].get(), channels, &layer_scale, &layer_shift);
+    for (int c = 0; c < channels; ++c) {
+      scale[c] *= layer_scale[c];
+      shift[c] = shift[c] * layer_scale[c] + layer_shift[c];
+    }
+  }
+  const Blob<Dtype>& source_weight = *source_blobs[0];
+  const Dtype* source = source_weight.cpu_data();
+  Dtype* weight = blobs[0]->mutable_cpu_data();
+  const int count = source_weight.count();
+  if (layer_param.type() == "Deconvolution") {
+    // (channels in, channels / group, kernel...): the output channels of a
+    // group are the second axis of its input channels.
+    const int group_channels = source_weight.shape(1);
+    const int group_inputs =
+        source_weight.shape(0) / layer_param.convolution_param().group();
+    const int kernel_dim = source_weight.count(2);
+    for (int i = 0; i < count; ++i) {
+      const int input = i / (group_channels * kernel_dim);
+      const int c = input / group_inputs * group_channels +
+          i / kernel_dim % group_channels;
+      weight[i] = source[i] * scale[c];
+    }
+  } else if (layer_param.type() == "InnerProduct" &&
+      layer_param.inner_product_param().transpose()) {
+    // (inputs, channels)
+    for (int i = 0; i < count; ++i) {
+      weight[i] = source[i] * scale[i % channels];
+    }
+  } else {
+    // (channels, inputs...)
+    const int dim = count / channels;
+    for (int i = 0; i < count; ++i) {
+      weight[i] = source[i] * scale[i / dim];
+    }
+  }
+  const Dtype* source_bias =
+      source_blobs.size() > 1 ? source_blobs[1]->cpu_data() : NULL;
+  Dtype* bias = blobs[1]->mutable_cpu_data();
+  for (int c = 0; c < channels; ++c) {
+    bias[c] = (source_bias ? source_bias[c] : 0) * scale[c] + shift[c];
+  }
+}
+
+template void FoldAffineLayers<float>(
+    const vector<shared_ptr<Layer<float> > >& layers, Layer<float>* host);
+template void FoldAffineLayers<double>(
+    const vector<shared_ptr<Layer<double> > >& layers, Layer<double>* host);
+
+template <typename Dtype>
+void caffe_cpu_fused_activation(const FusedActivationParameter& param,
+    const int n, Dtype* data) {
+  switch (param.type()) {
+  case FusedActivationParameter_Type_NONE:
+    break;
+  case FusedActivationParameter_Type_RELU: {
+    // As ReLULayer, which also maps NaN to 0.
+    const Dtype negative_slope = param.negative_slope();
+    for (int i = 0; i < n; ++i) {
+      const Dtype x = data[i];
+      Dtype y = std::max(x, Dtype(0)) + negative_slope * std::min(x, Dtype(0));
+      data[i] = std::isnan(y) ? Dtype(0) : y;
+    }
+    if (param.has_max()) {
+      const Dtype max = param.max();
+      for (int i = 0; i < n; ++i) {
+        data[i] = std::min(data[i], max);
+      }
+    }
+    if (param.has_min()) {
+      const Dtype min = param.min();
+      for (int i = 0; i < n; ++i) {
+        data[i] = std::max(data[i], min);
+      }
+    }
+    break;
+  }
+  case FusedActivationParameter_Type_CLIP: {
+    const Dtype min = param.min();
+    const Dtype max = param.max();
+    for (int i = 0; i < n; ++i) {
+      data[i] = std::max(min, std::min(data[i], max));
+    }
+    break;
+  }
+  case FusedActivationParameter_Type_HARD_SWISH:
+    // As HardSwishLayer.
+    for (int i = 0; i < n; ++i) {
+      const Dtype x = data[i];
+      data[i] = x * std::min(std::max(x + 3.0, 0.), 6.0) / 6.0;
+    }
+    break;
+  default:
+    LOG(FATAL) << "Unknown fused activation " << param.type();
+  }
+}
+
+template void caffe_cpu_fused_activation<float>(
+    const FusedActivationParameter& param, const int n, float* data);
+template void caffe_cpu_fused_activation<double>(
+    const FusedActivationParameter& param, const int n, double* data);
+
+}  // namespace caffe
@@ -6,11 +6,15 @@
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob, bool reshape) {
+boost::recursive_mutex& hdf5_mutex() {
+  static boost::recursive_mutex mutex;
+  return mutex;
+}
+
+// Verifies format of data stored in HDF5 file and returns its shape.
+vector<int> hdf5_get_nd_dataset_shape(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -62,6 +66,17 @@ void hdf5_load_nd_dataset_helper(
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
   }
+  return blob_dims;
+}
+
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob, bool reshape) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  vector<int> blob_dims =
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim);
 
   if (reshape) {
     blob->Reshape(blob_dims);
@@ -87,6 +102,7 @@ void hdf5_load_nd_dataset_helper(
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob, bool reshape) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob,
                               reshape);
   herr_t status = H5LTread_dataset_float(
@@ -97,6 +113,7 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<double>* blob, bool reshape) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob,
                               reshape);
   herr_t status = H5LTread_dataset_double(
@@ -104,10 +121,59 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads the rows [row_begin, row_begin + num_rows) of the first axis with a
+// hyperslab, so that only those are held in memory.
+template <typename Dtype>
+static void hdf5_load_nd_dataset_rows_helper(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, int row_begin,
+    int num_rows, Blob<Dtype>* blob, hid_t mem_type) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  vector<int> blob_dims =
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim);
+  CHECK_GE(row_begin, 0);
+  CHECK_LE(row_begin + num_rows, blob_dims[0])
+      << "Rows out of range of dataset " << dataset_name_;
+  blob_dims[0] = num_rows;
+  blob->Reshape(blob_dims);
+  std::vector<hsize_t> offset(blob_dims.size(), 0);
+  std::vector<hsize_t> count(blob_dims.begin(), blob_dims.end());
+  offset[0] = row_begin;
+  hid_t dataset_id = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset_id, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset_id);
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      offset.data(), NULL, count.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(count.size(), count.data(), NULL);
+  status = H5Dread(dataset_id, mem_type, mem_space, file_space, H5P_DEFAULT,
+      blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of dataset " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset_id);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, int row_begin,
+    int num_rows, Blob<float>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+      row_begin, num_rows, blob, H5T_NATIVE_FLOAT);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, int row_begin,
+    int num_rows, Blob<double>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+      row_begin, num_rows, blob, H5T_NATIVE_DOUBLE);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -129,6 +195,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -147,6 +214,7 @@ void hdf5_save_nd_dataset<double>(
 }
 
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -164,6 +232,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -171,6 +240,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -179,6 +249,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -188,6 +259,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 
 template <>
 float hdf5_load_float<float>(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   float val;
   herr_t status = H5LTread_dataset_float(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -196,6 +268,7 @@ float hdf5_load_float<float>(hid_t loc_id, const string& dataset_name) {
 }
 template <>
 double hdf5_load_float<double>(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   double val;
   herr_t status = H5LTread_dataset_double(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -206,6 +279,7 @@ double hdf5_load_float<double>(hid_t loc_id, const string& dataset_name) {
 template <>
 void hdf5_save_float<float>(hid_t loc_id,
                             const string& dataset_name, float f) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_float(loc_id, dataset_name.c_str(), 1, &one, &f);
@@ -215,6 +289,7 @@ void hdf5_save_float<float>(hid_t loc_id,
 template <>
 void hdf5_save_float<double>(hid_t loc_id,
                             const string& dataset_name, double f) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_double(loc_id, dataset_name.c_str(), 1, &one, &f);
@@ -223,6 +298,7 @@ void hdf5_save_float<double>(hid_t loc_id,
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -230,6 +306,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
@@ -0,0 +1,190 @@
+#include <boost/thread/mutex.hpp>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef USE_MKL
+  #include "mkl.h"
+#endif
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+// Buffers from this size on may be mapped with huge pages.
+static const size_t kHugePageSize = 2 << 20;
+
+class HostAllocator::sync {
+ public:
+  boost::mutex mutex_;
+};
+
+HostAllocator& HostAllocator::Get() {
+  // Never destroyed, so that memory freed at exit still finds it.
+  static HostAllocator* allocator = new HostAllocator();
+  return *allocator;
+}
+
+HostAllocator::HostAllocator()
+    : sync_(new sync()), max_retained_bytes_(0), huge_pages_(false) {
+  ResetStats();
+  stats_.retained_bytes = 0;
+  stats_.allocated_bytes = 0;
+}
+
+size_t HostAllocator::SizeClass(size_t size) {
+  if (size <= 64) {
+    return 64;
+  }
+  size_t base = 64;
+  while (base * 2 < size) {
+    base *= 2;
+  }
+  const size_t step = base / 4;
+  return (size + step - 1) / step * step;
+}
+
+void* HostAllocator::Allocate(size_t size) {
+  const size_t size_class = SizeClass(size);
+  bool huge_pages;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    huge_pages = huge_pages_;
+    stats_.allocated_bytes += size_class;
+    std::map<size_t, vector<Header*> >::iterator it = free_.find(size_class);
+    if (it != free_.end() && !it->second.empty()) {
+      Header* header = it->second.back();
+      it->second.pop_back();
+      stats_.retained_bytes -= size_class;
+      ++stats_.hits;
+      return header + 1;
+    }
+    ++stats_.misses;
+  }
+  return AllocateBlock(size_class, huge_pages) + 1;
+}
+
+void HostAllocator::Free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  Header* header = static_cast<Header*>(ptr) - 1;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stats_.allocated_bytes -= header->size;
+    if (stats_.retained_bytes + header->size <= max_retained_bytes_) {
+      free_[header->size].push_back(header);
+      stats_.retained_bytes += header->size;
+      return;
+    }
+  }
+  FreeBlock(header);
+}
+
+HostAllocator::Header* HostAllocator::AllocateBlock(size_t size,
+    bool huge_pages) {
+  const size_t bytes = size + sizeof(Header);
+  void* ptr = NULL;
+  bool mapped = false;
+#ifdef __linux__
+  if (huge_pages && size >= kHugePageSize) {
+    ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(ptr != MAP_FAILED) << "host allocation of size " << size
+        << " failed";
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    mapped = true;
+  }
+#endif
+  if (!mapped) {
+#ifdef USE_MKL
+    ptr = mkl_malloc(bytes, 64);
+#else
+    if (posix_memalign(&ptr, 64, bytes) != 0) {
+      ptr = NULL;
+    }
+#endif
+    CHECK(ptr) << "host allocation of size " << size << " failed";
+  }
+  Header* header = static_cast<Header*>(ptr);
+  header->size = size;
+  header->mapped = mapped;
+  return header;
+}
+
+void HostAllocator::FreeBlock(Header* header) {
+#ifdef __linux__
+  if (header->mapped) {
+    munmap(header, header->size + sizeof(Header));
+    return;
+  }
+#endif
+#ifdef USE_MKL
+  mkl_free(header);
+#else
+  free(header);
+#endif
+}
+
+void HostAllocator::Release(size_t bytes) {
+  vector<Header*> released;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    // Give back the largest buffers first.
+    std::map<size_t, vector<Header*> >::reverse_iterator it = free_.rbegin();
+    for (; it != free_.rend() && stats_.retained_bytes > bytes; ++it) {
+      while (!it->second.empty() && stats_.retained_bytes > bytes) {
+        released.push_back(it->second.back());
+        it->second.pop_back();
+        stats_.retained_bytes -= it->first;
+      }
+    }
+  }
+  for (int i = 0; i < released.size(); ++i) {
+    FreeBlock(released[i]);
+  }
+}
+
+void HostAllocator::set_max_retained_bytes(size_t bytes) {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    max_retained_bytes_ = bytes;
+  }
+  Release(bytes);
+}
+
+size_t HostAllocator::max_retained_bytes() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return max_retained_bytes_;
+}
+
+void HostAllocator::set_huge_pages(bool huge_pages) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  huge_pages_ = huge_pages;
+}
+
+bool HostAllocator::huge_pages() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return huge_pages_;
+}
+
+HostAllocator::Stats HostAllocator::stats() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return stats_;
+}
+
+void HostAllocator::ResetStats() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  stats_.hits = 0;
+  stats_.misses = 0;
+}
+
+void HostAllocator::Trim() {
+  Release(0);
+}
+
+}  // namespace caffe
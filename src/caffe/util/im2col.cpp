@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
@@ -15,16 +16,14 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
-template <typename Dtype>
-void im2col_cpu(const Dtype* data_im, const int channels,
-    const int height, const int width, const int kernel_h, const int kernel_w,
-    const int pad_h, const int pad_w,
+void im2col_output_and_pad(const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
     const int stride_h, const int stride_w,
 	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
 	const int pad_t, const int pad_b, //CUSTOMIZATION
     const int dilation_h, const int dilation_w,
-    Dtype* data_col) {
-
+    int* output_h_out, int* output_w_out, int* pad_top_out,
+    int* pad_left_out) {
 	//<--CUSTOMIZATION
 	int pad_top=0, pad_left=0; //pad_bottom=0, pad_right=0;
 	int output_h, output_w;
@@ -69,6 +68,28 @@ void im2col_cpu(const Dtype* data_im, const int channels,
 		break;
 	}
   //CUSTOMIZATION-->
+  *output_h_out = output_h;
+  *output_w_out = output_w;
+  *pad_top_out = pad_top;
+  *pad_left_out = pad_left;
+}
+
+template <typename Dtype>
+void im2col_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
+	const int pad_t, const int pad_b, //CUSTOMIZATION
+    const int dilation_h, const int dilation_w,
+    Dtype* data_col, const Dtype pad_value) {
+
+  //<--CUSTOMIZATION
+  int pad_top, pad_left, output_h, output_w;
+  im2col_output_and_pad(height, width, kernel_h, kernel_w, pad_h, pad_w,
+      stride_h, stride_w, pad_type, pad_l, pad_r, pad_t, pad_b,
+      dilation_h, dilation_w, &output_h, &output_w, &pad_top, &pad_left);
+  //CUSTOMIZATION-->
 
   const int channel_size = height * width;
   for (int channel = channels; channel--; data_im += channel_size) {
@@ -79,7 +100,7 @@ void im2col_cpu(const Dtype* data_im, const int channels,
         for (int output_rows = output_h; output_rows; output_rows--) {
           if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
             for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
+              *(data_col++) = pad_value;
             }
           } else {
             //int input_col = -pad_w + kernel_col * dilation_w;
@@ -88,7 +109,7 @@ void im2col_cpu(const Dtype* data_im, const int channels,
               if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
                 *(data_col++) = data_im[input_row * width + input_col];
               } else {
-                *(data_col++) = 0;
+                *(data_col++) = pad_value;
               }
               input_col += stride_w;
             }
@@ -107,14 +128,78 @@ template void im2col_cpu<float>(const float* data_im, const int channels,
 	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
 	const int pad_t, const int pad_b, //CUSTOMIZATION
 	const int dilation_h, const int dilation_w,
-    float* data_col);
+    float* data_col, const float pad_value);
 template void im2col_cpu<double>(const double* data_im, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w,
 	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
 	const int pad_t, const int pad_b, //CUSTOMIZATION
 	const int dilation_h, const int dilation_w,
-    double* data_col);
+    double* data_col, const double pad_value);
+template void im2col_cpu<uint8_t>(const uint8_t* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+	const int pad_type, const int pad_l, const int pad_r, //CUSTOMIZATION
+	const int pad_t, const int pad_b, //CUSTOMIZATION
+	const int dilation_h, const int dilation_w,
+    uint8_t* data_col, const uint8_t pad_value);
+
+template <typename Dtype>
+void im2row_cpu(const Dtype* data_im, const int channels,
+    const int pixel_stride, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int pad_type, const int pad_l, const int pad_r,
+    const int pad_t, const int pad_b,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, Dtype* data_row) {
+  int pad_top, pad_left, output_h, output_w;
+  im2col_output_and_pad(height, width, kernel_h, kernel_w, pad_h, pad_w,
+      stride_h, stride_w, pad_type, pad_l, pad_r, pad_t, pad_b,
+      dilation_h, dilation_w, &output_h, &output_w, &pad_top, &pad_left);
+  for (int output_row = row_begin; output_row < row_end; ++output_row) {
+    for (int output_col = 0; output_col < output_w; ++output_col) {
+      for (int kernel_row = 0; kernel_row < kernel_h; ++kernel_row) {
+        const int input_row =
+            output_row * stride_h - pad_top + kernel_row * dilation_h;
+        if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+          caffe_set(kernel_w * channels, Dtype(0), data_row);
+          data_row += kernel_w * channels;
+          continue;
+        }
+        for (int kernel_col = 0; kernel_col < kernel_w; ++kernel_col) {
+          const int input_col =
+              output_col * stride_w - pad_left + kernel_col * dilation_w;
+          if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+            const Dtype* pixel =
+                data_im + (input_row * width + input_col) * pixel_stride;
+            std::copy(pixel, pixel + channels, data_row);
+          } else {
+            caffe_set(channels, Dtype(0), data_row);
+          }
+          data_row += channels;
+        }
+      }
+    }
+  }
+}
+
+template void im2row_cpu<float>(const float* data_im, const int channels,
+    const int pixel_stride, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int pad_type, const int pad_l, const int pad_r,
+    const int pad_t, const int pad_b,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, float* data_row);
+template void im2row_cpu<double>(const double* data_im, const int channels,
+    const int pixel_stride, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int pad_type, const int pad_l, const int pad_r,
+    const int pad_t, const int pad_b,
+    const int dilation_h, const int dilation_w,
+    const int row_begin, const int row_end, double* data_row);
 
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
@@ -224,49 +309,11 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     Dtype* data_im) {
     caffe_set(height * width * channels, Dtype(0), data_im);
 
-	//<--CUSTOMIZATION
-	int pad_top=0, pad_left=0; //pad_bottom=0, pad_right=0;
-	int output_h, output_w;
-	switch (pad_type) {
-	  case 0:
-		if (pad_l != 0 || pad_r != 0 || pad_t != 0 || pad_b != 0) {
-		  output_h = (height + pad_t + pad_b -
-	          (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
-		  output_w = (width + pad_l + pad_r -
-			  (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-		  pad_top=pad_t;
-	      pad_left=pad_l;
-		}
-		else{
-		  output_h = (height + 2 * pad_h -
-		      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
-		  output_w = (width + 2 * pad_w -
-		      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-		  pad_top=pad_h;
-		  pad_left=pad_w;
-		}
-		break;
-	  case 1: //For "SAME" padding
-		output_h = ceil(float(height)/float(stride_h));
-		output_w = ceil(float(width)/float(stride_w));
-		int pad_along_height, pad_along_width;
-		if (height % stride_h == 0)
-		  pad_along_height = (kernel_h-stride_h)>0 ? (kernel_h-stride_h) : 0;
-		else
-		  pad_along_height = (kernel_h-height%stride_h)>0 ? (kernel_h-height%stride_h) : 0;
-		if (width % stride_w == 0)
-		  pad_along_width = (kernel_w-stride_w)>0 ? (kernel_w-stride_w) : 0;
-		else
-		  pad_along_width = (kernel_w-width%stride_w)>0 ? (kernel_w-width%stride_w): 0;
-		pad_top = pad_along_height / 2;
-		//pad_bottom = pad_along_height - pad_top;
-		pad_left = pad_along_width / 2;
-		//pad_right = pad_along_width - pad_left;
-		break;
-	  default:
-		LOG(FATAL) << "Unknown padding type.";
-		break;
-	}
+  //<--CUSTOMIZATION
+  int pad_top, pad_left, output_h, output_w;
+  im2col_output_and_pad(height, width, kernel_h, kernel_w, pad_h, pad_w,
+      stride_h, stride_w, pad_type, pad_l, pad_r, pad_t, pad_b,
+      dilation_h, dilation_w, &output_h, &output_w, &pad_top, &pad_left);
   //CUSTOMIZATION-->
 
   const int channel_size = height * width;
@@ -0,0 +1,229 @@
+#include <map>
+#include <set>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/insert_layouts.hpp"
+
+namespace caffe {
+
+// The NHWC axis of each NCHW axis of a 4-D blob.
+static const int kNHWCAxis[] = {0, 3, 1, 2};
+
+// The NHWC axis of an axis of a 4-D NCHW blob, or -1 if it is out of range.
+static int NHWCAxis(int axis) {
+  if (axis < 0) {
+    axis += 4;
+  }
+  return (axis >= 0 && axis < 4) ? kNHWCAxis[axis] : -1;
+}
+
+static const char* const kElementwiseTypes[] = {
+  "AbsVal", "BNLL", "Clip", "Dropout", "ELU", "Exp", "HardSigmoid",
+  "HardSwish", "Log", "Mish", "Power", "ReLU", "Sigmoid", "Swish", "TanH"
+};
+
+bool IsNHWCAnchorLayer(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) {
+    return false;
+  }
+  if (layer_param.type() == "Convolution") {
+    const ConvolutionParameter& param = layer_param.convolution_param();
+    return param.axis() == 1 && param.kernel_size_size() <= 2 &&
+        !param.force_nd_im2col() && !param.submanifold_sparse() &&
+        param.input_scale() == 1 && param.weight_scale() == 1 &&
+        param.output_scale() == 1 && param.input_zero_point() == 0 &&
+        param.weight_zero_point() == 0 && param.output_zero_point() == 0 &&
+        !param.per_channel_scale_weight() &&
+        !param.per_channel_scale_output() &&
+        param.saturate() == ConvolutionParameter_SaturateMethod_None;
+  }
+  if (layer_param.type() == "Pooling") {
+    const PoolingParameter& param = layer_param.pooling_param();
+    return (param.pool() == PoolingParameter_PoolMethod_MAX ||
+        param.pool() == PoolingParameter_PoolMethod_AVE ||
+        param.pool() == PoolingParameter_PoolMethod_AVE_EXC_PAD) &&
+        param.output_scale() == 1 && param.output_zero_point() == 0 &&
+        param.saturate() == PoolingParameter_SaturateMethod_None;
+  }
+  return false;
+}
+
+bool IsNHWCFollowerLayer(const LayerParameter& layer_param) {
+  const string& type = layer_param.type();
+  if (type == "Eltwise") {
+    return true;
+  }
+  if (type == "Concat") {
+    const ConcatParameter& param = layer_param.concat_param();
+    return NHWCAxis(param.has_concat_dim() ?
+        static_cast<int>(param.concat_dim()) : param.axis()) >= 0;
+  }
+  if (type == "BatchNorm") {
+    // Only the global statistics are computed in NHWC.
+    const BatchNormParameter& param = layer_param.batch_norm_param();
+    return !param.has_use_global_stats() || param.use_global_stats();
+  }
+  if (type == "Scale" || type == "Bias") {
+    const int axis = type == "Scale" ? layer_param.scale_param().axis() :
+        layer_param.bias_param().axis();
+    const int num_axes = type == "Scale" ?
+        layer_param.scale_param().num_axes() :
+        layer_param.bias_param().num_axes();
+    // Per-channel or scalar factors only, from the layer's own blobs.
+    return layer_param.bottom_size() == 1 && NHWCAxis(axis) >= 0 &&
+        (num_axes == 0 || (num_axes == 1 && NHWCAxis(axis) == 3));
+  }
+  for (int i = 0; i < sizeof(kElementwiseTypes) / sizeof(char*); ++i) {
+    if (type == kElementwiseTypes[i]) {
+      return layer_param.bottom_size() == 1;
+    }
+  }
+  return false;
+}
+
+// Switches the layer to NHWC, moving the axes in its parameters.
+static void SetNHWC(LayerParameter* layer_param) {
+  layer_param->set_data_format("NHWC");
+  const string& type = layer_param->type();
+  if (type == "Concat") {
+    ConcatParameter* param = layer_param->mutable_concat_param();
+    const int axis = param->has_concat_dim() ?
+        static_cast<int>(param->concat_dim()) : param->axis();
+    param->clear_concat_dim();
+    param->set_axis(NHWCAxis(axis));
+  } else if (type == "Scale") {
+    ScaleParameter* param = layer_param->mutable_scale_param();
+    param->set_axis(NHWCAxis(param->axis()));
+  } else if (type == "Bias") {
+    BiasParameter* param = layer_param->mutable_bias_param();
+    param->set_axis(NHWCAxis(param->axis()));
+  }
+}
+
+void ConfigureLayoutPermuteLayer(const string& layer_name,
+    const string& bottom_name, const string& top_name, const bool to_nhwc,
+    LayerParameter* permute_layer_param) {
+  const int to_nhwc_order[] = {0, 2, 3, 1};
+  const int to_nchw_order[] = {0, 3, 1, 2};
+  permute_layer_param->Clear();
+  permute_layer_param->set_name(layer_name);
+  permute_layer_param->set_type("Permute");
+  permute_layer_param->add_bottom(bottom_name);
+  permute_layer_param->add_top(top_name);
+  PermuteParameter* permute_param =
+      permute_layer_param->mutable_permute_param();
+  for (int i = 0; i < 4; ++i) {
+    permute_param->add_order(to_nhwc ? to_nhwc_order[i] : to_nchw_order[i]);
+  }
+}
+
+// Returns base, or base followed by _1, _2, ... if it is taken, and takes it.
+static string UniqueName(const string& base, set<string>* taken) {
+  string name = base;
+  for (int i = 1; taken->count(name); ++i) {
+    name = base + "_" + format_int(i);
+  }
+  taken->insert(name);
+  return name;
+}
+
+void InsertLayoutConversions(const NetParameter& param,
+    NetParameter* param_nhwc) {
+  param_nhwc->CopyFrom(param);
+  param_nhwc->clear_layer();
+  // The names of the blobs and of the layers of param, and of the new ones.
+  // The Permute layers are named after their tops where that name is free
+  // among the layers.
+  set<string> blob_names;
+  set<string> layer_names;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    layer_names.insert(layer_param.name());
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      blob_names.insert(layer_param.bottom(j));
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      blob_names.insert(layer_param.top(j));
+    }
+  }
+  // The blobs of the new net that hold the current value of each blob of
+  // param, in either layout. A blob is missing from a map while its value
+  // in that layout is stale or was never needed.
+  map<string, string> nchw_blob;
+  map<string, string> nhwc_blob;
+  // The blobs of the new net written by a layer, and those read by one.
+  set<string> produced;
+  set<string> consumed;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    bool nhwc = IsNHWCAnchorLayer(layer_param);
+    if (!nhwc && layer_param.bottom_size() > 0 &&
+        IsNHWCFollowerLayer(layer_param)) {
+      nhwc = true;
+      for (int j = 0; j < layer_param.bottom_size(); ++j) {
+        nhwc = nhwc && nhwc_blob.count(layer_param.bottom(j));
+      }
+    }
+    map<string, string>& layout_blob = nhwc ? nhwc_blob : nchw_blob;
+    map<string, string>& other_blob = nhwc ? nchw_blob : nhwc_blob;
+    LayerParameter layer_param_nhwc(layer_param);
+    // Bring the bottoms to the layer's layout.
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      const string& blob_name = layer_param.bottom(j);
+      if (!layout_blob.count(blob_name)) {
+        CHECK(other_blob.count(blob_name)) << "Unknown bottom blob '"
+            << blob_name << "' (layer '" << layer_param.name()
+            << "', bottom index " << j << ")";
+        // A blob goes back to NCHW under its own name where possible.
+        const string converted_name = (!nhwc && !produced.count(blob_name)) ?
+            blob_name : UniqueName(blob_name + (nhwc ? "_nhwc" : "_nchw"),
+            &blob_names);
+        ConfigureLayoutPermuteLayer(UniqueName(converted_name, &layer_names),
+            other_blob[blob_name], converted_name, nhwc,
+            param_nhwc->add_layer());
+        consumed.insert(other_blob[blob_name]);
+        produced.insert(converted_name);
+        layout_blob[blob_name] = converted_name;
+      }
+      layer_param_nhwc.set_bottom(j, layout_blob[blob_name]);
+      consumed.insert(layout_blob[blob_name]);
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      const string& blob_name = layer_param.top(j);
+      string top_name;
+      if (j < layer_param.bottom_size() && layer_param.bottom(j) == blob_name) {
+        // In-place computation stays in place.
+        top_name = layer_param_nhwc.bottom(j);
+      } else if (nhwc) {
+        top_name = UniqueName(blob_name + "_nhwc", &blob_names);
+      } else {
+        top_name = blob_name;
+      }
+      layer_param_nhwc.set_top(j, top_name);
+      produced.insert(top_name);
+      consumed.erase(top_name);
+      layout_blob[blob_name] = top_name;
+      other_blob.erase(blob_name);
+    }
+    if (nhwc) {
+      SetNHWC(&layer_param_nhwc);
+    }
+    param_nhwc->add_layer()->CopyFrom(layer_param_nhwc);
+  }
+  // Outputs of the net left in NHWC.
+  for (map<string, string>::iterator it = nhwc_blob.begin();
+       it != nhwc_blob.end(); ++it) {
+    if (nchw_blob.count(it->first) || consumed.count(it->second)) {
+      continue;
+    }
+    const string converted_name = !produced.count(it->first) ? it->first :
+        UniqueName(it->first + "_nchw", &blob_names);
+    ConfigureLayoutPermuteLayer(UniqueName(converted_name, &layer_names),
+        it->second, converted_name, false, param_nhwc->add_layer());
+    produced.insert(converted_name);
+  }
+}
+
+}  // namespace caffe
@@ -2,6 +2,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/interp.hpp"
+#include "caffe/util/sampling.hpp"
 #include <algorithm>
 #include <cmath>
 
@@ -16,6 +17,16 @@ void caffe_cpu_interp2(const int channels,
     Dtype *data2, const int x2, const int y2, const int height2, const int width2, const int Height2, const int Width2) {
   CHECK(x1 >= 0 && y1 >= 0 && height1 > 0 && width1 > 0 && x2 >= 0 && y2 >= 0 && height2 > 0 && width2 > 0);
   CHECK(Width1 >= width1 + x1 && Height1 >= height1 + y1 && Width2 >= width2 + x2 && Height2 >= height2 + y2);
+  // planar images: on the sampling engine
+  if (!packed) {
+    SampleAxis<Dtype> axis_y, axis_x;
+    caffe_bilinear_axis(height1, height2, &axis_y);
+    caffe_bilinear_axis(width1, width2, &axis_x);
+    caffe_cpu_resample(channels, axis_y, axis_x,
+        data1 + y1 * Width1 + x1, Width1, Height1 * Width1,
+        data2 + y2 * Width2 + x2, Width2, Height2 * Width2);
+    return;
+  }
   // special case: just copy
   if (height1 == height2 && width1 == width2) {
     for (int h2 = 0; h2 < height2; ++h2) {
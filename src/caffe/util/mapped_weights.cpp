@@ -0,0 +1,272 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <climits>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+static const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'M', 'A', 'P'};
+static const uint32_t kVersion = 1;
+// The magic, the version, 4 reserved bytes, the size of the index and the
+// offset of the tensor data.
+static const size_t kHeaderSize = 32;
+static const size_t kPageSize = 4096;
+static const size_t kTensorAlignment = 64;
+
+static bool IsLittleEndian() {
+  const uint16_t one = 1;
+  return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+static size_t AlignUp(size_t n, size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t ReadUint(const char* bytes, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(bytes[i]);
+  }
+  return value;
+}
+
+static void AppendUint(uint64_t value, int num_bytes, string* bytes) {
+  for (int i = 0; i < num_bytes; ++i) {
+    bytes->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+static uint64_t MappedBlobCount(const MappedWeightsIndex::Blob& source) {
+  uint64_t count = 1;
+  for (int i = 0; i < source.shape().dim_size(); ++i) {
+    count *= source.shape().dim(i);
+  }
+  return count;
+}
+
+static size_t MappedBlobBytes(const MappedWeightsIndex::Blob& source) {
+  return MappedBlobCount(source) *
+      (source.type() == MappedWeightsIndex_Blob_Type_DOUBLE ?
+      sizeof(double) : sizeof(float));
+}
+
+vector<int> MappedBlobShape(const MappedWeightsIndex::Blob& source) {
+  vector<int> shape(source.shape().dim_size());
+  for (int i = 0; i < shape.size(); ++i) {
+    CHECK_LE(source.shape().dim(i), INT_MAX);
+    shape[i] = source.shape().dim(i);
+  }
+  return shape;
+}
+
+bool MappedWeights::IsMappedWeights(const string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(kMagic)) &&
+      memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+template <typename Dtype>
+bool MappedWeights::ShapeEquals(const MappedWeightsIndex::Blob& source,
+    const Blob<Dtype>& blob) {
+  const vector<int> shape = MappedBlobShape(source);
+  if (source.legacy_shape()) {
+    return shape.size() == 4 && blob.num_axes() <= 4 &&
+        blob.LegacyShape(-4) == shape[0] && blob.LegacyShape(-3) == shape[1] &&
+        blob.LegacyShape(-2) == shape[2] && blob.LegacyShape(-1) == shape[3];
+  }
+  return shape == blob.shape();
+}
+
+template bool MappedWeights::ShapeEquals(
+    const MappedWeightsIndex::Blob& source, const Blob<float>& blob);
+template bool MappedWeights::ShapeEquals(
+    const MappedWeightsIndex::Blob& source, const Blob<double>& blob);
+
+MappedWeights::MappedWeights(const string& filename)
+    : filename_(filename), map_(NULL), size_(0), mapped_(false),
+      data_offset_(0) {
+  CHECK(IsLittleEndian())
+      << "Mapped weights are only read on little-endian hosts.";
+#ifndef _MSC_VER
+  const int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Couldn't stat " << filename;
+  size_ = file_stat.st_size;
+  if (size_ > 0) {
+    // Writable but private, so that blobs can still be modified in place.
+    void* map = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    CHECK(map != MAP_FAILED) << "Couldn't map " << filename;
+    map_ = static_cast<char*>(map);
+    mapped_ = true;
+  }
+  close(fd);
+#else
+  std::ifstream file(filename.c_str(),
+      std::ios::in | std::ios::binary | std::ios::ate);
+  CHECK(file) << "File not found: " << filename;
+  size_ = file.tellg();
+  map_ = new char[size_];
+  file.seekg(0);
+  CHECK(file.read(map_, size_)) << "Couldn't read " << filename;
+#endif
+  CHECK(size_ >= kHeaderSize && memcmp(map_, kMagic, sizeof(kMagic)) == 0)
+      << filename << " is not a mapped weights file.";
+  CHECK_EQ(ReadUint(map_ + 8, 4), kVersion)
+      << "Unsupported version of mapped weights file " << filename;
+  const uint64_t index_size = ReadUint(map_ + 16, 8);
+  data_offset_ = ReadUint(map_ + 24, 8);
+  CHECK(index_size <= size_ - kHeaderSize &&
+      data_offset_ >= kHeaderSize + index_size && data_offset_ <= size_ &&
+      index_size <= INT_MAX && index_.ParseFromArray(map_ + kHeaderSize,
+      static_cast<int>(index_size)))
+      << "Corrupted index in mapped weights file " << filename;
+  for (int i = 0; i < index_.layers_size(); ++i) {
+    const MappedWeightsIndex::Layer& layer = index_.layers(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      const MappedWeightsIndex::Blob& source = layer.blobs(j);
+      CHECK(source.offset() % kTensorAlignment == 0 &&
+          source.offset() <= size_ - data_offset_ &&
+          MappedBlobBytes(source) <= size_ - data_offset_ - source.offset())
+          << "Corrupted blob " << j << " of layer " << layer.name()
+          << " in mapped weights file " << filename;
+    }
+  }
+}
+
+MappedWeights::~MappedWeights() {
+#ifndef _MSC_VER
+  if (mapped_) {
+    munmap(map_, size_);
+  }
+#else
+  delete[] map_;
+#endif
+}
+
+const char* MappedWeights::data(const MappedWeightsIndex::Blob& source)
+    const {
+  return map_ + data_offset_ + source.offset();
+}
+
+template <typename Dtype>
+void MappedWeights::Load(const MappedWeightsIndex::Blob& source,
+    Blob<Dtype>* blob) const {
+  CHECK(ShapeEquals(source, *blob))
+      << "Shape mismatch loading mapped blob of shape "
+      << Blob<Dtype>(MappedBlobShape(source)).shape_string()
+      << " into blob of shape " << blob->shape_string();
+  if (blob->count() == 0) {
+    return;
+  }
+  const bool source_double =
+      source.type() == MappedWeightsIndex_Blob_Type_DOUBLE;
+  if (source_double == (sizeof(Dtype) == sizeof(double))) {
+    blob->set_cpu_data(reinterpret_cast<Dtype*>(
+        const_cast<char*>(data(source))));
+  } else if (source_double) {
+    const double* elements = reinterpret_cast<const double*>(data(source));
+    Dtype* blob_data = blob->mutable_cpu_data();
+    for (int i = 0; i < blob->count(); ++i) {
+      blob_data[i] = elements[i];
+    }
+  } else {
+    const float* elements = reinterpret_cast<const float*>(data(source));
+    Dtype* blob_data = blob->mutable_cpu_data();
+    for (int i = 0; i < blob->count(); ++i) {
+      blob_data[i] = elements[i];
+    }
+  }
+}
+
+template void MappedWeights::Load(const MappedWeightsIndex::Blob& source,
+    Blob<float>* blob) const;
+template void MappedWeights::Load(const MappedWeightsIndex::Blob& source,
+    Blob<double>* blob) const;
+
+void WriteMappedWeights(const NetParameter& param, const string& filename) {
+  CHECK(IsLittleEndian())
+      << "Mapped weights are only written on little-endian hosts.";
+  MappedWeightsIndex index;
+  vector<const BlobProto*> blob_protos;
+  size_t data_size = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    if (layer_param.blobs_size() == 0) {
+      continue;
+    }
+    MappedWeightsIndex::Layer* layer = index.add_layers();
+    layer->set_name(layer_param.name());
+    for (int j = 0; j < layer_param.blobs_size(); ++j) {
+      const BlobProto& blob_proto = layer_param.blobs(j);
+      MappedWeightsIndex::Blob* blob = layer->add_blobs();
+      if (blob_proto.has_shape()) {
+        blob->mutable_shape()->CopyFrom(blob_proto.shape());
+      } else if (blob_proto.has_num() || blob_proto.has_channels() ||
+          blob_proto.has_height() || blob_proto.has_width()) {
+        blob->mutable_shape()->add_dim(blob_proto.num());
+        blob->mutable_shape()->add_dim(blob_proto.channels());
+        blob->mutable_shape()->add_dim(blob_proto.height());
+        blob->mutable_shape()->add_dim(blob_proto.width());
+        blob->set_legacy_shape(true);
+      }
+      const bool is_double = blob_proto.double_data_size() > 0;
+      blob->set_type(is_double ? MappedWeightsIndex_Blob_Type_DOUBLE :
+          MappedWeightsIndex_Blob_Type_FLOAT);
+      CHECK_EQ(MappedBlobCount(*blob), is_double ?
+          blob_proto.double_data_size() : blob_proto.data_size())
+          << "Wrong number of elements in blob " << j << " of layer "
+          << layer_param.name();
+      data_size = AlignUp(data_size, kTensorAlignment);
+      blob->set_offset(data_size);
+      data_size += MappedBlobBytes(*blob);
+      blob_protos.push_back(&blob_proto);
+    }
+  }
+  string index_bytes;
+  CHECK(index.SerializeToString(&index_bytes));
+  const size_t data_offset = AlignUp(kHeaderSize + index_bytes.size(),
+      kPageSize);
+  string header(kMagic, sizeof(kMagic));
+  AppendUint(kVersion, 4, &header);
+  AppendUint(0, 4, &header);
+  AppendUint(index_bytes.size(), 8, &header);
+  AppendUint(data_offset, 8, &header);
+
+  std::ofstream file(filename.c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  CHECK(file) << "Couldn't open " << filename;
+  file.write(header.data(), header.size());
+  file.write(index_bytes.data(), index_bytes.size());
+  const string padding(kPageSize, '\0');
+  file.write(padding.data(), data_offset - kHeaderSize - index_bytes.size());
+  size_t position = 0;
+  int blob_id = 0;
+  for (int i = 0; i < index.layers_size(); ++i) {
+    for (int j = 0; j < index.layers(i).blobs_size(); ++j, ++blob_id) {
+      const MappedWeightsIndex::Blob& blob = index.layers(i).blobs(j);
+      const BlobProto& blob_proto = *blob_protos[blob_id];
+      file.write(padding.data(), blob.offset() - position);
+      const char* elements = blob.type() == MappedWeightsIndex_Blob_Type_DOUBLE
+          ? reinterpret_cast<const char*>(blob_proto.double_data().data())
+          : reinterpret_cast<const char*>(blob_proto.data().data());
+      file.write(elements, MappedBlobBytes(blob));
+      position = blob.offset() + MappedBlobBytes(blob);
+    }
+  }
+  CHECK(file) << "Error writing " << filename;
+}
+
+}  // namespace caffe
@@ -5,6 +5,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
 #include "caffe/util/rng.hpp"
 
 #define SIGNED_SATURATE_MAX 2047
@@ -38,6 +39,24 @@ void caffe_cpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
       ldb, beta, C, N);
 }
 
+template<>
+void caffe_cpu_strided_gemm<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float alpha, const float* A, const int lda, const float* B,
+    const int ldb, const float beta, float* C, const int ldc) {
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
+template<>
+void caffe_cpu_strided_gemm<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double alpha, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
 template <>
 void caffe_cpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
@@ -89,6 +108,19 @@ void caffe_add_scalar(const int N, const double alpha, double* Y) {
   }
 }
 
+template <typename Dtype>
+void caffe_add_scalar(const int N, const Dtype alpha, const Dtype* X,
+    Dtype* Y) {
+  for (int i = 0; i < N; ++i) {
+    Y[i] = X[i] + alpha;
+  }
+}
+
+template void caffe_add_scalar<float>(const int N, const float alpha,
+    const float* X, float* Y);
+template void caffe_add_scalar<double>(const int N, const double alpha,
+    const double* X, double* Y);
+
 template <>
 void caffe_div_scalar(const int N, const float alpha, float* Y) {
   for (int i = 0; i < N; ++i) {
@@ -422,7 +454,7 @@ template void caffe_cpu_saturate<double>(const int n, double* x, double saturate
 
 template <typename Dtype>
 void caffe_cpu_universal_saturate(const int n, Dtype* x, Dtype SATURATE_MAX, Dtype SATURATE_MIN) {
-  for (int i = 0; i < n; ++i) {
+  for (int i = caffe_simd_saturate(n, x, SATURATE_MAX, SATURATE_MIN); i < n; ++i) {
     if (x[i] > SATURATE_MAX) {
       x[i] = SATURATE_MAX;
     }
@@ -550,7 +582,7 @@ void MultiplyByQuantizedMultiplierVR(const int n, Dtype* x, const int mul, const
     // https://github.com/tensorflow/tensorflow/blob/cfa91be9863a91d5105a3b4941096044ab32036b/tensorflow/core/kernels/quantized_conv_ops.cc#L73
     // also found ruy::MultiplyByQuantizedMultiplier using single-rounding
     // https://github.com/google/ruy/blob/master/ruy/apply_multiplier.cc#L48
-    for (int i = 0; i < n; ++i) {
+    for (int i = caffe_simd_multiply_single_round(n, x, mul, shf); i < n; ++i) {
       long long v = (long long) x[i];
       v *= mul;
       v += round;
@@ -558,10 +590,10 @@ void MultiplyByQuantizedMultiplierVR(const int n, Dtype* x, const int mul, const
       x[i] = v;
     }
   } else if (round_mode == 2) {
-    for(int i = 0; i < n; ++i) {
-      // ref see https://github.com/tensorflow/tensorflow/blob/master/tensorflow/lite/kernels/internal/common.h#L251
-      int left_shift = shift > 0 ? shift : 0;
-      int right_shift = shift > 0 ? 0 : -shift;
+    // ref see https://github.com/tensorflow/tensorflow/blob/master/tensorflow/lite/kernels/internal/common.h#L251
+    int left_shift = shift > 0 ? shift : 0;
+    int right_shift = shift > 0 ? 0 : -shift;
+    for (int i = caffe_simd_multiply_double_round(n, x, mul, left_shift, right_shift); i < n; ++i) {
       x[i] = tfl_RoundingDivideByPOT(tfl_SaturatingRoundingDoublingHighMul(int(x[i]) *
           (1 << left_shift), mul), right_shift);
     }
@@ -572,6 +604,8 @@ template void MultiplyByQuantizedMultiplierVR<float>(const int n, float* x, cons
 
 template void MultiplyByQuantizedMultiplierVR<double>(const int n, double* x, const int mul, const int shift, const int round_mode);
 
+template void MultiplyByQuantizedMultiplierVR<int>(const int n, int* x, const int mul, const int shift, const int round_mode);
+
 int tfl_SaturatingRoundingDoublingHighMul(int a, int b) {
   // https://github.com/google/gemmlowp/blob/master/fixedpoint/fixedpoint.h#L340
   bool overflow = a == b && a== std::numeric_limits<std::int32_t>::min();
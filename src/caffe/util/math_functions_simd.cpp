@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <climits>
+
+#include "caffe/util/math_functions_simd.hpp"
+
+// The x86 kernels are compiled with per-function target attributes, so the
+// rest of the build keeps its baseline flags and the kernels are only called
+// after the CPU has been checked at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CAFFE_SIMD_X86
+#include <immintrin.h>
+#define CAFFE_TARGET_AVX2 __attribute__((target("avx2")))
+#define CAFFE_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace caffe {
+
+static SimdLevel caffe_simd_detect() {
+#ifdef CAFFE_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return SIMD_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SIMD_AVX2;
+  }
+#endif
+  return SIMD_SCALAR;
+}
+
+static SimdLevel detected_simd_level() {
+  static const SimdLevel level = caffe_simd_detect();
+  return level;
+}
+
+static SimdLevel* current_simd_level() {
+  static SimdLevel level = detected_simd_level();
+  return &level;
+}
+
+SimdLevel caffe_simd_level() {
+  return *current_simd_level();
+}
+
+SimdLevel caffe_set_simd_level(SimdLevel level) {
+  *current_simd_level() = std::min(level, detected_simd_level());
+  return caffe_simd_level();
+}
+
+#ifdef CAFFE_SIMD_X86
+
+// Notes shared by the AVX2 and AVX-512 kernels:
+// - Elements are loaded truncated to int32 as int(x) does; values out of the
+//   int32 range become INT_MIN, again like the scalar conversion on x86.
+// - mul_epi32 multiplies the even int32 lanes into int64 lanes, so the odd
+//   lanes are shifted down and multiplied separately, then blended back.
+// - round_mode 2: gemmlowp's SaturatingRoundingDoublingHighMul nudges by
+//   +2^30 or 1-2^30 and divides by 2^31 rounding toward zero; both cases
+//   equal floor((a*b + 2^30) / 2^31), i.e. bits 31..62 of a*b + 2^30.
+// - round_mode 1 is only vectorized for shf >= 32, where the result is the
+//   high word of x*mul + round shifted right by shf - 32 and always fits
+//   int32. x == INT_MIN ends the vector loop, since (long long)x may differ.
+// - min(hi, v) and max(lo, v) return v when it is NaN, exactly like the
+//   two comparisons of caffe_cpu_universal_saturate.
+
+CAFFE_TARGET_AVX2 static inline __m256i avx2_load(const float* x) {
+  return _mm256_cvttps_epi32(_mm256_loadu_ps(x));
+}
+
+CAFFE_TARGET_AVX2 static inline __m256i avx2_load(const double* x) {
+  const __m128i lo = _mm256_cvttpd_epi32(_mm256_loadu_pd(x));
+  const __m128i hi = _mm256_cvttpd_epi32(_mm256_loadu_pd(x + 4));
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+CAFFE_TARGET_AVX2 static inline __m256i avx2_load(const int* x) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x));
+}
+
+CAFFE_TARGET_AVX2 static inline void avx2_store(float* x, const __m256i v) {
+  _mm256_storeu_ps(x, _mm256_cvtepi32_ps(v));
+}
+
+CAFFE_TARGET_AVX2 static inline void avx2_store(double* x, const __m256i v) {
+  _mm256_storeu_pd(x, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+  _mm256_storeu_pd(x + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+}
+
+CAFFE_TARGET_AVX2 static inline void avx2_store(int* x, const __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(x), v);
+}
+
+template <typename Dtype>
+CAFFE_TARGET_AVX2 static int avx2_multiply_single_round(const int n,
+    Dtype* x, const int mul, const int shf) {
+  const __m256i m = _mm256_set1_epi32(mul);
+  const __m256i round = _mm256_set1_epi64x(1ll << (shf - 1));
+  const __m256i int_min = _mm256_set1_epi32(INT_MIN);
+  const __m128i count = _mm_cvtsi32_si128(shf - 32);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i v = avx2_load(x + i);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, int_min))) {
+      break;
+    }
+    const __m256i even = _mm256_add_epi64(_mm256_mul_epi32(v, m), round);
+    const __m256i odd = _mm256_add_epi64(
+        _mm256_mul_epi32(_mm256_srli_epi64(v, 32), m), round);
+    const __m256i high =
+        _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    avx2_store(x + i, _mm256_sra_epi32(high, count));
+  }
+  return i;
+}
+
+template <typename Dtype>
+CAFFE_TARGET_AVX2 static int avx2_multiply_double_round(const int n,
+    Dtype* x, const int mul, const int left_shift, const int right_shift) {
+  const __m256i m = _mm256_set1_epi32(mul);
+  const __m256i nudge = _mm256_set1_epi64x(1ll << 30);
+  const __m256i mask = _mm256_set1_epi32((int)((1ll << right_shift) - 1));
+  const __m256i half = _mm256_srai_epi32(mask, 1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m128i left = _mm_cvtsi32_si128(left_shift);
+  const __m128i right = _mm_cvtsi32_si128(right_shift);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i a = _mm256_sll_epi32(avx2_load(x + i), left);
+    const __m256i even = _mm256_srli_epi64(
+        _mm256_add_epi64(_mm256_mul_epi32(a, m), nudge), 31);
+    const __m256i odd = _mm256_slli_epi64(_mm256_add_epi64(
+        _mm256_mul_epi32(_mm256_srli_epi64(a, 32), m), nudge), 1);
+    const __m256i high = _mm256_blend_epi32(even, odd, 0xAA);
+    // RoundingDivideByPOT; the compare masks are -1 where true.
+    const __m256i remainder = _mm256_and_si256(high, mask);
+    const __m256i threshold =
+        _mm256_sub_epi32(half, _mm256_cmpgt_epi32(zero, high));
+    avx2_store(x + i, _mm256_sub_epi32(_mm256_sra_epi32(high, right),
+        _mm256_cmpgt_epi32(remainder, threshold)));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX2 static int avx2_saturate(const int n, float* x,
+    const float max_value, const float min_value) {
+  const __m256 hi = _mm256_set1_ps(max_value);
+  const __m256 lo = _mm256_set1_ps(min_value);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_loadu_ps(x + i);
+    _mm256_storeu_ps(x + i, _mm256_max_ps(lo, _mm256_min_ps(hi, v)));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX2 static int avx2_saturate(const int n, double* x,
+    const double max_value, const double min_value) {
+  const __m256d hi = _mm256_set1_pd(max_value);
+  const __m256d lo = _mm256_set1_pd(min_value);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d v = _mm256_loadu_pd(x + i);
+    _mm256_storeu_pd(x + i, _mm256_max_pd(lo, _mm256_min_pd(hi, v)));
+  }
+  return i;
+}
+
+// The intersection is empty unless both of its sides are positive; the
+// masked lanes may divide by zero, which is harmless as they are cleared.
+CAFFE_TARGET_AVX2 static int avx2_jaccard_overlap(const int n,
+    const float* bbox, const float* xmin, const float* ymin,
+    const float* xmax, const float* ymax, const float* size,
+    float* overlap) {
+  const __m256 x1 = _mm256_set1_ps(bbox[0]);
+  const __m256 y1 = _mm256_set1_ps(bbox[1]);
+  const __m256 x2 = _mm256_set1_ps(bbox[2]);
+  const __m256 y2 = _mm256_set1_ps(bbox[3]);
+  const __m256 s = _mm256_set1_ps(bbox[4]);
+  const __m256 zero = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 w = _mm256_sub_ps(_mm256_min_ps(x2, _mm256_loadu_ps(xmax + i)),
+        _mm256_max_ps(x1, _mm256_loadu_ps(xmin + i)));
+    const __m256 h = _mm256_sub_ps(_mm256_min_ps(y2, _mm256_loadu_ps(ymax + i)),
+        _mm256_max_ps(y1, _mm256_loadu_ps(ymin + i)));
+    const __m256 inter = _mm256_mul_ps(w, h);
+    const __m256 iou = _mm256_div_ps(inter, _mm256_sub_ps(
+        _mm256_add_ps(s, _mm256_loadu_ps(size + i)), inter));
+    const __m256 mask = _mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ),
+        _mm256_cmp_ps(h, zero, _CMP_GT_OQ));
+    _mm256_storeu_ps(overlap + i, _mm256_and_ps(mask, iou));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX2 static inline __m256 avx2_load_ps(const uint8_t* x) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x))));
+}
+
+CAFFE_TARGET_AVX2 static inline __m256 avx2_load_ps(const float* x) {
+  return _mm256_loadu_ps(x);
+}
+
+// Subtracting before scaling, as the scalar code does, keeps the results
+// bit-exact with it.
+template <typename Stype, bool kMirror, bool kMeanArray>
+CAFFE_TARGET_AVX2 static int avx2_transform_row(const int n,
+    const Stype* src, const float* mean, const float mean_value,
+    const float scale, float* dst) {
+  const __m256 m = _mm256_set1_ps(mean_value);
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 v = _mm256_mul_ps(_mm256_sub_ps(avx2_load_ps(src + i),
+        kMeanArray ? _mm256_loadu_ps(mean + i) : m), s);
+    if (kMirror) {
+      _mm256_storeu_ps(dst + n - 8 - i, _mm256_permutevar8x32_ps(v, reverse));
+    } else {
+      _mm256_storeu_ps(dst + i, v);
+    }
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX2 static int avx2_transpose_rows8(const int cols,
+    const float* src, const int lds, float* dst, const int ldd) {
+  int c = 0;
+  for (; c + 8 <= cols; c += 8) {
+    __m256 r[8];
+    for (int i = 0; i < 8; ++i) {
+      r[i] = _mm256_loadu_ps(src + i * lds + c);
+    }
+    __m256 t[8];
+    for (int i = 0; i < 8; i += 2) {
+      t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+      t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+      r[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+      r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+      r[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+      r[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    // r[0..3] hold columns 0, 1, 2, 3 and 4, 5, 6, 7 of rows 0-3 in their
+    // low and high halves, r[4..7] the same of rows 4-7.
+    for (int i = 0; i < 4; ++i) {
+      _mm256_storeu_ps(dst + (c + i) * ldd,
+          _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+      _mm256_storeu_ps(dst + (c + i + 4) * ldd,
+          _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+    }
+  }
+  return c;
+}
+
+CAFFE_TARGET_AVX2 static inline float avx2_hsum(const __m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+      _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+// Four rows at a time, so that each load of a serves four products.
+CAFFE_TARGET_AVX2 static int avx2_dot_rows(const int n, const float* a,
+    const float* b, const int ldb, const int m, float* dots, const int ldd) {
+  const int len = n & ~7;
+  if (len == 0) {
+    return 0;
+  }
+  int d = 0;
+  for (; d + 4 <= m; d += 4) {
+    const float* b0 = b + d * ldb;
+    const float* b1 = b0 + ldb;
+    const float* b2 = b1 + ldb;
+    const float* b3 = b2 + ldb;
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps();
+    __m256 s3 = _mm256_setzero_ps();
+    for (int c = 0; c < len; c += 8) {
+      const __m256 va = _mm256_loadu_ps(a + c);
+      s0 = _mm256_add_ps(s0, _mm256_mul_ps(va, _mm256_loadu_ps(b0 + c)));
+      s1 = _mm256_add_ps(s1, _mm256_mul_ps(va, _mm256_loadu_ps(b1 + c)));
+      s2 = _mm256_add_ps(s2, _mm256_mul_ps(va, _mm256_loadu_ps(b2 + c)));
+      s3 = _mm256_add_ps(s3, _mm256_mul_ps(va, _mm256_loadu_ps(b3 + c)));
+    }
+    dots[d * ldd] += avx2_hsum(s0);
+    dots[(d + 1) * ldd] += avx2_hsum(s1);
+    dots[(d + 2) * ldd] += avx2_hsum(s2);
+    dots[(d + 3) * ldd] += avx2_hsum(s3);
+  }
+  for (; d < m; ++d) {
+    const float* bd = b + d * ldb;
+    __m256 s0 = _mm256_setzero_ps();
+    for (int c = 0; c < len; c += 8) {
+      s0 = _mm256_add_ps(s0,
+          _mm256_mul_ps(_mm256_loadu_ps(a + c), _mm256_loadu_ps(bd + c)));
+    }
+    dots[d * ldd] += avx2_hsum(s0);
+  }
+  return len;
+}
+
+// One tap at a time over eight outputs, in the order of the scalar loop.
+CAFFE_TARGET_AVX2 static int avx2_gather_taps(const int n, const float* src,
+    const int* index, const float* weight, const int taps, const int ld,
+    float* dst) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int k = 0; k < taps; ++k) {
+      const __m256i vi = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(index + k * ld + i));
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(
+          _mm256_loadu_ps(weight + k * ld + i),
+          _mm256_i32gather_ps(src, vi, 4)));
+    }
+    _mm256_storeu_ps(dst + i, sum);
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX512 static inline __m512i avx512_load(const float* x) {
+  return _mm512_cvttps_epi32(_mm512_loadu_ps(x));
+}
+
+CAFFE_TARGET_AVX512 static inline __m512i avx512_load(const double* x) {
+  const __m256i lo = _mm512_cvttpd_epi32(_mm512_loadu_pd(x));
+  const __m256i hi = _mm512_cvttpd_epi32(_mm512_loadu_pd(x + 8));
+  return _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1);
+}
+
+CAFFE_TARGET_AVX512 static inline __m512i avx512_load(const int* x) {
+  return _mm512_loadu_si512(x);
+}
+
+CAFFE_TARGET_AVX512 static inline void avx512_store(float* x,
+    const __m512i v) {
+  _mm512_storeu_ps(x, _mm512_cvtepi32_ps(v));
+}
+
+CAFFE_TARGET_AVX512 static inline void avx512_store(double* x,
+    const __m512i v) {
+  _mm512_storeu_pd(x, _mm512_cvtepi32_pd(_mm512_castsi512_si256(v)));
+  _mm512_storeu_pd(x + 8, _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1)));
+}
+
+CAFFE_TARGET_AVX512 static inline void avx512_store(int* x, const __m512i v) {
+  _mm512_storeu_si512(x, v);
+}
+
+template <typename Dtype>
+CAFFE_TARGET_AVX512 static int avx512_multiply_single_round(const int n,
+    Dtype* x, const int mul, const int shf) {
+  const __m512i m = _mm512_set1_epi32(mul);
+  const __m512i round = _mm512_set1_epi64(1ll << (shf - 1));
+  const __m512i int_min = _mm512_set1_epi32(INT_MIN);
+  const __m128i count = _mm_cvtsi32_si128(shf - 32);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512i v = avx512_load(x + i);
+    if (_mm512_cmpeq_epi32_mask(v, int_min)) {
+      break;
+    }
+    const __m512i even = _mm512_add_epi64(_mm512_mul_epi32(v, m), round);
+    const __m512i odd = _mm512_add_epi64(
+        _mm512_mul_epi32(_mm512_srli_epi64(v, 32), m), round);
+    const __m512i high =
+        _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    avx512_store(x + i, _mm512_sra_epi32(high, count));
+  }
+  return i;
+}
+
+template <typename Dtype>
+CAFFE_TARGET_AVX512 static int avx512_multiply_double_round(const int n,
+    Dtype* x, const int mul, const int left_shift, const int right_shift) {
+  const __m512i m = _mm512_set1_epi32(mul);
+  const __m512i nudge = _mm512_set1_epi64(1ll << 30);
+  const __m512i mask = _mm512_set1_epi32((int)((1ll << right_shift) - 1));
+  const __m512i half = _mm512_srai_epi32(mask, 1);
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i zero = _mm512_setzero_si512();
+  const __m128i left = _mm_cvtsi32_si128(left_shift);
+  const __m128i right = _mm_cvtsi32_si128(right_shift);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512i a = _mm512_sll_epi32(avx512_load(x + i), left);
+    const __m512i even = _mm512_srli_epi64(
+        _mm512_add_epi64(_mm512_mul_epi32(a, m), nudge), 31);
+    const __m512i odd = _mm512_slli_epi64(_mm512_add_epi64(
+        _mm512_mul_epi32(_mm512_srli_epi64(a, 32), m), nudge), 1);
+    const __m512i high = _mm512_mask_blend_epi32(0xAAAA, even, odd);
+    // RoundingDivideByPOT
+    const __m512i remainder = _mm512_and_si512(high, mask);
+    const __m512i threshold = _mm512_mask_add_epi32(half,
+        _mm512_cmpgt_epi32_mask(zero, high), half, one);
+    const __m512i y = _mm512_sra_epi32(high, right);
+    avx512_store(x + i, _mm512_mask_add_epi32(y,
+        _mm512_cmpgt_epi32_mask(remainder, threshold), y, one));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX512 static int avx512_saturate(const int n, float* x,
+    const float max_value, const float min_value) {
+  const __m512 hi = _mm512_set1_ps(max_value);
+  const __m512 lo = _mm512_set1_ps(min_value);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 v = _mm512_loadu_ps(x + i);
+    _mm512_storeu_ps(x + i, _mm512_max_ps(lo, _mm512_min_ps(hi, v)));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX512 static int avx512_saturate(const int n, double* x,
+    const double max_value, const double min_value) {
+  const __m512d hi = _mm512_set1_pd(max_value);
+  const __m512d lo = _mm512_set1_pd(min_value);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m512d v = _mm512_loadu_pd(x + i);
+    _mm512_storeu_pd(x + i, _mm512_max_pd(lo, _mm512_min_pd(hi, v)));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX512 static int avx512_jaccard_overlap(const int n,
+    const float* bbox, const float* xmin, const float* ymin,
+    const float* xmax, const float* ymax, const float* size,
+    float* overlap) {
+  const __m512 x1 = _mm512_set1_ps(bbox[0]);
+  const __m512 y1 = _mm512_set1_ps(bbox[1]);
+  const __m512 x2 = _mm512_set1_ps(bbox[2]);
+  const __m512 y2 = _mm512_set1_ps(bbox[3]);
+  const __m512 s = _mm512_set1_ps(bbox[4]);
+  const __m512 zero = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 w = _mm512_sub_ps(_mm512_min_ps(x2, _mm512_loadu_ps(xmax + i)),
+        _mm512_max_ps(x1, _mm512_loadu_ps(xmin + i)));
+    const __m512 h = _mm512_sub_ps(_mm512_min_ps(y2, _mm512_loadu_ps(ymax + i)),
+        _mm512_max_ps(y1, _mm512_loadu_ps(ymin + i)));
+    const __m512 inter = _mm512_mul_ps(w, h);
+    const __m512 iou = _mm512_div_ps(inter, _mm512_sub_ps(
+        _mm512_add_ps(s, _mm512_loadu_ps(size + i)), inter));
+    const __mmask16 mask = _mm512_cmp_ps_mask(w, zero, _CMP_GT_OQ) &
+        _mm512_cmp_ps_mask(h, zero, _CMP_GT_OQ);
+    _mm512_storeu_ps(overlap + i, _mm512_maskz_mov_ps(mask, iou));
+  }
+  return i;
+}
+
+CAFFE_TARGET_AVX512 static inline __m512 avx512_load_ps(const uint8_t* x) {
+  return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(x))));
+}
+
+CAFFE_TARGET_AVX512 static inline __m512 avx512_load_ps(const float* x) {
+  return _mm512_loadu_ps(x);
+}
+
+template <typename Stype, bool kMirror, bool kMeanArray>
+CAFFE_TARGET_AVX512 static int avx512_transform_row(const int n,
+    const Stype* src, const float* mean, const float mean_value,
+    const float scale, float* dst) {
+  const __m512 m = _mm512_set1_ps(mean_value);
+  const __m512 s = _mm512_set1_ps(scale);
+  const __m512i reverse = _mm512_set_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+      11, 12, 13, 14, 15);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const __m512 v = _mm512_mul_ps(_mm512_sub_ps(avx512_load_ps(src + i),
+        kMeanArray ? _mm512_loadu_ps(mean + i) : m), s);
+    if (kMirror) {
+      _mm512_storeu_ps(dst + n - 16 - i, _mm512_permutexvar_ps(reverse, v));
+    } else {
+      _mm512_storeu_ps(dst + i, v);
+    }
+  }
+  return i;
+}
+
+#endif  // CAFFE_SIMD_X86
+
+template <typename Dtype>
+int caffe_simd_multiply_single_round(const int n, Dtype* x, const int mul,
+    const int shf) {
+  if (shf < 32 || shf > 62) {
+    return 0;
+  }
+#ifdef CAFFE_SIMD_X86
+  switch (caffe_simd_level()) {
+  case SIMD_AVX512:
+    return avx512_multiply_single_round(n, x, mul, shf);
+  case SIMD_AVX2:
+    return avx2_multiply_single_round(n, x, mul, shf);
+  default:
+    break;
+  }
+#endif
+  return 0;
+}
+
+template int caffe_simd_multiply_single_round<float>(const int n, float* x,
+    const int mul, const int shf);
+template int caffe_simd_multiply_single_round<double>(const int n, double* x,
+    const int mul, const int shf);
+template int caffe_simd_multiply_single_round<int>(const int n, int* x,
+    const int mul, const int shf);
+
+template <typename Dtype>
+int caffe_simd_multiply_double_round(const int n, Dtype* x, const int mul,
+    const int left_shift, const int right_shift) {
+  // Out-of-range shifts and the INT_MIN * INT_MIN overflow are left to the
+  // checks of the scalar code.
+  if (left_shift < 0 || left_shift > 31 || right_shift < 0 ||
+      right_shift > 31 || mul == INT_MIN) {
+    return 0;
+  }
+#ifdef CAFFE_SIMD_X86
+  switch (caffe_simd_level()) {
+  case SIMD_AVX512:
+    return avx512_multiply_double_round(n, x, mul, left_shift, right_shift);
+  case SIMD_AVX2:
+    return avx2_multiply_double_round(n, x, mul, left_shift, right_shift);
+  default:
+    break;
+  }
+#endif
+  return 0;
+}
+
+template int caffe_simd_multiply_double_round<float>(const int n, float* x,
+    const int mul, const int left_shift, const int right_shift);
+template int caffe_simd_multiply_double_round<double>(const int n, double* x,
+    const int mul, const int left_shift, const int right_shift);
+template int caffe_simd_multiply_double_round<int>(const int n, int* x,
+    const int mul, const int left_shift, const int right_shift);
+
+template <typename Dtype>
+int caffe_simd_saturate(const int n, Dtype* x, const Dtype max_value,
+    const Dtype min_value) {
+#ifdef CAFFE_SIMD_X86
+  switch (caffe_simd_level()) {
+  case SIMD_AVX512:
+    return avx512_saturate(n, x, max_value, min_value);
+  case SIMD_AVX2:
+    return avx2_saturate(n, x, max_value, min_value);
+  default:
+    break;
+  }
+#endif
+  return 0;
+}
+
+template int caffe_simd_saturate<float>(const int n, float* x,
+    const float max_value, const float min_value);
+template int caffe_simd_saturate<double>(const int n, double* x,
+    const double max_value, const double min_value);
+
+int caffe_simd_jaccard_overlap(const int n, const float* bbox,
+    const float* xmin, const float* ymin, const float* xmax,
+    const float* ymax, const float* size, float* overlap) {
+#ifdef CAFFE_SIMD_X86
+  switch (caffe_simd_level()) {
+  case SIMD_AVX512:
+    return avx512_jaccard_overlap(n, bbox, xmin, ymin, xmax, ymax, size,
+        overlap);
+  case SIMD_AVX2:
+    return avx2_jaccard_overlap(n, bbox, xmin, ymin, xmax, ymax, size,
+        overlap);
+  default:
+    break;
+  }
+#endif
+  return 0;
+}
+
+// Picks the kernel for the mirror and mean of the row, once per row.
+template <typename Stype>
+static int caffe_simd_transform_row_impl(const int n, const Stype* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst) {
+#ifdef CAFFE_SIMD_X86
+  switch (caffe_simd_level()) {
+  case SIMD_AVX512:
+    if (mirror) {
+      return mean ?
+          avx512_transform_row<Stype, true, true>(n, src, mean, 0, scale, dst) :
+          avx512_transform_row<Stype, true, false>(n, src, NULL, mean_value,
+              scale, dst);
+    }
+    return mean ?
+        avx512_transform_row<Stype, false, true>(n, src, mean, 0, scale, dst) :
+        avx512_transform_row<Stype, false, false>(n, src, NULL, mean_value,
+            scale, dst);
+  case SIMD_AVX2:
+    if (mirror) {
+      return mean ?
+          avx2_transform_row<Stype, true, true>(n, src, mean, 0, scale, dst) :
+          avx2_transform_row<Stype, true, false>(n, src, NULL, mean_value,
+              scale, dst);
+    }
+    return mean ?
+        avx2_transform_row<Stype, false, true>(n, src, mean, 0, scale, dst) :
+        avx2_transform_row<Stype, false, false>(n, src, NULL, mean_value,
+            scale, dst);
+  default:
+    break;
+  }
+#endif
+  return 0;
+}
+
+int caffe_simd_transform_row(const int n, const uint8_t* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst) {
+  return caffe_simd_transform_row_impl(n, src, mean, mean_value, scale,
+      mirror, dst);
+}
+
+int caffe_simd_transform_row(const int n, const float* src,
+    const float* mean, const float mean_value, const float scale,
+    const bool mirror, float* dst) {
+  return caffe_simd_transform_row_impl(n, src, mean, mean_value, scale,
+      mirror, dst);
+}
+
+// AVX-512 machines run the AVX2 kernel: an 8x8 block of floats is a cache
+// line per row either way, and wider blocks only add shuffles.
+int caffe_simd_transpose_rows8(const int cols, const float* src,
+    const int lds, float* dst, const int ldd) {
+#ifdef CAFFE_SIMD_X86
+  if (caffe_simd_level() >= SIMD_AVX2) {
+    return avx2_transpose_rows8(cols, src, lds, dst, ldd);
+  }
+#endif
+  return 0;
+}
+
+// As for the transposes, AVX-512 machines run the AVX2 kernel: the rows of
+// image 1 come from L1 either way, and the loads of a are shared already.
+int caffe_simd_dot_rows(const int n, const float* a, const float* b,
+    const int ldb, const int m, float* dots, const int ldd) {
+#ifdef CAFFE_SIMD_X86
+  if (caffe_simd_level() >= SIMD_AVX2) {
+    return avx2_dot_rows(n, a, b, ldb, m, dots, ldd);
+  }
+#endif
+  return 0;
+}
+
+// AVX-512 machines run the AVX2 kernel too: the gathers are bound by the
+// loads of the pixels, which wider vectors do not make any faster.
+int caffe_simd_gather_taps(const int n, const float* src, const int* index,
+    const float* weight, const int taps, const int ld, float* dst) {
+#ifdef CAFFE_SIMD_X86
+  if (caffe_simd_level() >= SIMD_AVX2) {
+    return avx2_gather_taps(n, src, index, weight, taps, ld, dst);
+  }
+#endif
+  return 0;
+}
+
+}  // namespace caffe
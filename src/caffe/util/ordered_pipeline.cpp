@@ -0,0 +1,87 @@
+#include <boost/thread.hpp>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct PipelineState {
+  boost::mutex mutex;
+  boost::condition_variable produced;
+  boost::condition_variable consumed;
+  // The next item to produce, and the number of items consumed.
+  int next;
+  int done;
+  // Whether the item of each slot has been produced.
+  std::vector<char> ready;
+};
+
+void ProduceEntry(const int n, const int window,
+    const boost::function<void(int, int)>& produce, PipelineState* state) {
+  while (true) {
+    int i;
+    {
+      boost::mutex::scoped_lock lock(state->mutex);
+      while (state->next < n && state->next >= state->done + window) {
+        state->consumed.wait(lock);
+      }
+      if (state->next >= n) {
+        return;
+      }
+      i = state->next++;
+    }
+    produce(i, i % window);
+    {
+      boost::mutex::scoped_lock lock(state->mutex);
+      state->ready[i % window] = 1;
+    }
+    state->produced.notify_all();
+  }
+}
+
+}  // namespace
+
+void RunOrderedPipeline(const int n, const int num_workers, const int window,
+    const boost::function<void(int, int)>& produce,
+    const boost::function<void(int, int)>& consume) {
+  CHECK_GT(window, 0) << "The pipeline needs a window of at least 1 item";
+  if (num_workers <= 0) {
+    for (int i = 0; i < n; ++i) {
+      produce(i, i % window);
+      consume(i, i % window);
+    }
+    return;
+  }
+  PipelineState state;
+  state.next = 0;
+  state.done = 0;
+  state.ready.assign(window, 0);
+  boost::thread_group workers;
+  for (int w = 0; w < num_workers; ++w) {
+    workers.create_thread(boost::bind(&ProduceEntry, n, window,
+        boost::cref(produce), &state));
+  }
+  for (int i = 0; i < n; ++i) {
+    const int slot = i % window;
+    {
+      boost::mutex::scoped_lock lock(state.mutex);
+      while (!state.ready[slot]) {
+        state.produced.wait(lock);
+      }
+    }
+    consume(i, slot);
+    {
+      boost::mutex::scoped_lock lock(state.mutex);
+      state.ready[slot] = 0;
+      ++state.done;
+    }
+    state.consumed.notify_all();
+  }
+  workers.join_all();
+}
+
+}  // namespace caffe
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/math_functions_simd.hpp"
+#include "caffe/util/permute.hpp"
+
+namespace caffe {
+
+// Side of the square tiles the transposes copy, in blocks. A tile of floats
+// and its transpose take 8 KB, well within L1.
+static const int kTile = 32;
+
+vector<int> caffe_inverse_permute_order(const vector<int>& order) {
+  vector<int> inverse(order.size());
+  for (int i = 0; i < order.size(); ++i) {
+    inverse[order[i]] = i;
+  }
+  return inverse;
+}
+
+// Drops the axes of size 1 and merges each run of src axes that dst keeps
+// in the same order into one axis.
+static void SimplifyPermute(const vector<int>& shape, const vector<int>& order,
+    vector<int>* new_shape, vector<int>* new_order) {
+  const int num_axes = shape.size();
+  vector<int> kept(num_axes, -1);
+  vector<int> kept_shape;
+  for (int i = 0; i < num_axes; ++i) {
+    if (shape[i] != 1) {
+      kept[i] = kept_shape.size();
+      kept_shape.push_back(shape[i]);
+    }
+  }
+  // The first src axis and the size of each run, in dst order.
+  vector<int> first;
+  vector<int> size;
+  int last = -2;
+  for (int i = 0; i < num_axes; ++i) {
+    const int axis = kept[order[i]];
+    if (axis < 0) {
+      continue;
+    }
+    if (axis == last + 1) {
+      size.back() *= kept_shape[axis];
+    } else {
+      first.push_back(axis);
+      size.push_back(kept_shape[axis]);
+    }
+    last = axis;
+  }
+  vector<int> sorted(first);
+  std::sort(sorted.begin(), sorted.end());
+  new_shape->resize(first.size());
+  new_order->resize(first.size());
+  for (int i = 0; i < first.size(); ++i) {
+    const int axis =
+        std::lower_bound(sorted.begin(), sorted.end(), first[i]) - sorted.begin();
+    (*new_order)[i] = axis;
+    (*new_shape)[axis] = size[i];
+  }
+}
+
+static int SimdTransposeRows8(const int cols, const float* src, const int lds,
+    float* dst, const int ldd) {
+  return caffe_simd_transpose_rows8(cols, src, lds, dst, ldd);
+}
+
+template <typename Dtype>
+static int SimdTransposeRows8(const int cols, const Dtype* src, const int lds,
+    Dtype* dst, const int ldd) {
+  return 0;
+}
+
+// Transposes the rows x cols matrix src into dst.
+template <typename Dtype>
+static void Transpose(const int rows, const int cols, const Dtype* src,
+    Dtype* dst) {
+  for (int r0 = 0; r0 < rows; r0 += kTile) {
+    const int r1 = std::min(r0 + kTile, rows);
+    for (int c0 = 0; c0 < cols; c0 += kTile) {
+      const int tile_cols = std::min(c0 + kTile, cols) - c0;
+      int r = r0;
+      for (; r + 8 <= r1; r += 8) {
+        const Dtype* s = src + r * cols + c0;
+        Dtype* d = dst + c0 * rows + r;
+        int c = SimdTransposeRows8(tile_cols, s, cols, d, rows);
+        for (; c < tile_cols; ++c) {
+          for (int i = 0; i < 8; ++i) {
+            d[c * rows + i] = s[i * cols + c];
+          }
+        }
+      }
+      for (; r < r1; ++r) {
+        for (int c = c0; c < c0 + tile_cols; ++c) {
+          dst[c * rows + r] = src[r * cols + c];
+        }
+      }
+    }
+  }
+}
+
+// Transposes the rows x cols matrix of blocks of inner elements src into dst.
+template <typename Dtype>
+static void TransposeBlocks(const int rows, const int cols, const int inner,
+    const Dtype* src, Dtype* dst) {
+  for (int r0 = 0; r0 < rows; r0 += kTile) {
+    const int r1 = std::min(r0 + kTile, rows);
+    for (int c0 = 0; c0 < cols; c0 += kTile) {
+      const int c1 = std::min(c0 + kTile, cols);
+      for (int r = r0; r < r1; ++r) {
+        for (int c = c0; c < c1; ++c) {
+          const Dtype* s = src + (r * cols + c) * inner;
+          std::copy(s, s + inner, dst + (c * rows + r) * inner);
+        }
+      }
+    }
+  }
+}
+
+// Walks dst in order, stepping the offset of each element in src instead of
+// decoding it from the index in dst.
+template <typename Dtype>
+static void PermuteGeneric(const vector<int>& shape, const vector<int>& order,
+    const int count, const Dtype* src, Dtype* dst) {
+  const int num_axes = shape.size();
+  vector<int> src_steps(num_axes, 1);
+  for (int i = num_axes - 2; i >= 0; --i) {
+    src_steps[i] = src_steps[i + 1] * shape[i + 1];
+  }
+  // The size of each dst axis and its step in src.
+  vector<int> dims(num_axes);
+  vector<int> steps(num_axes);
+  for (int i = 0; i < num_axes; ++i) {
+    dims[i] = shape[order[i]];
+    steps[i] = src_steps[order[i]];
+  }
+  const int inner = dims[num_axes - 1];
+  const int inner_step = steps[num_axes - 1];
+  vector<int> index(num_axes - 1, 0);
+  int offset = 0;
+  for (int i = 0; i < count; i += inner) {
+    const Dtype* s = src + offset;
+    for (int j = 0; j < inner; ++j) {
+      dst[i + j] = s[j * inner_step];
+    }
+    for (int a = num_axes - 2; a >= 0; --a) {
+      offset += steps[a];
+      if (++index[a] < dims[a]) {
+        break;
+      }
+      offset -= steps[a] * dims[a];
+      index[a] = 0;
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_permute(const vector<int>& shape, const vector<int>& order,
+    const Dtype* src, Dtype* dst) {
+  CHECK_EQ(shape.size(), order.size());
+  int count = 1;
+  for (int i = 0; i < shape.size(); ++i) {
+    count *= shape[i];
+  }
+  vector<int> dims;
+  vector<int> dims_order;
+  SimplifyPermute(shape, order, &dims, &dims_order);
+  const int num_axes = dims.size();
+  if (num_axes <= 1) {
+    std::copy(src, src + count, dst);
+    return;
+  }
+  // A transpose swaps two axes, possibly between a batch axis in front and
+  // a block axis behind; no other axes are left once they are merged.
+  const int batch_axes = dims_order[0] == 0 ? 1 : 0;
+  const int block_axes = num_axes - batch_axes - 2;
+  const bool transpose = block_axes >= 0 && block_axes <= 1 &&
+      dims_order[batch_axes] == batch_axes + 1 &&
+      dims_order[batch_axes + 1] == batch_axes &&
+      (block_axes == 0 || dims_order[num_axes - 1] == num_axes - 1);
+  if (!transpose) {
+    PermuteGeneric(dims, dims_order, count, src, dst);
+    return;
+  }
+  const int batch = batch_axes ? dims[0] : 1;
+  const int rows = dims[batch_axes];
+  const int cols = dims[batch_axes + 1];
+  const int inner = block_axes ? dims[num_axes - 1] : 1;
+  const int matrix = rows * cols * inner;
+  for (int b = 0; b < batch; ++b) {
+    if (inner == 1) {
+      Transpose(rows, cols, src + b * matrix, dst + b * matrix);
+    } else {
+      TransposeBlocks(rows, cols, inner, src + b * matrix, dst + b * matrix);
+    }
+  }
+}
+
+template void caffe_cpu_permute<int>(const vector<int>& shape,
+    const vector<int>& order, const int* src, int* dst);
+template void caffe_cpu_permute<float>(const vector<int>& shape,
+    const vector<int>& order, const float* src, float* dst);
+template void caffe_cpu_permute<double>(const vector<int>& shape,
+    const vector<int>& order, const double* src, double* dst);
+
+}  // namespace caffe
@@ -1,5 +1,11 @@
+#include <algorithm>
+
+#include "caffe/util/densecrf_util.hpp"
 #include "caffe/util/permutohedral.hpp"
 
+// The fewest lattice points or features a thread filters at a time.
+static const int kMinChunk = 1024;
+
 /************************************************/
 /***                Hash Table                ***/
 /************************************************/
@@ -33,7 +39,7 @@ protected:
     delete [] old_keys;
     delete [] old_table;
   }
-  size_t hash( const short * k ) {
+  size_t hash( const short * k ) const {
     size_t r = 0;
     for( size_t i=0; i<key_size_; i++ ){
       r += k[i];
@@ -58,8 +64,23 @@ protected:
     filled_ = 0;
     memset( table_, -1, capacity_*sizeof(int) );
   }
+  // Empties the table for keys of key_size, keeping its memory if it can
+  // hold n_elements.
+  void reset( int key_size, int n_elements ) {
+    if ( key_size_ != (size_t)key_size || capacity_ < 2*(size_t)n_elements ){
+      delete [] keys_;
+      delete [] table_;
+      key_size_ = key_size;
+      capacity_ = 2*n_elements;
+      table_ = new int[ capacity_ ];
+      keys_ = new short[ (capacity_/2+10)*key_size_ ];
+    }
+    reset();
+  }
+  // Lookups without create leave the table as it is, so that several
+  // threads can run them at once.
   int find( const short * k, bool create = false ){
-    if (2*filled_ >= capacity_) grow();
+    if (create && 2*filled_ >= capacity_) grow();
     // Get the hash value
     size_t h = hash( k ) % capacity_;
     // Find the element with he right key, using linear probing
@@ -97,21 +118,24 @@ protected:
 /***          Permutohedral Lattice           ***/
 /************************************************/
 Permutohedral::Permutohedral() 
-  : offset_( NULL ),barycentric_( NULL ),blur_neighbors_( NULL ),N_ ( 0 ),M_ ( 0 ),d_ ( 0 ) {
+  : hash_table_( new HashTable( 1, 1 ) ),N_ ( 0 ),M_ ( 0 ),d_ ( 0 ),num_threads_( 1 ),
+    values_( NULL ),new_values_( NULL ),packed_( NULL ),values_size_( 0 ),packed_size_( 0 ) {
 }
 
 Permutohedral::~Permutohedral() {
-  if (barycentric_)    delete[] barycentric_;
-  if (offset_)         delete[] offset_;
-  if (blur_neighbors_) delete[] blur_neighbors_;
+  delete hash_table_;
+  deallocate( values_ );
+  deallocate( new_values_ );
+  deallocate( packed_ );
 }
 
 void Permutohedral::init(const float* feature, int feature_size, int N) {
+    HashTable & hash_table = *hash_table_;
 #ifdef SSE_PERMUTOHEDRAL
     // Compute the lattice coordinates for each feature [there is going to be a lot of magic here
     N_ = N;
     d_ = feature_size;
-    HashTable hash_table( d_, N_/**(d_+1)*/ );
+    hash_table.reset( d_, N_/**(d_+1)*/ );
 		
     const int blocksize = sizeof(__m128) / sizeof(float);
     const __m128 invdplus1   = _mm_set1_ps( 1.0f / (d_+1) );
@@ -120,13 +144,8 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     const __m128 One         = _mm_set1_ps( 1 );
 
     // Allocate the class memory
-    if (offset_) delete [] offset_;
-    offset_ = new int[ (d_+1)*(N_+16) ];
-    memset( offset_, 0, (d_+1)*(N_+16)*sizeof(int) );
-		
-    if (barycentric_) delete [] barycentric_;
-    barycentric_ = new float[ (d_+1)*(N_+16) ];
-    memset( barycentric_, 0, (d_+1)*(N_+16)*sizeof(float) );
+    offset_.assign( (d_+1)*(N_+16), 0 );
+    barycentric_.assign( (d_+1)*(N_+16), 0 );
 		
     // Allocate the local memory
     __m128 * scale_factor = (__m128*) _mm_malloc( (d_  )*sizeof(__m128) , 16 );
@@ -258,48 +277,15 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
 #ifndef __SSE4_1__
     _mm_setcsr( old_rounding );
 #endif
-		
-    // This is normally fast enough so no SSE needed here
-    // Find the Neighbors of each lattice point
-		
-    // Get the number of vertices in the lattice
-    M_ = hash_table.size();
-		
-    // Create the neighborhood structure
-    if(blur_neighbors_) delete[] blur_neighbors_;
-    blur_neighbors_ = new Neighbors[ (d_+1)*M_ ];
-		
-    short * n1 = new short[d_+1];
-    short * n2 = new short[d_+1];
-		
-    // For each of d+1 axes,
-    for( int j = 0; j <= d_; j++ ){
-      for( int i=0; i<M_; i++ ){
-	const short * key = hash_table.getKey( i );
-	for( int k=0; k<d_; k++ ){
-	  n1[k] = key[k] - 1;
-	  n2[k] = key[k] + 1;
-	}
-	n1[j] = key[j] + d_;
-	n2[j] = key[j] - d_;
-				
-	blur_neighbors_[j*M_+i].n1 = hash_table.find( n1 );
-	blur_neighbors_[j*M_+i].n2 = hash_table.find( n2 );
-      }
-    }
-    delete[] n1;
-    delete[] n2;
 #else
     // Compute the lattice coordinates for each feature [there is going to be a lot of magic here
     N_ = N;
     d_ = feature_size;
-    HashTable hash_table( d_, N_*(d_+1) );
+    hash_table.reset( d_, N_*(d_+1) );
 
     // Allocate the class memory
-    if (offset_) delete [] offset_;
-    offset_ = new int[ (d_+1)*N_ ];
-    if (barycentric_) delete [] barycentric_;
-    barycentric_ = new float[ (d_+1)*N_ ];
+    offset_.resize( (d_+1)*N_ );
+    barycentric_.resize( (d_+1)*N_ );
 		
     // Allocate the local memory
     float * scale_factor = new float[d_];
@@ -399,101 +385,140 @@ void Permutohedral::init(const float* feature, int feature_size, int N) {
     delete [] rank;
     delete [] canonical;
     delete [] key;
-		
-		
+#endif
+
     // Find the Neighbors of each lattice point
 		
     // Get the number of vertices in the lattice
     M_ = hash_table.size();
 		
     // Create the neighborhood structure
-    if(blur_neighbors_) delete[] blur_neighbors_;
-    blur_neighbors_ = new Neighbors[ (d_+1)*M_ ];
-		
-    short * n1 = new short[d_+1];
-    short * n2 = new short[d_+1];
+    blur_neighbors_.resize( (d_+1)*M_ );
 		
     // For each of d+1 axes,
-    for( int j = 0; j <= d_; j++ ){
-      for( int i=0; i<M_; i++ ){
-	const short * key = hash_table.getKey( i );
-	for( int k=0; k<d_; k++ ){
-	  n1[k] = key[k] - 1;
-	  n2[k] = key[k] + 1;
-	}
-	n1[j] = key[j] + d_;
-	n2[j] = key[j] - d_;
+    parallel_for( M_, num_threads_, kMinChunk, [&]( int begin, int end ){
+      std::vector<short> n1( d_+1 );
+      std::vector<short> n2( d_+1 );
+      for( int j = 0; j <= d_; j++ ){
+	for( int i=begin; i<end; i++ ){
+	  const short * key = hash_table.getKey( i );
+	  for( int k=0; k<d_; k++ ){
+	    n1[k] = key[k] - 1;
+	    n2[k] = key[k] + 1;
+	  }
+	  n1[j] = key[j] + d_;
+	  n2[j] = key[j] - d_;
 				
-	blur_neighbors_[j*M_+i].n1 = hash_table.find( n1 );
-	blur_neighbors_[j*M_+i].n2 = hash_table.find( n2 );
+	  blur_neighbors_[j*M_+i].n1 = hash_table.find( &n1[0] );
+	  blur_neighbors_[j*M_+i].n2 = hash_table.find( &n2[0] );
+	}
       }
-    }
-    delete[] n1;
-    delete[] n2;
-#endif
+    });
+
+    // Sort the entries of the features by lattice point, keeping their order
+    const int num_entries = N_*(d_+1);
+    splat_begin_.assign( M_+2, 0 );
+    for( int e=0; e<num_entries; e++ )
+      splat_begin_[ offset_[e]+2 ]++;
+    for( int i=2; i<M_+2; i++ )
+      splat_begin_[i] += splat_begin_[i-1];
+    splat_index_.resize( num_entries );
+    for( int e=0; e<num_entries; e++ )
+      splat_index_[ splat_begin_[ offset_[e]+1 ]++ ] = e;
+    splat_begin_.resize( M_+1 );
 }
 
+template <typename V> inline V broadcast( float x );
+template <> inline float broadcast<float>( float x ) {
+  return x;
+}
 #ifdef SSE_PERMUTOHEDRAL
-void Permutohedral::compute( __m128* out, const __m128* in, int value_size, int in_offset, int out_offset, int in_size, int out_size) const {
+template <> inline __m128 broadcast<__m128>( float x ) {
+  return _mm_set1_ps( x );
+}
+#endif
+
+// Filters values of value_size Vs per feature; V is a float or an __m128.
+template <typename V>
+void Permutohedral::filter( V* out, const V* in, int value_size, int in_offset, int out_offset, int in_size, int out_size) const {
     if ( in_size == -1)  in_size = N_ -  in_offset;
     if (out_size == -1) out_size = N_ - out_offset;
-		
+    const int d1 = d_+1;
+
     // Shift all values by 1 such that -1 -> 0 (used for blurring)
-    __m128 * values     = (__m128*) _mm_malloc( (M_+2)*value_size*sizeof(__m128), 16 );
-    __m128 * new_values = (__m128*) _mm_malloc( (M_+2)*value_size*sizeof(__m128), 16 );
-		
-    __m128 Zero = _mm_set1_ps( 0 );
+    const size_t values_size = (M_+2)*value_size*(sizeof(V)/sizeof(float));
+    if (values_size > values_size_){
+      deallocate( values_ );
+      deallocate( new_values_ );
+      values_ = allocate( values_size );
+      new_values_ = allocate( values_size );
+      values_size_ = values_size;
+    }
+    V * values     = (V*) values_;
+    V * new_values = (V*) new_values_;
 		
-    for( int i=0; i<(M_+2)*value_size; i++ )
-      values[i] = new_values[i] = Zero;
+    const V Zero = broadcast<V>( 0 );
+    for( int k=0; k<value_size; k++ )
+      values[k] = new_values[k] = Zero;
 		
-    // Splatting
-    for( int i=0;  i<in_size; i++ ){
-      const __m128 * sse_val = in + i*value_size;
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(in_offset+i)*(d_+1)+j]+1;
-	__m128 w = _mm_set1_ps( barycentric_[(in_offset+i)*(d_+1)+j] );
+    // Splatting, gathering the features of each lattice point in turn
+    parallel_for( M_, num_threads_, kMinChunk, [&]( int begin, int end ){
+      for( int i=begin; i<end; i++ ){
+	V * val = values + (i+1)*value_size;
 	for( int k=0; k<value_size; k++ )
-	  values[ o*value_size+k ] += w * sse_val[k];
+	  val[k] = Zero;
+	for( int e=splat_begin_[i]; e<splat_begin_[i+1]; e++ ){
+	  const int index = splat_index_[e];
+	  const int p = index/d1 - in_offset;
+	  if (p < 0 || p >= in_size) continue;
+	  const V w = broadcast<V>( barycentric_[index] );
+	  const V * in_val = in + p*value_size;
+	  for( int k=0; k<value_size; k++ )
+	    val[k] += w * in_val[k];
+	}
       }
-    }
+    });
 		
     // Blurring
-    __m128 half = _mm_set1_ps(0.5);
+    const V half = broadcast<V>( 0.5f );
     for( int j=0; j<=d_; j++ ){
-      for( int i=0; i<M_; i++ ){
-	__m128 * old_val = values + (i+1)*value_size;
-	__m128 * new_val = new_values + (i+1)*value_size;
+      parallel_for( M_, num_threads_, kMinChunk, [&]( int begin, int end ){
+	for( int i=begin; i<end; i++ ){
+	  const V * old_val = values + (i+1)*value_size;
+	  V * new_val = new_values + (i+1)*value_size;
 				
-	int n1 = blur_neighbors_[j*M_+i].n1+1;
-	int n2 = blur_neighbors_[j*M_+i].n2+1;
-	__m128 * n1_val = values + n1*value_size;
-	__m128 * n2_val = values + n2*value_size;
-	for( int k=0; k<value_size; k++ )
-	  new_val[k] = old_val[k]+half*(n1_val[k] + n2_val[k]);
-      }
-      __m128 * tmp = values;
-      values = new_values;
-      new_values = tmp;
+	  int n1 = blur_neighbors_[j*M_+i].n1+1;
+	  int n2 = blur_neighbors_[j*M_+i].n2+1;
+	  const V * n1_val = values + n1*value_size;
+	  const V * n2_val = values + n2*value_size;
+	  for( int k=0; k<value_size; k++ )
+	    new_val[k] = old_val[k]+half*(n1_val[k] + n2_val[k]);
+	}
+      });
+      std::swap( values, new_values );
     }
     // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
-    float alpha = 1.0f / (1+powf(2, -d_));
+    const float alpha = 1.0f / (1.f+powf(2.f, -(float)d_));
 		
     // Slicing
-    for( int i=0; i<out_size; i++ ){
-      __m128 * sse_val = out + i*value_size;
-      for( int k=0; k<value_size; k++ )
-	sse_val[ k ] = Zero;
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(out_offset+i)*(d_+1)+j]+1;
-	__m128 w = _mm_set1_ps( barycentric_[(out_offset+i)*(d_+1)+j] * alpha );
+    parallel_for( out_size, num_threads_, kMinChunk, [&]( int begin, int end ){
+      for( int i=begin; i<end; i++ ){
+	V * out_val = out + i*value_size;
 	for( int k=0; k<value_size; k++ )
-	  sse_val[ k ] += w * values[ o*value_size+k ];
+	  out_val[k] = Zero;
+	for( int j=0; j<=d_; j++ ){
+	  int o = offset_[(out_offset+i)*d1+j]+1;
+	  const V w = broadcast<V>( barycentric_[(out_offset+i)*d1+j] * alpha );
+	  for( int k=0; k<value_size; k++ )
+	    out_val[k] += w * values[ o*value_size+k ];
+	}
       }
-    }
-		
-    _mm_free( values );
-    _mm_free( new_values );
+    });
+}
+
+#ifdef SSE_PERMUTOHEDRAL
+void Permutohedral::compute( __m128* out, const __m128* in, int value_size, int in_offset, int out_offset, int in_size, int out_size) const {
+    filter( out, in, value_size, in_offset, out_offset, in_size, out_size );
 }
   
 #endif
@@ -503,123 +528,29 @@ void Permutohedral::compute(float* out, const float* in, int value_size, int in_
     if ( in_size == -1)  in_size = N_ -  in_offset;
     if (out_size == -1) out_size = N_ - out_offset;
 		
+    // Pad the values of each feature to whole __m128s, in place of the
+    // outputs, which are only written once the inputs are splatted
     const int sse_value_size = (value_size-1)*sizeof(float) / sizeof(__m128) + 1;
-    // Shift all values by 1 such that -1 -> 0 (used for blurring)
-    __m128 * sse_val    = (__m128*) _mm_malloc( sse_value_size*sizeof(__m128), 16 );
-    __m128 * values     = (__m128*) _mm_malloc( (M_+2)*sse_value_size*sizeof(__m128), 16 );
-    __m128 * new_values = (__m128*) _mm_malloc( (M_+2)*sse_value_size*sizeof(__m128), 16 );
-		
-    __m128 Zero = _mm_set1_ps( 0 );
-  
-    for( int i=0; i<(M_+2)*sse_value_size; i++ )
-      values[i] = new_values[i] = Zero;
-    for( int i=0; i<sse_value_size; i++ )
-      sse_val[i] = Zero;
-		
-    // Splatting
-    for (int i = 0; i < in_size; i++) {
-      memcpy(sse_val, in+i*value_size, value_size*sizeof(float));
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(in_offset+i)*(d_+1)+j]+1;
-	__m128 w = _mm_set1_ps( barycentric_[(in_offset+i)*(d_+1)+j] );
-	for( int k=0; k<sse_value_size; k++ )
-	  values[ o*sse_value_size+k ] += w * sse_val[k];
-      }
+    const int padded_size = sse_value_size*sizeof(__m128) / sizeof(float);
+    const size_t packed_size = (size_t)std::max( in_size, out_size )*padded_size;
+    if (packed_size > packed_size_){
+      deallocate( packed_ );
+      packed_ = allocate( packed_size );
+      packed_size_ = packed_size;
     }
-    // Blurring
-    __m128 half = _mm_set1_ps(0.5);
-    for( int j=0; j<=d_; j++ ){
-      for( int i=0; i<M_; i++ ){
-	__m128 * old_val = values + (i+1)*sse_value_size;
-	__m128 * new_val = new_values + (i+1)*sse_value_size;
-				
-	int n1 = blur_neighbors_[j*M_+i].n1+1;
-	int n2 = blur_neighbors_[j*M_+i].n2+1;
-	__m128 * n1_val = values + n1*sse_value_size;
-	__m128 * n2_val = values + n2*sse_value_size;
-	for( int k=0; k<sse_value_size; k++ )
-	  new_val[k] = old_val[k]+half*(n1_val[k] + n2_val[k]);
-      }
-      __m128 * tmp = values;
-      values = new_values;
-      new_values = tmp;
-    }
-    // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
-    float alpha = 1.0f / (1+powf(2, -d_));
-		
-    // Slicing
-    for( int i=0; i<out_size; i++ ){
-      for( int k=0; k<sse_value_size; k++ )
-	sse_val[ k ] = Zero;
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(out_offset+i)*(d_+1)+j]+1;
-	__m128 w = _mm_set1_ps( barycentric_[(out_offset+i)*(d_+1)+j] * alpha );
-	for( int k=0; k<sse_value_size; k++ )
-	  sse_val[ k ] += w * values[ o*sse_value_size+k ];
+    float * packed = packed_;
+    parallel_for( in_size, num_threads_, kMinChunk, [&]( int begin, int end ){
+      for( int i=begin; i<end; i++ ){
+	memcpy( packed+i*padded_size, in+i*value_size, value_size*sizeof(float) );
+	memset( packed+i*padded_size+value_size, 0, (padded_size-value_size)*sizeof(float) );
       }
-      memcpy( out+i*value_size, sse_val, value_size*sizeof(float) );
-    }
-		
-    _mm_free( sse_val );
-    _mm_free( values );
-    _mm_free( new_values );
-
+    });
+    filter( (__m128*)packed, (const __m128*)packed, sse_value_size, in_offset, out_offset, in_size, out_size );
+    parallel_for( out_size, num_threads_, kMinChunk, [&]( int begin, int end ){
+      for( int i=begin; i<end; i++ )
+	memcpy( out+i*value_size, packed+i*padded_size, value_size*sizeof(float) );
+    });
 #else
-
-    if ( in_size == -1)  in_size = N_ -  in_offset;
-    if (out_size == -1) out_size = N_ - out_offset;
-		
-    // Shift all values by 1 such that -1 -> 0 (used for blurring)
-    float * values = new float[ (M_+2)*value_size ];
-    float * new_values = new float[ (M_+2)*value_size ];
-		
-    for( int i=0; i<(M_+2)*value_size; i++ )
-      values[i] = new_values[i] = 0;
-		
-    // Splatting
-    for( int i=0;  i<in_size; i++ ){
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(in_offset+i)*(d_+1)+j]+1;
-	float w = barycentric_[(in_offset+i)*(d_+1)+j];
-	for( int k=0; k<value_size; k++ )
-	  values[ o*value_size+k ] += w * in[ i*value_size+k ];
-      }
-    }
-		
-    for( int j=0; j<=d_; j++ ){
-      for( int i=0; i<M_; i++ ){
-	float * old_val = values + (i+1)*value_size;
-	float * new_val = new_values + (i+1)*value_size;
-				
-	int n1 = blur_neighbors_[j*M_+i].n1+1;
-	int n2 = blur_neighbors_[j*M_+i].n2+1;
-	float * n1_val = values + n1*value_size;
-	float * n2_val = values + n2*value_size;
-	for( int k=0; k<value_size; k++ )
-	  new_val[k] = old_val[k]+0.5f*(n1_val[k] + n2_val[k]);
-      }
-      float * tmp = values;
-      values = new_values;
-      new_values = tmp;
-    }
-    // Alpha is a magic scaling constant (write Andrew if you really wanna understand this)
-    float alpha = 1.0f / (1.f+powf(2.f, -(float)d_));
-		
-    // Slicing
-    for( int i=0; i<out_size; i++ ){
-      for( int k=0; k<value_size; k++ )
-	out[i*value_size+k] = 0;
-      for( int j=0; j<=d_; j++ ){
-	int o = offset_[(out_offset+i)*(d_+1)+j]+1;
-	float w = barycentric_[(out_offset+i)*(d_+1)+j];
-	for( int k=0; k<value_size; k++ )
-	  out[ i*value_size+k ] += w * values[ o*value_size+k ] * alpha;
-      }
-    }
-		
-    delete[] values;
-    delete[] new_values;
-
+    filter( out, in, value_size, in_offset, out_offset, in_size, out_size );
 #endif
-
 }
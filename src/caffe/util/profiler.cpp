@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+
+#include "caffe/util/profiler.hpp"
+
+namespace caffe {
+
+static const char* const kEventNames[] = {
+  "forward", "backward", "reshape", "data_wait"
+};
+
+static string JsonString(const string& value) {
+  std::ostringstream out;
+  out << '"';
+  for (int i = 0; i < value.size(); ++i) {
+    const char c = value[i];
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+static void WriteBlobs(std::ostream& out, const vector<string>& names,
+    const vector<int64_t>& bytes) {
+  out << "[";
+  for (int i = 0; i < names.size(); ++i) {
+    out << (i ? ", " : "") << "{\"name\": " << JsonString(names[i])
+        << ", \"bytes\": " << bytes[i] << "}";
+  }
+  out << "]";
+}
+
+static void WriteFile(const string& filename, const string& contents) {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  out << contents;
+  CHECK(out) << "Failed to write " << filename;
+}
+
+Profiler::Profiler(const vector<string>& layer_names,
+    const vector<string>& layer_types)
+    : layer_names_(layer_names), layer_types_(layer_types),
+      samples_(layer_names.size() * kNumEvents),
+      blob_bytes_(layer_names.size()),
+      origin_(boost::posix_time::microsec_clock::local_time()),
+      start_us_(0) {
+  CHECK_EQ(layer_names.size(), layer_types.size());
+}
+
+void Profiler::Clear() {
+  for (int i = 0; i < samples_.size(); ++i) {
+    samples_[i].clear();
+  }
+  calls_.clear();
+  origin_ = boost::posix_time::microsec_clock::local_time();
+}
+
+double Profiler::Now() const {
+  return (boost::posix_time::microsec_clock::local_time() - origin_)
+      .total_microseconds();
+}
+
+void Profiler::Start() {
+  start_us_ = Now();
+  timer_.Start();
+}
+
+void Profiler::Stop(const int layer_id, const Event event) {
+  timer_.Stop();
+  Record(layer_id, event, timer_.MicroSeconds());
+}
+
+void Profiler::Record(const int layer_id, const Event event,
+    const float microseconds) {
+  CHECK_GE(layer_id, 0);
+  CHECK_LT(layer_id, num_layers());
+  samples_[layer_id * kNumEvents + event].push_back(microseconds);
+  Call call = { layer_id, event, start_us_, microseconds };
+  calls_.push_back(call);
+}
+
+void Profiler::SetBlobNames(const int layer_id,
+    const vector<string>& bottom_names, const vector<string>& top_names) {
+  CHECK_GE(layer_id, 0);
+  CHECK_LT(layer_id, num_layers());
+  BlobBytes& blobs = blob_bytes_[layer_id];
+  blobs.bottom_names = bottom_names;
+  blobs.bottom_bytes.assign(bottom_names.size(), 0);
+  blobs.top_names = top_names;
+  blobs.top_bytes.assign(top_names.size(), 0);
+}
+
+void Profiler::SetBlobBytes(const int layer_id,
+    const vector<int64_t>& bottom_bytes, const vector<int64_t>& top_bytes) {
+  CHECK_GE(layer_id, 0);
+  CHECK_LT(layer_id, num_layers());
+  BlobBytes& blobs = blob_bytes_[layer_id];
+  CHECK_EQ(blobs.bottom_names.size(), bottom_bytes.size());
+  CHECK_EQ(blobs.top_names.size(), top_bytes.size());
+  blobs.bottom_bytes = bottom_bytes;
+  blobs.top_bytes = top_bytes;
+}
+
+Profiler::Stats Profiler::ComputeStats(const vector<float>& microseconds) {
+  Stats stats = { 0, 0, 0, 0, 0, 0, 0 };
+  const int n = microseconds.size();
+  if (n == 0) {
+    return stats;
+  }
+  vector<float> sorted(microseconds);
+  std::sort(sorted.begin(), sorted.end());
+  double total = 0;
+  for (int i = 0; i < n; ++i) {
+    total += sorted[i];
+  }
+  const double percents[] = { 50, 90, 99 };
+  double percentiles[3];
+  for (int p = 0; p < 3; ++p) {
+    const int rank = static_cast<int>(std::ceil(percents[p] / 100. * n));
+    percentiles[p] = sorted[std::max(rank, 1) - 1];
+  }
+  stats.count = n;
+  stats.total_ms = total / 1000.;
+  stats.mean_ms = total / n / 1000.;
+  stats.p50_ms = percentiles[0] / 1000.;
+  stats.p90_ms = percentiles[1] / 1000.;
+  stats.p99_ms = percentiles[2] / 1000.;
+  stats.max_ms = sorted[n - 1] / 1000.;
+  return stats;
+}
+
+Profiler::Stats Profiler::LayerStats(const int layer_id,
+    const Event event) const {
+  CHECK_GE(layer_id, 0);
+  CHECK_LT(layer_id, num_layers());
+  return ComputeStats(samples_[layer_id * kNumEvents + event]);
+}
+
+string Profiler::Report() const {
+  std::ostringstream out;
+  out << "{\n  \"layers\": [";
+  double totals_ms[kNumEvents] = { 0 };
+  for (int i = 0; i < num_layers(); ++i) {
+    out << (i ? "," : "") << "\n    {\"name\": " << JsonString(layer_names_[i])
+        << ", \"type\": " << JsonString(layer_types_[i]);
+    const BlobBytes& blobs = blob_bytes_[i];
+    out << ",\n     \"bottoms\": ";
+    WriteBlobs(out, blobs.bottom_names, blobs.bottom_bytes);
+    out << ",\n     \"tops\": ";
+    WriteBlobs(out, blobs.top_names, blobs.top_bytes);
+    for (int e = 0; e < kNumEvents; ++e) {
+      const Stats stats = LayerStats(i, static_cast<Event>(e));
+      if (stats.count == 0) {
+        continue;
+      }
+      totals_ms[e] += stats.total_ms;
+      out << ",\n     \"" << kEventNames[e] << "\": {\"count\": "
+          << stats.count << ", \"total_ms\": " << stats.total_ms
+          << ", \"mean_ms\": " << stats.mean_ms
+          << ", \"p50_ms\": " << stats.p50_ms
+          << ", \"p90_ms\": " << stats.p90_ms
+          << ", \"p99_ms\": " << stats.p99_ms
+          << ", \"max_ms\": " << stats.max_ms << "}";
+    }
+    out << "}";
+  }
+  out << "\n  ],\n  \"total_ms\": {";
+  for (int e = 0; e < kNumEvents; ++e) {
+    out << (e ? ", " : "") << "\"" << kEventNames[e] << "\": "
+        << totals_ms[e];
+  }
+  out << "}\n}\n";
+  return out.str();
+}
+
+string Profiler::ChromeTrace() const {
+  std::ostringstream out;
+  out << "{\"traceEvents\": [";
+  for (int i = 0; i < calls_.size(); ++i) {
+    const Call& call = calls_[i];
+    // Data waits start with the forward of their layer and nest inside it.
+    out << (i ? "," : "") << "\n  {\"name\": "
+        << JsonString(layer_names_[call.layer_id])
+        << ", \"cat\": \"" << kEventNames[call.event] << "\""
+        << ", \"ph\": \"X\", \"pid\": 0, \"tid\": 0"
+        << ", \"ts\": " << static_cast<int64_t>(call.start_us)
+        << ", \"dur\": " << call.duration_us
+        << ", \"args\": {\"type\": " << JsonString(layer_types_[call.layer_id])
+        << "}}";
+  }
+  out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+  return out.str();
+}
+
+void Profiler::WriteReport(const string& filename) const {
+  WriteFile(filename, Report());
+}
+
+void Profiler::WriteChromeTrace(const string& filename) const {
+  WriteFile(filename, ChromeTrace());
+}
+
+}  // namespace caffe
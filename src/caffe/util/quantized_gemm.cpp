@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/quantized_gemm.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+bool caffe_cpu_quantize_u8(const int n, const Dtype* x, const int offset,
+    uint8_t* q) {
+  for (int i = 0; i < n; ++i) {
+    const int v = static_cast<int>(x[i]);
+    const int u = v + offset;
+    if (Dtype(v) != x[i] || u < 0 || u > 255) {
+      return false;
+    }
+    q[i] = static_cast<uint8_t>(u);
+  }
+  return true;
+}
+
+template bool caffe_cpu_quantize_u8<float>(const int n, const float* x,
+    const int offset, uint8_t* q);
+template bool caffe_cpu_quantize_u8<double>(const int n, const double* x,
+    const int offset, uint8_t* q);
+
+void caffe_cpu_gemm_u8u8s32(const int M, const int N, const int K,
+    const uint8_t* A, const int* a_zero_point, const int* a_row_sum,
+    const uint8_t* B, const int b_zero_point, int* C) {
+  CHECK_LE(K, kQuantizedGemmMaxDepth);
+  // Column sums of B carry the a_zero_point correction.
+  std::vector<int> b_col_sum(N, 0);
+  for (int k = 0; k < K; ++k) {
+    const uint8_t* b = B + k * N;
+    for (int n = 0; n < N; ++n) {
+      b_col_sum[n] += b[n];
+    }
+  }
+  // The raw products are accumulated for four rows of A at a time over a
+  // panel of kBlockN columns of B, so each B element loaded feeds four
+  // multiply-adds and the inner loop is a plain widening integer
+  // multiply-accumulate the compiler vectorizes.
+  const int kBlockM = 4;
+  const int kBlockN = 256;
+  int acc[kBlockM][kBlockN];
+  for (int n0 = 0; n0 < N; n0 += kBlockN) {
+    const int nb = std::min(kBlockN, N - n0);
+    for (int m0 = 0; m0 < M; m0 += kBlockM) {
+      const int mb = std::min(kBlockM, M - m0);
+      memset(acc, 0, sizeof(acc));
+      for (int k = 0; k < K; ++k) {
+        int a[kBlockM] = {0, 0, 0, 0};
+        for (int i = 0; i < mb; ++i) {
+          a[i] = A[(m0 + i) * K + k];
+        }
+        const uint8_t* b = B + k * N + n0;
+        for (int n = 0; n < nb; ++n) {
+          const int bv = b[n];
+          acc[0][n] += a[0] * bv;
+          acc[1][n] += a[1] * bv;
+          acc[2][n] += a[2] * bv;
+          acc[3][n] += a[3] * bv;
+        }
+      }
+      for (int i = 0; i < mb; ++i) {
+        const int m = m0 + i;
+        const long long za = a_zero_point[m];
+        const long long row_term = (long long)b_zero_point * a_row_sum[m] -
+            za * b_zero_point * K;
+        int* c = C + m * N + n0;
+        for (int n = 0; n < nb; ++n) {
+          c[n] = static_cast<int>(acc[i][n] - row_term - za * b_col_sum[n0 + n]);
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_cpu_requantize(const int channels, const int spatial_dim,
+    int* acc, const int* bias, const Requantizer* rq, const Dtype saturate,
+    Dtype* y) {
+  for (int c = 0; c < channels; ++c) {
+    int* a = acc + c * spatial_dim;
+    Dtype* out = y + c * spatial_dim;
+    if (bias) {
+      for (int i = 0; i < spatial_dim; ++i) {
+        a[i] += bias[c];
+      }
+    }
+    const Dtype zero_point = Dtype(rq[c].zero_point);
+    switch (rq[c].mode) {
+    case Requantizer::SINGLE_ROUND:
+    case Requantizer::DOUBLE_ROUND:
+      MultiplyByQuantizedMultiplierVR(spatial_dim, a, rq[c].mul, rq[c].shift,
+          static_cast<int>(rq[c].mode));
+      // fall through
+    case Requantizer::NONE:
+      for (int i = 0; i < spatial_dim; ++i) {
+        out[i] = Dtype(a[i]) + zero_point;
+      }
+      break;
+    case Requantizer::FLOAT_SCALE:
+      for (int i = 0; i < spatial_dim; ++i) {
+        out[i] = std::rint(Dtype(a[i]) * rq[c].scale) + zero_point;
+      }
+      break;
+    }
+    caffe_cpu_saturate(spatial_dim, out, saturate);
+  }
+}
+
+template void caffe_cpu_requantize<float>(const int channels,
+    const int spatial_dim, int* acc, const int* bias, const Requantizer* rq,
+    const float saturate, float* y);
+template void caffe_cpu_requantize<double>(const int channels,
+    const int spatial_dim, int* acc, const int* bias, const Requantizer* rq,
+    const double saturate, double* y);
+
+}  // namespace caffe
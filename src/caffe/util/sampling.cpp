@@ -0,0 +1,297 @@
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/math_functions_simd.hpp"
+#include "caffe/util/sampling.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Calls task(begin, end) on contiguous ranges covering [0, n), one for each
+// of Caffe::num_threads() threads, so that a task sets up its scratch memory
+// once.
+template <typename Task>
+static void ParallelRanges(const int n, const Task& task) {
+  const int num_tasks = std::min(n, Caffe::num_threads());
+  if (num_tasks <= 1) {
+    task(0, n);
+    return;
+  }
+  Caffe::thread_pool(num_tasks).Run(num_tasks, [&](int t, int /*worker*/) {
+    task(static_cast<int64_t>(n) * t / num_tasks,
+        static_cast<int64_t>(n) * (t + 1) / num_tasks);
+  });
+}
+
+static inline int SimdGatherTaps(const int n, const float* src,
+    const int* index, const float* weight, const int taps, const int ld,
+    float* dst) {
+  return caffe_simd_gather_taps(n, src, index, weight, taps, ld, dst);
+}
+
+static inline int SimdGatherTaps(const int n, const double* src,
+    const int* index, const double* weight, const int taps, const int ld,
+    double* dst) {
+  return 0;
+}
+
+// dst[i] = the sum over k < taps of weight[k * ld + i] * src[index[k * ld + i]]
+// for i < n.
+template <typename Dtype>
+static void GatherTaps(const int n, const Dtype* src, const int* index,
+    const Dtype* weight, const int taps, const int ld, Dtype* dst) {
+  const int done = SimdGatherTaps(n, src, index, weight, taps, ld, dst);
+  for (int i = done; i < n; ++i) {
+    Dtype sum = 0;
+    for (int k = 0; k < taps; ++k) {
+      sum += weight[k * ld + i] * src[index[k * ld + i]];
+    }
+    dst[i] = sum;
+  }
+}
+
+// Lays out the taps of each output, padding the shorter lists with taps of
+// weight zero on their last input (or on input 0 when they are empty).
+template <typename Dtype>
+static void SetTaps(const vector<vector<std::pair<int, Dtype> > >& taps,
+    SampleAxis<Dtype>* axis) {
+  const int size = taps.size();
+  int max_taps = 1;
+  for (int i = 0; i < size; ++i) {
+    max_taps = std::max(max_taps, static_cast<int>(taps[i].size()));
+  }
+  axis->size = size;
+  axis->taps = max_taps;
+  axis->index.assign(max_taps * size, 0);
+  axis->weight.assign(max_taps * size, Dtype(0));
+  for (int i = 0; i < size; ++i) {
+    for (int k = 0; k < max_taps; ++k) {
+      if (k < taps[i].size()) {
+        axis->index[k * size + i] = taps[i][k].first;
+        axis->weight[k * size + i] = taps[i][k].second;
+      } else if (!taps[i].empty()) {
+        axis->index[k * size + i] = taps[i].back().first;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void caffe_bilinear_axis(const int in_size, const int out_size,
+    SampleAxis<Dtype>* axis) {
+  const float rscale = (out_size > 1) ?
+      static_cast<float>(in_size - 1) / (out_size - 1) : 0.f;
+  vector<vector<std::pair<int, Dtype> > > taps(out_size);
+  for (int i = 0; i < out_size; ++i) {
+    const float r = rscale * i;
+    const int i0 = r;
+    const int p = (i0 < in_size - 1) ? 1 : 0;
+    const Dtype lambda1 = r - i0;
+    taps[i].push_back(std::make_pair(i0, Dtype(1.) - lambda1));
+    // Without the empty taps, grids of the same size copy their rows.
+    if (lambda1 != 0) {
+      taps[i].push_back(std::make_pair(i0 + p, lambda1));
+    }
+  }
+  SetTaps(taps, axis);
+}
+
+template <typename Dtype>
+void caffe_nearest_axis(const int in_size, const int out_size,
+    const float scale, const float start, SampleAxis<Dtype>* axis) {
+  vector<vector<std::pair<int, Dtype> > > taps(out_size);
+  for (int i = 0; i < out_size; ++i) {
+    const int nearest = std::round(i * scale + start);
+    taps[i].push_back(std::make_pair(
+        std::min(std::max(nearest, 0), in_size - 1), Dtype(1)));
+  }
+  SetTaps(taps, axis);
+}
+
+static float bicubicCoeff(float x_) {
+  float x = fabs(x_);
+  if (x <= 1.0f)     return x * x * (1.5f * x - 2.5f) + 1.0f;
+  else if (x < 2.0f) return x * (x * (-0.5f * x + 2.5f) - 4.0f) + 2.0f;
+  else               return 0.0f;
+}
+
+static float boxCoeff(float x) {
+  if (-0.5 <= x && x < 0.5) return 1.0;
+  return 0;
+}
+
+static float triangleCoeff(float x) {
+  if (-1 <= x && x < 0) return x + 1;
+  if (0 <= x && x <= 1) return 1 - x;
+  return 0;
+}
+
+template <typename Dtype>
+void caffe_filter_axis(const int in_size, const int out_size,
+    const float scale, const float start, const SampleFilter filter,
+    const bool antialias, SampleAxis<Dtype>* axis) {
+  int kernel_width;
+  if (filter == SAMPLE_FILTER_CUBIC) kernel_width = 4;
+  else if (filter == SAMPLE_FILTER_BOX) kernel_width = 1;
+  else kernel_width = 2;
+  const float a = 1.0f / (antialias ? scale : 1.0f);
+  const int radius = (scale < 1.0f) ? 2 : ceil(float(kernel_width) / a);
+  vector<vector<std::pair<int, Dtype> > > taps(out_size);
+  for (int i = 0; i < out_size; ++i) {
+    const float in = i * scale + start;
+    const int in_round = round(in);
+    Dtype wsum = 0;
+    for (int j = std::max(in_round - radius, 0);
+         j <= std::min(in_round + radius, in_size - 1); ++j) {
+      float w;
+      if (filter == SAMPLE_FILTER_CUBIC) w = a * bicubicCoeff(a * (in - j));
+      else if (filter == SAMPLE_FILTER_BOX) w = a * boxCoeff(a * (in - j));
+      else w = a * triangleCoeff(a * (in - j));
+      if (w != 0) {
+        taps[i].push_back(std::make_pair(j, Dtype(w)));
+        wsum += w;
+      }
+    }
+    // The filters of the two axes are separable, and so is their sum: the
+    // normalized product of ResampleLayer is the product of normalized taps.
+    for (int k = 0; k < taps[i].size(); ++k) {
+      taps[i][k].second = wsum ? taps[i][k].second / wsum : Dtype(0);
+    }
+  }
+  SetTaps(taps, axis);
+}
+
+template <typename Dtype>
+void caffe_cpu_resample(const int planes, const SampleAxis<Dtype>& axis_y,
+    const SampleAxis<Dtype>& axis_x, const Dtype* src, const int src_width,
+    const int src_plane, Dtype* dst, const int dst_width,
+    const int dst_plane) {
+  const int height = axis_y.size;
+  const int width = axis_x.size;
+  // The blends of input rows only span the columns that axis_x reads.
+  const int src_cols =
+      *std::max_element(axis_x.index.begin(), axis_x.index.end()) + 1;
+  ParallelRanges(planes * height, [&](int begin, int end) {
+    vector<Dtype> blend(src_cols);
+    for (int row = begin; row < end; ++row) {
+      const int p = row / height;
+      const int y = row % height;
+      const Dtype* src_p = src + p * src_plane;
+      const Dtype* line = src_p + axis_y.index[y] * src_width;
+      const Dtype w0 = axis_y.weight[y];
+      if (axis_y.taps > 1 || w0 != Dtype(1)) {
+        caffe_cpu_scale(src_cols, w0, line, &blend[0]);
+        for (int k = 1; k < axis_y.taps; ++k) {
+          const Dtype w = axis_y.weight[k * height + y];
+          if (w != 0) {
+            caffe_axpy(src_cols, w,
+                src_p + axis_y.index[k * height + y] * src_width,
+                &blend[0]);
+          }
+        }
+        line = &blend[0];
+      }
+      GatherTaps(width, line, &axis_x.index[0], &axis_x.weight[0],
+          axis_x.taps, width, dst + p * dst_plane + y * dst_width);
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_cpu_flow_warp(const int num, const int channels, const int height,
+    const int width, const Dtype* image, const Dtype* flow,
+    const Dtype fill_value, Dtype* top) {
+  const int spatial_dim = height * width;
+  ParallelRanges(num * height, [&](int begin, int end) {
+    // The corners top left, top right, bottom left and bottom right of the
+    // pixels of a row, and whether they lie in the image.
+    vector<int> index(4 * width);
+    vector<Dtype> weight(4 * width);
+    vector<char> inside(width);
+    for (int row = begin; row < end; ++row) {
+      const int n = row / height;
+      const int y = row % height;
+      const Dtype* flow_x = flow + 2 * n * spatial_dim + y * width;
+      const Dtype* flow_y = flow_x + spatial_dim;
+      bool any_outside = false;
+      for (int x = 0; x < width; ++x) {
+        const float x2 = float(x) + float(flow_x[x]);
+        const float y2 = float(y) + float(flow_y[x]);
+        inside[x] = x2 >= 0 && y2 >= 0 && x2 < width && y2 < height;
+        if (!inside[x]) {
+          any_outside = true;
+          for (int k = 0; k < 4; ++k) {
+            index[k * width + x] = 0;
+            weight[k * width + x] = 0;
+          }
+          continue;
+        }
+        const int ix2_L = int(x2);
+        const int iy2_T = int(y2);
+        const int ix2_R = std::min(ix2_L + 1, width - 1);
+        const int iy2_B = std::min(iy2_T + 1, height - 1);
+        const float alpha = x2 - ix2_L;
+        const float beta = y2 - iy2_T;
+        index[x] = iy2_T * width + ix2_L;
+        index[width + x] = iy2_T * width + ix2_R;
+        index[2 * width + x] = iy2_B * width + ix2_L;
+        index[3 * width + x] = iy2_B * width + ix2_R;
+        weight[x] = (1 - alpha) * (1 - beta);
+        weight[width + x] = alpha * (1 - beta);
+        weight[2 * width + x] = (1 - alpha) * beta;
+        weight[3 * width + x] = alpha * beta;
+      }
+      for (int c = 0; c < channels; ++c) {
+        const int offset = (n * channels + c) * spatial_dim;
+        Dtype* top_row = top + offset + y * width;
+        GatherTaps(width, image + offset, &index[0], &weight[0], 4, width,
+            top_row);
+        if (any_outside) {
+          for (int x = 0; x < width; ++x) {
+            if (!inside[x]) {
+              top_row[x] = fill_value;
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+template void caffe_bilinear_axis<float>(const int in_size,
+    const int out_size, SampleAxis<float>* axis);
+template void caffe_bilinear_axis<double>(const int in_size,
+    const int out_size, SampleAxis<double>* axis);
+template void caffe_nearest_axis<float>(const int in_size,
+    const int out_size, const float scale, const float start,
+    SampleAxis<float>* axis);
+template void caffe_nearest_axis<double>(const int in_size,
+    const int out_size, const float scale, const float start,
+    SampleAxis<double>* axis);
+template void caffe_filter_axis<float>(const int in_size, const int out_size,
+    const float scale, const float start, const SampleFilter filter,
+    const bool antialias, SampleAxis<float>* axis);
+template void caffe_filter_axis<double>(const int in_size,
+    const int out_size, const float scale, const float start,
+    const SampleFilter filter, const bool antialias,
+    SampleAxis<double>* axis);
+template void caffe_cpu_resample<float>(const int planes,
+    const SampleAxis<float>& axis_y, const SampleAxis<float>& axis_x,
+    const float* src, const int src_width, const int src_plane, float* dst,
+    const int dst_width, const int dst_plane);
+template void caffe_cpu_resample<double>(const int planes,
+    const SampleAxis<double>& axis_y, const SampleAxis<double>& axis_x,
+    const double* src, const int src_width, const int src_plane,
+    double* dst, const int dst_width, const int dst_plane);
+template void caffe_cpu_flow_warp<float>(const int num, const int channels,
+    const int height, const int width, const float* image,
+    const float* flow, const float fill_value, float* top);
+template void caffe_cpu_flow_warp<double>(const int num, const int channels,
+    const int height, const int width, const double* image,
+    const double* flow, const double fill_value, double* top);
+
+}  // namespace caffe
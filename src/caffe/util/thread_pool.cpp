@@ -0,0 +1,107 @@
+#include <boost/thread.hpp>
+#include <exception>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable work_condition_;
+  boost::condition_variable done_condition_;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads), sync_(new sync()), task_(NULL),
+      num_tasks_(0), next_task_(0), busy_workers_(0), generation_(0),
+      stop_(false) {
+  CHECK_GE(num_threads, 1);
+  try {
+    for (int i = 1; i < num_threads; ++i) {
+      workers_.push_back(shared_ptr<boost::thread>(
+          new boost::thread(&ThreadPool::WorkerEntry, this, i)));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  // The owner may be an interruptible InternalThread; an interruption must
+  // neither abort the joins nor throw from here.
+  boost::this_thread::disable_interruption no_interruption;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    stop_ = true;
+  }
+  sync_->work_condition_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void ThreadPool::Run(int num_tasks,
+    const boost::function<void(int, int)>& task) {
+  if (workers_.empty() || num_tasks <= 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i, 0);
+    }
+    return;
+  }
+  // Leaving before the workers are done would free task under them, so an
+  // interruption of the calling thread waits for the next interruption point.
+  boost::this_thread::disable_interruption no_interruption;
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    task_ = &task;
+    num_tasks_ = num_tasks;
+    next_task_ = 0;
+    busy_workers_ = workers_.size();
+    ++generation_;
+  }
+  sync_->work_condition_.notify_all();
+  RunTasks(0);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (busy_workers_ > 0) {
+    sync_->done_condition_.wait(lock);
+  }
+  task_ = NULL;
+}
+
+void ThreadPool::RunTasks(int worker) {
+  for (;;) {
+    int i;
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      if (next_task_ >= num_tasks_) {
+        return;
+      }
+      i = next_task_++;
+    }
+    (*task_)(i, worker);
+  }
+}
+
+void ThreadPool::WorkerEntry(int worker) {
+  int generation = 0;
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!stop_ && generation_ == generation) {
+        sync_->work_condition_.wait(lock);
+      }
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+    }
+    RunTasks(worker);
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    if (--busy_workers_ == 0) {
+      sync_->done_condition_.notify_one();
+    }
+  }
+}
+
+}  // namespace caffe
@@ -48,6 +48,18 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(threads, 1,
+    "Optional; the number of CPU threads a layer may use in CPU mode.");
+DEFINE_int32(host_pool_mb, 0,
+    "Optional; megabytes of freed host memory to keep for reuse in CPU mode.");
+DEFINE_bool(host_huge_pages, false,
+    "Optional; back host buffers of 2 MB and more with huge pages.");
+DEFINE_string(profile_json, "",
+    "Optional; for 'time', also run the iterations through the net profiler "
+    "and write its per-layer percentile report to this JSON file.");
+DEFINE_string(profile_trace, "",
+    "Optional; for 'time', write every layer call of the profiled "
+    "iterations to this file in the chrome://tracing format.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -413,7 +425,40 @@ int time() {
   LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
+  if (FLAGS_host_pool_mb > 0) {
+    const caffe::HostAllocator::Stats stats =
+        caffe::HostAllocator::Get().stats();
+    LOG(INFO) << "Host memory pool: " << stats.hits << " hits, "
+      << stats.misses << " misses, " << stats.retained_bytes
+      << " bytes retained.";
+  }
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_profile_json.size() || FLAGS_profile_trace.size()) {
+    LOG(INFO) << "Profiling for " << FLAGS_iterations << " iterations.";
+    caffe_net.EnableProfiler(true);
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      caffe_net.Forward();
+      caffe_net.Backward();
+    }
+    caffe_net.EnableProfiler(false);
+    const caffe::Profiler& profiler = *caffe_net.profiler();
+    for (int i = 0; i < layers.size(); ++i) {
+      const caffe::Profiler::Stats forward =
+          profiler.LayerStats(i, caffe::Profiler::FORWARD);
+      LOG(INFO) << std::setfill(' ') << std::setw(10)
+        << caffe_net.layer_names()[i] << "\tforward p50/p90/p99: "
+        << forward.p50_ms << " / " << forward.p90_ms << " / "
+        << forward.p99_ms << " ms.";
+    }
+    if (FLAGS_profile_json.size()) {
+      profiler.WriteReport(FLAGS_profile_json);
+      LOG(INFO) << "Wrote profile report to " << FLAGS_profile_json;
+    }
+    if (FLAGS_profile_trace.size()) {
+      profiler.WriteChromeTrace(FLAGS_profile_trace);
+      LOG(INFO) << "Wrote profile trace to " << FLAGS_profile_trace;
+    }
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -433,6 +478,10 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_num_threads(FLAGS_threads);
+  caffe::HostAllocator::Get().set_max_retained_bytes(
+      static_cast<size_t>(FLAGS_host_pool_mb) << 20);
+  caffe::HostAllocator::Get().set_huge_pages(FLAGS_host_huge_pages);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
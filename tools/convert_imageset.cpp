@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
@@ -22,6 +23,7 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/ordered_pipeline.hpp"
 #include "caffe/util/rng.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
@@ -42,6 +44,11 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Optional; the number of threads reading and encoding the images, "
+    "0 for one per core. The db is the same whatever the number.");
+DEFINE_int32(commit_size, 1000,
+    "Optional; the number of images written to the db per transaction.");
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -101,13 +108,26 @@ int main(int argc, char** argv) {
 
   // Storing to db
   std::string root_folder(argv[1]);
-  Datum datum;
+  const int num_threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max<int>(1, boost::thread::hardware_concurrency());
+  const int commit_size = std::max<int>(1, FLAGS_commit_size);
+  LOG(INFO) << "Converting with " << num_threads << " threads.";
+  // The workers read, resize and encode the images into the slots of their
+  // lines, which are written to the db in the order of the lines.
+  struct Slot {
+    bool status;
+    int data_size;
+    int data_length;
+    string out;
+  };
+  std::vector<Slot> slots(8 * num_threads);
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
+  RunOrderedPipeline(lines.size(), num_threads, slots.size(),
+      [&](int line_id, int s) {
+    Slot& slot = slots[s];
     std::string enc = encode_type;
     if (encoded && !enc.size()) {
       // Guess the encoding type from the file name
@@ -118,37 +138,42 @@ int main(int argc, char** argv) {
       enc = fn.substr(p+1);
       std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
     }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
+    Datum datum;
+    slot.status = ReadImageToDatum(root_folder + lines[line_id].first,
         lines[line_id].second, resize_height, resize_width, is_color,
         enc, &datum);
-    if (status == false) continue;
+    if (slot.status == false) return;
+    slot.data_size = datum.channels() * datum.height() * datum.width();
+    slot.data_length = datum.data().size();
+    CHECK(datum.SerializeToString(&slot.out));
+  }, [&](int line_id, int s) {
+    Slot& slot = slots[s];
+    if (slot.status == false) return;
     if (check_size) {
       if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
+        data_size = slot.data_size;
         data_size_initialized = true;
       } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+        CHECK_EQ(slot.data_length, data_size) << "Incorrect data field size "
+            << slot.data_length;
       }
     }
     // sequential
     string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
 
     // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
+    txn->Put(key_str, slot.out);
+    slot.out.clear();
 
-    if (++count % 1000 == 0) {
+    if (++count % commit_size == 0) {
       // Commit db
       txn->Commit();
       txn.reset(db->NewTransaction());
       LOG(INFO) << "Processed " << count << " files.";
     }
-  }
+  });
   // write the last batch
-  if (count % 1000 != 0) {
+  if (count % commit_size != 0) {
     txn->Commit();
     LOG(INFO) << "Processed " << count << " files.";
   }
@@ -0,0 +1,31 @@
+// This is a script to convert trained weights to the memory-mapped format
+// (see caffe/util/mapped_weights.hpp), which nets load without copying the
+// weights and which processes on a host share through the page cache.
+// Usage:
+//    convert_mapped_weights weights_file_in mapped_weights_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 3) {
+    LOG(ERROR) << "Usage: "
+        << "convert_mapped_weights weights_file_in mapped_weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[1]), &net_param);
+  WriteMappedWeights(net_param, argv[2]);
+
+  LOG(INFO) << "Wrote mapped weights to " << argv[2];
+  return 0;
+}
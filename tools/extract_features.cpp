@@ -2,19 +2,25 @@
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "google/protobuf/text_format.h"
 
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/feature_matrix.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 using caffe::Blob;
+using caffe::BlockingQueue;
 using caffe::Caffe;
 using caffe::Datum;
+using caffe::FeatureMatrixWriter;
 using caffe::Net;
 using std::string;
 namespace db = caffe::db;
@@ -42,7 +48,11 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "db_type is lmdb or leveldb for databases of Datums, or raw or raw_fp16"
+    " for float32 or float16 matrices of one row per input, which are written"
+    " to the dataset names with an index in name.index"
+    " (see caffe/util/feature_matrix.hpp).";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -120,9 +130,18 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   std::vector<boost::shared_ptr<db::DB> > feature_dbs;
   std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
+  std::vector<boost::shared_ptr<FeatureMatrixWriter> > feature_matrices;
+  const string db_type = argv[++arg_pos];
+  const bool raw = db_type == "raw" || db_type == "raw_fp16";
   for (size_t i = 0; i < num_features; ++i) {
     LOG(INFO)<< "Opening dataset " << dataset_names[i];
+    if (raw) {
+      feature_matrices.push_back(boost::shared_ptr<FeatureMatrixWriter>(
+          new FeatureMatrixWriter(dataset_names[i], db_type == "raw" ?
+          caffe::FeatureMatrixIndex_Type_FLOAT :
+          caffe::FeatureMatrixIndex_Type_FLOAT16)));
+      continue;
+    }
     boost::shared_ptr<db::DB> db(db::GetDB(db_type));
     db->Open(dataset_names.at(i), db::NEW);
     feature_dbs.push_back(db);
@@ -132,50 +151,92 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   LOG(ERROR)<< "Extracting Features";
 
-  Datum datum;
+  // Forward runs while a writer thread stores the features of the previous
+  // batch: they are copied to one of two batches of host blobs, which the
+  // writer hands back once stored, and a NULL batch stops it.
+  typedef std::vector<boost::shared_ptr<Blob<Dtype> > > FeatureBatch;
+  std::vector<FeatureBatch> batches(2);
+  BlockingQueue<FeatureBatch*> free_batches;
+  BlockingQueue<FeatureBatch*> full_batches;
+  for (int b = 0; b < batches.size(); ++b) {
+    for (int i = 0; i < num_features; ++i) {
+      batches[b].push_back(boost::shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+    free_batches.push(&batches[b]);
+  }
   std::vector<int> image_indices(num_features, 0);
+  boost::thread writer([&]() {
+    Datum datum;
+    string out;
+    while (FeatureBatch* batch = full_batches.pop()) {
+      for (int i = 0; i < num_features; ++i) {
+        const Blob<Dtype>& feature_blob = *(*batch)[i];
+        int batch_size = feature_blob.num();
+        if (raw) {
+          feature_matrices[i]->Write(feature_blob);
+          image_indices[i] += batch_size;
+          continue;
+        }
+        int dim_features = feature_blob.count() / batch_size;
+        const Dtype* feature_blob_data;
+        for (int n = 0; n < batch_size; ++n) {
+          datum.set_height(feature_blob.height());
+          datum.set_width(feature_blob.width());
+          datum.set_channels(feature_blob.channels());
+          datum.clear_data();
+          datum.clear_float_data();
+          feature_blob_data = feature_blob.cpu_data() +
+              feature_blob.offset(n);
+          // Sized at once rather than grown element by element.
+          datum.mutable_float_data()->Resize(dim_features, 0);
+          float* float_data = datum.mutable_float_data()->mutable_data();
+          for (int d = 0; d < dim_features; ++d) {
+            float_data[d] = feature_blob_data[d];
+          }
+          string key_str = caffe::format_int(image_indices[i], 10);
+
+          CHECK(datum.SerializeToString(&out));
+          txns.at(i)->Put(key_str, out);
+          ++image_indices[i];
+          if (image_indices[i] % 1000 == 0) {
+            txns.at(i)->Commit();
+            txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
+            LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
+                " query images for feature blob " << blob_names[i];
+          }
+        }  // for (int n = 0; n < batch_size; ++n)
+      }  // for (int i = 0; i < num_features; ++i)
+      free_batches.push(batch);
+    }
+  });
+
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
     feature_extraction_net->Forward();
+    FeatureBatch* batch = free_batches.pop();
     for (int i = 0; i < num_features; ++i) {
       const boost::shared_ptr<Blob<Dtype> > feature_blob =
         feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
+      Blob<Dtype>* copy = (*batch)[i].get();
+      copy->ReshapeLike(*feature_blob);
+      caffe::caffe_copy(feature_blob->count(), feature_blob->cpu_data(),
+          copy->mutable_cpu_data());
+    }
+    full_batches.push(batch);
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
+  full_batches.push(NULL);
+  writer.join();
   // write the last batch
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
+    if (raw) {
+      feature_matrices[i]->Close();
+    } else {
+      if (image_indices[i] % 1000 != 0) {
+        txns.at(i)->Commit();
+      }
+      feature_dbs.at(i)->Close();
     }
     LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
         " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,51 @@
+// This is a script to fold the BatchNorm, BN, Scale and Bias layers of a
+// trained net into the Convolution, Deconvolution and InnerProduct layers
+// before them, and fuse the activations after those (see
+// NetParameter.fold_inference_layers), for CPU inference.
+// Usage:
+//    fold_net net_proto_file_in weights_file_in net_proto_file_out
+//        weights_file_out
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fold_net net_proto_file_in weights_file_in "
+        << "net_proto_file_out weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  net_param.set_fold_inference_layers(true);
+  // The layout conversions are left to the net that loads the output.
+  const string data_format = net_param.data_format();
+  net_param.clear_data_format();
+  net_param.mutable_state()->set_phase(TEST);
+  Caffe::set_mode(Caffe::CPU);
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(string(argv[2]));
+
+  NetParameter folded_param;
+  net.ToProto(&folded_param, false);
+  WriteProtoToBinaryFile(folded_param, argv[4]);
+  for (int i = 0; i < folded_param.layer_size(); ++i) {
+    folded_param.mutable_layer(i)->clear_blobs();
+  }
+  if (data_format != "NCHW") {
+    folded_param.set_data_format(data_format);
+  }
+  WriteProtoToTextFile(folded_param, argv[3]);
+
+  LOG(INFO) << "Wrote folded net to " << argv[3] << " and its weights to "
+      << argv[4];
+  return 0;
+}
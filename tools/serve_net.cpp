@@ -0,0 +1,348 @@
+// This is a script to serve the forward passes of a net with an
+// InferenceServer, which batches the requests that arrive together and runs
+// them on worker threads with replicas of the net sharing its weights, and to
+// report the throughput and latency.
+// Usage:
+//    serve_net -model net.prototxt [-weights net.caffemodel]
+//        (-socket path | -inputs list_file) [options]
+//
+// With -inputs, every line of list_file names a BlobProto holding one input
+// item, which -clients threads request -iterations times each, each waiting
+// for a reply before the next request.
+//
+// With -socket, requests come over a local stream socket at path. A request
+// is an int32 number of axes, the int32 dimensions of the input item (1
+// along the first axis), then its float32 elements. The reply is an int32
+// number of outputs, then for each its number of axes, its dimensions and its
+// elements, in the same way. A request whose shape is not that of the net
+// input along the other axes gets a reply of -1 outputs, and the connection
+// is closed. All numbers are in host byte order.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#ifndef _MSC_VER
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include <stdint.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/inference_server.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+using caffe::Blob;
+using caffe::BlobProto;
+using caffe::Caffe;
+using caffe::InferenceRequest;
+using caffe::InferenceServer;
+using caffe::NetParameter;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "Optional; the trained weights of the model.");
+DEFINE_int32(gpu, -1,
+    "Optional; run in GPU mode on the given device.");
+DEFINE_int32(workers, 1,
+    "The number of worker threads, each with its own replica of the net.");
+DEFINE_int32(max_batch_size, 8,
+    "The largest number of requests run as one batch.");
+DEFINE_int32(max_delay_us, 2000,
+    "How long a request may wait for others to batch with, in microseconds.");
+DEFINE_string(socket, "",
+    "Serve requests over a local socket at this path.");
+DEFINE_string(inputs, "",
+    "Serve the BlobProto files listed in this file.");
+DEFINE_int32(clients, 4,
+    "With -inputs, the number of threads sending requests.");
+DEFINE_int32(iterations, 1,
+    "With -inputs, the number of times each client requests the inputs.");
+DEFINE_string(output_dir, "",
+    "Optional; with -inputs, the directory to write the outputs of the "
+    "first iteration to, as BlobProto files <input index>_<output>.");
+DEFINE_int32(report_every, 1000,
+    "With -socket, the number of requests between reports.");
+
+// Collects the latencies of the requests served since the last report.
+class LatencyStats {
+ public:
+  LatencyStats()
+      : start_(boost::posix_time::microsec_clock::local_time()),
+        num_batches_(0) {}
+
+  // Returns the number of latencies since the last report.
+  int Add(double latency_us) {
+    boost::mutex::scoped_lock lock(mutex_);
+    latencies_us_.push_back(latency_us);
+    return latencies_us_.size();
+  }
+
+  void Report(int num_batches) {
+    boost::mutex::scoped_lock lock(mutex_);
+    const double seconds = (boost::posix_time::microsec_clock::local_time() -
+        start_).total_microseconds() / 1e6;
+    vector<double>& latencies = latencies_us_;
+    std::sort(latencies.begin(), latencies.end());
+    const int count = latencies.size();
+    double sum = 0;
+    for (int i = 0; i < count; ++i) {
+      sum += latencies[i];
+    }
+    if (count > 0 && num_batches > num_batches_) {
+      LOG(INFO) << count << " requests in " << seconds << " s: "
+          << count / seconds << " requests/s, "
+          << static_cast<double>(count) / (num_batches - num_batches_)
+          << " requests per batch";
+      LOG(INFO) << "Latency (ms): mean " << sum / count / 1000
+          << ", p50 " << latencies[count / 2] / 1000
+          << ", p90 " << latencies[count * 9 / 10] / 1000
+          << ", p99 " << latencies[count * 99 / 100] / 1000
+          << ", max " << latencies[count - 1] / 1000;
+    }
+    latencies.clear();
+    start_ = boost::posix_time::microsec_clock::local_time();
+    num_batches_ = num_batches;
+  }
+
+ private:
+  boost::mutex mutex_;
+  vector<double> latencies_us_;
+  boost::posix_time::ptime start_;
+  int num_batches_;
+};
+
+// Sends the inputs with index client, client + clients, ... in turn.
+void RunClient(InferenceServer<float>* server,
+    const vector<shared_ptr<Blob<float> > >* inputs, int client,
+    LatencyStats* stats) {
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    for (int i = client; i < inputs->size(); i += FLAGS_clients) {
+      const Blob<float>& input = *(*inputs)[i];
+      shared_ptr<InferenceRequest<float> > request(
+          new InferenceRequest<float>(input.shape()));
+      request->mutable_input()->CopyFrom(input);
+      server->Submit(request);
+      request->Wait();
+      stats->Add(request->latency_us());
+      if (iter == 0 && !FLAGS_output_dir.empty()) {
+        const vector<int>& output_ids = server->net().output_blob_indices();
+        for (int j = 0; j < output_ids.size(); ++j) {
+          BlobProto proto;
+          request->outputs()[j]->ToProto(&proto);
+          caffe::WriteProtoToBinaryFile(proto, FLAGS_output_dir + "/" +
+              caffe::format_int(i) + "_" +
+              server->net().blob_names()[output_ids[j]]);
+        }
+      }
+    }
+  }
+}
+
+int ServeInputs(InferenceServer<float>* server) {
+  std::ifstream list(FLAGS_inputs.c_str());
+  CHECK(list) << "Couldn't open " << FLAGS_inputs;
+  vector<shared_ptr<Blob<float> > > inputs;
+  string filename;
+  while (std::getline(list, filename)) {
+    if (filename.empty()) {
+      continue;
+    }
+    BlobProto proto;
+    caffe::ReadProtoFromBinaryFileOrDie(filename, &proto);
+    inputs.push_back(shared_ptr<Blob<float> >(new Blob<float>()));
+    inputs.back()->FromProto(proto);
+  }
+  CHECK(!inputs.empty()) << "No inputs listed in " << FLAGS_inputs;
+  LOG(INFO) << "Requesting " << inputs.size() << " inputs "
+      << FLAGS_iterations << " times from " << FLAGS_clients << " clients";
+  LatencyStats stats;
+  boost::thread_group clients;
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    clients.create_thread(boost::bind(&RunClient, server, &inputs, i,
+        &stats));
+  }
+  clients.join_all();
+  stats.Report(server->num_batches());
+  return 0;
+}
+
+#ifndef _MSC_VER
+bool ReadFully(int fd, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t n = read(fd, bytes, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteFully(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t n = write(fd, bytes, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool WriteBlob(int fd, const Blob<float>& blob) {
+  const int32_t num_axes = blob.num_axes();
+  vector<int32_t> shape(blob.shape().begin(), blob.shape().end());
+  return WriteFully(fd, &num_axes, sizeof(num_axes)) &&
+      WriteFully(fd, shape.data(), shape.size() * sizeof(int32_t)) &&
+      WriteFully(fd, blob.cpu_data(), blob.count() * sizeof(float));
+}
+
+template <typename T>
+string ShapeString(const vector<T>& shape) {
+  std::ostringstream stream;
+  for (int i = 0; i < shape.size(); ++i) {
+    stream << (i ? " " : "") << shape[i];
+  }
+  return stream.str();
+}
+
+// Logs why a request is refused and replies with -1 outputs.
+void ReplyError(int fd, const string& message) {
+  LOG(ERROR) << message;
+  const int32_t num_outputs = -1;
+  WriteFully(fd, &num_outputs, sizeof(num_outputs));
+}
+
+// Serves the requests of a connection one after the other.
+void ServeConnection(InferenceServer<float>* server, int fd,
+    LatencyStats* stats) {
+  // The items are batched along the first axis, with the shape of the
+  // net input along the others.
+  const vector<int>& item_shape = server->input_item_shape();
+  const int input_axes = item_shape.size();
+  for (;;) {
+    int32_t num_axes;
+    if (!ReadFully(fd, &num_axes, sizeof(num_axes))) {
+      break;
+    }
+    if (num_axes != input_axes) {
+      ReplyError(fd, "Request with " + caffe::format_int(num_axes) +
+          " axes instead of " + caffe::format_int(input_axes));
+      break;
+    }
+    vector<int32_t> dims(num_axes);
+    if (!ReadFully(fd, dims.data(), num_axes * sizeof(int32_t))) {
+      break;
+    }
+    if (vector<int>(dims.begin(), dims.end()) != item_shape) {
+      ReplyError(fd, "Request of shape " + ShapeString(dims) +
+          " instead of " + ShapeString(item_shape));
+      break;
+    }
+    shared_ptr<InferenceRequest<float> > request(
+        new InferenceRequest<float>(vector<int>(dims.begin(), dims.end())));
+    Blob<float>* input = request->mutable_input();
+    if (!ReadFully(fd, input->mutable_cpu_data(),
+        input->count() * sizeof(float))) {
+      break;
+    }
+    server->Submit(request);
+    request->Wait();
+    const int32_t num_outputs = request->outputs().size();
+    bool written = WriteFully(fd, &num_outputs, sizeof(num_outputs));
+    for (int i = 0; i < num_outputs && written; ++i) {
+      written = WriteBlob(fd, *request->outputs()[i]);
+    }
+    if (!written) {
+      break;
+    }
+    if (stats->Add(request->latency_us()) == FLAGS_report_every) {
+      stats->Report(server->num_batches());
+    }
+  }
+  close(fd);
+}
+
+int ServeSocket(InferenceServer<float>* server) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long: " << FLAGS_socket;
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd, 0) << "Couldn't create socket: " << strerror(errno);
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0) << "Couldn't bind " << FLAGS_socket << ": "
+      << strerror(errno);
+  CHECK_EQ(listen(listen_fd, 64), 0) << "Couldn't listen on " << FLAGS_socket
+      << ": " << strerror(errno);
+  LOG(INFO) << "Serving on " << FLAGS_socket;
+  LatencyStats stats;
+  for (;;) {
+    const int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      LOG(ERROR) << "Couldn't accept a connection: " << strerror(errno);
+      continue;
+    }
+    boost::thread(boost::bind(&ServeConnection, server, fd, &stats)).detach();
+  }
+  return 0;
+}
+#else
+int ServeSocket(InferenceServer<float>* server) {
+  LOG(FATAL) << "serve_net -socket needs local sockets";
+  return 1;
+}
+#endif  // _MSC_VER
+
+int main(int argc, char** argv) {
+  // Print output to stderr (while still logging).
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serve the forward passes of a net with batching.\n"
+      "Usage: serve_net -model net.prototxt [-weights net.caffemodel] "
+      "(-socket path | -inputs list_file) [options]");
+  caffe::GlobalInit(&argc, &argv);
+  if (FLAGS_model.empty() || FLAGS_socket.empty() == FLAGS_inputs.empty()) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/serve_net");
+    return 1;
+  }
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+  NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  InferenceServer<float> server(param, FLAGS_weights, FLAGS_workers,
+      FLAGS_max_batch_size, FLAGS_max_delay_us);
+  LOG(INFO) << "Started " << server.num_workers() << " workers";
+  return FLAGS_socket.empty() ? ServeInputs(&server) : ServeSocket(&server);
+}